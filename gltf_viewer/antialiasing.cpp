@@ -0,0 +1,118 @@
+#include "antialiasing.h"
+#include "gl_state.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+static const char* ANTIALIASING_MODE_NAMES[ANTIALIASING_MODE_COUNT] = { "none", "msaa2", "msaa4", "msaa8", "fxaa", "taa" };
+
+static AntiAliasingMode previous_mode = ANTIALIASING_NONE;
+static glm::mat4 previous_projection_view = glm::mat4(1.0f);
+
+static GLuint history_textures[2];
+static unsigned int history_width = 0;
+static unsigned int history_height = 0;
+static GLenum history_format = GL_NONE;
+static unsigned int history_current = 0;
+
+const char* antialiasing_mode_name(AntiAliasingMode mode) {
+	return ANTIALIASING_MODE_NAMES[mode];
+}
+
+unsigned int antialiasing_samples(AntiAliasingMode mode, unsigned int max_samples) {
+	unsigned int samples = 0;
+	if (mode == ANTIALIASING_MSAA_2) {
+		samples = 2;
+	} else if (mode == ANTIALIASING_MSAA_4) {
+		samples = 4;
+	} else if (mode == ANTIALIASING_MSAA_8) {
+		samples = 8;
+	}
+	if (samples > max_samples) {
+		samples = max_samples < 2 ? 0 : max_samples;
+	}
+	return samples;
+}
+
+const char* antialiasing_zone_name(AntiAliasingMode mode) {
+	if (mode == ANTIALIASING_FXAA) {
+		return "fxaa";
+	} else if (mode == ANTIALIASING_TAA) {
+		return "taa";
+	} else if (mode != ANTIALIASING_NONE) {
+		return "msaa_resolve";
+	}
+	return NULL;
+}
+
+static float antialiasing_halton(unsigned int index, unsigned int base) {
+	float result = 0.0f;
+	float fraction = 1.0f;
+	while (index > 0) {
+		fraction /= (float)base;
+		result += fraction * (float)(index % base);
+		index /= base;
+	}
+	return result;
+}
+
+glm::mat4 antialiasing_plan(AntiAliasingFrame* frame, AntiAliasingMode mode, const glm::mat4& view, const glm::mat4& projection, unsigned int width, unsigned int height, unsigned long frame_number) {
+	frame->mode = mode;
+	frame->projection_view = projection * view;
+	frame->previous_projection_view = previous_projection_view;
+	frame->history_valid = mode == ANTIALIASING_TAA && previous_mode == ANTIALIASING_TAA;
+	previous_mode = mode;
+	previous_projection_view = frame->projection_view;
+	if (mode != ANTIALIASING_TAA) {
+		return projection;
+	}
+
+	// Index 0 of the sequence is the pixel corner, so it starts at 1. Offsets are within half a pixel of the center.
+	unsigned int phase = (unsigned int)(frame_number % TAA_JITTER_PHASES) + 1;
+	glm::vec2 jitter = glm::vec2(antialiasing_halton(phase, 2), antialiasing_halton(phase, 3)) - glm::vec2(0.5f);
+	glm::vec3 offset = glm::vec3(jitter.x * 2.0f / (float)width, jitter.y * 2.0f / (float)height, 0.0f);
+	return glm::translate(glm::mat4(1.0f), offset) * projection;
+}
+
+bool antialiasing_begin_frame(unsigned int width, unsigned int height, GLenum internal_format) {
+	history_current = 1 - history_current;
+	if (history_textures[0] != 0 && history_width == width && history_height == height && history_format == internal_format) {
+		return true;
+	}
+
+	antialiasing_destroy_buffers();
+	glGenTextures(2, history_textures);
+	for (unsigned int i = 0; i < 2; i++) {
+		gl_state_bind_texture(0, GL_TEXTURE_2D, history_textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		// Reprojected history lands between texels
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	history_width = width;
+	history_height = height;
+	history_format = internal_format;
+	return false;
+}
+
+GLuint antialiasing_history_read() {
+	return history_textures[1 - history_current];
+}
+
+GLuint antialiasing_history_write() {
+	return history_textures[history_current];
+}
+
+// The history is stored in the scene color's format, which is 4 bytes a pixel
+size_t antialiasing_history_bytes() {
+	return history_textures[0] == 0 ? 0 : (size_t)history_width * history_height * 4 * 2;
+}
+
+void antialiasing_destroy_buffers() {
+	if (history_textures[0] != 0) {
+		glDeleteTextures(2, history_textures);
+		history_textures[0] = 0;
+		history_textures[1] = 0;
+	}
+}
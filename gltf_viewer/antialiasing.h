@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+
+// Anti-aliasing, picked at runtime:
+// - MSAA renders the forward path's scene targets multisampled. The render graph resolves the color with a blit
+//   when the present pass samples it. The deferred and visibility paths shade from single sample targets, so they
+//   render without it.
+// - FXAA is one post pass over the scene color. It finds edges from luma contrast and blends across them.
+// - TAA offsets the projection by a different sub-pixel amount each frame and blends each frame into a history.
+//   The history is reprojected with the scene depth and last frame's camera, so only camera motion is followed.
+//   History colors are clamped to the current frame's neighbourhood, which keeps ghosting down where that is wrong.
+// Each mode's own work is timed as a GPU zone, see antialiasing_zone_name(). MSAA also costs in the scene pass.
+enum AntiAliasingMode {
+	ANTIALIASING_NONE,
+	ANTIALIASING_MSAA_2,
+	ANTIALIASING_MSAA_4,
+	ANTIALIASING_MSAA_8,
+	ANTIALIASING_FXAA,
+	ANTIALIASING_TAA,
+	ANTIALIASING_MODE_COUNT
+};
+
+// Jitter follows the 2, 3 Halton sequence, repeating after this many frames
+const unsigned int TAA_JITTER_PHASES = 8;
+// Weight of the current frame against the history
+const float TAA_CURRENT_WEIGHT = 0.1f;
+
+// One frame's anti-aliasing. Built on the update thread, so it can be part of the render packet.
+struct AntiAliasingFrame {
+	AntiAliasingMode mode;
+	// Unjittered, this frame's and the previous one's
+	glm::mat4 projection_view;
+	glm::mat4 previous_projection_view;
+	// False on the first TAA frame after switching to it, there is nothing to blend with yet
+	bool history_valid;
+};
+
+const char* antialiasing_mode_name(AntiAliasingMode mode);
+// Samples of the scene targets, 0 for single sample. MSAA is capped at max_samples.
+unsigned int antialiasing_samples(AntiAliasingMode mode, unsigned int max_samples);
+// GPU timer zone of the mode's own pass, NULL if it has none
+const char* antialiasing_zone_name(AntiAliasingMode mode);
+// Returns the projection to render with, jittered for TAA. Only one thread may plan, since it remembers the last frame.
+glm::mat4 antialiasing_plan(AntiAliasingFrame* frame, AntiAliasingMode mode, const glm::mat4& view, const glm::mat4& projection, unsigned int width, unsigned int height, unsigned long frame_number);
+
+// GL side. Two history textures swap each frame, one holds the last frame's result and the other gets this one's.
+// Returns false if they were just created, so there is no history yet.
+bool antialiasing_begin_frame(unsigned int width, unsigned int height, GLenum internal_format);
+GLuint antialiasing_history_read();
+GLuint antialiasing_history_write();
+size_t antialiasing_history_bytes();
+void antialiasing_destroy_buffers();
@@ -0,0 +1,1246 @@
+#include "benchmark.h"
+#include "gpu_timer.h"
+#include "cull.h"
+#include "bvh.h"
+#include "occlusion.h"
+#include "light_cluster.h"
+#include "scene.h"
+#include "gl_state.h"
+#include "dynamic_resolution.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+
+void benchmark_init(Benchmark* benchmark, const BenchmarkSettings& settings) {
+	*benchmark = Benchmark();
+	benchmark->settings = settings;
+	benchmark->frequency = SDL_GetPerformanceFrequency();
+	benchmark->last_frame_end = SDL_GetPerformanceCounter();
+}
+
+bool benchmark_record_frame(Benchmark* benchmark, const BenchmarkFrame& frame) {
+	Uint64 now = SDL_GetPerformanceCounter();
+	double frame_time = (double)(now - benchmark->last_frame_end) * 1000.0 / (double)benchmark->frequency;
+	benchmark->last_frame_end = now;
+	benchmark->frame++;
+
+	// GPU times arrive a few frames late, so the first few measured ones still belong to the warm-up. With a
+	// steady camera path that doesn't skew the results.
+	if (benchmark->frame <= benchmark->settings.warmup_frames) {
+		std::vector<double> warmup_samples;
+		benchmark->next_gpu_sample = gpu_timer_get_samples("frame", benchmark->next_gpu_sample, &warmup_samples);
+		benchmark->next_shadow_sample = gpu_timer_get_samples("shadows", benchmark->next_shadow_sample, &warmup_samples);
+		if (!benchmark->settings.antialiasing_zone.empty()) {
+			benchmark->next_antialiasing_sample = gpu_timer_get_samples(benchmark->settings.antialiasing_zone.c_str(), benchmark->next_antialiasing_sample, &warmup_samples);
+		}
+		return false;
+	}
+
+	benchmark->cpu_frame_times.push_back(frame_time);
+	benchmark->next_gpu_sample = gpu_timer_get_samples("frame", benchmark->next_gpu_sample, &benchmark->gpu_frame_times);
+	benchmark->draws.push_back((double)frame.draws);
+	benchmark->triangles.push_back((double)frame.triangles);
+	benchmark->state_changes.push_back((double)frame.state_changes);
+	benchmark->light_cluster_ms.push_back(frame.light_cluster_ms);
+	benchmark->next_shadow_sample = gpu_timer_get_samples("shadows", benchmark->next_shadow_sample, &benchmark->shadow_gpu_times);
+	benchmark->shadow_updates.push_back((double)frame.shadow_updates);
+	benchmark->shadow_triangles.push_back((double)frame.shadow_triangles);
+	benchmark->shadow_plan_ms.push_back(frame.shadow_plan_ms);
+	if (!benchmark->settings.antialiasing_zone.empty()) {
+		benchmark->next_antialiasing_sample = gpu_timer_get_samples(benchmark->settings.antialiasing_zone.c_str(), benchmark->next_antialiasing_sample, &benchmark->antialiasing_gpu_times);
+	}
+	benchmark->render_scales.push_back((double)frame.render_scale);
+
+	return benchmark->frame >= benchmark->settings.warmup_frames + benchmark->settings.frames;
+}
+
+BenchmarkStats benchmark_compute_stats(std::vector<double> samples) {
+	BenchmarkStats stats = {};
+	stats.samples = (unsigned int)samples.size();
+	if (samples.empty()) {
+		return stats;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	double sum = 0.0;
+	for (double sample : samples) {
+		sum += sample;
+	}
+	stats.mean = sum / (double)samples.size();
+	// Nearest rank percentiles
+	stats.p50 = samples[(samples.size() - 1) * 50 / 100];
+	stats.p95 = samples[(samples.size() - 1) * 95 / 100];
+	stats.p99 = samples[(samples.size() - 1) * 99 / 100];
+	stats.min = samples.front();
+	stats.max = samples.back();
+
+	return stats;
+}
+
+// Escapes quotes, backslashes and control characters, since camera paths and driver strings can contain them
+static std::string benchmark_json_escape(const char* value) {
+	std::string escaped;
+	for (const char* c = value != NULL ? value : ""; *c != '\0'; c++) {
+		switch (*c) {
+			case '"':
+				escaped += "\\\"";
+				break;
+			case '\\':
+				escaped += "\\\\";
+				break;
+			case '\n':
+				escaped += "\\n";
+				break;
+			case '\r':
+				escaped += "\\r";
+				break;
+			case '\t':
+				escaped += "\\t";
+				break;
+			default:
+				if ((unsigned char)*c < 0x20) {
+					char code[8];
+					snprintf(code, sizeof(code), "\\u%04x", (unsigned int)(unsigned char)*c);
+					escaped += code;
+				} else {
+					escaped += *c;
+				}
+				break;
+		}
+	}
+	return escaped;
+}
+
+// Writes the results files. Keeps track of the commas and indentation, and writes objects in arrays on one line.
+struct BenchmarkJson {
+	FILE* file;
+	unsigned int depth;
+	// Nothing written yet in the open object or array
+	bool first;
+	bool single_line;
+};
+
+static bool benchmark_json_open(BenchmarkJson* json, const char* path) {
+	json->file = fopen(path, "w");
+	if (json->file == NULL) {
+		printf("Unable to open %s for writing\n", path);
+		return false;
+	}
+	fprintf(json->file, "{");
+	json->depth = 1;
+	json->first = true;
+	json->single_line = false;
+	return true;
+}
+
+static void benchmark_json_close(BenchmarkJson* json) {
+	fprintf(json->file, "\n}\n");
+	fclose(json->file);
+}
+
+// Name is NULL for array entries
+static void benchmark_json_key(BenchmarkJson* json, const char* name) {
+	if (json->single_line) {
+		fprintf(json->file, json->first ? " " : ", ");
+	} else {
+		fprintf(json->file, json->first ? "\n" : ",\n");
+		for (unsigned int i = 0; i < json->depth; i++) {
+			fprintf(json->file, "\t");
+		}
+	}
+	json->first = false;
+	if (name != NULL) {
+		fprintf(json->file, "\"%s\": ", name);
+	}
+}
+
+static void benchmark_json_close_scope(BenchmarkJson* json, const char* bracket) {
+	json->depth--;
+	if (json->single_line) {
+		fprintf(json->file, " %s", bracket);
+		json->single_line = false;
+	} else {
+		fprintf(json->file, "\n");
+		for (unsigned int i = 0; i < json->depth; i++) {
+			fprintf(json->file, "\t");
+		}
+		fprintf(json->file, "%s", bracket);
+	}
+	json->first = false;
+}
+
+static void benchmark_json_begin_object(BenchmarkJson* json, const char* name) {
+	benchmark_json_key(json, name);
+	fprintf(json->file, "{");
+	json->depth++;
+	json->first = true;
+	// Array entries and anything nested below the top level sections go on one line
+	json->single_line = name == NULL || json->depth > 2;
+}
+
+static void benchmark_json_end_object(BenchmarkJson* json) {
+	benchmark_json_close_scope(json, "}");
+}
+
+static void benchmark_json_begin_array(BenchmarkJson* json, const char* name) {
+	benchmark_json_key(json, name);
+	fprintf(json->file, "[");
+	json->depth++;
+	json->first = true;
+}
+
+static void benchmark_json_end_array(BenchmarkJson* json) {
+	benchmark_json_close_scope(json, "]");
+}
+
+static void benchmark_json_uint(BenchmarkJson* json, const char* name, unsigned int value) {
+	benchmark_json_key(json, name);
+	fprintf(json->file, "%u", value);
+}
+
+static void benchmark_json_double(BenchmarkJson* json, const char* name, double value, int decimals) {
+	benchmark_json_key(json, name);
+	fprintf(json->file, "%.*f", decimals, value);
+}
+
+static void benchmark_json_bool(BenchmarkJson* json, const char* name, bool value) {
+	benchmark_json_key(json, name);
+	fprintf(json->file, value ? "true" : "false");
+}
+
+static void benchmark_json_string(BenchmarkJson* json, const char* name, const char* value) {
+	benchmark_json_key(json, name);
+	fprintf(json->file, "\"%s\"", benchmark_json_escape(value).c_str());
+}
+
+static void benchmark_json_size(BenchmarkJson* json, const char* name, unsigned int width, unsigned int height) {
+	char size[32];
+	snprintf(size, sizeof(size), "%ux%u", width, height);
+	benchmark_json_string(json, name, size);
+}
+
+static void benchmark_json_stats(BenchmarkJson* json, const char* name, const std::vector<double>& samples) {
+	BenchmarkStats stats = benchmark_compute_stats(samples);
+	benchmark_json_begin_object(json, name);
+	benchmark_json_uint(json, "samples", stats.samples);
+	benchmark_json_double(json, "mean", stats.mean, 4);
+	benchmark_json_double(json, "p50", stats.p50, 4);
+	benchmark_json_double(json, "p95", stats.p95, 4);
+	benchmark_json_double(json, "p99", stats.p99, 4);
+	benchmark_json_double(json, "min", stats.min, 4);
+	benchmark_json_double(json, "max", stats.max, 4);
+	benchmark_json_end_object(json);
+}
+
+static double benchmark_elapsed_ms(Uint64 start) {
+	return (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// Calls run once untimed to warm the caches and size any buffers, then times it repeats times. After each timed call
+// sample is called if given, for benchmarks that also keep the times the code under test measures itself.
+static BenchmarkStats benchmark_repeat(unsigned int repeats, const std::function<void()>& run, const std::function<void()>& sample = nullptr) {
+	run();
+	std::vector<double> times;
+	for (unsigned int repeat = 0; repeat < repeats; repeat++) {
+		Uint64 start = SDL_GetPerformanceCounter();
+		run();
+		times.push_back(benchmark_elapsed_ms(start));
+		if (sample) {
+			sample();
+		}
+	}
+	return benchmark_compute_stats(times);
+}
+
+bool benchmark_write_json(const Benchmark& benchmark, const char* path) {
+	BenchmarkJson json;
+	if (!benchmark_json_open(&json, path)) {
+		return false;
+	}
+
+	const BenchmarkSettings& settings = benchmark.settings;
+	benchmark_json_string(&json, "renderer", (const char*)glGetString(GL_RENDERER));
+	benchmark_json_string(&json, "gl_version", (const char*)glGetString(GL_VERSION));
+	benchmark_json_begin_object(&json, "settings");
+	benchmark_json_uint(&json, "warmup_frames", settings.warmup_frames);
+	benchmark_json_uint(&json, "frames", settings.frames);
+	benchmark_json_string(&json, "camera_path", settings.camera_path.c_str());
+	benchmark_json_uint(&json, "spheres", settings.grid_size * settings.grid_size);
+	benchmark_json_uint(&json, "sphere_segments", settings.sphere_segments);
+	benchmark_json_uint(&json, "lights", settings.lights);
+	benchmark_json_uint(&json, "texture_size", settings.texture_size);
+	benchmark_json_bool(&json, "headless", settings.headless);
+	benchmark_json_bool(&json, "pipelined", settings.pipelined);
+	benchmark_json_string(&json, "render_path", settings.render_path.c_str());
+	benchmark_json_bool(&json, "lod", settings.lod);
+	benchmark_json_string(&json, "vertex_format", settings.vertex_format.c_str());
+	benchmark_json_string(&json, "depth_prepass", settings.depth_prepass.c_str());
+	benchmark_json_string(&json, "shading", settings.shading.c_str());
+	benchmark_json_bool(&json, "shadows", settings.shadows);
+	benchmark_json_uint(&json, "shadow_cascades", settings.shadow_cascades);
+	benchmark_json_uint(&json, "shadow_update_budget", settings.shadow_update_budget);
+	benchmark_json_double(&json, "sun_speed", settings.sun_speed, 4);
+	benchmark_json_string(&json, "antialiasing", settings.antialiasing.c_str());
+	benchmark_json_uint(&json, "antialiasing_samples", settings.antialiasing_samples);
+	benchmark_json_size(&json, "window", settings.window_width, settings.window_height);
+	benchmark_json_double(&json, "render_scale", settings.render_scale, 4);
+	benchmark_json_bool(&json, "dynamic_resolution", settings.dynamic_resolution);
+	benchmark_json_double(&json, "dynamic_resolution_budget_ms", settings.dynamic_resolution_budget_ms, 4);
+	benchmark_json_string(&json, "upscaler", settings.upscaler.c_str());
+	benchmark_json_uint(&json, "gbuffer_bytes_per_pixel", settings.gbuffer_bytes_per_pixel);
+	benchmark_json_end_object(&json);
+	benchmark_json_begin_object(&json, "results");
+	benchmark_json_stats(&json, "cpu_frame_ms", benchmark.cpu_frame_times);
+	benchmark_json_stats(&json, "gpu_frame_ms", benchmark.gpu_frame_times);
+	benchmark_json_stats(&json, "draw_calls", benchmark.draws);
+	benchmark_json_stats(&json, "triangles", benchmark.triangles);
+	benchmark_json_stats(&json, "state_changes", benchmark.state_changes);
+	benchmark_json_stats(&json, "light_cluster_ms", benchmark.light_cluster_ms);
+	benchmark_json_stats(&json, "shadow_updates", benchmark.shadow_updates);
+	benchmark_json_stats(&json, "shadow_triangles", benchmark.shadow_triangles);
+	benchmark_json_stats(&json, "shadow_plan_ms", benchmark.shadow_plan_ms);
+	benchmark_json_stats(&json, "shadow_gpu_ms", benchmark.shadow_gpu_times);
+	benchmark_json_stats(&json, "antialiasing_gpu_ms", benchmark.antialiasing_gpu_times);
+	benchmark_json_stats(&json, "render_scale", benchmark.render_scales);
+	benchmark_json_end_object(&json);
+	benchmark_json_close(&json);
+
+	return true;
+}
+
+struct CullBenchmarkRun {
+	unsigned int objects;
+	CullImplementation implementation;
+	unsigned int threads;
+	unsigned int visible;
+	BenchmarkStats stats;
+};
+
+static const unsigned int CULL_BENCHMARK_OBJECT_COUNTS[] = { 100000, 250000, 500000, 1000000 };
+static const unsigned int CULL_BENCHMARK_REPEATS = 25;
+
+// Random boxes filling a 1000 unit cube. Same seed every time so the runs are repeatable.
+static void benchmark_random_boxes(unsigned int count, std::vector<glm::vec3>* box_min, std::vector<glm::vec3>* box_max) {
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> extent(0.25f, 2.0f);
+	box_min->resize(count);
+	box_max->resize(count);
+	for (unsigned int i = 0; i < count; i++) {
+		glm::vec3 center = glm::vec3(position(random), position(random), position(random));
+		glm::vec3 half_extent = glm::vec3(extent(random), extent(random), extent(random));
+		(*box_min)[i] = center - half_extent;
+		(*box_max)[i] = center + half_extent;
+	}
+}
+
+// Looking down -z from the middle of the cube, roughly a tenth of the boxes are in view
+static Frustum benchmark_frustum() {
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	return frustum_from_matrix(projection * view);
+}
+
+bool benchmark_culling(const char* path) {
+	Frustum frustum = benchmark_frustum();
+	CullImplementation default_implementation = cull_get_implementation();
+
+	std::vector<CullBenchmarkRun> runs;
+	bool matched = true;
+	for (unsigned int object_count : CULL_BENCHMARK_OBJECT_COUNTS) {
+		std::vector<glm::vec3> box_min, box_max;
+		benchmark_random_boxes(object_count, &box_min, &box_max);
+		CullBounds bounds;
+		cull_bounds_clear(&bounds);
+		for (unsigned int i = 0; i < object_count; i++) {
+			glm::vec3 half_extent = (box_max[i] - box_min[i]) * 0.5f;
+			cull_bounds_add(&bounds, box_min[i] + half_extent, glm::length(half_extent), box_min[i], box_max[i]);
+		}
+
+		std::vector<unsigned int> reference;
+		std::vector<unsigned int> visible(object_count);
+		for (int implementation = 0; implementation < CULL_IMPLEMENTATION_COUNT; implementation++) {
+			if (!cull_implementation_supported((CullImplementation)implementation)) {
+				continue;
+			}
+			cull_set_implementation((CullImplementation)implementation);
+			for (int parallel = 0; parallel < 2; parallel++) {
+				if (parallel == 1 && cull_get_worker_count() == 0) {
+					continue;
+				}
+				cull_set_parallel(parallel == 1);
+
+				unsigned int visible_count = 0;
+				BenchmarkStats stats = benchmark_repeat(CULL_BENCHMARK_REPEATS, [&]() {
+					visible_count = cull_frustum(bounds, frustum, &visible[0]);
+				});
+
+				// Every implementation has to find exactly the same objects as the scalar one
+				if (reference.empty()) {
+					reference.assign(visible.begin(), visible.begin() + visible_count);
+				} else if (visible_count != reference.size() || !std::equal(reference.begin(), reference.end(), visible.begin())) {
+					printf("%s culling of %u objects disagrees with scalar culling\n", cull_implementation_name((CullImplementation)implementation), object_count);
+					matched = false;
+				}
+
+				CullBenchmarkRun run;
+				run.objects = object_count;
+				run.implementation = (CullImplementation)implementation;
+				run.threads = parallel == 1 && object_count >= CULL_PARALLEL_MIN_OBJECTS ? cull_get_worker_count() + 1 : 1;
+				run.visible = visible_count;
+				run.stats = stats;
+				runs.push_back(run);
+				printf("%8u objects  %-6s %u thread%s  %7u visible  %8.3f ms p50  %8.3f ms min\n", run.objects, cull_implementation_name(run.implementation), run.threads, run.threads == 1 ? " " : "s", run.visible, run.stats.p50, run.stats.min);
+			}
+		}
+	}
+	cull_set_implementation(default_implementation);
+	cull_set_parallel(true);
+
+	BenchmarkJson json;
+	if (!benchmark_json_open(&json, path)) {
+		return false;
+	}
+	benchmark_json_uint(&json, "workers", cull_get_worker_count());
+	benchmark_json_uint(&json, "repeats", CULL_BENCHMARK_REPEATS);
+	benchmark_json_begin_array(&json, "runs");
+	for (const CullBenchmarkRun& run : runs) {
+		benchmark_json_begin_object(&json, NULL);
+		benchmark_json_uint(&json, "objects", run.objects);
+		benchmark_json_string(&json, "implementation", cull_implementation_name(run.implementation));
+		benchmark_json_uint(&json, "threads", run.threads);
+		benchmark_json_uint(&json, "visible", run.visible);
+		benchmark_json_double(&json, "mean_ms", run.stats.mean, 4);
+		benchmark_json_double(&json, "p50_ms", run.stats.p50, 4);
+		benchmark_json_double(&json, "min_ms", run.stats.min, 4);
+		benchmark_json_double(&json, "max_ms", run.stats.max, 4);
+		benchmark_json_end_object(&json);
+	}
+	benchmark_json_end_array(&json);
+	benchmark_json_close(&json);
+
+	return matched;
+}
+
+struct BvhBenchmarkRun {
+	unsigned int objects;
+	unsigned int nodes;
+	unsigned int depth;
+	double build_ms;
+	double parallel_build_ms;
+	unsigned int build_threads;
+	double refit_ms;
+	unsigned int refit_objects;
+	double frustum_ms;
+	unsigned int visible;
+	unsigned int nodes_visited;
+	unsigned int subtrees_accepted;
+	double ray_ms;
+	double nearest_ms;
+};
+
+static const unsigned int BVH_BENCHMARK_OBJECT_COUNTS[] = { 100000, 250000, 500000, 1000000, 2000000 };
+static const unsigned int BVH_BENCHMARK_QUERIES = 1000;
+// Queries checked against a brute force search, which is too slow to do for all of them
+static const unsigned int BVH_BENCHMARK_CHECKED_QUERIES = 20;
+// Share of the objects moved before the refit
+static const unsigned int BVH_BENCHMARK_REFIT_DIVISOR = 100;
+
+static bool benchmark_box_in_frustum(const Frustum& frustum, glm::vec3 box_min, glm::vec3 box_max) {
+	glm::vec3 center = (box_min + box_max) * 0.5f;
+	glm::vec3 extent = (box_max - box_min) * 0.5f;
+	for (int i = 0; i < 6; i++) {
+		glm::vec3 normal = glm::vec3(frustum.planes[i]);
+		if (glm::dot(normal, center) + frustum.planes[i].w + glm::dot(glm::abs(normal), extent) < 0.0f) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Compares the BVH's visible set against testing every box
+static bool benchmark_check_bvh_frustum(const Bvh& bvh, const Frustum& frustum, std::vector<unsigned int>* visible) {
+	unsigned int count = bvh_query_frustum(bvh, frustum, &(*visible)[0], NULL);
+	std::sort(visible->begin(), visible->begin() + count);
+	unsigned int expected = 0;
+	for (unsigned int i = 0; i < (unsigned int)bvh.item_min.size(); i++) {
+		if (benchmark_box_in_frustum(frustum, bvh.item_min[i], bvh.item_max[i])) {
+			if (expected >= count || (*visible)[expected] != i) {
+				return false;
+			}
+			expected++;
+		}
+	}
+
+	return expected == count;
+}
+
+bool benchmark_bvh(const char* path, unsigned int max_threads) {
+	Frustum frustum = benchmark_frustum();
+	std::vector<BvhBenchmarkRun> runs;
+	bool matched = true;
+
+	for (unsigned int object_count : BVH_BENCHMARK_OBJECT_COUNTS) {
+		std::vector<glm::vec3> box_min, box_max;
+		benchmark_random_boxes(object_count, &box_min, &box_max);
+		BvhBenchmarkRun run = {};
+		run.objects = object_count;
+
+		Bvh bvh;
+		bvh_build(&bvh, box_min, box_max, 1);
+		run.build_ms = bvh.build_ms;
+		bvh_build(&bvh, box_min, box_max, max_threads);
+		run.parallel_build_ms = bvh.build_ms;
+		run.build_threads = bvh.build_threads;
+		run.nodes = (unsigned int)bvh.nodes.size();
+		run.depth = bvh.depth;
+
+		std::vector<unsigned int> visible(object_count);
+		BvhQueryStats frustum_stats;
+		run.visible = bvh_query_frustum(bvh, frustum, &visible[0], &frustum_stats);
+		run.frustum_ms = frustum_stats.ms;
+		run.nodes_visited = frustum_stats.nodes_visited;
+		run.subtrees_accepted = frustum_stats.subtrees_accepted;
+		if (!benchmark_check_bvh_frustum(bvh, frustum, &visible)) {
+			printf("BVH frustum query of %u objects disagrees with testing every object\n", object_count);
+			matched = false;
+		}
+
+		// Nudge every hundredth object, then check the refit tree still finds the right objects
+		std::mt19937 random(5678);
+		std::uniform_real_distribution<float> nudge(-4.0f, 4.0f);
+		for (unsigned int i = 0; i < object_count; i += BVH_BENCHMARK_REFIT_DIVISOR) {
+			glm::vec3 offset = glm::vec3(nudge(random), nudge(random), nudge(random));
+			box_min[i] += offset;
+			box_max[i] += offset;
+			bvh_update_item(&bvh, i, box_min[i], box_max[i]);
+			run.refit_objects++;
+		}
+		bvh_refit(&bvh);
+		run.refit_ms = bvh.refit_ms;
+		if (!benchmark_check_bvh_frustum(bvh, frustum, &visible)) {
+			printf("BVH frustum query of %u objects disagrees with testing every object after the refit\n", object_count);
+			matched = false;
+		}
+
+		// Rays from the center and points scattered through the cube
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+		std::vector<glm::vec3> ray_directions(BVH_BENCHMARK_QUERIES);
+		std::vector<glm::vec3> points(BVH_BENCHMARK_QUERIES);
+		for (unsigned int i = 0; i < BVH_BENCHMARK_QUERIES; i++) {
+			ray_directions[i] = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.0f, 0.0f, 0.001f));
+			points[i] = glm::vec3(position(random), position(random), position(random));
+		}
+		std::vector<BvhRayHit> ray_hits(BVH_BENCHMARK_QUERIES);
+		std::vector<bool> ray_found(BVH_BENCHMARK_QUERIES);
+		Uint64 start = SDL_GetPerformanceCounter();
+		for (unsigned int i = 0; i < BVH_BENCHMARK_QUERIES; i++) {
+			ray_found[i] = bvh_query_ray(bvh, glm::vec3(0.0f), ray_directions[i], 1000.0f, &ray_hits[i], NULL);
+		}
+		run.ray_ms = benchmark_elapsed_ms(start);
+
+		std::vector<unsigned int> nearest_items(BVH_BENCHMARK_QUERIES);
+		std::vector<float> nearest_distances(BVH_BENCHMARK_QUERIES);
+		start = SDL_GetPerformanceCounter();
+		for (unsigned int i = 0; i < BVH_BENCHMARK_QUERIES; i++) {
+			bvh_query_nearest(bvh, points[i], 1000.0f, &nearest_items[i], &nearest_distances[i], NULL);
+		}
+		run.nearest_ms = benchmark_elapsed_ms(start);
+
+		// Distances are compared rather than items, since two boxes can be equally close
+		for (unsigned int i = 0; i < BVH_BENCHMARK_CHECKED_QUERIES; i++) {
+			glm::vec3 inverse_direction = 1.0f / ray_directions[i];
+			float ray_distance = FLT_MAX;
+			float point_distance = FLT_MAX;
+			for (unsigned int item = 0; item < object_count; item++) {
+				glm::vec3 t0 = box_min[item] * inverse_direction;
+				glm::vec3 t1 = box_max[item] * inverse_direction;
+				glm::vec3 t_min = glm::min(t0, t1);
+				glm::vec3 t_max = glm::max(t0, t1);
+				float enter = glm::max(glm::max(t_min.x, t_min.y), glm::max(t_min.z, 0.0f));
+				float exit = glm::min(glm::min(t_max.x, t_max.y), glm::min(t_max.z, 1000.0f));
+				if (enter <= exit) {
+					ray_distance = glm::min(ray_distance, enter);
+				}
+				glm::vec3 offset = glm::max(glm::max(box_min[item] - points[i], points[i] - box_max[item]), glm::vec3(0.0f));
+				point_distance = glm::min(point_distance, glm::length(offset));
+			}
+			bool ray_matched = ray_found[i] ? ray_hits[i].distance == ray_distance : ray_distance == FLT_MAX;
+			if (!ray_matched || glm::abs(nearest_distances[i] - point_distance) > 0.001f) {
+				printf("BVH ray or nearest query %u of %u objects disagrees with testing every object\n", i, object_count);
+				matched = false;
+			}
+		}
+
+		runs.push_back(run);
+		printf("%8u objects  %7u nodes  depth %2u  build %8.2f ms, %8.2f ms on %u threads  refit %6.3f ms  frustum %6.3f ms (%u visible, %u nodes)  %u rays %6.2f ms  %u nearest %6.2f ms\n", run.objects, run.nodes, run.depth, run.build_ms, run.parallel_build_ms, run.build_threads, run.refit_ms, run.frustum_ms, run.visible, run.nodes_visited, BVH_BENCHMARK_QUERIES, run.ray_ms, BVH_BENCHMARK_QUERIES, run.nearest_ms);
+	}
+
+	BenchmarkJson json;
+	if (!benchmark_json_open(&json, path)) {
+		return false;
+	}
+	benchmark_json_uint(&json, "max_threads", max_threads);
+	benchmark_json_uint(&json, "queries", BVH_BENCHMARK_QUERIES);
+	benchmark_json_begin_array(&json, "runs");
+	for (const BvhBenchmarkRun& run : runs) {
+		benchmark_json_begin_object(&json, NULL);
+		benchmark_json_uint(&json, "objects", run.objects);
+		benchmark_json_uint(&json, "nodes", run.nodes);
+		benchmark_json_uint(&json, "depth", run.depth);
+		benchmark_json_double(&json, "build_ms", run.build_ms, 4);
+		benchmark_json_double(&json, "parallel_build_ms", run.parallel_build_ms, 4);
+		benchmark_json_uint(&json, "build_threads", run.build_threads);
+		benchmark_json_uint(&json, "refit_objects", run.refit_objects);
+		benchmark_json_double(&json, "refit_ms", run.refit_ms, 4);
+		benchmark_json_double(&json, "frustum_ms", run.frustum_ms, 4);
+		benchmark_json_uint(&json, "visible", run.visible);
+		benchmark_json_uint(&json, "nodes_visited", run.nodes_visited);
+		benchmark_json_uint(&json, "subtrees_accepted", run.subtrees_accepted);
+		benchmark_json_double(&json, "ray_ms", run.ray_ms, 4);
+		benchmark_json_double(&json, "nearest_ms", run.nearest_ms, 4);
+		benchmark_json_end_object(&json);
+	}
+	benchmark_json_end_array(&json);
+	benchmark_json_close(&json);
+
+	return matched;
+}
+
+struct OcclusionBenchmarkRun {
+	unsigned int workers;
+	unsigned int tested;
+	unsigned int occluded;
+	double raster_ms;
+	double test_ms;
+};
+
+static const unsigned int OCCLUSION_BENCHMARK_OCCLUDEES = 100000;
+static const unsigned int OCCLUSION_BENCHMARK_REPEATS = 10;
+// Wall of box occluders facing the camera, with a gap in the middle to see through
+static const int OCCLUSION_BENCHMARK_WALL_COLUMNS = 20;
+static const int OCCLUSION_BENCHMARK_WALL_ROWS = 10;
+static const float OCCLUSION_BENCHMARK_WALL_Z = -50.0f;
+
+static void benchmark_box_occluder(OcclusionMesh* mesh) {
+	std::vector<glm::vec3> positions;
+	for (int corner = 0; corner < 8; corner++) {
+		positions.push_back(glm::vec3(corner & 1 ? 0.5f : -0.5f, corner & 2 ? 0.5f : -0.5f, corner & 4 ? 0.5f : -0.5f));
+	}
+	// Counter-clockwise seen from outside
+	std::vector<unsigned int> indices = {
+		0, 2, 3, 0, 3, 1, // -z
+		4, 5, 7, 4, 7, 6, // +z
+		0, 4, 6, 0, 6, 2, // -x
+		1, 3, 7, 1, 7, 5, // +x
+		0, 1, 5, 0, 5, 4, // -y
+		2, 6, 7, 2, 7, 3  // +y
+	};
+	occlusion_mesh_create(mesh, positions, indices, false);
+}
+
+bool benchmark_occlusion(const char* path, unsigned int max_workers) {
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum = frustum_from_matrix(projection * view);
+
+	OcclusionMesh box;
+	benchmark_box_occluder(&box);
+	std::vector<glm::mat4> walls;
+	for (int row = 0; row < OCCLUSION_BENCHMARK_WALL_ROWS; row++) {
+		for (int column = 0; column < OCCLUSION_BENCHMARK_WALL_COLUMNS; column++) {
+			if (row == OCCLUSION_BENCHMARK_WALL_ROWS / 2 && column == OCCLUSION_BENCHMARK_WALL_COLUMNS / 2) {
+				continue;
+			}
+			glm::vec3 position = glm::vec3((float)(column - OCCLUSION_BENCHMARK_WALL_COLUMNS / 2) * 10.0f + 5.0f, (float)(row - OCCLUSION_BENCHMARK_WALL_ROWS / 2) * 10.0f + 5.0f, OCCLUSION_BENCHMARK_WALL_Z);
+			walls.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(10.0f, 10.0f, 1.0f)));
+		}
+	}
+
+	// Only boxes inside the frustum are tested, like in the viewer
+	std::vector<glm::vec3> box_min, box_max;
+	benchmark_random_boxes(OCCLUSION_BENCHMARK_OCCLUDEES, &box_min, &box_max);
+	std::vector<unsigned int> occludees;
+	for (unsigned int i = 0; i < OCCLUSION_BENCHMARK_OCCLUDEES; i++) {
+		glm::vec3 half_extent = (box_max[i] - box_min[i]) * 0.5f;
+		if (frustum_intersects_sphere(frustum, box_min[i] + half_extent, glm::length(half_extent))) {
+			occludees.push_back(i);
+		}
+	}
+
+	std::vector<OcclusionBenchmarkRun> runs;
+	bool matched = true;
+	for (unsigned int workers = 0; workers <= max_workers; workers = workers == 0 ? 1 : workers * 2) {
+		occlusion_quit();
+		if (!occlusion_init(OCCLUSION_DEFAULT_WIDTH, OCCLUSION_DEFAULT_HEIGHT, workers)) {
+			return false;
+		}
+
+		std::vector<double> raster_times, test_times;
+		std::vector<unsigned int> visible;
+		unsigned int visible_count = 0;
+		OcclusionStats stats = {};
+		// Reported from the occlusion code's own timings, which are split into rasterizing and testing
+		benchmark_repeat(OCCLUSION_BENCHMARK_REPEATS, [&]() {
+			occlusion_begin_frame(view, projection);
+			for (const glm::mat4& wall : walls) {
+				occlusion_add_occluder(box, wall);
+			}
+			occlusion_rasterize();
+			visible = occludees;
+			visible_count = occlusion_cull_items(box_min, box_max, &visible[0], (unsigned int)visible.size());
+		}, [&]() {
+			stats = occlusion_get_stats();
+			raster_times.push_back(stats.raster_ms);
+			test_times.push_back(stats.test_ms);
+		});
+
+		// Anything in front of the wall has nothing in front of it
+		std::vector<bool> kept(OCCLUSION_BENCHMARK_OCCLUDEES, false);
+		for (unsigned int i = 0; i < visible_count; i++) {
+			kept[visible[i]] = true;
+		}
+		for (unsigned int occludee : occludees) {
+			if (!kept[occludee] && box_max[occludee].z > OCCLUSION_BENCHMARK_WALL_Z - 0.5f) {
+				printf("Box %u is in front of the occluders but was culled\n", occludee);
+				matched = false;
+			}
+		}
+
+		OcclusionBenchmarkRun run;
+		run.workers = workers;
+		run.tested = stats.tested;
+		run.occluded = stats.occluded;
+		run.raster_ms = benchmark_compute_stats(raster_times).p50;
+		run.test_ms = benchmark_compute_stats(test_times).p50;
+		runs.push_back(run);
+		printf("%u workers  %u triangles  %u of %u boxes occluded (%.1f%%)  raster %.3f ms  test %.3f ms\n", run.workers, stats.triangles, run.occluded, run.tested, 100.0 * run.occluded / glm::max(run.tested, 1u), run.raster_ms, run.test_ms);
+		if (max_workers == 0) {
+			break;
+		}
+	}
+
+	BenchmarkJson json;
+	if (!benchmark_json_open(&json, path)) {
+		return false;
+	}
+	benchmark_json_size(&json, "buffer", occlusion_get_width(), occlusion_get_height());
+	benchmark_json_uint(&json, "occluders", (unsigned int)walls.size());
+	benchmark_json_begin_array(&json, "runs");
+	for (const OcclusionBenchmarkRun& run : runs) {
+		benchmark_json_begin_object(&json, NULL);
+		benchmark_json_uint(&json, "workers", run.workers);
+		benchmark_json_uint(&json, "tested", run.tested);
+		benchmark_json_uint(&json, "occluded", run.occluded);
+		benchmark_json_double(&json, "raster_ms", run.raster_ms, 4);
+		benchmark_json_double(&json, "test_ms", run.test_ms, 4);
+		benchmark_json_end_object(&json);
+	}
+	benchmark_json_end_array(&json);
+	benchmark_json_close(&json);
+
+	return matched;
+}
+
+struct LightClusterBenchmarkRun {
+	unsigned int lights;
+	LightClusterImplementation implementation;
+	unsigned int threads;
+	LightClusterStats clusters;
+	BenchmarkStats stats;
+};
+
+static const unsigned int LIGHT_CLUSTER_BENCHMARK_LIGHT_COUNTS[] = { 1000, 10000, 50000, 100000 };
+static const unsigned int LIGHT_CLUSTER_BENCHMARK_REPEATS = 20;
+static const unsigned int LIGHT_CLUSTER_BENCHMARK_POINTS = 1000;
+static const unsigned int LIGHT_CLUSTER_BENCHMARK_WIDTH = 1280;
+static const unsigned int LIGHT_CLUSTER_BENCHMARK_HEIGHT = 720;
+static const float LIGHT_CLUSTER_BENCHMARK_NEAR = 0.1f;
+static const float LIGHT_CLUSTER_BENCHMARK_FAR = 100.0f;
+
+// Every light reaching a random point in view has to be listed in the point's cluster. Points are spread evenly
+// over the slices, and lights that only just reach a point are let off to allow for rounding.
+static bool benchmark_check_clusters(const LightClusters& clusters, const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection) {
+	glm::mat4 inverse_view = glm::inverse(view);
+	std::mt19937 random(8765);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	bool conservative = true;
+	for (unsigned int point = 0; point < LIGHT_CLUSTER_BENCHMARK_POINTS; point++) {
+		glm::vec2 pixel = glm::vec2(unit(random) * (float)LIGHT_CLUSTER_BENCHMARK_WIDTH, unit(random) * (float)LIGHT_CLUSTER_BENCHMARK_HEIGHT);
+		float depth = LIGHT_CLUSTER_BENCHMARK_NEAR * glm::pow(LIGHT_CLUSTER_BENCHMARK_FAR / LIGHT_CLUSTER_BENCHMARK_NEAR, unit(random));
+		glm::vec2 ndc = pixel / glm::vec2((float)LIGHT_CLUSTER_BENCHMARK_WIDTH, (float)LIGHT_CLUSTER_BENCHMARK_HEIGHT) * 2.0f - 1.0f;
+		glm::vec3 view_position = glm::vec3(ndc.x * depth / projection[0][0], ndc.y * depth / projection[1][1], -depth);
+		glm::vec3 position = glm::vec3(inverse_view * glm::vec4(view_position, 1.0f));
+
+		unsigned int cluster = light_cluster_index(pixel, depth, LIGHT_CLUSTER_BENCHMARK_WIDTH, LIGHT_CLUSTER_BENCHMARK_HEIGHT, LIGHT_CLUSTER_BENCHMARK_NEAR, LIGHT_CLUSTER_BENCHMARK_FAR);
+		const uint32_t* first = clusters.indices.data() + clusters.grid[cluster * 2];
+		const uint32_t* last = first + clusters.grid[cluster * 2 + 1];
+		for (unsigned int light = 0; light < lights.size(); light++) {
+			if (glm::length(lights[light].position - position) < lights[light].radius * 0.999f && std::find(first, last, light) == last) {
+				printf("Light %u reaches the point at pixel (%.1f, %.1f) depth %.2f but isn't in its cluster\n", light, pixel.x, pixel.y, depth);
+				conservative = false;
+			}
+		}
+	}
+
+	return conservative;
+}
+
+bool benchmark_light_clusters(const char* path, unsigned int max_workers) {
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)LIGHT_CLUSTER_BENCHMARK_WIDTH / (float)LIGHT_CLUSTER_BENCHMARK_HEIGHT, LIGHT_CLUSTER_BENCHMARK_NEAR, LIGHT_CLUSTER_BENCHMARK_FAR);
+	glm::mat4 view = glm::lookAt(glm::vec3(5.0f, 3.0f, 10.0f), glm::vec3(0.0f, 0.0f, -40.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	LightClusterImplementation default_implementation = light_cluster_get_implementation();
+	max_workers = glm::min(max_workers, LIGHT_CLUSTER_MAX_WORKERS);
+
+	std::vector<LightClusterBenchmarkRun> runs;
+	bool matched = true;
+	for (unsigned int light_count : LIGHT_CLUSTER_BENCHMARK_LIGHT_COUNTS) {
+		// A box around the view, so some lights are behind the camera, to the sides and past the far plane
+		Scene scene;
+		scene_spawn_lights(&scene, light_count, glm::vec3(-60.0f, -40.0f, -110.0f), glm::vec3(60.0f, 40.0f, 20.0f));
+
+		LightClusters reference;
+		for (int implementation = 0; implementation < LIGHT_CLUSTER_IMPLEMENTATION_COUNT; implementation++) {
+			if (!light_cluster_implementation_supported((LightClusterImplementation)implementation)) {
+				continue;
+			}
+			for (unsigned int workers = 0; workers <= max_workers; workers = workers == 0 ? 1 : workers * 2) {
+				// Too few lights to hand out to the workers
+				if (workers != 0 && light_count < LIGHT_CLUSTER_PARALLEL_MIN_LIGHTS) {
+					break;
+				}
+				light_cluster_quit();
+				if (!light_cluster_init(workers)) {
+					return false;
+				}
+				light_cluster_set_implementation((LightClusterImplementation)implementation);
+
+				LightClusters clusters;
+				std::vector<double> times;
+				benchmark_repeat(LIGHT_CLUSTER_BENCHMARK_REPEATS, [&]() {
+					light_cluster_build(&clusters, scene.lights, view, projection, LIGHT_CLUSTER_BENCHMARK_NEAR, LIGHT_CLUSTER_BENCHMARK_FAR);
+				}, [&]() {
+					times.push_back(clusters.stats.build_ms);
+				});
+
+				// Lists come out in light order however the work is split, so every run has to match exactly
+				if (reference.grid.empty()) {
+					reference = clusters;
+					if (!benchmark_check_clusters(reference, scene.lights, view, projection)) {
+						matched = false;
+					}
+				} else if (clusters.grid != reference.grid || clusters.indices != reference.indices) {
+					printf("%s light clustering of %u lights with %u workers disagrees with scalar clustering\n", light_cluster_implementation_name((LightClusterImplementation)implementation), light_count, workers);
+					matched = false;
+				}
+
+				LightClusterBenchmarkRun run;
+				run.lights = light_count;
+				run.implementation = (LightClusterImplementation)implementation;
+				run.threads = light_count >= LIGHT_CLUSTER_PARALLEL_MIN_LIGHTS ? workers + 1 : 1;
+				run.clusters = clusters.stats;
+				run.stats = benchmark_compute_stats(times);
+				runs.push_back(run);
+				printf("%7u lights  %-6s  %u threads  %u visible  %u in clusters, %u most in one  %.3f ms p50  %.3f ms p95\n", run.lights, benchmark_json_escape(light_cluster_implementation_name(run.implementation)).c_str(), run.threads, run.clusters.visible_lights, run.clusters.references, run.clusters.max_cluster_lights, run.stats.p50, run.stats.p95);
+			}
+		}
+	}
+	light_cluster_set_implementation(default_implementation);
+
+	BenchmarkJson json;
+	if (!benchmark_json_open(&json, path)) {
+		return false;
+	}
+	char cluster_grid[32];
+	snprintf(cluster_grid, sizeof(cluster_grid), "%ux%ux%u", LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y, LIGHT_CLUSTER_Z);
+	benchmark_json_string(&json, "clusters", cluster_grid);
+	benchmark_json_begin_array(&json, "runs");
+	for (const LightClusterBenchmarkRun& run : runs) {
+		benchmark_json_begin_object(&json, NULL);
+		benchmark_json_uint(&json, "lights", run.lights);
+		benchmark_json_string(&json, "implementation", light_cluster_implementation_name(run.implementation));
+		benchmark_json_uint(&json, "threads", run.threads);
+		benchmark_json_uint(&json, "visible", run.clusters.visible_lights);
+		benchmark_json_uint(&json, "references", run.clusters.references);
+		benchmark_json_uint(&json, "max_cluster_lights", run.clusters.max_cluster_lights);
+		benchmark_json_double(&json, "p50_ms", run.stats.p50, 4);
+		benchmark_json_double(&json, "p95_ms", run.stats.p95, 4);
+		benchmark_json_end_object(&json);
+	}
+	benchmark_json_end_array(&json);
+	benchmark_json_close(&json);
+
+	return matched;
+}
+
+struct VertexBenchmarkRun {
+	VertexFormat format;
+	double position_error;
+	double normal_error_degrees;
+	double uv_error;
+	BenchmarkStats stats;
+};
+
+static const unsigned int VERTEX_BENCHMARK_INSTANCES = 256;
+static const unsigned int VERTEX_BENCHMARK_REPEATS = 20;
+
+static glm::vec3 benchmark_decode_attribute(const VertexAttributeFormat& attribute, const uint8_t* data) {
+	glm::vec3 value = glm::vec3(0.0f);
+	switch (attribute.encoding) {
+		case VERTEX_ENCODING_FLOAT:
+			memcpy(&value[0], data, attribute.size);
+			break;
+		case VERTEX_ENCODING_UNORM16: {
+			uint16_t encoded[3];
+			memcpy(encoded, data, sizeof(encoded));
+			value = glm::vec3(encoded[0], encoded[1], encoded[2]) / 65535.0f;
+			break;
+		}
+		case VERTEX_ENCODING_OCTAHEDRAL_SNORM16: {
+			int16_t encoded[2];
+			memcpy(encoded, data, sizeof(encoded));
+			glm::vec2 octahedral = glm::max(glm::vec2(encoded[0], encoded[1]) / 32767.0f, glm::vec2(-1.0f));
+			value = glm::vec3(octahedral, 1.0f - glm::abs(octahedral.x) - glm::abs(octahedral.y));
+			float fold = glm::max(-value.z, 0.0f);
+			value.x += value.x >= 0.0f ? -fold : fold;
+			value.y += value.y >= 0.0f ? -fold : fold;
+			break;
+		}
+		case VERTEX_ENCODING_SNORM10: {
+			uint32_t encoded;
+			memcpy(&encoded, data, sizeof(encoded));
+			value = glm::vec3(glm::unpackSnorm3x10_1x2(encoded));
+			break;
+		}
+		case VERTEX_ENCODING_HALF: {
+			uint16_t encoded[2];
+			memcpy(encoded, data, sizeof(encoded));
+			value = glm::vec3(glm::unpackHalf1x16(encoded[0]), glm::unpackHalf1x16(encoded[1]), 0.0f);
+			break;
+		}
+	}
+	return value;
+}
+
+bool benchmark_vertex_fetch(const char* path, GLuint program, const std::vector<Vertex>& vertices) {
+	VertexFormat formats[] = { vertex_format_full(), vertex_format_compact(), vertex_format_packed() };
+	unsigned int vertex_count = (unsigned int)vertices.size();
+
+	gl_state_use_program(program);
+	// A negative w puts every vertex outside the clip volume. Unlike turning rasterization off, drivers can't skip
+	// the vertex shader, since clipping needs its output.
+	glm::mat4 identity = glm::mat4(1.0f);
+	glm::mat4 clip_all = identity;
+	clip_all[3][3] = -1.0f;
+	glUniformMatrix4fv(glGetUniformLocation(program, "projection_view"), 1, GL_FALSE, glm::value_ptr(clip_all));
+	glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(identity));
+	glUniformMatrix3fv(glGetUniformLocation(program, "normal_matrix"), 1, GL_FALSE, glm::value_ptr(glm::mat3(1.0f)));
+
+	std::vector<VertexBenchmarkRun> runs;
+	for (const VertexFormat& format : formats) {
+		MeshBuffer buffer;
+		buffer.vertices = vertices;
+		buffer.indices.push_back(0);
+		mesh_buffer_upload(&buffer, format);
+		mesh_buffer_set_decode_uniforms(buffer, program);
+
+		// Decode on the CPU the same way the shader does to measure what the encoding loses
+		std::vector<uint8_t> data;
+		vertex_format_encode(format, vertices.data(), vertices.size(), buffer.position_offset, buffer.position_scale, &data);
+		VertexBenchmarkRun run;
+		run.format = format;
+		run.position_error = 0.0;
+		run.normal_error_degrees = 0.0;
+		run.uv_error = 0.0;
+		for (unsigned int i = 0; i < vertex_count; i++) {
+			const uint8_t* vertex = &data[i * format.stride];
+			glm::vec3 position = benchmark_decode_attribute(format.position, vertex + format.position.offset);
+			if (format.position.encoding != VERTEX_ENCODING_FLOAT) {
+				position = buffer.position_offset + position * buffer.position_scale;
+			}
+			glm::vec3 normal = glm::normalize(benchmark_decode_attribute(format.normal, vertex + format.normal.offset));
+			glm::vec2 uv = glm::vec2(benchmark_decode_attribute(format.texture_coordinates, vertex + format.texture_coordinates.offset));
+			float cosine = glm::clamp(glm::dot(normal, glm::normalize(vertices[i].normal)), -1.0f, 1.0f);
+			run.position_error = glm::max(run.position_error, (double)glm::length(position - vertices[i].position));
+			run.normal_error_degrees = glm::max(run.normal_error_degrees, (double)glm::degrees(std::acos(cosine)));
+			run.uv_error = glm::max(run.uv_error, (double)glm::length(uv - vertices[i].texture_coordinates));
+		}
+
+		// Points touch every vertex once and are all clipped, so fetch is most of the cost
+		gl_state_bind_vertex_array(buffer.vao);
+		// Timed from submit to glFinish rather than with a timer query, since software drivers can do vertex work
+		// before the query starts. One draw's submission is noise next to fetching this many vertices.
+		run.stats = benchmark_repeat(VERTEX_BENCHMARK_REPEATS, [&]() {
+			glDrawArraysInstanced(GL_POINTS, 0, vertex_count, VERTEX_BENCHMARK_INSTANCES);
+			glFinish();
+		});
+		runs.push_back(run);
+
+		gl_state_bind_vertex_array(0);
+		glDeleteVertexArrays(1, &buffer.vao);
+		glDeleteBuffers(1, &buffer.vbo);
+		glDeleteBuffers(1, &buffer.ebo);
+
+		double vertices_drawn = (double)vertex_count * VERTEX_BENCHMARK_INSTANCES;
+		printf("%-8s %2u bytes  %8.3f ms p50  %6.1f Mverts/s  %6.2f GB/s  error: position %.6f, normal %.4f deg, uv %.6f\n", format.name, format.stride, run.stats.p50, vertices_drawn / run.stats.p50 / 1000.0, vertices_drawn * format.stride / run.stats.p50 / 1000000.0, run.position_error, run.normal_error_degrees, run.uv_error);
+	}
+
+	BenchmarkJson json;
+	if (!benchmark_json_open(&json, path)) {
+		return false;
+	}
+	benchmark_json_uint(&json, "vertices", vertex_count);
+	benchmark_json_uint(&json, "instances", VERTEX_BENCHMARK_INSTANCES);
+	benchmark_json_uint(&json, "repeats", VERTEX_BENCHMARK_REPEATS);
+	benchmark_json_begin_array(&json, "runs");
+	for (const VertexBenchmarkRun& run : runs) {
+		double vertices_drawn = (double)vertex_count * VERTEX_BENCHMARK_INSTANCES;
+		benchmark_json_begin_object(&json, NULL);
+		benchmark_json_string(&json, "format", run.format.name);
+		benchmark_json_uint(&json, "bytes_per_vertex", run.format.stride);
+		benchmark_json_double(&json, "p50_ms", run.stats.p50, 4);
+		benchmark_json_double(&json, "min_ms", run.stats.min, 4);
+		benchmark_json_double(&json, "mvertices_per_second", vertices_drawn / run.stats.p50 / 1000.0, 2);
+		benchmark_json_double(&json, "gb_per_second", vertices_drawn * run.format.stride / run.stats.p50 / 1000000.0, 3);
+		benchmark_json_double(&json, "position_error", run.position_error, 7);
+		benchmark_json_double(&json, "normal_error_degrees", run.normal_error_degrees, 5);
+		benchmark_json_double(&json, "uv_error", run.uv_error, 7);
+		benchmark_json_end_object(&json);
+	}
+	benchmark_json_end_array(&json);
+	benchmark_json_close(&json);
+
+	return true;
+}
+
+struct UpscaleBenchmarkRun {
+	UpscalePreset preset;
+	unsigned int width;
+	unsigned int height;
+	const char* method;
+	BenchmarkStats stats;
+	double psnr;
+	double ssim;
+	double sharpness;
+};
+
+static const unsigned int UPSCALE_BENCHMARK_REPEATS = 20;
+// SSIM is taken over blocks of this many pixels a side and averaged
+static const unsigned int UPSCALE_BENCHMARK_SSIM_BLOCK = 8;
+static const char* UPSCALE_BENCHMARK_METHODS[] = { "bilinear", "easu", "easu_rcas" };
+
+static GLuint benchmark_create_color_target(unsigned int width, unsigned int height, GLuint* framebuffer) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	gl_state_bind_texture(0, GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glGenFramebuffers(1, framebuffer);
+	gl_state_bind_framebuffer(GL_FRAMEBUFFER, *framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	return texture;
+}
+
+// Luma of each pixel, read back as RGBA
+static void benchmark_read_luma(GLuint framebuffer, unsigned int width, unsigned int height, std::vector<uint8_t>* rgba, std::vector<double>* luma) {
+	rgba->resize((size_t)width * height * 4);
+	gl_state_bind_framebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba->data());
+	luma->resize((size_t)width * height);
+	for (size_t i = 0; i < luma->size(); i++) {
+		const uint8_t* pixel = &(*rgba)[i * 4];
+		(*luma)[i] = 0.2126 * pixel[0] + 0.7152 * pixel[1] + 0.0722 * pixel[2];
+	}
+}
+
+// Mean of the absolute luma differences between neighbouring pixels
+static double benchmark_gradient(const std::vector<double>& luma, unsigned int width, unsigned int height) {
+	double sum = 0.0;
+	for (unsigned int y = 0; y + 1 < height; y++) {
+		for (unsigned int x = 0; x + 1 < width; x++) {
+			double center = luma[(size_t)y * width + x];
+			sum += std::fabs(luma[(size_t)y * width + x + 1] - center) + std::fabs(luma[(size_t)(y + 1) * width + x] - center);
+		}
+	}
+	return sum / ((double)(width - 1) * (height - 1) * 2.0);
+}
+
+// PSNR over the RGB channels, and SSIM on luma with the usual constants for 8 bit values
+static void benchmark_compare_images(const std::vector<uint8_t>& reference_rgba, const std::vector<double>& reference_luma, const std::vector<uint8_t>& rgba, const std::vector<double>& luma, unsigned int width, unsigned int height, double* psnr, double* ssim) {
+	double squared_error = 0.0;
+	for (size_t i = 0; i < reference_rgba.size(); i++) {
+		if (i % 4 != 3) {
+			double difference = (double)reference_rgba[i] - (double)rgba[i];
+			squared_error += difference * difference;
+		}
+	}
+	double mean_squared_error = squared_error / ((double)width * height * 3.0);
+	*psnr = mean_squared_error > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mean_squared_error) : 99.0;
+
+	const double c1 = (0.01 * 255.0) * (0.01 * 255.0);
+	const double c2 = (0.03 * 255.0) * (0.03 * 255.0);
+	const unsigned int block = UPSCALE_BENCHMARK_SSIM_BLOCK;
+	double ssim_sum = 0.0;
+	unsigned int blocks = 0;
+	for (unsigned int block_y = 0; block_y + block <= height; block_y += block) {
+		for (unsigned int block_x = 0; block_x + block <= width; block_x += block) {
+			double mean_a = 0.0, mean_b = 0.0;
+			for (unsigned int y = block_y; y < block_y + block; y++) {
+				for (unsigned int x = block_x; x < block_x + block; x++) {
+					mean_a += reference_luma[(size_t)y * width + x];
+					mean_b += luma[(size_t)y * width + x];
+				}
+			}
+			double count = (double)(block * block);
+			mean_a /= count;
+			mean_b /= count;
+			double variance_a = 0.0, variance_b = 0.0, covariance = 0.0;
+			for (unsigned int y = block_y; y < block_y + block; y++) {
+				for (unsigned int x = block_x; x < block_x + block; x++) {
+					double a = reference_luma[(size_t)y * width + x] - mean_a;
+					double b = luma[(size_t)y * width + x] - mean_b;
+					variance_a += a * a;
+					variance_b += b * b;
+					covariance += a * b;
+				}
+			}
+			variance_a /= count - 1.0;
+			variance_b /= count - 1.0;
+			covariance /= count - 1.0;
+			ssim_sum += (2.0 * mean_a * mean_b + c1) * (2.0 * covariance + c2) / ((mean_a * mean_a + mean_b * mean_b + c1) * (variance_a + variance_b + c2));
+			blocks++;
+		}
+	}
+	*ssim = blocks > 0 ? ssim_sum / (double)blocks : 1.0;
+}
+
+// Method indexes UPSCALE_BENCHMARK_METHODS. EASU and RCAS go through the intermediate target like the viewer's passes.
+static void benchmark_upscale(const UpscalePrograms& programs, unsigned int method, GLuint source, GLuint intermediate, GLuint intermediate_framebuffer, GLuint output_framebuffer, unsigned int width, unsigned int height) {
+	glViewport(0, 0, width, height);
+	if (method == 0) {
+		gl_state_bind_framebuffer(GL_FRAMEBUFFER, output_framebuffer);
+		gl_state_use_program(programs.bilinear);
+		gl_state_bind_texture(0, GL_TEXTURE_2D, source);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		return;
+	}
+	gl_state_bind_framebuffer(GL_FRAMEBUFFER, method == 1 ? output_framebuffer : intermediate_framebuffer);
+	gl_state_use_program(programs.easu);
+	gl_state_bind_texture(0, GL_TEXTURE_2D, source);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	if (method == 2) {
+		gl_state_bind_framebuffer(GL_FRAMEBUFFER, output_framebuffer);
+		gl_state_use_program(programs.rcas);
+		gl_state_bind_texture(0, GL_TEXTURE_2D, intermediate);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+	}
+}
+
+bool benchmark_upscaling(const char* path, GLuint reference, unsigned int width, unsigned int height, const UpscalePrograms& programs, GLuint quad_vao) {
+	const unsigned int method_count = sizeof(UPSCALE_BENCHMARK_METHODS) / sizeof(UPSCALE_BENCHMARK_METHODS[0]);
+
+	GLuint reference_framebuffer;
+	glGenFramebuffers(1, &reference_framebuffer);
+	gl_state_bind_framebuffer(GL_FRAMEBUFFER, reference_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, reference, 0);
+	std::vector<uint8_t> reference_rgba;
+	std::vector<double> reference_luma;
+	benchmark_read_luma(reference_framebuffer, width, height, &reference_rgba, &reference_luma);
+	double reference_gradient = benchmark_gradient(reference_luma, width, height);
+
+	GLuint intermediate_framebuffer, output_framebuffer;
+	GLuint intermediate = benchmark_create_color_target(width, height, &intermediate_framebuffer);
+	GLuint output = benchmark_create_color_target(width, height, &output_framebuffer);
+	gl_state_disable(GL_DEPTH_TEST);
+	gl_state_blend_func(GL_ONE, GL_ZERO);
+	gl_state_bind_vertex_array(quad_vao);
+
+	std::vector<UpscaleBenchmarkRun> runs;
+	std::vector<uint8_t> rgba;
+	std::vector<double> luma;
+	for (int preset = 0; preset < UPSCALE_PRESET_COUNT; preset++) {
+		// The low resolution input is the reference filtered down, not the scene rendered at that size
+		unsigned int low_width, low_height;
+		dynamic_resolution_size(upscale_preset_scale((UpscalePreset)preset), width, height, &low_width, &low_height);
+		GLuint low_framebuffer;
+		GLuint low = benchmark_create_color_target(low_width, low_height, &low_framebuffer);
+		gl_state_bind_framebuffer(GL_READ_FRAMEBUFFER, reference_framebuffer);
+		gl_state_bind_framebuffer(GL_DRAW_FRAMEBUFFER, low_framebuffer);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, low_width, low_height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+		for (unsigned int method = 0; method < method_count; method++) {
+			UpscaleBenchmarkRun run;
+			run.preset = (UpscalePreset)preset;
+			run.width = low_width;
+			run.height = low_height;
+			run.method = UPSCALE_BENCHMARK_METHODS[method];
+
+			// Timed from submit to glFinish like the vertex fetch benchmark, a pass or two is all that is queued
+			run.stats = benchmark_repeat(UPSCALE_BENCHMARK_REPEATS, [&]() {
+				benchmark_upscale(programs, method, low, intermediate, intermediate_framebuffer, output_framebuffer, width, height);
+				glFinish();
+			});
+
+			benchmark_read_luma(output_framebuffer, width, height, &rgba, &luma);
+			benchmark_compare_images(reference_rgba, reference_luma, rgba, luma, width, height, &run.psnr, &run.ssim);
+			run.sharpness = reference_gradient > 0.0 ? benchmark_gradient(luma, width, height) / reference_gradient : 1.0;
+			runs.push_back(run);
+			printf("%-13s %4ux%-4u %-9s %7.3f ms p50  psnr %6.2f dB  ssim %.4f  sharpness %.3f\n", upscale_preset_name(run.preset), low_width, low_height, run.method, run.stats.p50, run.psnr, run.ssim, run.sharpness);
+		}
+
+		gl_state_bind_framebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &low_framebuffer);
+		glDeleteTextures(1, &low);
+	}
+
+	gl_state_bind_framebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &reference_framebuffer);
+	glDeleteFramebuffers(1, &intermediate_framebuffer);
+	glDeleteFramebuffers(1, &output_framebuffer);
+	glDeleteTextures(1, &intermediate);
+	glDeleteTextures(1, &output);
+
+	BenchmarkJson json;
+	if (!benchmark_json_open(&json, path)) {
+		return false;
+	}
+	benchmark_json_uint(&json, "width", width);
+	benchmark_json_uint(&json, "height", height);
+	benchmark_json_uint(&json, "repeats", UPSCALE_BENCHMARK_REPEATS);
+	benchmark_json_uint(&json, "ssim_block", UPSCALE_BENCHMARK_SSIM_BLOCK);
+	benchmark_json_begin_array(&json, "runs");
+	for (const UpscaleBenchmarkRun& run : runs) {
+		benchmark_json_begin_object(&json, NULL);
+		benchmark_json_string(&json, "preset", upscale_preset_name(run.preset));
+		benchmark_json_double(&json, "render_scale", upscale_preset_scale(run.preset), 4);
+		benchmark_json_uint(&json, "render_width", run.width);
+		benchmark_json_uint(&json, "render_height", run.height);
+		benchmark_json_string(&json, "method", run.method);
+		benchmark_json_double(&json, "p50_ms", run.stats.p50, 4);
+		benchmark_json_double(&json, "min_ms", run.stats.min, 4);
+		benchmark_json_double(&json, "psnr_db", run.psnr, 3);
+		benchmark_json_double(&json, "ssim", run.ssim, 5);
+		benchmark_json_double(&json, "sharpness", run.sharpness, 4);
+		benchmark_json_end_object(&json);
+	}
+	benchmark_json_end_array(&json);
+	benchmark_json_close(&json);
+
+	return true;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "mesh.h"
+#include "upscale.h"
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+
+// Repeatable benchmark runs. The viewer flies a camera path with fixed timesteps, and after the warm-up frames every
+// frame's CPU time, GPU time and submission counts are recorded. The summary is written as JSON so runs from
+// different builds or machines can be diffed. Headless runs still need a GL driver, see platform.h, and run on
+// whichever one the machine has, so the JSON records the renderer to tell software and GPU runs apart.
+struct BenchmarkSettings {
+	unsigned int warmup_frames;
+	unsigned int frames;
+	std::string camera_path;
+	unsigned int grid_size;
+	unsigned int sphere_segments;
+	unsigned int lights;
+	unsigned int texture_size;
+	bool headless;
+	bool pipelined;
+	std::string render_path;
+	bool lod;
+	std::string vertex_format;
+	std::string depth_prepass;
+	std::string shading;
+	bool shadows;
+	unsigned int shadow_cascades;
+	unsigned int shadow_update_budget;
+	float sun_speed;
+	std::string antialiasing;
+	// Scene target samples, 0 unless MSAA is in use
+	unsigned int antialiasing_samples;
+	// GPU timer zone of the anti-aliasing mode's own pass, empty if it has none
+	std::string antialiasing_zone;
+	unsigned int window_width;
+	unsigned int window_height;
+	// Scale the scene starts rendering at, which it keeps without dynamic resolution
+	float render_scale;
+	bool dynamic_resolution;
+	float dynamic_resolution_budget_ms;
+	std::string upscaler;
+	// Of the G-buffer or the visibility buffer and its depth, 0 when forward shading
+	unsigned int gbuffer_bytes_per_pixel;
+};
+
+struct BenchmarkFrame {
+	unsigned int draws;
+	unsigned int triangles;
+	unsigned int state_changes;
+	double light_cluster_ms;
+	unsigned int shadow_updates;
+	unsigned int shadow_triangles;
+	double shadow_plan_ms;
+	float render_scale;
+};
+
+struct Benchmark {
+	BenchmarkSettings settings;
+	unsigned int frame;
+	Uint64 frequency;
+	Uint64 last_frame_end;
+	unsigned long next_gpu_sample;
+	unsigned long next_shadow_sample;
+	unsigned long next_antialiasing_sample;
+
+	std::vector<double> cpu_frame_times;
+	std::vector<double> gpu_frame_times;
+	std::vector<double> draws;
+	std::vector<double> triangles;
+	std::vector<double> state_changes;
+	std::vector<double> light_cluster_ms;
+	std::vector<double> shadow_updates;
+	std::vector<double> shadow_triangles;
+	std::vector<double> shadow_plan_ms;
+	// Only frames that rendered any cascades have a sample
+	std::vector<double> shadow_gpu_times;
+	// Only modes with a pass of their own have samples
+	std::vector<double> antialiasing_gpu_times;
+	std::vector<double> render_scales;
+};
+
+struct BenchmarkStats {
+	unsigned int samples;
+	double mean;
+	double p50;
+	double p95;
+	double p99;
+	double min;
+	double max;
+};
+
+void benchmark_init(Benchmark* benchmark, const BenchmarkSettings& settings);
+// Call once per frame after presenting. Returns true once the measured frames are done.
+bool benchmark_record_frame(Benchmark* benchmark, const BenchmarkFrame& frame);
+BenchmarkStats benchmark_compute_stats(std::vector<double> samples);
+bool benchmark_write_json(const Benchmark& benchmark, const char* path);
+
+// Times frustum culling of 100k to 1M random objects with each supported implementation, with and without the
+// worker threads, and checks they all agree on what is visible. Doesn't need a GL context.
+bool benchmark_culling(const char* path);
+// Times BVH builds, serial and on up to max_threads threads, a refit after moving 1% of the objects, and frustum,
+// ray and nearest object queries over 100k to 2M random objects. Query results are checked against testing every
+// object.
+bool benchmark_bvh(const char* path, unsigned int max_threads);
+// Rasterizes a wall of box occluders and tests 100k random boxes behind and in front of it, with an increasing
+// number of worker threads. Fails if anything in front of the wall is culled.
+bool benchmark_occlusion(const char* path, unsigned int max_workers);
+// Assigns 1k to 100k random lights to clusters with each supported implementation and up to max_workers worker
+// threads. Every run has to match the scalar single threaded one, which is checked against testing random points
+// in view against every light.
+bool benchmark_light_clusters(const char* path, unsigned int max_workers);
+// Fetches every vertex of the mesh once per instance in each vertex format, with everything clipped so the timing
+// is down to vertex fetch, and reports how much precision each format loses. Needs a GL context and a program
+// that reads all three attributes through vertex_decode.glsl.
+bool benchmark_vertex_fetch(const char* path, GLuint program, const std::vector<Vertex>& vertices);
+// Filters a window sized reference frame down to each upscaling preset's size, then upscales it back with bilinear,
+// EASU and EASU plus RCAS. Reports each one's time against PSNR, SSIM and how sharp it is next to the reference,
+// from the mean luma gradient. Needs a GL context and an RGBA8 reference.
+bool benchmark_upscaling(const char* path, GLuint reference, unsigned int width, unsigned int height, const UpscalePrograms& programs, GLuint quad_vao);
@@ -0,0 +1,468 @@
+#include "bvh.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+// Nodes smaller than this are always built on the thread that reached them
+static const unsigned int BVH_THREAD_MIN_ITEMS = 4096;
+static const unsigned int BVH_OUTSIDE = 0xFFFFFFFF;
+static const unsigned int BVH_ALL_PLANES = 0x3F;
+
+struct BvhBuildContext {
+	Bvh* bvh;
+	std::vector<glm::vec3> centroids;
+	std::atomic<unsigned int> node_count;
+	std::atomic<unsigned int> depth;
+	std::atomic<unsigned int> threads;
+	// Nodes above this depth hand their right child to a new thread
+	unsigned int thread_depth;
+};
+
+struct BvhBuildTask {
+	BvhBuildContext* context;
+	unsigned int node;
+	unsigned int depth;
+};
+
+struct BvhBin {
+	glm::vec3 bounds_min;
+	glm::vec3 bounds_max;
+	unsigned int count;
+};
+
+struct BvhStackEntry {
+	unsigned int node;
+	// Planes still straddled for frustum queries, entry distance for ray and nearest queries
+	unsigned int plane_mask;
+	float distance;
+};
+
+static double bvh_elapsed_ms(Uint64 start) {
+	return (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static float bvh_surface_area(glm::vec3 bounds_min, glm::vec3 bounds_max) {
+	glm::vec3 size = glm::max(bounds_max - bounds_min, glm::vec3(0.0f));
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static void bvh_build_node(BvhBuildContext* context, unsigned int node_index, unsigned int depth);
+
+static int bvh_build_thread(void* data) {
+	BvhBuildTask* task = (BvhBuildTask*)data;
+	bvh_build_node(task->context, task->node, task->depth);
+
+	return 0;
+}
+
+static void bvh_build_node(BvhBuildContext* context, unsigned int node_index, unsigned int depth) {
+	Bvh* bvh = context->bvh;
+	BvhNode& node = bvh->nodes[node_index];
+	unsigned int* items = &bvh->items[node.first];
+
+	node.bounds_min = glm::vec3(FLT_MAX);
+	node.bounds_max = glm::vec3(-FLT_MAX);
+	glm::vec3 centroid_min = glm::vec3(FLT_MAX);
+	glm::vec3 centroid_max = glm::vec3(-FLT_MAX);
+	for (unsigned int i = 0; i < node.count; i++) {
+		node.bounds_min = glm::min(node.bounds_min, bvh->item_min[items[i]]);
+		node.bounds_max = glm::max(node.bounds_max, bvh->item_max[items[i]]);
+		centroid_min = glm::min(centroid_min, context->centroids[items[i]]);
+		centroid_max = glm::max(centroid_max, context->centroids[items[i]]);
+	}
+
+	unsigned int seen_depth = context->depth.load();
+	while (depth > seen_depth && !context->depth.compare_exchange_weak(seen_depth, depth)) {
+	}
+
+	if (node.count <= BVH_MAX_LEAF_ITEMS) {
+		node.left = 0;
+		for (unsigned int i = 0; i < node.count; i++) {
+			bvh->item_leaf[items[i]] = node_index;
+		}
+		return;
+	}
+
+	// Bin the centroids along each axis and take the split with the lowest surface area cost
+	int best_axis = -1;
+	unsigned int best_split = 0;
+	float best_cost = FLT_MAX;
+	glm::vec3 centroid_extent = centroid_max - centroid_min;
+	for (int axis = 0; axis < 3; axis++) {
+		if (centroid_extent[axis] <= 0.0f) {
+			continue;
+		}
+
+		BvhBin bins[BVH_BIN_COUNT];
+		for (BvhBin& bin : bins) {
+			bin.bounds_min = glm::vec3(FLT_MAX);
+			bin.bounds_max = glm::vec3(-FLT_MAX);
+			bin.count = 0;
+		}
+		float scale = (float)BVH_BIN_COUNT / centroid_extent[axis];
+		for (unsigned int i = 0; i < node.count; i++) {
+			unsigned int bin_index = std::min((unsigned int)((context->centroids[items[i]][axis] - centroid_min[axis]) * scale), BVH_BIN_COUNT - 1);
+			BvhBin& bin = bins[bin_index];
+			bin.bounds_min = glm::min(bin.bounds_min, bvh->item_min[items[i]]);
+			bin.bounds_max = glm::max(bin.bounds_max, bvh->item_max[items[i]]);
+			bin.count++;
+		}
+
+		// Split i puts bins 0 to i on the left
+		float left_cost[BVH_BIN_COUNT - 1];
+		glm::vec3 sweep_min = glm::vec3(FLT_MAX);
+		glm::vec3 sweep_max = glm::vec3(-FLT_MAX);
+		unsigned int sweep_count = 0;
+		for (unsigned int i = 0; i < BVH_BIN_COUNT - 1; i++) {
+			sweep_min = glm::min(sweep_min, bins[i].bounds_min);
+			sweep_max = glm::max(sweep_max, bins[i].bounds_max);
+			sweep_count += bins[i].count;
+			left_cost[i] = sweep_count == 0 ? 0.0f : bvh_surface_area(sweep_min, sweep_max) * (float)sweep_count;
+		}
+		sweep_min = glm::vec3(FLT_MAX);
+		sweep_max = glm::vec3(-FLT_MAX);
+		sweep_count = 0;
+		for (unsigned int i = BVH_BIN_COUNT - 1; i > 0; i--) {
+			sweep_min = glm::min(sweep_min, bins[i].bounds_min);
+			sweep_max = glm::max(sweep_max, bins[i].bounds_max);
+			sweep_count += bins[i].count;
+			float cost = left_cost[i - 1] + (sweep_count == 0 ? 0.0f : bvh_surface_area(sweep_min, sweep_max) * (float)sweep_count);
+			if (sweep_count != 0 && sweep_count != node.count && cost < best_cost) {
+				best_cost = cost;
+				best_axis = axis;
+				best_split = i - 1;
+			}
+		}
+	}
+
+	unsigned int left_count;
+	if (best_axis == -1) {
+		// Every centroid is in the same place, so any split is as good as another
+		left_count = node.count / 2;
+	} else {
+		float scale = (float)BVH_BIN_COUNT / centroid_extent[best_axis];
+		unsigned int* middle = std::partition(items, items + node.count, [&](unsigned int item) {
+			unsigned int bin_index = std::min((unsigned int)((context->centroids[item][best_axis] - centroid_min[best_axis]) * scale), BVH_BIN_COUNT - 1);
+			return bin_index <= best_split;
+		});
+		left_count = (unsigned int)(middle - items);
+	}
+
+	unsigned int left = context->node_count.fetch_add(2);
+	node.left = left;
+	BvhNode& left_node = bvh->nodes[left];
+	BvhNode& right_node = bvh->nodes[left + 1];
+	left_node.first = node.first;
+	left_node.count = left_count;
+	left_node.parent = node_index;
+	right_node.first = node.first + left_count;
+	right_node.count = node.count - left_count;
+	right_node.parent = node_index;
+
+	SDL_Thread* thread = NULL;
+	BvhBuildTask task = { context, left + 1, depth + 1 };
+	if (depth < context->thread_depth && right_node.count >= BVH_THREAD_MIN_ITEMS) {
+		thread = SDL_CreateThread(bvh_build_thread, "bvh build", &task);
+		if (thread != NULL) {
+			context->threads++;
+		}
+	}
+	bvh_build_node(context, left, depth + 1);
+	if (thread != NULL) {
+		SDL_WaitThread(thread, NULL);
+	} else {
+		bvh_build_node(context, left + 1, depth + 1);
+	}
+}
+
+void bvh_build(Bvh* bvh, const std::vector<glm::vec3>& item_min, const std::vector<glm::vec3>& item_max, unsigned int max_threads) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	unsigned int item_count = (unsigned int)item_min.size();
+	bvh->item_min = item_min;
+	bvh->item_max = item_max;
+	bvh->item_leaf.assign(item_count, 0);
+	bvh->dirty_leaves.clear();
+	bvh->items.resize(item_count);
+	for (unsigned int i = 0; i < item_count; i++) {
+		bvh->items[i] = i;
+	}
+	bvh->nodes.clear();
+	bvh->depth = 0;
+	bvh->build_threads = 1;
+	bvh->refit_ms = 0.0;
+	if (item_count == 0) {
+		bvh->build_ms = bvh_elapsed_ms(start);
+		return;
+	}
+
+	BvhBuildContext context;
+	context.bvh = bvh;
+	context.centroids.resize(item_count);
+	for (unsigned int i = 0; i < item_count; i++) {
+		context.centroids[i] = (item_min[i] + item_max[i]) * 0.5f;
+	}
+	context.node_count.store(1);
+	context.depth.store(0);
+	context.threads.store(1);
+	// Each level of spawning doubles the threads
+	context.thread_depth = 0;
+	while (item_count >= BVH_PARALLEL_MIN_ITEMS && (1u << context.thread_depth) < max_threads) {
+		context.thread_depth++;
+	}
+
+	// A binary tree with single item leaves is as big as it gets
+	bvh->nodes.resize(item_count * 2 - 1);
+	bvh->nodes[0].first = 0;
+	bvh->nodes[0].count = item_count;
+	bvh->nodes[0].parent = BVH_NO_PARENT;
+	bvh_build_node(&context, 0, 0);
+
+	bvh->nodes.resize(context.node_count.load());
+	bvh->depth = context.depth.load();
+	bvh->build_threads = context.threads.load();
+	bvh->build_ms = bvh_elapsed_ms(start);
+}
+
+void bvh_update_item(Bvh* bvh, unsigned int item, glm::vec3 item_min, glm::vec3 item_max) {
+	bvh->item_min[item] = item_min;
+	bvh->item_max[item] = item_max;
+	bvh->dirty_leaves.push_back(bvh->item_leaf[item]);
+}
+
+void bvh_refit(Bvh* bvh) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	std::sort(bvh->dirty_leaves.begin(), bvh->dirty_leaves.end());
+	bvh->dirty_leaves.erase(std::unique(bvh->dirty_leaves.begin(), bvh->dirty_leaves.end()), bvh->dirty_leaves.end());
+
+	for (unsigned int leaf : bvh->dirty_leaves) {
+		BvhNode& node = bvh->nodes[leaf];
+		node.bounds_min = glm::vec3(FLT_MAX);
+		node.bounds_max = glm::vec3(-FLT_MAX);
+		for (unsigned int i = node.first; i < node.first + node.count; i++) {
+			node.bounds_min = glm::min(node.bounds_min, bvh->item_min[bvh->items[i]]);
+			node.bounds_max = glm::max(node.bounds_max, bvh->item_max[bvh->items[i]]);
+		}
+
+		unsigned int parent = node.parent;
+		while (parent != BVH_NO_PARENT) {
+			BvhNode& parent_node = bvh->nodes[parent];
+			const BvhNode& left = bvh->nodes[parent_node.left];
+			const BvhNode& right = bvh->nodes[parent_node.left + 1];
+			glm::vec3 bounds_min = glm::min(left.bounds_min, right.bounds_min);
+			glm::vec3 bounds_max = glm::max(left.bounds_max, right.bounds_max);
+			if (bounds_min == parent_node.bounds_min && bounds_max == parent_node.bounds_max) {
+				break;
+			}
+			parent_node.bounds_min = bounds_min;
+			parent_node.bounds_max = bounds_max;
+			parent = parent_node.parent;
+		}
+	}
+
+	bvh->dirty_leaves.clear();
+	bvh->refit_ms = bvh_elapsed_ms(start);
+}
+
+// Returns the planes in plane_mask the box straddles, or BVH_OUTSIDE if it is entirely behind one of them
+static unsigned int bvh_classify_box(const Frustum& frustum, glm::vec3 bounds_min, glm::vec3 bounds_max, unsigned int plane_mask) {
+	glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+	glm::vec3 extent = (bounds_max - bounds_min) * 0.5f;
+	unsigned int straddled = 0;
+	for (int i = 0; i < 6; i++) {
+		if ((plane_mask & (1u << i)) == 0) {
+			continue;
+		}
+		glm::vec3 normal = glm::vec3(frustum.planes[i]);
+		float distance = glm::dot(normal, center) + frustum.planes[i].w;
+		float radius = glm::dot(glm::abs(normal), extent);
+		if (distance + radius < 0.0f) {
+			return BVH_OUTSIDE;
+		}
+		if (distance - radius < 0.0f) {
+			straddled |= 1u << i;
+		}
+	}
+
+	return straddled;
+}
+
+unsigned int bvh_query_frustum(const Bvh& bvh, const Frustum& frustum, unsigned int* visible, BvhQueryStats* stats) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	BvhQueryStats query_stats = {};
+	unsigned int count = 0;
+
+	std::vector<BvhStackEntry> stack;
+	if (!bvh.nodes.empty()) {
+		stack.push_back({ 0, BVH_ALL_PLANES, 0.0f });
+	}
+	while (!stack.empty()) {
+		BvhStackEntry entry = stack.back();
+		stack.pop_back();
+		const BvhNode& node = bvh.nodes[entry.node];
+		query_stats.nodes_visited++;
+
+		unsigned int plane_mask = bvh_classify_box(frustum, node.bounds_min, node.bounds_max, entry.plane_mask);
+		if (plane_mask == BVH_OUTSIDE) {
+			continue;
+		}
+		if (plane_mask == 0) {
+			memcpy(visible + count, &bvh.items[node.first], node.count * sizeof(unsigned int));
+			count += node.count;
+			query_stats.subtrees_accepted++;
+			continue;
+		}
+		if (node.left == 0) {
+			for (unsigned int i = node.first; i < node.first + node.count; i++) {
+				unsigned int item = bvh.items[i];
+				query_stats.items_tested++;
+				if (bvh_classify_box(frustum, bvh.item_min[item], bvh.item_max[item], plane_mask) != BVH_OUTSIDE) {
+					visible[count++] = item;
+				}
+			}
+			continue;
+		}
+		stack.push_back({ node.left + 1, plane_mask, 0.0f });
+		stack.push_back({ node.left, plane_mask, 0.0f });
+	}
+
+	if (stats != NULL) {
+		query_stats.ms = bvh_elapsed_ms(start);
+		*stats = query_stats;
+	}
+
+	return count;
+}
+
+// Slab test. distance is where the ray enters the box, or 0 if it starts inside.
+static bool bvh_ray_box(glm::vec3 origin, glm::vec3 inverse_direction, glm::vec3 bounds_min, glm::vec3 bounds_max, float max_distance, float* distance) {
+	glm::vec3 t0 = (bounds_min - origin) * inverse_direction;
+	glm::vec3 t1 = (bounds_max - origin) * inverse_direction;
+	glm::vec3 t_min = glm::min(t0, t1);
+	glm::vec3 t_max = glm::max(t0, t1);
+	float enter = std::max(std::max(t_min.x, t_min.y), std::max(t_min.z, 0.0f));
+	float exit = std::min(std::min(t_max.x, t_max.y), std::min(t_max.z, max_distance));
+	*distance = enter;
+
+	return enter <= exit;
+}
+
+bool bvh_query_ray(const Bvh& bvh, glm::vec3 origin, glm::vec3 direction, float max_distance, BvhRayHit* hit, BvhQueryStats* stats) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	BvhQueryStats query_stats = {};
+	glm::vec3 inverse_direction = 1.0f / direction;
+	float best_distance = max_distance;
+	bool found = false;
+
+	std::vector<BvhStackEntry> stack;
+	float root_distance;
+	if (!bvh.nodes.empty() && bvh_ray_box(origin, inverse_direction, bvh.nodes[0].bounds_min, bvh.nodes[0].bounds_max, best_distance, &root_distance)) {
+		stack.push_back({ 0, 0, root_distance });
+	}
+	while (!stack.empty()) {
+		BvhStackEntry entry = stack.back();
+		stack.pop_back();
+		// A closer hit may have been found since this node was pushed
+		if (entry.distance > best_distance) {
+			continue;
+		}
+		const BvhNode& node = bvh.nodes[entry.node];
+		query_stats.nodes_visited++;
+
+		if (node.left == 0) {
+			for (unsigned int i = node.first; i < node.first + node.count; i++) {
+				unsigned int item = bvh.items[i];
+				float distance;
+				query_stats.items_tested++;
+				if (bvh_ray_box(origin, inverse_direction, bvh.item_min[item], bvh.item_max[item], best_distance, &distance)) {
+					best_distance = distance;
+					hit->item = item;
+					hit->distance = distance;
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// The nearer child goes on top so it is searched first
+		float left_distance, right_distance;
+		bool left_hit = bvh_ray_box(origin, inverse_direction, bvh.nodes[node.left].bounds_min, bvh.nodes[node.left].bounds_max, best_distance, &left_distance);
+		bool right_hit = bvh_ray_box(origin, inverse_direction, bvh.nodes[node.left + 1].bounds_min, bvh.nodes[node.left + 1].bounds_max, best_distance, &right_distance);
+		if (left_hit && right_hit) {
+			bool left_first = left_distance <= right_distance;
+			stack.push_back(left_first ? BvhStackEntry{ node.left + 1, 0, right_distance } : BvhStackEntry{ node.left, 0, left_distance });
+			stack.push_back(left_first ? BvhStackEntry{ node.left, 0, left_distance } : BvhStackEntry{ node.left + 1, 0, right_distance });
+		} else if (left_hit) {
+			stack.push_back({ node.left, 0, left_distance });
+		} else if (right_hit) {
+			stack.push_back({ node.left + 1, 0, right_distance });
+		}
+	}
+
+	if (stats != NULL) {
+		query_stats.ms = bvh_elapsed_ms(start);
+		*stats = query_stats;
+	}
+
+	return found;
+}
+
+static float bvh_box_distance_squared(glm::vec3 point, glm::vec3 bounds_min, glm::vec3 bounds_max) {
+	glm::vec3 offset = glm::max(glm::max(bounds_min - point, point - bounds_max), glm::vec3(0.0f));
+	return glm::dot(offset, offset);
+}
+
+bool bvh_query_nearest(const Bvh& bvh, glm::vec3 point, float max_distance, unsigned int* item, float* distance, BvhQueryStats* stats) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	BvhQueryStats query_stats = {};
+	// Compared squared until the end
+	float best_distance = max_distance * max_distance;
+	bool found = false;
+
+	std::vector<BvhStackEntry> stack;
+	if (!bvh.nodes.empty()) {
+		stack.push_back({ 0, 0, bvh_box_distance_squared(point, bvh.nodes[0].bounds_min, bvh.nodes[0].bounds_max) });
+	}
+	while (!stack.empty()) {
+		BvhStackEntry entry = stack.back();
+		stack.pop_back();
+		if (entry.distance > best_distance) {
+			continue;
+		}
+		const BvhNode& node = bvh.nodes[entry.node];
+		query_stats.nodes_visited++;
+
+		if (node.left == 0) {
+			for (unsigned int i = node.first; i < node.first + node.count; i++) {
+				unsigned int candidate = bvh.items[i];
+				query_stats.items_tested++;
+				float candidate_distance = bvh_box_distance_squared(point, bvh.item_min[candidate], bvh.item_max[candidate]);
+				if (candidate_distance <= best_distance) {
+					best_distance = candidate_distance;
+					*item = candidate;
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		float left_distance = bvh_box_distance_squared(point, bvh.nodes[node.left].bounds_min, bvh.nodes[node.left].bounds_max);
+		float right_distance = bvh_box_distance_squared(point, bvh.nodes[node.left + 1].bounds_min, bvh.nodes[node.left + 1].bounds_max);
+		bool left_first = left_distance <= right_distance;
+		stack.push_back(left_first ? BvhStackEntry{ node.left + 1, 0, right_distance } : BvhStackEntry{ node.left, 0, left_distance });
+		stack.push_back(left_first ? BvhStackEntry{ node.left, 0, left_distance } : BvhStackEntry{ node.left + 1, 0, right_distance });
+	}
+
+	if (found) {
+		*distance = std::sqrt(best_distance);
+	}
+	if (stats != NULL) {
+		query_stats.ms = bvh_elapsed_ms(start);
+		*stats = query_stats;
+	}
+
+	return found;
+}
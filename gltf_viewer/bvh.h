@@ -0,0 +1,68 @@
+#pragma once
+
+#include "frustum.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// Bounding volume hierarchy over world space object AABBs. Built top down with binned SAH splits, and refit
+// bottom up when objects move, which keeps the tree valid without rebuilding it. Every node covers a contiguous
+// range of bvh.items, so a subtree entirely inside the frustum is accepted without visiting its children.
+const unsigned int BVH_MAX_LEAF_ITEMS = 4;
+const unsigned int BVH_BIN_COUNT = 16;
+// Builds over this many items split the upper subtrees across threads
+const unsigned int BVH_PARALLEL_MIN_ITEMS = 100000;
+const unsigned int BVH_NO_PARENT = 0xFFFFFFFF;
+
+struct BvhNode {
+	glm::vec3 bounds_min;
+	// Index of the left child, the right child follows it. 0 for leaves, since the root is never a child.
+	unsigned int left;
+	glm::vec3 bounds_max;
+	unsigned int first;
+	unsigned int count;
+	unsigned int parent;
+};
+
+struct Bvh {
+	std::vector<BvhNode> nodes;
+	// Item indices in leaf order
+	std::vector<unsigned int> items;
+	std::vector<glm::vec3> item_min;
+	std::vector<glm::vec3> item_max;
+	std::vector<unsigned int> item_leaf;
+	std::vector<unsigned int> dirty_leaves;
+	unsigned int depth;
+	unsigned int build_threads;
+	double build_ms;
+	double refit_ms;
+};
+
+struct BvhQueryStats {
+	unsigned int nodes_visited;
+	unsigned int items_tested;
+	// Subtrees taken whole because they were entirely inside the frustum
+	unsigned int subtrees_accepted;
+	double ms;
+};
+
+struct BvhRayHit {
+	unsigned int item;
+	float distance;
+};
+
+// Uses up to max_threads threads once there are BVH_PARALLEL_MIN_ITEMS items
+void bvh_build(Bvh* bvh, const std::vector<glm::vec3>& item_min, const std::vector<glm::vec3>& item_max, unsigned int max_threads);
+// Moves an item. The tree isn't touched until the next bvh_refit.
+void bvh_update_item(Bvh* bvh, unsigned int item, glm::vec3 item_min, glm::vec3 item_max);
+// Refits the leaves of the updated items and their ancestors, stopping wherever a node's bounds didn't change.
+// Quality drops as items drift from where the tree was built, so rebuild after large changes.
+void bvh_refit(Bvh* bvh);
+
+// Queries test item AABBs, not the geometry inside them. stats may be NULL.
+// Writes the items touching the frustum, in no particular order. visible needs room for every item.
+unsigned int bvh_query_frustum(const Bvh& bvh, const Frustum& frustum, unsigned int* visible, BvhQueryStats* stats);
+// Nearest item whose AABB the ray hits within max_distance. direction doesn't need to be normalized, distances
+// are in multiples of it.
+bool bvh_query_ray(const Bvh& bvh, glm::vec3 origin, glm::vec3 direction, float max_distance, BvhRayHit* hit, BvhQueryStats* stats);
+// Item whose AABB is closest to point, within max_distance
+bool bvh_query_nearest(const Bvh& bvh, glm::vec3 point, float max_distance, unsigned int* item, float* distance, BvhQueryStats* stats);
@@ -0,0 +1,100 @@
+#include "camera_path.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+bool camera_path_load(CameraPath* path, const char* filename) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		printf("Unable to open camera path %s\n", filename);
+		return false;
+	}
+
+	path->keyframes.clear();
+	std::string line;
+	unsigned int line_number = 0;
+	while (std::getline(file, line)) {
+		line_number++;
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		std::istringstream stream(line);
+		CameraKeyframe keyframe;
+		if (!(stream >> keyframe.time >> keyframe.camera.position.x >> keyframe.camera.position.y >> keyframe.camera.position.z >> keyframe.camera.yaw >> keyframe.camera.pitch)) {
+			printf("Camera path %s line %u: expected time x y z yaw pitch\n", filename, line_number);
+			return false;
+		}
+		if (!path->keyframes.empty() && keyframe.time <= path->keyframes.back().time) {
+			printf("Camera path %s line %u: keyframe times must increase\n", filename, line_number);
+			return false;
+		}
+		path->keyframes.push_back(keyframe);
+	}
+
+	if (path->keyframes.empty()) {
+		printf("Camera path %s has no keyframes\n", filename);
+		return false;
+	}
+
+	return true;
+}
+
+void camera_path_create_orbit(CameraPath* path, glm::vec3 center, float radius, float height, float duration, unsigned int keyframe_count) {
+	path->keyframes.clear();
+	float pitch = -glm::degrees(std::atan2(height, radius));
+	for (unsigned int i = 0; i <= keyframe_count; i++) {
+		// Starts on the -z side, which is in front of the sphere grid
+		float angle = glm::radians(360.0f * (float)i / (float)keyframe_count - 90.0f);
+
+		// Yaw keeps increasing past 360 so the blend between keyframes never swings the long way round
+		CameraKeyframe keyframe;
+		keyframe.time = duration * (float)i / (float)keyframe_count;
+		keyframe.camera.position = center + glm::vec3(std::cos(angle) * radius, height, std::sin(angle) * radius);
+		keyframe.camera.yaw = glm::degrees(angle) + 180.0f;
+		keyframe.camera.pitch = pitch;
+		path->keyframes.push_back(keyframe);
+	}
+}
+
+float camera_path_duration(const CameraPath& path) {
+	return path.keyframes.empty() ? 0.0f : path.keyframes.back().time;
+}
+
+CameraState camera_path_sample(const CameraPath& path, float time) {
+	const std::vector<CameraKeyframe>& keyframes = path.keyframes;
+	if (keyframes.size() == 1) {
+		return keyframes[0].camera;
+	}
+
+	float duration = camera_path_duration(path);
+	if (duration > 0.0f) {
+		time = std::fmod(time, duration);
+	}
+
+	unsigned int segment = 0;
+	while (segment + 2 < keyframes.size() && keyframes[segment + 1].time <= time) {
+		segment++;
+	}
+	const CameraKeyframe& start = keyframes[segment];
+	const CameraKeyframe& end = keyframes[segment + 1];
+	float t = glm::clamp((time - start.time) / (end.time - start.time), 0.0f, 1.0f);
+
+	// The end keyframes stand in for their missing neighbours
+	glm::vec3 p0 = keyframes[segment == 0 ? 0 : segment - 1].camera.position;
+	glm::vec3 p1 = start.camera.position;
+	glm::vec3 p2 = end.camera.position;
+	glm::vec3 p3 = keyframes[segment + 2 < keyframes.size() ? segment + 2 : segment + 1].camera.position;
+	float t2 = t * t;
+	float t3 = t2 * t;
+
+	CameraState camera;
+	camera.position = 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+	camera.yaw = glm::mix(start.camera.yaw, end.camera.yaw, t);
+	camera.pitch = glm::mix(start.camera.pitch, end.camera.pitch, t);
+
+	return camera;
+}
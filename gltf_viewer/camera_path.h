@@ -0,0 +1,23 @@
+#pragma once
+
+#include "simulation.h"
+#include <vector>
+
+// Scripted camera for headless runs and benchmarks. Positions follow a Catmull-Rom spline through the keyframes,
+// yaw and pitch are blended linearly.
+struct CameraKeyframe {
+	float time;
+	CameraState camera;
+};
+
+struct CameraPath {
+	std::vector<CameraKeyframe> keyframes;
+};
+
+// Text file with one "time x y z yaw pitch" keyframe per line, sorted by time. Lines starting with # are skipped.
+bool camera_path_load(CameraPath* path, const char* filename);
+// Circles center once over duration, looking at it from height above
+void camera_path_create_orbit(CameraPath* path, glm::vec3 center, float radius, float height, float duration, unsigned int keyframe_count);
+float camera_path_duration(const CameraPath& path);
+// Times past the end wrap around to the start
+CameraState camera_path_sample(const CameraPath& path, float time);
@@ -0,0 +1,157 @@
+#include "cpu_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+static std::atomic<ProfilerThread*> threads[PROFILER_MAX_THREADS];
+static std::atomic<unsigned int> thread_count(0);
+static thread_local ProfilerThread* local_thread = NULL;
+static thread_local bool local_thread_full = false;
+static Uint64 base_time = 0;
+static double ticks_per_microsecond = 1.0;
+
+static ProfilerThread* profiler_get_thread() {
+	if (local_thread != NULL || local_thread_full) {
+		return local_thread;
+	}
+
+	unsigned int index = thread_count.fetch_add(1);
+	if (index >= PROFILER_MAX_THREADS) {
+		printf("Profiler thread limit reached, zones on this thread are ignored\n");
+		local_thread_full = true;
+		return NULL;
+	}
+	local_thread = new ProfilerThread();
+	local_thread->name = NULL;
+	local_thread->head.store(0);
+	threads[index].store(local_thread, std::memory_order_release);
+
+	return local_thread;
+}
+
+static void profiler_record(const char* name, ProfilerEventType type) {
+	ProfilerThread* thread = profiler_get_thread();
+	if (thread == NULL) {
+		return;
+	}
+
+	Uint64 head = thread->head.load(std::memory_order_relaxed);
+	ProfilerEvent& event = thread->events[head % PROFILER_RING_SIZE];
+	event.name = name;
+	event.time = SDL_GetPerformanceCounter();
+	event.type = type;
+	thread->head.store(head + 1, std::memory_order_release);
+}
+
+// Copies a thread's ring, keeping only the events that can't have been overwritten while copying
+static void profiler_copy_events(ProfilerThread* thread, std::vector<ProfilerEvent>* events) {
+	Uint64 head = thread->head.load(std::memory_order_acquire);
+	Uint64 first = head > PROFILER_RING_SIZE ? head - PROFILER_RING_SIZE : 0;
+	events->clear();
+	for (Uint64 index = first; index < head; index++) {
+		events->push_back(thread->events[index % PROFILER_RING_SIZE]);
+	}
+
+	// The writer may be partway through the slot after its current head, which holds the oldest event
+	Uint64 head_after = thread->head.load(std::memory_order_acquire);
+	Uint64 first_valid = head_after + 1 > PROFILER_RING_SIZE ? head_after + 1 - PROFILER_RING_SIZE : 0;
+	if (first_valid > first) {
+		Uint64 skip = std::min(first_valid - first, (Uint64)events->size());
+		events->erase(events->begin(), events->begin() + skip);
+	}
+}
+
+void profiler_init() {
+	base_time = SDL_GetPerformanceCounter();
+	ticks_per_microsecond = (double)SDL_GetPerformanceFrequency() / 1000000.0;
+}
+
+void profiler_set_thread_name(const char* name) {
+	ProfilerThread* thread = profiler_get_thread();
+	if (thread != NULL) {
+		thread->name = name;
+	}
+}
+
+void profiler_begin(const char* name) {
+	profiler_record(name, PROFILER_EVENT_BEGIN);
+}
+
+void profiler_end() {
+	profiler_record(NULL, PROFILER_EVENT_END);
+}
+
+void profiler_frame_mark() {
+	profiler_record("frame", PROFILER_EVENT_FRAME);
+}
+
+bool profiler_write_trace(const char* path, unsigned int frame_count) {
+	unsigned int count = std::min(thread_count.load(), PROFILER_MAX_THREADS);
+	std::vector<std::vector<ProfilerEvent>> thread_events(count);
+	std::vector<Uint64> frame_times;
+	for (unsigned int i = 0; i < count; i++) {
+		ProfilerThread* thread = threads[i].load(std::memory_order_acquire);
+		if (thread == NULL) {
+			continue;
+		}
+		profiler_copy_events(thread, &thread_events[i]);
+		for (const ProfilerEvent& event : thread_events[i]) {
+			if (event.type == PROFILER_EVENT_FRAME) {
+				frame_times.push_back(event.time);
+			}
+		}
+	}
+
+	// Everything since the start of the oldest requested frame
+	Uint64 start_time = 0;
+	std::sort(frame_times.begin(), frame_times.end());
+	if (frame_count != 0 && frame_times.size() > frame_count) {
+		start_time = frame_times[frame_times.size() - frame_count];
+	}
+
+	FILE* file = fopen(path, "w");
+	if (file == NULL) {
+		printf("Unable to open %s for writing\n", path);
+		return false;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"gltf_viewer\"}}");
+	unsigned int zones_written = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		ProfilerThread* thread = threads[i].load(std::memory_order_acquire);
+		if (thread == NULL) {
+			continue;
+		}
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", i, thread->name != NULL ? thread->name : "thread");
+
+		// Begins and ends are paired into complete events. Zones cut off by the start of the ring are dropped.
+		std::vector<const ProfilerEvent*> open_zones;
+		for (const ProfilerEvent& event : thread_events[i]) {
+			double timestamp = (double)(event.time - base_time) / ticks_per_microsecond;
+			if (event.type == PROFILER_EVENT_BEGIN) {
+				open_zones.push_back(&event);
+			} else if (event.type == PROFILER_EVENT_END) {
+				if (open_zones.empty()) {
+					continue;
+				}
+				const ProfilerEvent* begin = open_zones.back();
+				open_zones.pop_back();
+				if (event.time < start_time) {
+					continue;
+				}
+				double begin_timestamp = (double)(begin->time - base_time) / ticks_per_microsecond;
+				fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", begin->name, i, begin_timestamp, timestamp - begin_timestamp);
+				zones_written++;
+			} else if (event.time >= start_time) {
+				fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", event.name, i, timestamp);
+			}
+		}
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	printf("Wrote %u CPU zones to %s\n", zones_written, path);
+	return true;
+}
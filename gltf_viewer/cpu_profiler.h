@@ -0,0 +1,70 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <atomic>
+
+// CPU profiling zones. Each thread writes begin and end timestamps into its own ring buffer, which only that thread
+// writes to, so recording is a timer read and a store. The last few frames can be dumped as Chrome trace_event JSON
+// and opened in Perfetto or chrome://tracing.
+//
+// Zones are only compiled in when PROFILER_ENABLED is defined, otherwise the macros expand to nothing.
+// Main and update threads plus the cull, occlusion and light cluster pools of up to 8 workers each. Thread buffers are
+// only allocated when a thread first records, so unused slots cost a pointer.
+const unsigned int PROFILER_MAX_THREADS = 2 + 3 * 8;
+const unsigned int PROFILER_RING_SIZE = 1 << 15;
+const unsigned int PROFILER_TRACE_FRAMES = 120;
+
+enum ProfilerEventType {
+	PROFILER_EVENT_BEGIN,
+	PROFILER_EVENT_END,
+	PROFILER_EVENT_FRAME
+};
+
+// Names must be string literals, only the pointer is stored
+struct ProfilerEvent {
+	const char* name;
+	Uint64 time;
+	ProfilerEventType type;
+};
+
+struct ProfilerThread {
+	const char* name;
+	ProfilerEvent events[PROFILER_RING_SIZE];
+	// Total events ever written, the ring index is this modulo PROFILER_RING_SIZE
+	std::atomic<Uint64> head;
+};
+
+void profiler_init();
+// Threads are registered the first time they record something. Naming them is optional.
+void profiler_set_thread_name(const char* name);
+void profiler_begin(const char* name);
+void profiler_end();
+void profiler_frame_mark();
+// Writes the zones of the last frame_count frames. Safe to call while other threads keep recording.
+bool profiler_write_trace(const char* path, unsigned int frame_count);
+
+struct ProfilerZone {
+	ProfilerZone(const char* name) {
+		profiler_begin(name);
+	}
+	~ProfilerZone() {
+		profiler_end();
+	}
+};
+
+#ifdef PROFILER_ENABLED
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+// Times the rest of the enclosing scope
+#define PROFILE_ZONE(name) ProfilerZone PROFILER_CONCAT(profiler_zone_, __LINE__)(name)
+#define PROFILE_BEGIN(name) profiler_begin(name)
+#define PROFILE_END() profiler_end()
+#define PROFILE_FRAME() profiler_frame_mark()
+#define PROFILE_THREAD(name) profiler_set_thread_name(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_BEGIN(name)
+#define PROFILE_END()
+#define PROFILE_FRAME()
+#define PROFILE_THREAD(name)
+#endif
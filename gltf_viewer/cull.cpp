@@ -0,0 +1,418 @@
+#include "cull.h"
+#include "cpu_profiler.h"
+
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define CULL_HAS_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define CULL_TARGET_AVX
+	#else
+		// Lets the AVX path be built without building the rest of the viewer for AVX
+		#define CULL_TARGET_AVX __attribute__((target("avx")))
+	#endif
+#endif
+
+// The six planes with each component in its own array, plus the absolute normals for the AABB extents
+struct CullPlanes {
+	float x[6];
+	float y[6];
+	float z[6];
+	float w[6];
+	float abs_x[6];
+	float abs_y[6];
+	float abs_z[6];
+};
+
+// A batch aligned range of objects. Visible indices are written from visible + first so ranges never overlap.
+struct CullJob {
+	const CullBounds* bounds;
+	const CullPlanes* planes;
+	unsigned int first;
+	unsigned int last;
+	unsigned int* visible;
+	unsigned int visible_count;
+};
+
+static const char* WORKER_NAMES[CULL_MAX_WORKERS] = { "cull 0", "cull 1", "cull 2", "cull 3", "cull 4", "cull 5", "cull 6", "cull 7" };
+
+static CullImplementation implementation = CULL_SCALAR;
+static bool parallel = true;
+static unsigned int worker_count = 0;
+static SDL_Thread* workers[CULL_MAX_WORKERS];
+static SDL_sem* worker_start[CULL_MAX_WORKERS];
+static SDL_sem* workers_done = NULL;
+static CullJob jobs[CULL_MAX_WORKERS + 1];
+static std::atomic<bool> running(false);
+
+static inline unsigned int cull_lowest_bit(unsigned int mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (unsigned int)index;
+#else
+	return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+
+// Appends the indices of the set bits in mask, offset by base
+static inline unsigned int cull_write_visible(unsigned int mask, unsigned int base, unsigned int* visible) {
+	unsigned int count = 0;
+	while (mask != 0) {
+		visible[count++] = base + cull_lowest_bit(mask);
+		mask &= mask - 1;
+	}
+
+	return count;
+}
+
+// Lanes past the end of the range hold padding or the next range's objects
+static inline unsigned int cull_lane_mask(unsigned int base, unsigned int last, unsigned int lanes) {
+	unsigned int remaining = last - base;
+	return remaining >= lanes ? (1u << lanes) - 1 : (1u << remaining) - 1;
+}
+
+static unsigned int cull_range_scalar(const CullBounds& bounds, const CullPlanes& planes, unsigned int first, unsigned int last, unsigned int* visible) {
+	unsigned int count = 0;
+	for (unsigned int index = first; index < last; index++) {
+		bool outside = false;
+		for (int i = 0; i < 6 && !outside; i++) {
+			float sphere_distance = planes.x[i] * bounds.sphere_x[index] + planes.y[i] * bounds.sphere_y[index] + planes.z[i] * bounds.sphere_z[index] + planes.w[i];
+			float box_distance = planes.x[i] * bounds.box_x[index] + planes.y[i] * bounds.box_y[index] + planes.z[i] * bounds.box_z[index] + planes.w[i];
+			float box_radius = planes.abs_x[i] * bounds.box_extent_x[index] + planes.abs_y[i] * bounds.box_extent_y[index] + planes.abs_z[i] * bounds.box_extent_z[index];
+			outside = sphere_distance + bounds.sphere_radius[index] < 0.0f || box_distance + box_radius < 0.0f;
+		}
+		if (!outside) {
+			visible[count++] = index;
+		}
+	}
+
+	return count;
+}
+
+#ifdef CULL_HAS_X86
+static unsigned int cull_range_sse(const CullBounds& bounds, const CullPlanes& planes, unsigned int first, unsigned int last, unsigned int* visible) {
+	__m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6], plane_abs_x[6], plane_abs_y[6], plane_abs_z[6];
+	for (int i = 0; i < 6; i++) {
+		plane_x[i] = _mm_set1_ps(planes.x[i]);
+		plane_y[i] = _mm_set1_ps(planes.y[i]);
+		plane_z[i] = _mm_set1_ps(planes.z[i]);
+		plane_w[i] = _mm_set1_ps(planes.w[i]);
+		plane_abs_x[i] = _mm_set1_ps(planes.abs_x[i]);
+		plane_abs_y[i] = _mm_set1_ps(planes.abs_y[i]);
+		plane_abs_z[i] = _mm_set1_ps(planes.abs_z[i]);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	unsigned int count = 0;
+	for (unsigned int base = first; base < last; base += 4) {
+		__m128 sphere_x = _mm_loadu_ps(&bounds.sphere_x[base]);
+		__m128 sphere_y = _mm_loadu_ps(&bounds.sphere_y[base]);
+		__m128 sphere_z = _mm_loadu_ps(&bounds.sphere_z[base]);
+		__m128 sphere_radius = _mm_loadu_ps(&bounds.sphere_radius[base]);
+		__m128 box_x = _mm_loadu_ps(&bounds.box_x[base]);
+		__m128 box_y = _mm_loadu_ps(&bounds.box_y[base]);
+		__m128 box_z = _mm_loadu_ps(&bounds.box_z[base]);
+		__m128 box_extent_x = _mm_loadu_ps(&bounds.box_extent_x[base]);
+		__m128 box_extent_y = _mm_loadu_ps(&bounds.box_extent_y[base]);
+		__m128 box_extent_z = _mm_loadu_ps(&bounds.box_extent_z[base]);
+
+		__m128 outside = zero;
+		for (int i = 0; i < 6; i++) {
+			__m128 sphere_distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x[i], sphere_x), _mm_mul_ps(plane_y[i], sphere_y)), _mm_add_ps(_mm_mul_ps(plane_z[i], sphere_z), plane_w[i]));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(sphere_distance, sphere_radius), zero));
+
+			__m128 box_distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x[i], box_x), _mm_mul_ps(plane_y[i], box_y)), _mm_add_ps(_mm_mul_ps(plane_z[i], box_z), plane_w[i]));
+			__m128 box_radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_abs_x[i], box_extent_x), _mm_mul_ps(plane_abs_y[i], box_extent_y)), _mm_mul_ps(plane_abs_z[i], box_extent_z));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(box_distance, box_radius), zero));
+		}
+
+		unsigned int mask = ~(unsigned int)_mm_movemask_ps(outside) & cull_lane_mask(base, last, 4);
+		count += cull_write_visible(mask, base, visible + count);
+	}
+
+	return count;
+}
+
+CULL_TARGET_AVX static unsigned int cull_range_avx(const CullBounds& bounds, const CullPlanes& planes, unsigned int first, unsigned int last, unsigned int* visible) {
+	__m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6], plane_abs_x[6], plane_abs_y[6], plane_abs_z[6];
+	for (int i = 0; i < 6; i++) {
+		plane_x[i] = _mm256_set1_ps(planes.x[i]);
+		plane_y[i] = _mm256_set1_ps(planes.y[i]);
+		plane_z[i] = _mm256_set1_ps(planes.z[i]);
+		plane_w[i] = _mm256_set1_ps(planes.w[i]);
+		plane_abs_x[i] = _mm256_set1_ps(planes.abs_x[i]);
+		plane_abs_y[i] = _mm256_set1_ps(planes.abs_y[i]);
+		plane_abs_z[i] = _mm256_set1_ps(planes.abs_z[i]);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	unsigned int count = 0;
+	for (unsigned int base = first; base < last; base += 8) {
+		__m256 sphere_x = _mm256_loadu_ps(&bounds.sphere_x[base]);
+		__m256 sphere_y = _mm256_loadu_ps(&bounds.sphere_y[base]);
+		__m256 sphere_z = _mm256_loadu_ps(&bounds.sphere_z[base]);
+		__m256 sphere_radius = _mm256_loadu_ps(&bounds.sphere_radius[base]);
+		__m256 box_x = _mm256_loadu_ps(&bounds.box_x[base]);
+		__m256 box_y = _mm256_loadu_ps(&bounds.box_y[base]);
+		__m256 box_z = _mm256_loadu_ps(&bounds.box_z[base]);
+		__m256 box_extent_x = _mm256_loadu_ps(&bounds.box_extent_x[base]);
+		__m256 box_extent_y = _mm256_loadu_ps(&bounds.box_extent_y[base]);
+		__m256 box_extent_z = _mm256_loadu_ps(&bounds.box_extent_z[base]);
+
+		__m256 outside = zero;
+		for (int i = 0; i < 6; i++) {
+			__m256 sphere_distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(plane_x[i], sphere_x), _mm256_mul_ps(plane_y[i], sphere_y)), _mm256_add_ps(_mm256_mul_ps(plane_z[i], sphere_z), plane_w[i]));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(sphere_distance, sphere_radius), zero, _CMP_LT_OQ));
+
+			__m256 box_distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(plane_x[i], box_x), _mm256_mul_ps(plane_y[i], box_y)), _mm256_add_ps(_mm256_mul_ps(plane_z[i], box_z), plane_w[i]));
+			__m256 box_radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(plane_abs_x[i], box_extent_x), _mm256_mul_ps(plane_abs_y[i], box_extent_y)), _mm256_mul_ps(plane_abs_z[i], box_extent_z));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(box_distance, box_radius), zero, _CMP_LT_OQ));
+		}
+
+		unsigned int mask = ~(unsigned int)_mm256_movemask_ps(outside) & cull_lane_mask(base, last, 8);
+		count += cull_write_visible(mask, base, visible + count);
+	}
+
+	return count;
+}
+
+static bool cull_cpu_has_avx() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	bool has_osxsave = (info[2] & (1 << 27)) != 0;
+	bool has_avx = (info[2] & (1 << 28)) != 0;
+	// The OS also has to save the upper halves of the registers on context switches
+	return has_osxsave && has_avx && (_xgetbv(0) & 6) == 6;
+#else
+	return __builtin_cpu_supports("avx");
+#endif
+}
+#endif
+
+static void cull_run_job(CullJob* job) {
+	PROFILE_ZONE("cull_range");
+	unsigned int* visible = job->visible + job->first;
+	switch (implementation) {
+#ifdef CULL_HAS_X86
+		case CULL_SSE:
+			job->visible_count = cull_range_sse(*job->bounds, *job->planes, job->first, job->last, visible);
+			break;
+		case CULL_AVX:
+			job->visible_count = cull_range_avx(*job->bounds, *job->planes, job->first, job->last, visible);
+			break;
+#endif
+		default:
+			job->visible_count = cull_range_scalar(*job->bounds, *job->planes, job->first, job->last, visible);
+			break;
+	}
+}
+
+static int cull_worker_thread(void* data) {
+	unsigned int worker = (unsigned int)(size_t)data;
+	PROFILE_THREAD(WORKER_NAMES[worker]);
+	while (true) {
+		SDL_SemWait(worker_start[worker]);
+		if (!running.load()) {
+			break;
+		}
+		// Job 0 belongs to the calling thread
+		cull_run_job(&jobs[worker + 1]);
+		SDL_SemPost(workers_done);
+	}
+
+	return 0;
+}
+
+bool cull_init(unsigned int requested_workers) {
+	implementation = CULL_SCALAR;
+	for (int i = CULL_IMPLEMENTATION_COUNT - 1; i >= 0; i--) {
+		if (cull_implementation_supported((CullImplementation)i)) {
+			implementation = (CullImplementation)i;
+			break;
+		}
+	}
+
+	worker_count = 0;
+	requested_workers = requested_workers < CULL_MAX_WORKERS ? requested_workers : CULL_MAX_WORKERS;
+	if (requested_workers == 0) {
+		return true;
+	}
+
+	workers_done = SDL_CreateSemaphore(0);
+	if (workers_done == NULL) {
+		printf("Unable to create cull semaphore! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+	running.store(true);
+	for (unsigned int i = 0; i < requested_workers; i++) {
+		worker_start[i] = SDL_CreateSemaphore(0);
+		if (worker_start[i] == NULL) {
+			printf("Unable to create cull semaphore! SDL Error: %s\n", SDL_GetError());
+			cull_quit();
+			return false;
+		}
+		workers[i] = SDL_CreateThread(cull_worker_thread, WORKER_NAMES[i], (void*)(size_t)i);
+		if (workers[i] == NULL) {
+			printf("Unable to create cull worker thread! SDL Error: %s\n", SDL_GetError());
+			SDL_DestroySemaphore(worker_start[i]);
+			cull_quit();
+			return false;
+		}
+		worker_count++;
+	}
+
+	return true;
+}
+
+void cull_quit() {
+	running.store(false);
+	for (unsigned int i = 0; i < worker_count; i++) {
+		SDL_SemPost(worker_start[i]);
+		SDL_WaitThread(workers[i], NULL);
+		SDL_DestroySemaphore(worker_start[i]);
+	}
+	worker_count = 0;
+	if (workers_done != NULL) {
+		SDL_DestroySemaphore(workers_done);
+		workers_done = NULL;
+	}
+}
+
+bool cull_implementation_supported(CullImplementation implementation) {
+	switch (implementation) {
+		case CULL_SCALAR:
+			return true;
+#ifdef CULL_HAS_X86
+		case CULL_SSE:
+			return true;
+		case CULL_AVX:
+			return cull_cpu_has_avx();
+#endif
+		default:
+			return false;
+	}
+}
+
+const char* cull_implementation_name(CullImplementation implementation) {
+	switch (implementation) {
+		case CULL_SCALAR:
+			return "scalar";
+		case CULL_SSE:
+			return "SSE";
+		case CULL_AVX:
+			return "AVX";
+		default:
+			return "unknown";
+	}
+}
+
+void cull_set_implementation(CullImplementation new_implementation) {
+	if (!cull_implementation_supported(new_implementation)) {
+		printf("%s culling is not supported on this CPU\n", cull_implementation_name(new_implementation));
+		return;
+	}
+	implementation = new_implementation;
+}
+
+CullImplementation cull_get_implementation() {
+	return implementation;
+}
+
+void cull_set_parallel(bool new_parallel) {
+	parallel = new_parallel;
+}
+
+unsigned int cull_get_worker_count() {
+	return worker_count;
+}
+
+void cull_bounds_clear(CullBounds* bounds) {
+	*bounds = CullBounds();
+	bounds->count = 0;
+}
+
+unsigned int cull_bounds_add(CullBounds* bounds, glm::vec3 sphere_center, float sphere_radius, glm::vec3 box_min, glm::vec3 box_max) {
+	unsigned int index = bounds->count++;
+	// Grows a whole batch at a time so the SIMD loads never read past the end
+	if (index % CULL_BATCH_SIZE == 0) {
+		size_t size = index + CULL_BATCH_SIZE;
+		std::vector<float>* arrays[] = {
+			&bounds->sphere_x, &bounds->sphere_y, &bounds->sphere_z, &bounds->sphere_radius,
+			&bounds->box_x, &bounds->box_y, &bounds->box_z, &bounds->box_extent_x, &bounds->box_extent_y, &bounds->box_extent_z
+		};
+		for (std::vector<float>* array : arrays) {
+			array->resize(size, 0.0f);
+		}
+	}
+
+	glm::vec3 box_center = (box_min + box_max) * 0.5f;
+	glm::vec3 box_extent = (box_max - box_min) * 0.5f;
+	bounds->sphere_x[index] = sphere_center.x;
+	bounds->sphere_y[index] = sphere_center.y;
+	bounds->sphere_z[index] = sphere_center.z;
+	bounds->sphere_radius[index] = sphere_radius;
+	bounds->box_x[index] = box_center.x;
+	bounds->box_y[index] = box_center.y;
+	bounds->box_z[index] = box_center.z;
+	bounds->box_extent_x[index] = box_extent.x;
+	bounds->box_extent_y[index] = box_extent.y;
+	bounds->box_extent_z[index] = box_extent.z;
+
+	return index;
+}
+
+unsigned int cull_frustum(const CullBounds& bounds, const Frustum& frustum, unsigned int* visible) {
+	CullPlanes planes;
+	for (int i = 0; i < 6; i++) {
+		planes.x[i] = frustum.planes[i].x;
+		planes.y[i] = frustum.planes[i].y;
+		planes.z[i] = frustum.planes[i].z;
+		planes.w[i] = frustum.planes[i].w;
+		planes.abs_x[i] = std::fabs(frustum.planes[i].x);
+		planes.abs_y[i] = std::fabs(frustum.planes[i].y);
+		planes.abs_z[i] = std::fabs(frustum.planes[i].z);
+	}
+
+	unsigned int job_count = 1;
+	if (parallel && worker_count != 0 && bounds.count >= CULL_PARALLEL_MIN_OBJECTS) {
+		job_count = worker_count + 1;
+	}
+	unsigned int batch_count = (bounds.count + CULL_BATCH_SIZE - 1) / CULL_BATCH_SIZE;
+	unsigned int job_batches = (batch_count + job_count - 1) / job_count;
+	for (unsigned int i = 0; i < job_count; i++) {
+		CullJob& job = jobs[i];
+		job.bounds = &bounds;
+		job.planes = &planes;
+		job.first = glm::min(i * job_batches * CULL_BATCH_SIZE, bounds.count);
+		job.last = glm::min((i + 1) * job_batches * CULL_BATCH_SIZE, bounds.count);
+		job.visible = visible;
+		job.visible_count = 0;
+	}
+
+	for (unsigned int i = 1; i < job_count; i++) {
+		SDL_SemPost(worker_start[i - 1]);
+	}
+	cull_run_job(&jobs[0]);
+	for (unsigned int i = 1; i < job_count; i++) {
+		SDL_SemWait(workers_done);
+	}
+
+	// Close the gaps between the ranges. Each range only moves down, so the copies never clobber unread indices.
+	unsigned int count = jobs[0].visible_count;
+	for (unsigned int i = 1; i < job_count; i++) {
+		if (jobs[i].visible_count != 0 && jobs[i].first != count) {
+			memmove(visible + count, visible + jobs[i].first, jobs[i].visible_count * sizeof(unsigned int));
+		}
+		count += jobs[i].visible_count;
+	}
+
+	return count;
+}
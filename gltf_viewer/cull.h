@@ -0,0 +1,54 @@
+#pragma once
+
+#include "frustum.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+// Frustum culling over object bounds kept as structure-of-arrays, so SSE tests 4 objects per instruction and AVX
+// tests 8. Every object has a world space bounding sphere and AABB and is only visible if both touch the frustum.
+// Large object counts are split across worker threads, each compacting its own range of visible indices.
+const unsigned int CULL_BATCH_SIZE = 8;
+const unsigned int CULL_MAX_WORKERS = 8;
+// Below this many objects handing ranges to the workers costs more than it saves
+const unsigned int CULL_PARALLEL_MIN_OBJECTS = 32768;
+
+enum CullImplementation {
+	CULL_SCALAR,
+	CULL_SSE,
+	CULL_AVX,
+	CULL_IMPLEMENTATION_COUNT
+};
+
+// Arrays are padded to a multiple of CULL_BATCH_SIZE, the padding lanes are masked off rather than tested
+struct CullBounds {
+	unsigned int count;
+	std::vector<float> sphere_x;
+	std::vector<float> sphere_y;
+	std::vector<float> sphere_z;
+	std::vector<float> sphere_radius;
+	// AABBs are stored as center and half extents
+	std::vector<float> box_x;
+	std::vector<float> box_y;
+	std::vector<float> box_z;
+	std::vector<float> box_extent_x;
+	std::vector<float> box_extent_y;
+	std::vector<float> box_extent_z;
+};
+
+// worker_count threads are started on top of the calling thread, which always takes a share of the work
+bool cull_init(unsigned int worker_count);
+void cull_quit();
+bool cull_implementation_supported(CullImplementation implementation);
+const char* cull_implementation_name(CullImplementation implementation);
+// Defaults to the widest supported implementation
+void cull_set_implementation(CullImplementation implementation);
+CullImplementation cull_get_implementation();
+void cull_set_parallel(bool parallel);
+unsigned int cull_get_worker_count();
+
+void cull_bounds_clear(CullBounds* bounds);
+// Returns the object's index
+unsigned int cull_bounds_add(CullBounds* bounds, glm::vec3 sphere_center, float sphere_radius, glm::vec3 box_min, glm::vec3 box_max);
+// Writes the indices of the visible objects in ascending order and returns how many there are. visible must have
+// room for bounds.count indices. Not reentrant, only one thread may cull at a time.
+unsigned int cull_frustum(const CullBounds& bounds, const Frustum& frustum, unsigned int* visible);
@@ -0,0 +1,98 @@
+#include "depth_prepass.h"
+
+static const char* DEPTH_PREPASS_MODE_NAMES[] = { "off", "on", "auto" };
+
+void depth_prepass_init(DepthPrepass* prepass, DepthPrepassMode mode) {
+	for (unsigned int slot = 0; slot < DEPTH_PREPASS_FRAME_LATENCY; slot++) {
+		glGenQueries(DEPTH_PREPASS_QUERY_COUNT, prepass->queries[slot]);
+		prepass->pending[slot] = false;
+	}
+	prepass->current = 0;
+	prepass->frame = 0;
+	prepass->running = false;
+	prepass->overdraw = 0.0f;
+	depth_prepass_set_mode(prepass, mode);
+}
+
+void depth_prepass_quit(DepthPrepass* prepass) {
+	for (unsigned int slot = 0; slot < DEPTH_PREPASS_FRAME_LATENCY; slot++) {
+		glDeleteQueries(DEPTH_PREPASS_QUERY_COUNT, prepass->queries[slot]);
+	}
+}
+
+void depth_prepass_set_mode(DepthPrepass* prepass, DepthPrepassMode mode) {
+	prepass->mode = mode;
+	// Auto mode starts off and measures on the next frame
+	prepass->enabled = false;
+	prepass->next_probe = prepass->frame;
+}
+
+static void depth_prepass_collect(DepthPrepass* prepass, unsigned int slot) {
+	GLuint64 depth_samples = 0;
+	GLuint64 shaded_samples = 0;
+	glGetQueryObjectui64v(prepass->queries[slot][DEPTH_PREPASS_QUERY_DEPTH], GL_QUERY_RESULT, &depth_samples);
+	glGetQueryObjectui64v(prepass->queries[slot][DEPTH_PREPASS_QUERY_SHADED], GL_QUERY_RESULT, &shaded_samples);
+	prepass->pending[slot] = false;
+	if (shaded_samples == 0) {
+		return;
+	}
+
+	prepass->overdraw = (float)((double)depth_samples / (double)shaded_samples);
+	if (prepass->mode == DEPTH_PREPASS_AUTO) {
+		// Separate thresholds for switching on and off, so overdraw near the limit doesn't flip it every probe
+		prepass->enabled = prepass->overdraw >= (prepass->enabled ? DEPTH_PREPASS_OFF_OVERDRAW : DEPTH_PREPASS_ON_OVERDRAW);
+		if (!prepass->enabled) {
+			prepass->next_probe = prepass->frame + DEPTH_PREPASS_PROBE_FRAMES;
+		}
+	}
+}
+
+bool depth_prepass_begin_frame(DepthPrepass* prepass) {
+	prepass->current = (prepass->current + 1) % DEPTH_PREPASS_FRAME_LATENCY;
+	prepass->frame++;
+
+	// Oldest first. The shaded query is issued last, so once it is available the frame is done.
+	for (unsigned int i = 0; i < DEPTH_PREPASS_FRAME_LATENCY; i++) {
+		unsigned int slot = (prepass->current + i) % DEPTH_PREPASS_FRAME_LATENCY;
+		if (!prepass->pending[slot]) {
+			continue;
+		}
+		GLuint available = 0;
+		glGetQueryObjectuiv(prepass->queries[slot][DEPTH_PREPASS_QUERY_SHADED], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == 0) {
+			break;
+		}
+		depth_prepass_collect(prepass, slot);
+	}
+	// A measurement still not in by the time its slot comes around is dropped
+	prepass->pending[prepass->current] = false;
+
+	switch (prepass->mode) {
+		case DEPTH_PREPASS_OFF:
+			prepass->running = false;
+			break;
+		case DEPTH_PREPASS_ON:
+			prepass->running = true;
+			break;
+		case DEPTH_PREPASS_AUTO:
+			prepass->running = prepass->enabled || prepass->frame >= prepass->next_probe;
+			if (prepass->running && !prepass->enabled) {
+				prepass->next_probe = prepass->frame + DEPTH_PREPASS_PROBE_FRAMES;
+			}
+			break;
+		default:
+			prepass->running = false;
+			break;
+	}
+	prepass->pending[prepass->current] = prepass->running;
+
+	return prepass->running;
+}
+
+GLuint depth_prepass_get_query(const DepthPrepass& prepass, DepthPrepassQuery query) {
+	return prepass.queries[prepass.current][query];
+}
+
+const char* depth_prepass_mode_name(DepthPrepassMode mode) {
+	return DEPTH_PREPASS_MODE_NAMES[mode];
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Depth-only pass ahead of the opaque pass, so the PBR shader only runs once per visible sample. The opaque pass
+// then tests GL_EQUAL against the laid down depth without writing it. It pays off once overdraw is high enough that
+// the shading saved outweighs drawing the geometry twice.
+//
+// Overdraw is measured with GL_SAMPLES_PASSED queries on frames that run the pre-pass: samples that pass the
+// pre-pass's front to back depth test are what the opaque pass would shade without it, and samples that pass the
+// equal test are the visible ones. In auto mode the pre-pass switches off once overdraw drops below
+// DEPTH_PREPASS_OFF_OVERDRAW, and while off, one frame in every DEPTH_PREPASS_PROBE_FRAMES runs it to measure again.
+enum DepthPrepassMode {
+	DEPTH_PREPASS_OFF,
+	DEPTH_PREPASS_ON,
+	DEPTH_PREPASS_AUTO,
+	DEPTH_PREPASS_MODE_COUNT
+};
+
+enum DepthPrepassQuery {
+	DEPTH_PREPASS_QUERY_DEPTH,
+	DEPTH_PREPASS_QUERY_SHADED,
+	DEPTH_PREPASS_QUERY_COUNT
+};
+
+// Results are read without stalling, the same way as the GPU timers
+const unsigned int DEPTH_PREPASS_FRAME_LATENCY = 4;
+const unsigned int DEPTH_PREPASS_PROBE_FRAMES = 120;
+const float DEPTH_PREPASS_ON_OVERDRAW = 1.3f;
+const float DEPTH_PREPASS_OFF_OVERDRAW = 1.15f;
+
+struct DepthPrepass {
+	DepthPrepassMode mode;
+	// Whether auto mode currently wants the pre-pass, and whether this frame runs it
+	bool enabled;
+	bool running;
+	unsigned long frame;
+	unsigned long next_probe;
+	// Opaque samples that passed a front to back depth test per visible sample, 0 until measured
+	float overdraw;
+
+	GLuint queries[DEPTH_PREPASS_FRAME_LATENCY][DEPTH_PREPASS_QUERY_COUNT];
+	bool pending[DEPTH_PREPASS_FRAME_LATENCY];
+	unsigned int current;
+};
+
+void depth_prepass_init(DepthPrepass* prepass, DepthPrepassMode mode);
+void depth_prepass_quit(DepthPrepass* prepass);
+void depth_prepass_set_mode(DepthPrepass* prepass, DepthPrepassMode mode);
+// Call once per frame before rendering. Collects finished measurements and returns whether this frame runs the pre-pass.
+bool depth_prepass_begin_frame(DepthPrepass* prepass);
+// Query for the current frame's opaque samples, see RenderQueue::opaque_samples_query
+GLuint depth_prepass_get_query(const DepthPrepass& prepass, DepthPrepassQuery query);
+const char* depth_prepass_mode_name(DepthPrepassMode mode);
@@ -0,0 +1,81 @@
+#include "dynamic_resolution.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static float dynamic_resolution_clamp(const DynamicResolutionSettings& settings, float scale) {
+	return scale < settings.min_scale ? settings.min_scale : (scale > settings.max_scale ? settings.max_scale : scale);
+}
+
+void dynamic_resolution_init(DynamicResolution* controller, const DynamicResolutionSettings& settings, float scale) {
+	*controller = DynamicResolution();
+	controller->settings = settings;
+	controller->scale = scale;
+	dynamic_resolution_set_enabled(controller, settings.enabled);
+}
+
+void dynamic_resolution_set_enabled(DynamicResolution* controller, bool enabled) {
+	controller->settings.enabled = enabled;
+	controller->settle_frames = DYNAMIC_RESOLUTION_SETTLE_FRAMES;
+	controller->sample_sum = 0.0;
+	controller->sample_count = 0;
+	if (enabled) {
+		controller->scale = dynamic_resolution_clamp(controller->settings, controller->scale);
+	}
+}
+
+bool dynamic_resolution_update(DynamicResolution* controller, const char* zone) {
+	// Always collected, so turning the controller on doesn't start from a backlog
+	std::vector<double> samples;
+	controller->next_sample = gpu_timer_get_samples(zone, controller->next_sample, &samples);
+	if (!controller->settings.enabled) {
+		return false;
+	}
+	if (controller->settle_frames > 0) {
+		controller->settle_frames--;
+		return false;
+	}
+	for (double sample : samples) {
+		controller->sample_sum += sample;
+		controller->sample_count++;
+	}
+	if (controller->sample_count < DYNAMIC_RESOLUTION_SAMPLES) {
+		return false;
+	}
+
+	const DynamicResolutionSettings& settings = controller->settings;
+	double measured_ms = controller->sample_sum / (double)controller->sample_count;
+	controller->measured_ms = measured_ms;
+	controller->sample_sum = 0.0;
+	controller->sample_count = 0;
+	bool over = measured_ms > settings.budget_ms;
+	bool under = measured_ms < settings.budget_ms * DYNAMIC_RESOLUTION_RAISE_FRACTION;
+	if (!over && !under) {
+		return false;
+	}
+
+	// At least one step whichever way it has to go
+	float target = controller->scale * (float)std::sqrt(settings.budget_ms * DYNAMIC_RESOLUTION_HEADROOM / measured_ms);
+	float scale = std::round(target / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP;
+	if (over && scale > controller->scale - DYNAMIC_RESOLUTION_STEP) {
+		scale = controller->scale - DYNAMIC_RESOLUTION_STEP;
+	} else if (under && scale < controller->scale + DYNAMIC_RESOLUTION_STEP) {
+		scale = controller->scale + DYNAMIC_RESOLUTION_STEP;
+	}
+	scale = dynamic_resolution_clamp(settings, scale);
+	if (std::fabs(scale - controller->scale) < DYNAMIC_RESOLUTION_STEP * 0.5f) {
+		return false;
+	}
+
+	printf("Dynamic resolution: %.2f -> %.2f, gpu %.2f ms against a %.2f ms budget\n", controller->scale, scale, measured_ms, settings.budget_ms);
+	controller->scale = scale;
+	controller->settle_frames = DYNAMIC_RESOLUTION_SETTLE_FRAMES;
+	controller->changes++;
+	return true;
+}
+
+void dynamic_resolution_size(float scale, unsigned int width, unsigned int height, unsigned int* render_width, unsigned int* render_height) {
+	*render_width = (unsigned int)std::fmax(std::round((float)width * scale), 1.0f);
+	*render_height = (unsigned int)std::fmax(std::round((float)height * scale), 1.0f);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "gpu_timer.h"
+
+// Scales the scene's render targets to keep the GPU frame time within a budget. The scene is upscaled to the
+// window when presented and the overlay is drawn on top at the window's resolution, so only the scene pays.
+//
+// Each frame the controller collects the GPU times that have come in for a timer zone. They trail by a few frames,
+// so after a change it throws away what arrives during the settle frames, then judges the mean of a few frames
+// measured at the new scale. Time is taken to go with the pixel count, so the scale moves by the square root of
+// the time it wants over the time it measured. It aims for DYNAMIC_RESOLUTION_HEADROOM of the budget, and only
+// raises the scale once frames are below DYNAMIC_RESOLUTION_RAISE_FRACTION of it, so it doesn't hunt around the
+// limit. Scales are rounded to DYNAMIC_RESOLUTION_STEP, so the render graph's pool only ever sees a few sizes.
+const float DYNAMIC_RESOLUTION_STEP = 0.05f;
+const float DYNAMIC_RESOLUTION_HEADROOM = 0.9f;
+const float DYNAMIC_RESOLUTION_RAISE_FRACTION = 0.75f;
+const unsigned int DYNAMIC_RESOLUTION_SAMPLES = 3;
+const unsigned int DYNAMIC_RESOLUTION_SETTLE_FRAMES = GPU_TIMER_FRAME_LATENCY + 1;
+
+struct DynamicResolutionSettings {
+	bool enabled;
+	float budget_ms;
+	float min_scale;
+	float max_scale;
+};
+
+struct DynamicResolution {
+	DynamicResolutionSettings settings;
+	// Of the window's width and height
+	float scale;
+	unsigned long next_sample;
+	unsigned int settle_frames;
+	double sample_sum;
+	unsigned int sample_count;
+	// Mean GPU time of the last frames judged, 0 until then
+	double measured_ms;
+	unsigned int changes;
+};
+
+// Starts at scale, which is also the fixed scale while the controller is off
+void dynamic_resolution_init(DynamicResolution* controller, const DynamicResolutionSettings& settings, float scale);
+void dynamic_resolution_set_enabled(DynamicResolution* controller, bool enabled);
+// Call once per frame on the GL thread, after the frame's zones have ended. Returns true if the scale changed,
+// and logs each change with the time that caused it.
+bool dynamic_resolution_update(DynamicResolution* controller, const char* zone);
+// Pixel size at a scale, at least 1x1
+void dynamic_resolution_size(float scale, unsigned int width, unsigned int height, unsigned int* render_width, unsigned int* render_height);
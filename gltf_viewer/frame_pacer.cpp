@@ -0,0 +1,147 @@
+#include "frame_pacer.h"
+#include "platform.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// SDL_Delay can overshoot by a couple of milliseconds, so stop sleeping this far before the deadline and spin the rest
+static const double SPIN_THRESHOLD_SECONDS = 0.002;
+
+static void frame_pacer_update_stats(FramePacer* pacer) {
+	FramePacerStats stats;
+	memset(&stats, 0, sizeof(stats));
+	stats.fps = pacer->frames;
+
+	if (pacer->sample_count != 0) {
+		double frame_time_total = 0.0;
+		double busy_time_total = 0.0;
+		for (unsigned int i = 0; i < pacer->sample_count; i++) {
+			frame_time_total += pacer->frame_times[i];
+			busy_time_total += pacer->busy_times[i];
+			if (pacer->frame_times[i] > stats.frame_time_max) {
+				stats.frame_time_max = pacer->frame_times[i];
+			}
+		}
+		stats.frame_time_mean = frame_time_total / pacer->sample_count;
+		stats.cpu_utilization = frame_time_total > 0.0 ? busy_time_total / frame_time_total : 0.0;
+
+		// Jitter is the standard deviation of the frame time
+		double variance = 0.0;
+		for (unsigned int i = 0; i < pacer->sample_count; i++) {
+			double difference = pacer->frame_times[i] - stats.frame_time_mean;
+			variance += difference * difference;
+		}
+		stats.frame_time_jitter = std::sqrt(variance / pacer->sample_count);
+	}
+
+	pacer->stats = stats;
+}
+
+void frame_pacer_init(FramePacer* pacer, FramePacingMode mode, double target_fps) {
+	memset(pacer, 0, sizeof(FramePacer));
+	pacer->target_fps = target_fps;
+	pacer->frequency = SDL_GetPerformanceFrequency();
+	pacer->frame_start = SDL_GetPerformanceCounter();
+	pacer->deadline = pacer->frame_start;
+	pacer->last_second = pacer->frame_start;
+	frame_pacer_set_mode(pacer, mode);
+}
+
+void frame_pacer_set_mode(FramePacer* pacer, FramePacingMode mode) {
+	int swap_interval = 0;
+	if (mode == FRAME_PACING_VSYNC) {
+		swap_interval = 1;
+	} else if (mode == FRAME_PACING_ADAPTIVE_VSYNC) {
+		swap_interval = -1;
+	}
+
+	if (!platform_set_swap_interval(swap_interval)) {
+		if (mode == FRAME_PACING_ADAPTIVE_VSYNC) {
+			printf("Adaptive vsync not supported, using vsync. SDL Error: %s\n", SDL_GetError());
+			platform_set_swap_interval(1);
+		} else {
+			printf("Unable to set swap interval to %i. SDL Error: %s\n", swap_interval, SDL_GetError());
+		}
+	}
+
+	// Start stats fresh so each mode is measured on its own
+	pacer->mode = mode;
+	pacer->deadline = SDL_GetPerformanceCounter();
+	pacer->sample_index = 0;
+	pacer->sample_count = 0;
+}
+
+const char* frame_pacer_mode_name(FramePacingMode mode) {
+	switch (mode) {
+		case FRAME_PACING_VSYNC:
+			return "vsync";
+		case FRAME_PACING_ADAPTIVE_VSYNC:
+			return "adaptive vsync";
+		case FRAME_PACING_LIMITED:
+			return "limited";
+		case FRAME_PACING_UNCAPPED:
+			return "uncapped";
+		default:
+			return "unknown";
+	}
+}
+
+float frame_pacer_begin_frame(FramePacer* pacer) {
+	Uint64 now = SDL_GetPerformanceCounter();
+	double frame_seconds = (double)(now - pacer->frame_start) / (double)pacer->frequency;
+	double busy_seconds = (double)(pacer->work_time + pacer->spin_time) / (double)pacer->frequency;
+	pacer->frame_start = now;
+
+	pacer->frame_times[pacer->sample_index] = frame_seconds * 1000.0;
+	pacer->busy_times[pacer->sample_index] = busy_seconds * 1000.0;
+	pacer->sample_index = (pacer->sample_index + 1) % FRAME_PACER_SAMPLE_COUNT;
+	if (pacer->sample_count < FRAME_PACER_SAMPLE_COUNT) {
+		pacer->sample_count++;
+	}
+
+	pacer->frames++;
+	if (now - pacer->last_second >= pacer->frequency) {
+		frame_pacer_update_stats(pacer);
+		pacer->frames = 0;
+		pacer->last_second += pacer->frequency;
+		// Don't try to catch up on seconds lost to a long stall
+		if (now - pacer->last_second >= pacer->frequency) {
+			pacer->last_second = now;
+		}
+	}
+
+	return (float)frame_seconds;
+}
+
+void frame_pacer_wait(FramePacer* pacer) {
+	Uint64 now = SDL_GetPerformanceCounter();
+	pacer->work_time = now - pacer->frame_start;
+	pacer->spin_time = 0;
+
+	if (pacer->mode != FRAME_PACING_LIMITED || pacer->target_fps <= 0.0) {
+		return;
+	}
+
+	// Deadlines advance by a fixed period so rounding doesn't accumulate. If a frame ran over by more than a period,
+	// the schedule restarts from now instead of rushing out several frames to catch up. The late frame goes out at
+	// once and the next one is paced from it.
+	Uint64 period = (Uint64)((double)pacer->frequency / pacer->target_fps);
+	pacer->deadline += period;
+	if (now > pacer->deadline + period) {
+		pacer->deadline = now;
+	}
+	if (now >= pacer->deadline) {
+		return;
+	}
+
+	double remaining = (double)(pacer->deadline - now) / (double)pacer->frequency;
+	if (remaining > SPIN_THRESHOLD_SECONDS) {
+		SDL_Delay((Uint32)((remaining - SPIN_THRESHOLD_SECONDS) * 1000.0));
+	}
+
+	Uint64 spin_start = SDL_GetPerformanceCounter();
+	while (SDL_GetPerformanceCounter() < pacer->deadline) {
+	}
+	pacer->spin_time = SDL_GetPerformanceCounter() - spin_start;
+}
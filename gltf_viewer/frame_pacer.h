@@ -0,0 +1,53 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+
+enum FramePacingMode {
+	FRAME_PACING_VSYNC,
+	// Late frames are shown immediately instead of waiting for the next vblank. Falls back to vsync if unsupported.
+	FRAME_PACING_ADAPTIVE_VSYNC,
+	// Sleeps then spins until the next frame deadline with the swap interval off
+	FRAME_PACING_LIMITED,
+	FRAME_PACING_UNCAPPED,
+	FRAME_PACING_MODE_COUNT
+};
+
+// Stats over the last FRAME_PACER_SAMPLE_COUNT frames, refreshed once a second. Times are in milliseconds.
+struct FramePacerStats {
+	unsigned int fps;
+	double frame_time_mean;
+	double frame_time_jitter;
+	double frame_time_max;
+	// Fraction of the frame the CPU was busy, counting work and spin-waiting but not sleeping or blocking in the swap
+	double cpu_utilization;
+};
+
+const unsigned int FRAME_PACER_SAMPLE_COUNT = 240;
+
+struct FramePacer {
+	FramePacingMode mode;
+	double target_fps;
+
+	Uint64 frequency;
+	Uint64 frame_start;
+	Uint64 deadline;
+	Uint64 work_time;
+	Uint64 spin_time;
+	Uint64 last_second;
+	unsigned int frames;
+
+	double frame_times[FRAME_PACER_SAMPLE_COUNT];
+	double busy_times[FRAME_PACER_SAMPLE_COUNT];
+	unsigned int sample_index;
+	unsigned int sample_count;
+
+	FramePacerStats stats;
+};
+
+void frame_pacer_init(FramePacer* pacer, FramePacingMode mode, double target_fps);
+void frame_pacer_set_mode(FramePacer* pacer, FramePacingMode mode);
+const char* frame_pacer_mode_name(FramePacingMode mode);
+// Call at the top of the frame, returns seconds since the previous frame started
+float frame_pacer_begin_frame(FramePacer* pacer);
+// Call once the frame is rendered, right before swapping
+void frame_pacer_wait(FramePacer* pacer);
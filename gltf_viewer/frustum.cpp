@@ -0,0 +1,32 @@
+#include "frustum.h"
+
+// Gribb/Hartmann plane extraction from the rows of the combined matrix
+Frustum frustum_from_matrix(const glm::mat4& projection_view) {
+	glm::vec4 row_x = glm::vec4(projection_view[0][0], projection_view[1][0], projection_view[2][0], projection_view[3][0]);
+	glm::vec4 row_y = glm::vec4(projection_view[0][1], projection_view[1][1], projection_view[2][1], projection_view[3][1]);
+	glm::vec4 row_z = glm::vec4(projection_view[0][2], projection_view[1][2], projection_view[2][2], projection_view[3][2]);
+	glm::vec4 row_w = glm::vec4(projection_view[0][3], projection_view[1][3], projection_view[2][3], projection_view[3][3]);
+
+	Frustum frustum;
+	frustum.planes[0] = row_w + row_x;
+	frustum.planes[1] = row_w - row_x;
+	frustum.planes[2] = row_w + row_y;
+	frustum.planes[3] = row_w - row_y;
+	frustum.planes[4] = row_w + row_z;
+	frustum.planes[5] = row_w - row_z;
+	for (int i = 0; i < 6; i++) {
+		frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+	}
+
+	return frustum;
+}
+
+bool frustum_intersects_sphere(const Frustum& frustum, glm::vec3 center, float radius) {
+	for (int i = 0; i < 6; i++) {
+		if (glm::dot(glm::vec3(frustum.planes[i]), center) + frustum.planes[i].w < -radius) {
+			return false;
+		}
+	}
+
+	return true;
+}
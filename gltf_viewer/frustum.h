@@ -0,0 +1,11 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Planes point inwards: a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all six
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+Frustum frustum_from_matrix(const glm::mat4& projection_view);
+bool frustum_intersects_sphere(const Frustum& frustum, glm::vec3 center, float radius);
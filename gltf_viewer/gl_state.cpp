@@ -0,0 +1,217 @@
+#include "gl_state.h"
+
+#include <cstring>
+
+static const unsigned int MAX_TEXTURE_UNITS = 16;
+static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+// Only these texture targets and capabilities are tracked, anything else is passed straight through
+static const GLenum TEXTURE_TARGETS[] = { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_MULTISAMPLE, GL_TEXTURE_BUFFER };
+static const unsigned int TEXTURE_TARGET_COUNT = sizeof(TEXTURE_TARGETS) / sizeof(GLenum);
+static const GLenum CAPABILITIES[] = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE };
+static const unsigned int CAPABILITY_COUNT = sizeof(CAPABILITIES) / sizeof(GLenum);
+
+static GLuint current_program;
+static GLuint current_active_texture;
+static GLuint current_textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+static GLuint current_vao;
+static GLuint current_read_framebuffer;
+static GLuint current_draw_framebuffer;
+static GLuint current_capabilities[CAPABILITY_COUNT];
+static GLuint current_blend_source;
+static GLuint current_blend_destination;
+static GLuint current_depth_func;
+static GLuint current_depth_mask;
+
+static GLStateStats stats;
+
+static int texture_target_index(GLenum target) {
+	for (unsigned int i = 0; i < TEXTURE_TARGET_COUNT; i++) {
+		if (TEXTURE_TARGETS[i] == target) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+static int capability_index(GLenum capability) {
+	for (unsigned int i = 0; i < CAPABILITY_COUNT; i++) {
+		if (CAPABILITIES[i] == capability) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+// Returns true if the call should be issued, and records the new value
+static bool state_update(GLStateCategory category, GLuint* current, GLuint value) {
+	if (*current == value) {
+		stats.skipped[category]++;
+		return false;
+	}
+	*current = value;
+	stats.issued[category]++;
+	return true;
+}
+
+void gl_state_invalidate() {
+	current_program = UNKNOWN;
+	current_active_texture = UNKNOWN;
+	for (unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+		for (unsigned int target = 0; target < TEXTURE_TARGET_COUNT; target++) {
+			current_textures[unit][target] = UNKNOWN;
+		}
+	}
+	current_vao = UNKNOWN;
+	current_read_framebuffer = UNKNOWN;
+	current_draw_framebuffer = UNKNOWN;
+	for (unsigned int i = 0; i < CAPABILITY_COUNT; i++) {
+		current_capabilities[i] = UNKNOWN;
+	}
+	current_blend_source = UNKNOWN;
+	current_blend_destination = UNKNOWN;
+	current_depth_func = UNKNOWN;
+	current_depth_mask = UNKNOWN;
+}
+
+void gl_state_reset_stats() {
+	memset(&stats, 0, sizeof(stats));
+}
+
+const GLStateStats& gl_state_get_stats() {
+	return stats;
+}
+
+unsigned int gl_state_total_issued() {
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < STATE_CATEGORY_COUNT; i++) {
+		total += stats.issued[i];
+	}
+	return total;
+}
+
+unsigned int gl_state_total_skipped() {
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < STATE_CATEGORY_COUNT; i++) {
+		total += stats.skipped[i];
+	}
+	return total;
+}
+
+const char* gl_state_category_name(GLStateCategory category) {
+	switch (category) {
+		case STATE_PROGRAM:
+			return "program";
+		case STATE_ACTIVE_TEXTURE:
+			return "active_texture";
+		case STATE_TEXTURE:
+			return "texture";
+		case STATE_VERTEX_ARRAY:
+			return "vertex_array";
+		case STATE_FRAMEBUFFER:
+			return "framebuffer";
+		case STATE_CAPABILITY:
+			return "capability";
+		case STATE_BLEND_FUNC:
+			return "blend_func";
+		case STATE_DEPTH_FUNC:
+			return "depth_func";
+		case STATE_DEPTH_MASK:
+			return "depth_mask";
+		default:
+			return "unknown";
+	}
+}
+
+void gl_state_use_program(GLuint program) {
+	if (state_update(STATE_PROGRAM, &current_program, program)) {
+		glUseProgram(program);
+	}
+}
+
+void gl_state_bind_texture(unsigned int unit, GLenum target, GLuint texture) {
+	int target_index = texture_target_index(target);
+	if (unit >= MAX_TEXTURE_UNITS || target_index == -1) {
+		if (state_update(STATE_ACTIVE_TEXTURE, &current_active_texture, unit)) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+		}
+		stats.issued[STATE_TEXTURE]++;
+		glBindTexture(target, texture);
+		return;
+	}
+
+	// The active unit is only switched when a bind on that unit actually goes through
+	if (current_textures[unit][target_index] == texture) {
+		stats.skipped[STATE_TEXTURE]++;
+		return;
+	}
+	if (state_update(STATE_ACTIVE_TEXTURE, &current_active_texture, unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	state_update(STATE_TEXTURE, &current_textures[unit][target_index], texture);
+	glBindTexture(target, texture);
+}
+
+void gl_state_bind_vertex_array(GLuint vao) {
+	if (state_update(STATE_VERTEX_ARRAY, &current_vao, vao)) {
+		glBindVertexArray(vao);
+	}
+}
+
+void gl_state_bind_framebuffer(GLenum target, GLuint framebuffer) {
+	if (target == GL_FRAMEBUFFER) {
+		if (current_read_framebuffer == framebuffer && current_draw_framebuffer == framebuffer) {
+			stats.skipped[STATE_FRAMEBUFFER]++;
+			return;
+		}
+		current_read_framebuffer = framebuffer;
+		current_draw_framebuffer = framebuffer;
+		stats.issued[STATE_FRAMEBUFFER]++;
+		glBindFramebuffer(target, framebuffer);
+	} else if (state_update(STATE_FRAMEBUFFER, target == GL_READ_FRAMEBUFFER ? &current_read_framebuffer : &current_draw_framebuffer, framebuffer)) {
+		glBindFramebuffer(target, framebuffer);
+	}
+}
+
+void gl_state_enable(GLenum capability) {
+	int index = capability_index(capability);
+	if (index == -1) {
+		stats.issued[STATE_CAPABILITY]++;
+		glEnable(capability);
+	} else if (state_update(STATE_CAPABILITY, &current_capabilities[index], GL_TRUE)) {
+		glEnable(capability);
+	}
+}
+
+void gl_state_disable(GLenum capability) {
+	int index = capability_index(capability);
+	if (index == -1) {
+		stats.issued[STATE_CAPABILITY]++;
+		glDisable(capability);
+	} else if (state_update(STATE_CAPABILITY, &current_capabilities[index], GL_FALSE)) {
+		glDisable(capability);
+	}
+}
+
+void gl_state_blend_func(GLenum source_factor, GLenum destination_factor) {
+	if (current_blend_source == source_factor && current_blend_destination == destination_factor) {
+		stats.skipped[STATE_BLEND_FUNC]++;
+		return;
+	}
+	current_blend_source = source_factor;
+	current_blend_destination = destination_factor;
+	stats.issued[STATE_BLEND_FUNC]++;
+	glBlendFunc(source_factor, destination_factor);
+}
+
+void gl_state_depth_func(GLenum func) {
+	if (state_update(STATE_DEPTH_FUNC, &current_depth_func, func)) {
+		glDepthFunc(func);
+	}
+}
+
+void gl_state_depth_mask(GLboolean mask) {
+	if (state_update(STATE_DEPTH_MASK, &current_depth_mask, mask)) {
+		glDepthMask(mask);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Shadow copy of the GL state the frame loop touches. Calls that would set a value that is already current are
+// skipped. Anything that changes this state with raw GL calls must call gl_state_invalidate() afterwards.
+enum GLStateCategory {
+	STATE_PROGRAM,
+	STATE_ACTIVE_TEXTURE,
+	STATE_TEXTURE,
+	STATE_VERTEX_ARRAY,
+	STATE_FRAMEBUFFER,
+	STATE_CAPABILITY,
+	STATE_BLEND_FUNC,
+	STATE_DEPTH_FUNC,
+	STATE_DEPTH_MASK,
+	STATE_CATEGORY_COUNT
+};
+
+struct GLStateStats {
+	unsigned int issued[STATE_CATEGORY_COUNT];
+	unsigned int skipped[STATE_CATEGORY_COUNT];
+};
+
+void gl_state_invalidate();
+void gl_state_reset_stats();
+const GLStateStats& gl_state_get_stats();
+unsigned int gl_state_total_issued();
+unsigned int gl_state_total_skipped();
+const char* gl_state_category_name(GLStateCategory category);
+
+void gl_state_use_program(GLuint program);
+void gl_state_bind_texture(unsigned int unit, GLenum target, GLuint texture);
+void gl_state_bind_vertex_array(GLuint vao);
+void gl_state_bind_framebuffer(GLenum target, GLuint framebuffer);
+void gl_state_enable(GLenum capability);
+void gl_state_disable(GLenum capability);
+void gl_state_blend_func(GLenum source_factor, GLenum destination_factor);
+void gl_state_depth_func(GLenum func);
+void gl_state_depth_mask(GLboolean mask);
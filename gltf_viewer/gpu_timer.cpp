@@ -0,0 +1,277 @@
+#include "gpu_timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+
+// Zones not timed for this many frames are reported as inactive
+static const unsigned long ZONE_ACTIVE_FRAMES = 60;
+
+struct GpuTimerRecord {
+	int zone;
+	unsigned int begin_query;
+	// -1 until the zone is ended
+	int end_query;
+};
+
+struct GpuTimerFrame {
+	GLuint queries[GPU_TIMER_MAX_ZONES * 2];
+	unsigned int query_count;
+	std::vector<GpuTimerRecord> records;
+	bool pending;
+};
+
+struct GpuTimerZone {
+	std::string name;
+	unsigned int depth;
+	double history[GPU_TIMER_HISTORY_COUNT];
+	unsigned int history_index;
+	unsigned int history_count;
+	unsigned long total_samples;
+	unsigned long last_frame;
+};
+
+static bool supported = false;
+static GpuTimerFrame frames[GPU_TIMER_FRAME_LATENCY];
+static unsigned int current_frame = 0;
+static unsigned long frame_number = 0;
+static unsigned int dropped_frames = 0;
+static std::vector<GpuTimerZone> zones;
+static std::map<std::string, int> zone_lookup;
+static std::vector<unsigned int> open_records;
+
+static int gpu_timer_find_zone(const char* name) {
+	std::map<std::string, int>::iterator it = zone_lookup.find(name);
+	if (it != zone_lookup.end()) {
+		return it->second;
+	}
+
+	GpuTimerZone zone;
+	zone.name = name;
+	zone.depth = (unsigned int)open_records.size();
+	zone.history_index = 0;
+	zone.history_count = 0;
+	zone.total_samples = 0;
+	zone.last_frame = 0;
+	zones.push_back(zone);
+	zone_lookup[zone.name] = (int)zones.size() - 1;
+
+	return (int)zones.size() - 1;
+}
+
+static void gpu_timer_collect(GpuTimerFrame* frame) {
+	for (const GpuTimerRecord& record : frame->records) {
+		if (record.end_query == -1) {
+			continue;
+		}
+		GLuint64 begin_time, end_time;
+		glGetQueryObjectui64v(frame->queries[record.begin_query], GL_QUERY_RESULT, &begin_time);
+		glGetQueryObjectui64v(frame->queries[record.end_query], GL_QUERY_RESULT, &end_time);
+
+		GpuTimerZone& zone = zones[record.zone];
+		zone.history[zone.history_index] = end_time > begin_time ? (double)(end_time - begin_time) / 1000000.0 : 0.0;
+		zone.history_index = (zone.history_index + 1) % GPU_TIMER_HISTORY_COUNT;
+		if (zone.history_count < GPU_TIMER_HISTORY_COUNT) {
+			zone.history_count++;
+		}
+		zone.total_samples++;
+		zone.last_frame = frame_number;
+	}
+
+	frame->query_count = 0;
+	frame->records.clear();
+	frame->pending = false;
+}
+
+// Queries complete in order, so the frame is done once its last query is
+static bool gpu_timer_frame_available(const GpuTimerFrame& frame) {
+	if (frame.query_count == 0) {
+		return true;
+	}
+	GLuint available = 0;
+	glGetQueryObjectuiv(frame.queries[frame.query_count - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+	return available != 0;
+}
+
+bool gpu_timer_init() {
+	supported = glQueryCounter != NULL && glGetQueryObjectui64v != NULL;
+	if (!supported) {
+		printf("Timer queries not supported, GPU timings are disabled\n");
+		return false;
+	}
+
+	for (GpuTimerFrame& frame : frames) {
+		glGenQueries(GPU_TIMER_MAX_ZONES * 2, frame.queries);
+		frame.query_count = 0;
+		frame.records.clear();
+		frame.pending = false;
+	}
+	current_frame = 0;
+	frame_number = 0;
+	dropped_frames = 0;
+
+	return true;
+}
+
+void gpu_timer_quit() {
+	if (!supported) {
+		return;
+	}
+	for (GpuTimerFrame& frame : frames) {
+		glDeleteQueries(GPU_TIMER_MAX_ZONES * 2, frame.queries);
+	}
+	supported = false;
+}
+
+void gpu_timer_begin_frame() {
+	if (!supported) {
+		return;
+	}
+
+	frames[current_frame].pending = true;
+	open_records.clear();
+	current_frame = (current_frame + 1) % GPU_TIMER_FRAME_LATENCY;
+	frame_number++;
+
+	// Collect finished frames oldest first, stopping at the first one the GPU is still working on
+	for (unsigned int i = 0; i < GPU_TIMER_FRAME_LATENCY; i++) {
+		GpuTimerFrame& frame = frames[(current_frame + i) % GPU_TIMER_FRAME_LATENCY];
+		if (!frame.pending) {
+			continue;
+		}
+		if (!gpu_timer_frame_available(frame)) {
+			break;
+		}
+		gpu_timer_collect(&frame);
+	}
+
+	// The slot being reused is the oldest, if it still isn't done its results are thrown away
+	GpuTimerFrame& frame = frames[current_frame];
+	if (frame.pending) {
+		frame.query_count = 0;
+		frame.records.clear();
+		frame.pending = false;
+		dropped_frames++;
+	}
+}
+
+void gpu_timer_begin(const char* name) {
+	if (!supported) {
+		return;
+	}
+
+	GpuTimerFrame& frame = frames[current_frame];
+	int zone = gpu_timer_find_zone(name);
+	if (frame.query_count + 2 > GPU_TIMER_MAX_ZONES * 2) {
+		// Out of queries, the matching end still has to pop something
+		open_records.push_back(0xFFFFFFFF);
+		return;
+	}
+
+	GpuTimerRecord record;
+	record.zone = zone;
+	record.begin_query = frame.query_count++;
+	record.end_query = -1;
+	glQueryCounter(frame.queries[record.begin_query], GL_TIMESTAMP);
+	frame.records.push_back(record);
+	open_records.push_back((unsigned int)frame.records.size() - 1);
+}
+
+void gpu_timer_end() {
+	if (!supported || open_records.empty()) {
+		return;
+	}
+
+	unsigned int record_index = open_records.back();
+	open_records.pop_back();
+	if (record_index == 0xFFFFFFFF) {
+		return;
+	}
+
+	GpuTimerFrame& frame = frames[current_frame];
+	GpuTimerRecord& record = frame.records[record_index];
+	record.end_query = (int)frame.query_count++;
+	glQueryCounter(frame.queries[record.end_query], GL_TIMESTAMP);
+}
+
+void gpu_timer_flush() {
+	if (!supported) {
+		return;
+	}
+	gpu_timer_collect(&frames[current_frame]);
+	open_records.clear();
+}
+
+bool gpu_timer_is_supported() {
+	return supported;
+}
+
+unsigned long gpu_timer_get_samples(const char* name, unsigned long first_sample, std::vector<double>* samples) {
+	std::map<std::string, int>::iterator it = zone_lookup.find(name);
+	if (it == zone_lookup.end()) {
+		return first_sample;
+	}
+
+	const GpuTimerZone& zone = zones[it->second];
+	unsigned long oldest_sample = zone.total_samples - zone.history_count;
+	for (unsigned long sample = std::max(first_sample, oldest_sample); sample < zone.total_samples; sample++) {
+		samples->push_back(zone.history[sample % GPU_TIMER_HISTORY_COUNT]);
+	}
+
+	return zone.total_samples;
+}
+
+unsigned int gpu_timer_dropped_frames() {
+	return dropped_frames;
+}
+
+void gpu_timer_get_stats(std::vector<GpuTimerZoneStats>* stats) {
+	stats->clear();
+	std::vector<double> sorted;
+	for (const GpuTimerZone& zone : zones) {
+		GpuTimerZoneStats zone_stats = {};
+		zone_stats.name = zone.name;
+		zone_stats.depth = zone.depth;
+		zone_stats.samples = zone.history_count;
+		zone_stats.active = zone.history_count != 0 && frame_number - zone.last_frame <= ZONE_ACTIVE_FRAMES;
+
+		if (zone.history_count != 0) {
+			sorted.assign(zone.history, zone.history + zone.history_count);
+			std::sort(sorted.begin(), sorted.end());
+
+			double sum = 0.0;
+			for (double sample : sorted) {
+				sum += sample;
+			}
+			unsigned int last_index = (zone.history_index + GPU_TIMER_HISTORY_COUNT - 1) % GPU_TIMER_HISTORY_COUNT;
+			zone_stats.last = zone.history[last_index];
+			zone_stats.average = sum / (double)sorted.size();
+			// Nearest rank percentiles
+			zone_stats.p50 = sorted[(sorted.size() - 1) * 50 / 100];
+			zone_stats.p95 = sorted[(sorted.size() - 1) * 95 / 100];
+			zone_stats.p99 = sorted[(sorted.size() - 1) * 99 / 100];
+			zone_stats.max = sorted.back();
+		}
+
+		stats->push_back(zone_stats);
+	}
+}
+
+bool gpu_timer_write_csv(const char* path) {
+	FILE* file = fopen(path, "w");
+	if (file == NULL) {
+		printf("Unable to open %s for writing\n", path);
+		return false;
+	}
+
+	std::vector<GpuTimerZoneStats> stats;
+	gpu_timer_get_stats(&stats);
+	fprintf(file, "zone,depth,samples,last_ms,average_ms,p50_ms,p95_ms,p99_ms,max_ms\n");
+	for (const GpuTimerZoneStats& zone : stats) {
+		fprintf(file, "%s,%u,%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", zone.name.c_str(), zone.depth, zone.samples, zone.last, zone.average, zone.p50, zone.p95, zone.p99, zone.max);
+	}
+	fclose(file);
+
+	return true;
+}
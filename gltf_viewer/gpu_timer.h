@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+// Scoped GPU timers. Zones are bracketed by GL_TIMESTAMP queries so they can nest, and each frame's queries come
+// from their own slot in a ring GPU_TIMER_FRAME_LATENCY frames deep. Results are only read once the GPU reports
+// them available, so timing never stalls the pipeline. A frame whose results still aren't in by the time its slot
+// comes around again is dropped.
+const unsigned int GPU_TIMER_FRAME_LATENCY = 4;
+const unsigned int GPU_TIMER_MAX_ZONES = 64;
+const unsigned int GPU_TIMER_HISTORY_COUNT = 240;
+
+// Times are in milliseconds, over the last GPU_TIMER_HISTORY_COUNT samples of the zone
+struct GpuTimerZoneStats {
+	std::string name;
+	unsigned int depth;
+	unsigned int samples;
+	// False if the zone hasn't been timed recently, like the startup bake zones
+	bool active;
+	double last;
+	double average;
+	double p50;
+	double p95;
+	double p99;
+	double max;
+};
+
+bool gpu_timer_init();
+void gpu_timer_quit();
+// Call at the top of the frame. Collects whatever earlier frames have finished and starts recording a new one.
+void gpu_timer_begin_frame();
+void gpu_timer_begin(const char* name);
+void gpu_timer_end();
+// Blocks until the current frame's zones are finished and collects them. Only meant for startup work.
+void gpu_timer_flush();
+bool gpu_timer_is_supported();
+// Appends a zone's samples from sample number first_sample onwards, as far as the history still has them, and
+// returns the zone's total sample count to pass as first_sample next time
+unsigned long gpu_timer_get_samples(const char* name, unsigned long first_sample, std::vector<double>* samples);
+unsigned int gpu_timer_dropped_frames();
+
+// Zones are returned in the order they were first seen
+void gpu_timer_get_stats(std::vector<GpuTimerZoneStats>* stats);
+bool gpu_timer_write_csv(const char* path);
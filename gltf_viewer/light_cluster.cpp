@@ -0,0 +1,494 @@
+#include "light_cluster.h"
+#include "gl_state.h"
+#include "cpu_profiler.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define LIGHT_CLUSTER_HAS_SSE
+	#include <immintrin.h>
+#endif
+
+// Clusters a light overlaps, inclusive on both ends
+struct LightClusterRange {
+	uint8_t min_x;
+	uint8_t max_x;
+	uint8_t min_y;
+	uint8_t max_y;
+	uint8_t min_z;
+	uint8_t max_z;
+	bool visible;
+};
+
+// What bounding needs from the camera
+struct LightClusterView {
+	glm::mat4 view;
+	float scale_x;
+	float scale_y;
+	float near;
+	float far;
+	// Depth each slice after the first starts at
+	float slice_starts[LIGHT_CLUSTER_Z - 1];
+};
+
+enum LightClusterPhase {
+	LIGHT_CLUSTER_PHASE_BOUND,
+	LIGHT_CLUSTER_PHASE_COUNT,
+	LIGHT_CLUSTER_PHASE_FILL
+};
+
+// Bounding splits the lights into ranges. Counting and filling give job i every slice z with z % job_count == i.
+struct LightClusterJob {
+	unsigned int first_light;
+	unsigned int last_light;
+};
+
+static const char* WORKER_NAMES[LIGHT_CLUSTER_MAX_WORKERS] = { "light cluster 0", "light cluster 1", "light cluster 2", "light cluster 3", "light cluster 4", "light cluster 5", "light cluster 6", "light cluster 7" };
+static const GLenum TEXTURE_FORMATS[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+
+static LightClusterImplementation implementation = LIGHT_CLUSTER_SCALAR;
+static unsigned int worker_count = 0;
+static SDL_Thread* workers[LIGHT_CLUSTER_MAX_WORKERS];
+static SDL_sem* worker_start[LIGHT_CLUSTER_MAX_WORKERS];
+static SDL_sem* workers_done = NULL;
+static std::atomic<bool> running(false);
+
+// State of the build in progress, shared with the workers
+static LightClusterPhase phase;
+static unsigned int job_count;
+static LightClusterJob jobs[LIGHT_CLUSTER_MAX_WORKERS + 1];
+static LightClusterView build_view;
+static const std::vector<PointLight>* build_lights;
+static LightClusters* build_clusters;
+static std::vector<LightClusterRange> ranges;
+
+static GLuint buffers[3];
+static GLuint textures[3];
+
+static double light_cluster_elapsed_ms(Uint64 start) {
+	return (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// Number of slice starts at or before depth
+static unsigned int light_cluster_slice(const LightClusterView& view, float depth) {
+	return (unsigned int)(std::upper_bound(view.slice_starts, view.slice_starts + LIGHT_CLUSTER_Z - 1, depth) - view.slice_starts);
+}
+
+static unsigned int light_cluster_tile(float ndc, unsigned int tiles) {
+	float tile = (std::min(std::max(ndc, -1.0f), 1.0f) * 0.5f + 0.5f) * (float)tiles;
+	return (unsigned int)std::min(std::max(tile, 0.0f), (float)(tiles - 1));
+}
+
+// Bounds of a sphere's projection along one screen axis, from the lines through the eye that touch it. offset is
+// the center's view space x or y. Only valid with the whole sphere in front of the eye, depth > radius.
+static void light_cluster_project(float offset, float depth, float radius, float scale, float* min_ndc, float* max_ndc) {
+	float tangent = std::sqrt(offset * offset + depth * depth - radius * radius);
+	*min_ndc = (offset * tangent - depth * radius) / (offset * radius + depth * tangent) * scale;
+	*max_ndc = (offset * tangent + depth * radius) / (depth * tangent - offset * radius) * scale;
+}
+
+// The SSE version below must match this exactly, operation for operation, so both give the same clusters
+static LightClusterRange light_cluster_bound_scalar(const LightClusterView& view, const PointLight& light) {
+	LightClusterRange range = {};
+	const glm::mat4& m = view.view;
+	glm::vec3 p = light.position;
+	float x = (m[0][0] * p.x + m[1][0] * p.y) + (m[2][0] * p.z + m[3][0]);
+	float y = (m[0][1] * p.x + m[1][1] * p.y) + (m[2][1] * p.z + m[3][1]);
+	float depth = 0.0f - ((m[0][2] * p.x + m[1][2] * p.y) + (m[2][2] * p.z + m[3][2]));
+	float radius = light.radius;
+	if (depth + radius <= view.near || depth - radius >= view.far) {
+		return range;
+	}
+
+	// With the eye inside the sphere's depth range it can cover the whole screen
+	float min_x = -1.0f, max_x = 1.0f, min_y = -1.0f, max_y = 1.0f;
+	if (depth > radius) {
+		light_cluster_project(x, depth, radius, view.scale_x, &min_x, &max_x);
+		light_cluster_project(y, depth, radius, view.scale_y, &min_y, &max_y);
+	}
+	if (min_x >= 1.0f || max_x <= -1.0f || min_y >= 1.0f || max_y <= -1.0f) {
+		return range;
+	}
+
+	range.visible = true;
+	range.min_x = (uint8_t)light_cluster_tile(min_x, LIGHT_CLUSTER_X);
+	range.max_x = (uint8_t)light_cluster_tile(max_x, LIGHT_CLUSTER_X);
+	range.min_y = (uint8_t)light_cluster_tile(min_y, LIGHT_CLUSTER_Y);
+	range.max_y = (uint8_t)light_cluster_tile(max_y, LIGHT_CLUSTER_Y);
+	range.min_z = (uint8_t)light_cluster_slice(view, std::max(depth - radius, view.near));
+	range.max_z = (uint8_t)light_cluster_slice(view, std::min(depth + radius, view.far));
+	return range;
+}
+
+#ifdef LIGHT_CLUSTER_HAS_SSE
+static __m128 light_cluster_select(__m128 mask, __m128 a, __m128 b) {
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static __m128i light_cluster_tiles_sse(__m128 ndc, unsigned int tiles) {
+	__m128 clamped = _mm_min_ps(_mm_max_ps(ndc, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+	__m128 tile = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f)), _mm_set1_ps((float)tiles));
+	return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(tile, _mm_setzero_ps()), _mm_set1_ps((float)(tiles - 1))));
+}
+
+static __m128i light_cluster_slices_sse(const LightClusterView& view, __m128 depth) {
+	__m128i slice = _mm_setzero_si128();
+	for (unsigned int i = 0; i < LIGHT_CLUSTER_Z - 1; i++) {
+		// Compare masks are -1 where true
+		slice = _mm_sub_epi32(slice, _mm_castps_si128(_mm_cmpge_ps(depth, _mm_set1_ps(view.slice_starts[i]))));
+	}
+	return slice;
+}
+
+static void light_cluster_project_sse(__m128 offset, __m128 depth, __m128 radius, float scale, __m128* min_ndc, __m128* max_ndc) {
+	// Clamped so lanes that won't use the result don't produce NaNs
+	__m128 tangent = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(offset, offset), _mm_mul_ps(depth, depth)), _mm_mul_ps(radius, radius)), _mm_setzero_ps()));
+	__m128 offset_tangent = _mm_mul_ps(offset, tangent);
+	__m128 depth_radius = _mm_mul_ps(depth, radius);
+	__m128 offset_radius = _mm_mul_ps(offset, radius);
+	__m128 depth_tangent = _mm_mul_ps(depth, tangent);
+	*min_ndc = _mm_mul_ps(_mm_div_ps(_mm_sub_ps(offset_tangent, depth_radius), _mm_add_ps(offset_radius, depth_tangent)), _mm_set1_ps(scale));
+	*max_ndc = _mm_mul_ps(_mm_div_ps(_mm_add_ps(offset_tangent, depth_radius), _mm_sub_ps(depth_tangent, offset_radius)), _mm_set1_ps(scale));
+}
+
+// Bounds 4 lights at once
+static void light_cluster_bound_sse(const LightClusterView& view, const PointLight* lights, LightClusterRange* out) {
+	const glm::mat4& m = view.view;
+	__m128 px = _mm_setr_ps(lights[0].position.x, lights[1].position.x, lights[2].position.x, lights[3].position.x);
+	__m128 py = _mm_setr_ps(lights[0].position.y, lights[1].position.y, lights[2].position.y, lights[3].position.y);
+	__m128 pz = _mm_setr_ps(lights[0].position.z, lights[1].position.z, lights[2].position.z, lights[3].position.z);
+	__m128 radius = _mm_setr_ps(lights[0].radius, lights[1].radius, lights[2].radius, lights[3].radius);
+
+	__m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][0]), px), _mm_mul_ps(_mm_set1_ps(m[1][0]), py)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][0]), pz), _mm_set1_ps(m[3][0])));
+	__m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][1]), px), _mm_mul_ps(_mm_set1_ps(m[1][1]), py)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][1]), pz), _mm_set1_ps(m[3][1])));
+	__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0][2]), px), _mm_mul_ps(_mm_set1_ps(m[1][2]), py)), _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[2][2]), pz), _mm_set1_ps(m[3][2])));
+	__m128 depth = _mm_sub_ps(_mm_setzero_ps(), z);
+	__m128 near = _mm_set1_ps(view.near);
+	__m128 far = _mm_set1_ps(view.far);
+	__m128 visible = _mm_and_ps(_mm_cmpgt_ps(_mm_add_ps(depth, radius), near), _mm_cmplt_ps(_mm_sub_ps(depth, radius), far));
+
+	__m128 min_x, max_x, min_y, max_y;
+	light_cluster_project_sse(x, depth, radius, view.scale_x, &min_x, &max_x);
+	light_cluster_project_sse(y, depth, radius, view.scale_y, &min_y, &max_y);
+	__m128 in_front = _mm_cmpgt_ps(depth, radius);
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 minus_one = _mm_set1_ps(-1.0f);
+	min_x = light_cluster_select(in_front, min_x, minus_one);
+	max_x = light_cluster_select(in_front, max_x, one);
+	min_y = light_cluster_select(in_front, min_y, minus_one);
+	max_y = light_cluster_select(in_front, max_y, one);
+	visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmplt_ps(min_x, one), _mm_cmpgt_ps(max_x, minus_one)));
+	visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmplt_ps(min_y, one), _mm_cmpgt_ps(max_y, minus_one)));
+
+	alignas(16) int32_t tiles[6][4];
+	_mm_store_si128((__m128i*)tiles[0], light_cluster_tiles_sse(min_x, LIGHT_CLUSTER_X));
+	_mm_store_si128((__m128i*)tiles[1], light_cluster_tiles_sse(max_x, LIGHT_CLUSTER_X));
+	_mm_store_si128((__m128i*)tiles[2], light_cluster_tiles_sse(min_y, LIGHT_CLUSTER_Y));
+	_mm_store_si128((__m128i*)tiles[3], light_cluster_tiles_sse(max_y, LIGHT_CLUSTER_Y));
+	_mm_store_si128((__m128i*)tiles[4], light_cluster_slices_sse(view, _mm_max_ps(_mm_sub_ps(depth, radius), near)));
+	_mm_store_si128((__m128i*)tiles[5], light_cluster_slices_sse(view, _mm_min_ps(_mm_add_ps(depth, radius), far)));
+	int visible_mask = _mm_movemask_ps(visible);
+	for (int lane = 0; lane < 4; lane++) {
+		LightClusterRange range = {};
+		if (visible_mask & (1 << lane)) {
+			range.visible = true;
+			range.min_x = (uint8_t)tiles[0][lane];
+			range.max_x = (uint8_t)tiles[1][lane];
+			range.min_y = (uint8_t)tiles[2][lane];
+			range.max_y = (uint8_t)tiles[3][lane];
+			range.min_z = (uint8_t)tiles[4][lane];
+			range.max_z = (uint8_t)tiles[5][lane];
+		}
+		out[lane] = range;
+	}
+}
+#endif
+
+static void light_cluster_bound_lights(unsigned int first, unsigned int last) {
+	const std::vector<PointLight>& lights = *build_lights;
+	glm::vec4* light_data = build_clusters->light_data.data();
+	for (unsigned int i = first; i < last; i++) {
+		light_data[i * 2] = glm::vec4(lights[i].position, lights[i].radius);
+		light_data[i * 2 + 1] = glm::vec4(lights[i].color, 0.0f);
+	}
+
+	unsigned int light = first;
+#ifdef LIGHT_CLUSTER_HAS_SSE
+	if (implementation == LIGHT_CLUSTER_SSE) {
+		for (; light + 4 <= last; light += 4) {
+			light_cluster_bound_sse(build_view, &lights[light], &ranges[light]);
+		}
+	}
+#endif
+	for (; light < last; light++) {
+		ranges[light] = light_cluster_bound_scalar(build_view, lights[light]);
+	}
+}
+
+// Counts or fills the lists of the slices belonging to job. Filling uses the counts as cursors, which end up back
+// at the counts.
+static void light_cluster_assign(unsigned int job, bool fill) {
+	uint32_t* grid = build_clusters->grid.data();
+	uint32_t* indices = build_clusters->indices.data();
+	unsigned int light_count = (unsigned int)ranges.size();
+	for (unsigned int light = 0; light < light_count; light++) {
+		const LightClusterRange& range = ranges[light];
+		if (!range.visible) {
+			continue;
+		}
+		// First slice in the range that belongs to this job
+		unsigned int first_z = range.min_z + (job + job_count - range.min_z % job_count) % job_count;
+		for (unsigned int z = first_z; z <= range.max_z; z += job_count) {
+			for (unsigned int y = range.min_y; y <= range.max_y; y++) {
+				unsigned int row = (z * LIGHT_CLUSTER_Y + y) * LIGHT_CLUSTER_X;
+				for (unsigned int x = range.min_x; x <= range.max_x; x++) {
+					uint32_t* cluster = &grid[(row + x) * 2];
+					if (fill) {
+						indices[cluster[0] + cluster[1]] = light;
+					}
+					cluster[1]++;
+				}
+			}
+		}
+	}
+}
+
+static void light_cluster_run_job(unsigned int job) {
+	switch (phase) {
+		case LIGHT_CLUSTER_PHASE_BOUND:
+			light_cluster_bound_lights(jobs[job].first_light, jobs[job].last_light);
+			break;
+		case LIGHT_CLUSTER_PHASE_COUNT:
+			light_cluster_assign(job, false);
+			break;
+		case LIGHT_CLUSTER_PHASE_FILL:
+			light_cluster_assign(job, true);
+			break;
+	}
+}
+
+static void light_cluster_dispatch(LightClusterPhase new_phase) {
+	phase = new_phase;
+	for (unsigned int i = 1; i < job_count; i++) {
+		SDL_SemPost(worker_start[i - 1]);
+	}
+	// Job 0 belongs to the calling thread
+	light_cluster_run_job(0);
+	for (unsigned int i = 1; i < job_count; i++) {
+		SDL_SemWait(workers_done);
+	}
+}
+
+static int light_cluster_worker_thread(void* data) {
+	unsigned int worker = (unsigned int)(size_t)data;
+	PROFILE_THREAD(WORKER_NAMES[worker]);
+	while (true) {
+		SDL_SemWait(worker_start[worker]);
+		if (!running.load()) {
+			break;
+		}
+		light_cluster_run_job(worker + 1);
+		SDL_SemPost(workers_done);
+	}
+
+	return 0;
+}
+
+bool light_cluster_init(unsigned int requested_workers) {
+	implementation = light_cluster_implementation_supported(LIGHT_CLUSTER_SSE) ? LIGHT_CLUSTER_SSE : LIGHT_CLUSTER_SCALAR;
+
+	worker_count = 0;
+	requested_workers = std::min(requested_workers, LIGHT_CLUSTER_MAX_WORKERS);
+	if (requested_workers == 0) {
+		return true;
+	}
+
+	workers_done = SDL_CreateSemaphore(0);
+	if (workers_done == NULL) {
+		printf("Unable to create light cluster semaphore! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+	running.store(true);
+	for (unsigned int i = 0; i < requested_workers; i++) {
+		worker_start[i] = SDL_CreateSemaphore(0);
+		if (worker_start[i] == NULL) {
+			printf("Unable to create light cluster semaphore! SDL Error: %s\n", SDL_GetError());
+			light_cluster_quit();
+			return false;
+		}
+		workers[i] = SDL_CreateThread(light_cluster_worker_thread, WORKER_NAMES[i], (void*)(size_t)i);
+		if (workers[i] == NULL) {
+			printf("Unable to create light cluster worker thread! SDL Error: %s\n", SDL_GetError());
+			SDL_DestroySemaphore(worker_start[i]);
+			light_cluster_quit();
+			return false;
+		}
+		worker_count++;
+	}
+
+	return true;
+}
+
+void light_cluster_quit() {
+	running.store(false);
+	for (unsigned int i = 0; i < worker_count; i++) {
+		SDL_SemPost(worker_start[i]);
+		SDL_WaitThread(workers[i], NULL);
+		SDL_DestroySemaphore(worker_start[i]);
+	}
+	worker_count = 0;
+	if (workers_done != NULL) {
+		SDL_DestroySemaphore(workers_done);
+		workers_done = NULL;
+	}
+}
+
+bool light_cluster_implementation_supported(LightClusterImplementation implementation) {
+	switch (implementation) {
+		case LIGHT_CLUSTER_SCALAR:
+			return true;
+#ifdef LIGHT_CLUSTER_HAS_SSE
+		case LIGHT_CLUSTER_SSE:
+			return true;
+#endif
+		default:
+			return false;
+	}
+}
+
+const char* light_cluster_implementation_name(LightClusterImplementation implementation) {
+	switch (implementation) {
+		case LIGHT_CLUSTER_SCALAR:
+			return "scalar";
+		case LIGHT_CLUSTER_SSE:
+			return "SSE";
+		default:
+			return "unknown";
+	}
+}
+
+void light_cluster_set_implementation(LightClusterImplementation new_implementation) {
+	if (!light_cluster_implementation_supported(new_implementation)) {
+		printf("%s light clustering is not supported on this CPU\n", light_cluster_implementation_name(new_implementation));
+		return;
+	}
+	implementation = new_implementation;
+}
+
+LightClusterImplementation light_cluster_get_implementation() {
+	return implementation;
+}
+
+void light_cluster_build(LightClusters* clusters, const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection, float near, float far) {
+	PROFILE_ZONE("light_cluster_build");
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	build_view.view = view;
+	build_view.scale_x = projection[0][0];
+	build_view.scale_y = projection[1][1];
+	build_view.near = near;
+	build_view.far = far;
+	for (unsigned int i = 0; i < LIGHT_CLUSTER_Z - 1; i++) {
+		build_view.slice_starts[i] = near * std::pow(far / near, (float)(i + 1) / (float)LIGHT_CLUSTER_Z);
+	}
+	build_lights = &lights;
+	build_clusters = clusters;
+
+	unsigned int light_count = (unsigned int)lights.size();
+	clusters->light_data.resize(light_count * 2);
+	clusters->grid.assign(LIGHT_CLUSTER_COUNT * 2, 0);
+	ranges.resize(light_count);
+
+	job_count = 1;
+	if (worker_count != 0 && light_count >= LIGHT_CLUSTER_PARALLEL_MIN_LIGHTS) {
+		job_count = worker_count + 1;
+	}
+	// Light ranges are kept to multiples of 4 for the SSE batches
+	for (unsigned int i = 0; i < job_count; i++) {
+		jobs[i].first_light = std::min(light_count * i / job_count / 4 * 4, light_count);
+		jobs[i].last_light = i + 1 == job_count ? light_count : std::min(light_count * (i + 1) / job_count / 4 * 4, light_count);
+	}
+
+	light_cluster_dispatch(LIGHT_CLUSTER_PHASE_BOUND);
+	light_cluster_dispatch(LIGHT_CLUSTER_PHASE_COUNT);
+
+	// Turn the counts into offsets, resetting them to use as cursors while filling
+	uint32_t* grid = clusters->grid.data();
+	unsigned int references = 0;
+	unsigned int max_cluster_lights = 0;
+	for (unsigned int cluster = 0; cluster < LIGHT_CLUSTER_COUNT; cluster++) {
+		unsigned int count = grid[cluster * 2 + 1];
+		grid[cluster * 2] = references;
+		grid[cluster * 2 + 1] = 0;
+		references += count;
+		max_cluster_lights = std::max(max_cluster_lights, count);
+	}
+	clusters->indices.resize(references);
+	light_cluster_dispatch(LIGHT_CLUSTER_PHASE_FILL);
+
+	clusters->stats.lights = light_count;
+	clusters->stats.visible_lights = 0;
+	for (const LightClusterRange& range : ranges) {
+		clusters->stats.visible_lights += range.visible ? 1 : 0;
+	}
+	clusters->stats.references = references;
+	clusters->stats.max_cluster_lights = max_cluster_lights;
+	clusters->stats.build_ms = light_cluster_elapsed_ms(start);
+}
+
+unsigned int light_cluster_index(glm::vec2 pixel, float depth, unsigned int width, unsigned int height, float near, float far) {
+	float slice = std::log(depth / near) * (float)LIGHT_CLUSTER_Z / std::log(far / near);
+	unsigned int z = (unsigned int)std::min(std::max(slice, 0.0f), (float)(LIGHT_CLUSTER_Z - 1));
+	unsigned int x = std::min((unsigned int)(pixel.x / ((float)width / (float)LIGHT_CLUSTER_X)), LIGHT_CLUSTER_X - 1);
+	unsigned int y = std::min((unsigned int)(pixel.y / ((float)height / (float)LIGHT_CLUSTER_Y)), LIGHT_CLUSTER_Y - 1);
+	return (z * LIGHT_CLUSTER_Y + y) * LIGHT_CLUSTER_X + x;
+}
+
+// Expects the program to be in use
+void light_cluster_set_uniforms(GLuint program, unsigned int width, unsigned int height, float near, float far) {
+	glUniform1i(glGetUniformLocation(program, "cluster_light_data"), LIGHT_CLUSTER_TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "cluster_grid"), LIGHT_CLUSTER_TEXTURE_UNIT + 1);
+	glUniform1i(glGetUniformLocation(program, "cluster_light_indices"), LIGHT_CLUSTER_TEXTURE_UNIT + 2);
+	glUniform3ui(glGetUniformLocation(program, "cluster_dimensions"), LIGHT_CLUSTER_X, LIGHT_CLUSTER_Y, LIGHT_CLUSTER_Z);
+	glUniform2f(glGetUniformLocation(program, "cluster_tile_size"), (float)width / (float)LIGHT_CLUSTER_X, (float)height / (float)LIGHT_CLUSTER_Y);
+	glUniform2f(glGetUniformLocation(program, "cluster_depth_range"), near, far);
+	glUniform1f(glGetUniformLocation(program, "cluster_slice_scale"), (float)LIGHT_CLUSTER_Z / std::log(far / near));
+}
+
+void light_cluster_upload(const LightClusters& clusters) {
+	if (buffers[0] == 0) {
+		glGenBuffers(3, buffers);
+		glGenTextures(3, textures);
+		for (unsigned int i = 0; i < 3; i++) {
+			glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+			glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+			gl_state_bind_texture(LIGHT_CLUSTER_TEXTURE_UNIT + i, GL_TEXTURE_BUFFER, textures[i]);
+			glTexBuffer(GL_TEXTURE_BUFFER, TEXTURE_FORMATS[i], buffers[i]);
+		}
+	}
+
+	const void* data[3] = { clusters.light_data.data(), clusters.grid.data(), clusters.indices.data() };
+	size_t sizes[3] = { clusters.light_data.size() * sizeof(glm::vec4), clusters.grid.size() * sizeof(uint32_t), clusters.indices.size() * sizeof(uint32_t) };
+	for (unsigned int i = 0; i < 3; i++) {
+		// Fresh storage every frame, so the upload doesn't wait on draws still reading the last one
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, std::max(sizes[i], (size_t)16), NULL, GL_STREAM_DRAW);
+		if (sizes[i] != 0) {
+			glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], data[i]);
+		}
+		gl_state_bind_texture(LIGHT_CLUSTER_TEXTURE_UNIT + i, GL_TEXTURE_BUFFER, textures[i]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void light_cluster_destroy_buffers() {
+	if (buffers[0] != 0) {
+		glDeleteTextures(3, textures);
+		glDeleteBuffers(3, buffers);
+		buffers[0] = 0;
+	}
+}
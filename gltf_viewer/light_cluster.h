@@ -0,0 +1,71 @@
+#pragma once
+
+#include "scene.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Clustered forward lighting (Olsson, Billeter and Assarsson). The view frustum is split into a grid of clusters,
+// screen space tiles in x and y and exponentially spaced slices in depth, and every frame each light is assigned to
+// the clusters its sphere of influence overlaps. Fragments find their cluster from gl_FragCoord and only shade the
+// lights listed for it, so the cost per pixel follows the lights nearby rather than the lights in the scene.
+//
+// Assignment runs off the GL thread. Lights are bounded 4 at a time with SSE: their view space depth range picks
+// the slices, and the tangent planes of the sphere give the tiles. Then the slices are dealt out to the worker
+// threads, which count and fill the lists of their own clusters, so lists need no atomics and come out in light
+// order. The results are uploaded as buffer textures, which the GL 4.1 shaders can read.
+const unsigned int LIGHT_CLUSTER_X = 16;
+const unsigned int LIGHT_CLUSTER_Y = 9;
+const unsigned int LIGHT_CLUSTER_Z = 24;
+const unsigned int LIGHT_CLUSTER_COUNT = LIGHT_CLUSTER_X * LIGHT_CLUSTER_Y * LIGHT_CLUSTER_Z;
+const unsigned int LIGHT_CLUSTER_MAX_WORKERS = 8;
+// Below this many lights handing the work to the workers costs more than it saves
+const unsigned int LIGHT_CLUSTER_PARALLEL_MIN_LIGHTS = 1024;
+// Light data, cluster grid and light index buffer textures are bound to this unit and the two after it
+const unsigned int LIGHT_CLUSTER_TEXTURE_UNIT = 8;
+
+enum LightClusterImplementation {
+	LIGHT_CLUSTER_SCALAR,
+	LIGHT_CLUSTER_SSE,
+	LIGHT_CLUSTER_IMPLEMENTATION_COUNT
+};
+
+struct LightClusterStats {
+	unsigned int lights;
+	unsigned int visible_lights;
+	// Light indices summed over every cluster, and the most any one cluster has
+	unsigned int references;
+	unsigned int max_cluster_lights;
+	double build_ms;
+};
+
+// One frame's assignment. Built without GL, so it can be part of the render packet.
+struct LightClusters {
+	// Two texels per light, the view independent position and radius, then the color
+	std::vector<glm::vec4> light_data;
+	// Offset into indices and light count of each cluster, x fastest then y then slice
+	std::vector<uint32_t> grid;
+	std::vector<uint32_t> indices;
+	LightClusterStats stats;
+};
+
+// worker_count threads are started on top of the calling thread, which always takes a share of the work
+bool light_cluster_init(unsigned int worker_count);
+void light_cluster_quit();
+bool light_cluster_implementation_supported(LightClusterImplementation implementation);
+const char* light_cluster_implementation_name(LightClusterImplementation implementation);
+// Defaults to SSE where supported
+void light_cluster_set_implementation(LightClusterImplementation implementation);
+LightClusterImplementation light_cluster_get_implementation();
+
+// Assumes a symmetric perspective projection from near to far. Not reentrant, only one thread may build at a time.
+void light_cluster_build(LightClusters* clusters, const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection, float near, float far);
+// Cluster the fragment at this pixel and view space depth falls in, the same way the shader finds it
+unsigned int light_cluster_index(glm::vec2 pixel, float depth, unsigned int width, unsigned int height, float near, float far);
+
+// GL side. Sets the grid constants and sampler units on a program that includes pbr_common.glsl.
+void light_cluster_set_uniforms(GLuint program, unsigned int width, unsigned int height, float near, float far);
+// Uploads the assignment and binds the buffer textures
+void light_cluster_upload(const LightClusters& clusters);
+void light_cluster_destroy_buffers();
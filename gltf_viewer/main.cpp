@@ -9,45 +9,198 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <stb_image.h>
+#include "mesh.h"
+#include "mesh_simplify.h"
+#include "mesh_optimize.h"
+#include "scene.h"
+#include "render_indirect.h"
+#include "render_queue.h"
+#include "gl_state.h"
+#include "frame_pacer.h"
+#include "simulation.h"
+#include "pipeline.h"
+#include "frustum.h"
+#include "render_graph.h"
+#include "gpu_timer.h"
+#include "cpu_profiler.h"
+#include "platform.h"
+#include "camera_path.h"
+#include "benchmark.h"
+#include "cull.h"
+#include "bvh.h"
+#include "occlusion.h"
+#include "depth_prepass.h"
+#include "light_cluster.h"
+#include "visibility.h"
+#include "shadow.h"
+#include "antialiasing.h"
+#include "dynamic_resolution.h"
+#include "upscale.h"
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <functional>
 #include <string>
 #include <map>
 #include <vector>
 
-SDL_Window* window;
-SDL_GLContext context;
-
-// Window size
+// Window size, the default unless --window is given. The scene renders at the window's size times the render scale.
 const unsigned int SCREEN_WIDTH = 1280;
 const unsigned int SCREEN_HEIGHT = 720;
 unsigned int WINDOW_WIDTH = SCREEN_WIDTH;
 unsigned int WINDOW_HEIGHT = SCREEN_HEIGHT;
 
 // Timekeeping
-const unsigned long FRAME_TIME = (unsigned long)(1000.0 / 60.0);
-unsigned long last_time;
-unsigned long last_second;
-unsigned int frames = 0;
-unsigned int fps = 0;
+const double TARGET_FPS = 60.0;
+FramePacer frame_pacer;
+Simulation simulation;
 float delta = 0.0f;
+
+// Update and render stages, see pipeline.h
+Pipeline pipeline;
+bool pipeline_threaded = true;
+// Frames written to cpu_trace.json on exit, 0 to skip
+unsigned int trace_frames_on_exit = 0;
 bool running = false;
 
+// Headless and scripted runs
+const unsigned int HEADLESS_DEFAULT_FRAMES = 600;
+bool headless = false;
+// Set for headless and benchmark runs, which step one tick a frame and follow a camera path
+bool scripted = false;
+// Quits after this many frames, 0 to run until closed
+unsigned int frame_limit = 0;
+// Each frame is written here as a PPM if set
+const char* frame_output_dir = NULL;
+const char* camera_path_file = NULL;
+CameraPath camera_path;
+bool camera_path_active = false;
+
+// Benchmark runs, see benchmark.h
+const unsigned int BENCHMARK_DEFAULT_WARMUP_FRAMES = 60;
+bool benchmarking = false;
+unsigned int benchmark_warmup_frames = BENCHMARK_DEFAULT_WARMUP_FRAMES;
+const char* benchmark_output_path = "benchmark.json";
+Benchmark benchmark;
+// Runs the culling benchmark instead of the viewer
+bool cull_benchmarking = false;
+const char* cull_benchmark_output_path = "cull_benchmark.json";
+bool bvh_benchmarking = false;
+const char* bvh_benchmark_output_path = "bvh_benchmark.json";
+bool occlusion_benchmarking = false;
+const char* occlusion_benchmark_output_path = "occlusion_benchmark.json";
+bool vertex_benchmarking = false;
+const char* vertex_benchmark_output_path = "vertex_benchmark.json";
+bool light_cluster_benchmarking = false;
+const char* light_cluster_benchmark_output_path = "light_cluster_benchmark.json";
+// Compares the upscalers on a frame rendered at the window's size once the warm-up frames are done, then quits
+bool upscale_benchmarking = false;
+const char* upscale_benchmark_output_path = "upscale_benchmark.json";
+
 // Rendering resources
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 100.0f;
+glm::mat4 projection;
 GLuint quad_vao;
 
-GLuint sphere_vao;
-unsigned int sphere_vao_index_count;
+MeshBuffer mesh_buffer;
+VertexFormat vertex_format = vertex_format_compact();
+// Reorders meshes for the vertex cache and overdraw at load, see mesh_optimize.h
+bool optimize_meshes = true;
+// Rings and segments of the sphere mesh. Raising it makes small triangles.
+unsigned int sphere_segments = 64;
+unsigned int sphere_primitive;
+Scene scene;
+// World space bounds of scene.objects in the same order, and the update stage's visible list
+CullBounds scene_bounds;
+std::vector<glm::vec3> scene_box_min;
+std::vector<glm::vec3> scene_box_max;
+std::vector<unsigned int> scene_visible;
+const char* cull_implementation_arg = NULL;
+// The same bounds in a BVH, used for culling instead of the flat test when enabled
+Bvh scene_bvh;
+bool use_bvh = false;
+// Software occlusion culling after the frustum test, off unless occluders are picked
+OcclusionSettings occlusion_settings = { OCCLUDERS_NONE, 0.1f, 16 };
+// Lower detail sphere whose vertices are a subset of the drawn one's, so it stays inside it
+OcclusionMesh sphere_occluder;
+std::vector<std::pair<float, unsigned int>> occluder_candidates;
+// Objects are drawn at the coarsest detail level whose error stays under lod_max_pixels on screen. A fade band
+// above 0 dithers between levels while their errors are within that fraction of the limit.
+bool use_lod = false;
+float lod_max_pixels = 1.0f;
+float lod_fade_band = 0.0f;
+int scene_grid_size = 7;
+unsigned int scene_light_count = 0;
+// Small dynamic lights scattered through the grid on top of those, see light_cluster.h
+unsigned int scene_cluster_light_count = 0;
+// Face size of the environment cubemap the HDR is baked into
+unsigned int environment_size = 512;
 GLuint sphere_albedo;
 GLuint sphere_metallic;
 GLuint sphere_roughness;
 GLuint sphere_normal;
 GLuint sphere_ao;
 
-GLuint screen_framebuffer;
-GLuint screen_framebuffer_texture;
-GLuint screen_intermediate_framebuffer;
-GLuint screen_intermediate_framebuffer_texture;
+// A sun with cached cascaded shadow maps, see shadow.h. It turns speed radians a second, which keeps the cascades
+// re-rendering and shows what the update budget does.
+bool use_shadows = false;
+ShadowSettings shadow_settings = { SHADOW_MAX_CASCADES, 40.0f, 2 };
+float sun_speed = 0.0f;
+
+// Depth-only pass before the opaque pass, see depth_prepass.h
+DepthPrepassMode depth_prepass_mode = DEPTH_PREPASS_OFF;
+DepthPrepass depth_prepass;
+
+// Render targets are declared per frame through the render graph
+RenderGraph render_graph;
+RenderGraphResource scene_color_target;
+RenderGraphResource scene_depth_target;
+
+// See antialiasing.h. Switched on the GL thread and read by the update thread, which puts it in the packet.
+std::atomic<AntiAliasingMode> antialiasing_mode(ANTIALIASING_MSAA_4);
+// Multisample textures support at most this many samples, queried at startup
+unsigned int max_samples = 8;
+// What the present pass shows, the scene color or the anti-aliased copy of it
+RenderGraphResource present_source_target;
+bool taa_history_valid = false;
+
+// See dynamic_resolution.h. The controller runs on the GL thread and the update thread reads the scale it picks, so
+// each packet carries the size its projection was planned for.
+DynamicResolutionSettings dynamic_resolution_settings = { false, 16.0f, 0.5f, 1.0f };
+float initial_render_scale = 1.0f;
+DynamicResolution dynamic_resolution;
+std::atomic<float> render_scale(1.0f);
+
+// See upscale.h. Presets only pick the starting render scale.
+Upscaler upscaler = UPSCALER_EASU;
+UpscalePrograms upscale_programs;
+// Set while building the graph when the present source is smaller than the window and EASU is on. The present pass
+// then sharpens the upscaled copy instead of sampling the source.
+bool frame_upscaling = false;
+RenderGraphResource upscaled_target;
+
+// How the opaque surfaces are shaded. Deferred shading writes them into a G-buffer, see shader/gbuffer.glsl, then
+// lights it in one fullscreen pass. The visibility buffer only stores triangle IDs and fetches everything else when
+// shading, see visibility.h. Either way light markers and the sky are still drawn forward afterwards, single sample.
+enum ShadingPath {
+	SHADING_FORWARD,
+	SHADING_DEFERRED,
+	SHADING_VISIBILITY,
+	SHADING_PATH_COUNT
+};
+const char* SHADING_PATH_NAMES[SHADING_PATH_COUNT] = { "forward", "deferred", "visibility" };
+ShadingPath shading_path = SHADING_FORWARD;
+// Color targets plus 4 bytes of depth, each written once by the G-buffer pass and read once when lighting it
+const unsigned int GBUFFER_BYTES_PER_PIXEL = 4 + 8 + 4;
+RenderGraphResource gbuffer_albedo_target;
+RenderGraphResource gbuffer_normal_target;
+RenderGraphResource gbuffer_depth_target;
+RenderGraphResource visibility_target;
+RenderGraphResource visibility_depth_target;
 
 GLuint cube_vao;
 GLuint skybox_texture;
@@ -57,15 +210,48 @@ GLuint brdf_lookup_texture;
 
 // Shaders
 GLuint screen_shader;
+GLuint fxaa_shader;
+GLuint taa_shader;
+GLuint easu_shader;
+GLuint rcas_shader;
 GLuint text_shader;
 GLuint pbr_shader;
+GLuint pbr_indirect_shader;
 GLuint light_shader;
+GLuint depth_shader;
+GLuint depth_indirect_shader;
+GLuint light_depth_shader;
+GLuint gbuffer_shader;
+GLuint gbuffer_indirect_shader;
+GLuint deferred_shader;
+GLuint visibility_shader;
+GLuint visibility_resolve_shader;
 GLuint cubemap_shader;
 GLuint irradiance_map_shader;
 GLuint prefilter_shader;
 GLuint skybox_shader;
 GLuint brdf_shader;
 
+// Render queue handles
+RenderQueue render_queue;
+unsigned int pbr_queue_program;
+unsigned int pbr_indirect_queue_program;
+unsigned int light_queue_program;
+unsigned int depth_queue_program;
+unsigned int depth_indirect_queue_program;
+unsigned int light_depth_queue_program;
+unsigned int gbuffer_queue_program;
+unsigned int gbuffer_indirect_queue_program;
+unsigned int visibility_queue_program;
+unsigned int skybox_queue_program;
+unsigned int scene_texture_set;
+unsigned int skybox_texture_set;
+
+// Multi-draw indirect needs GL 4.3, otherwise each object is drawn with its own call
+bool indirect_supported = false;
+// Toggled on the GL thread, read by the update thread
+std::atomic<bool> use_indirect(false);
+
 // Fonts
 struct Font {
     GLuint atlas;
@@ -83,208 +269,1006 @@ Font font_hack10;
 
 bool init();
 void quit();
-void render_prepare_framebuffer();
-void render_flip_framebuffer();
+void quit_workers();
+float animation_time(const RenderPacket* packet);
+bool indirect_available();
+void update_frame(RenderPacket* packet, const SimulationInput& input, float delta);
+void render_pass_scene(const RenderGraph& graph, void* user_data);
+void render_pass_gbuffer(const RenderGraph& graph, void* user_data);
+void render_pass_deferred_lighting(const RenderGraph& graph, void* user_data);
+void render_pass_visibility(const RenderGraph& graph, void* user_data);
+void render_pass_visibility_resolve(const RenderGraph& graph, void* user_data);
+void render_pass_fxaa(const RenderGraph& graph, void* user_data);
+void render_pass_taa(const RenderGraph& graph, void* user_data);
+void render_pass_easu(const RenderGraph& graph, void* user_data);
+void render_pass_present(const RenderGraph& graph, void* user_data);
+void render_pass_overlay(const RenderGraph& graph, void* user_data);
+void set_lit_shader_render_size(unsigned int width, unsigned int height);
+bool shader_read_source(const char* path, std::string* source);
 bool shader_compile(GLuint* id, const char* vertex_path, const char* fragment_path);
 bool texture_load(GLuint* texture, std::string path);
-bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* prefilter_map, GLuint* brdf_lookup_texture, std::string path);
+bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* prefilter_map, GLuint* brdf_lookup_texture, std::string path, unsigned int cubemap_size);
+
+int main(int argc, char** argv) {
+	profiler_init();
+	PROFILE_THREAD("main");
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc) {
+			scene_grid_size = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--no-pipeline") == 0) {
+			pipeline_threaded = false;
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			trace_frames_on_exit = (unsigned int)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--headless") == 0) {
+			headless = true;
+		} else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			frame_limit = (unsigned int)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc) {
+			camera_path_file = argv[++i];
+		} else if (strcmp(argv[i], "--output-dir") == 0 && i + 1 < argc) {
+			frame_output_dir = argv[++i];
+		} else if (strcmp(argv[i], "--benchmark") == 0) {
+			benchmarking = true;
+		} else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+			benchmark_warmup_frames = (unsigned int)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--benchmark-output") == 0 && i + 1 < argc) {
+			benchmark_output_path = argv[++i];
+		} else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc) {
+			scene_light_count = (unsigned int)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--cluster-lights") == 0 && i + 1 < argc) {
+			scene_cluster_light_count = (unsigned int)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--light-cluster-benchmark") == 0) {
+			light_cluster_benchmarking = true;
+		} else if (strcmp(argv[i], "--texture-size") == 0 && i + 1 < argc) {
+			environment_size = glm::max(atoi(argv[++i]), 32);
+		} else if (strcmp(argv[i], "--cull") == 0 && i + 1 < argc) {
+			cull_implementation_arg = argv[++i];
+		} else if (strcmp(argv[i], "--cull-benchmark") == 0) {
+			cull_benchmarking = true;
+		} else if (strcmp(argv[i], "--bvh") == 0) {
+			use_bvh = true;
+		} else if (strcmp(argv[i], "--bvh-benchmark") == 0) {
+			bvh_benchmarking = true;
+		} else if (strcmp(argv[i], "--occluders") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "marked") == 0) {
+				occlusion_settings.selection = OCCLUDERS_MARKED;
+			} else if (strcmp(argv[i], "size") == 0) {
+				occlusion_settings.selection = OCCLUDERS_SCREEN_SIZE;
+			} else {
+				occlusion_settings.selection = OCCLUDERS_NONE;
+			}
+		} else if (strcmp(argv[i], "--occluder-size") == 0 && i + 1 < argc) {
+			occlusion_settings.min_screen_size = (float)atof(argv[++i]);
+		} else if (strcmp(argv[i], "--max-occluders") == 0 && i + 1 < argc) {
+			occlusion_settings.max_occluders = (unsigned int)atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--occlusion-benchmark") == 0) {
+			occlusion_benchmarking = true;
+		} else if (strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "full") == 0) {
+				vertex_format = vertex_format_full();
+			} else if (strcmp(argv[i], "packed") == 0) {
+				vertex_format = vertex_format_packed();
+			} else {
+				vertex_format = vertex_format_compact();
+			}
+		} else if (strcmp(argv[i], "--no-mesh-optimize") == 0) {
+			optimize_meshes = false;
+		} else if (strcmp(argv[i], "--vertex-benchmark") == 0) {
+			vertex_benchmarking = true;
+		} else if (strcmp(argv[i], "--depth-prepass") == 0 && i + 1 < argc) {
+			i++;
+			for (int mode = 0; mode < DEPTH_PREPASS_MODE_COUNT; mode++) {
+				if (strcmp(argv[i], depth_prepass_mode_name((DepthPrepassMode)mode)) == 0) {
+					depth_prepass_mode = (DepthPrepassMode)mode;
+				}
+			}
+		} else if (strcmp(argv[i], "--shading") == 0 && i + 1 < argc) {
+			i++;
+			for (int path = 0; path < SHADING_PATH_COUNT; path++) {
+				if (strcmp(argv[i], SHADING_PATH_NAMES[path]) == 0) {
+					shading_path = (ShadingPath)path;
+				}
+			}
+		} else if (strcmp(argv[i], "--aa") == 0 && i + 1 < argc) {
+			i++;
+			for (int mode = 0; mode < ANTIALIASING_MODE_COUNT; mode++) {
+				if (strcmp(argv[i], antialiasing_mode_name((AntiAliasingMode)mode)) == 0) {
+					antialiasing_mode = (AntiAliasingMode)mode;
+				}
+			}
+		} else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc) {
+			unsigned int width, height;
+			if (sscanf(argv[++i], "%ux%u", &width, &height) == 2 && width != 0 && height != 0) {
+				WINDOW_WIDTH = width;
+				WINDOW_HEIGHT = height;
+			}
+		} else if (strcmp(argv[i], "--render-scale") == 0 && i + 1 < argc) {
+			initial_render_scale = glm::clamp((float)atof(argv[++i]), 0.1f, 1.0f);
+		} else if (strcmp(argv[i], "--upscaler") == 0 && i + 1 < argc) {
+			i++;
+			for (int method = 0; method < UPSCALER_COUNT; method++) {
+				if (strcmp(argv[i], upscaler_name((Upscaler)method)) == 0) {
+					upscaler = (Upscaler)method;
+				}
+			}
+		} else if (strcmp(argv[i], "--upscale-preset") == 0 && i + 1 < argc) {
+			i++;
+			for (int preset = 0; preset < UPSCALE_PRESET_COUNT; preset++) {
+				if (strcmp(argv[i], upscale_preset_name((UpscalePreset)preset)) == 0) {
+					initial_render_scale = upscale_preset_scale((UpscalePreset)preset);
+				}
+			}
+		} else if (strcmp(argv[i], "--upscale-benchmark") == 0) {
+			upscale_benchmarking = true;
+		} else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc) {
+			dynamic_resolution_settings.enabled = true;
+			dynamic_resolution_settings.budget_ms = glm::max((float)atof(argv[++i]), 0.1f);
+		} else if (strcmp(argv[i], "--min-render-scale") == 0 && i + 1 < argc) {
+			dynamic_resolution_settings.min_scale = glm::clamp((float)atof(argv[++i]), 0.1f, 1.0f);
+		} else if (strcmp(argv[i], "--sphere-segments") == 0 && i + 1 < argc) {
+			sphere_segments = (unsigned int)glm::max(atoi(argv[++i]), 3);
+		} else if (strcmp(argv[i], "--shadows") == 0) {
+			use_shadows = true;
+		} else if (strcmp(argv[i], "--shadow-cascades") == 0 && i + 1 < argc) {
+			shadow_settings.cascade_count = (unsigned int)glm::max(atoi(argv[++i]), 1);
+		} else if (strcmp(argv[i], "--shadow-budget") == 0 && i + 1 < argc) {
+			shadow_settings.update_budget = (unsigned int)glm::max(atoi(argv[++i]), 0);
+		} else if (strcmp(argv[i], "--sun-speed") == 0 && i + 1 < argc) {
+			sun_speed = (float)atof(argv[++i]);
+		} else if (strcmp(argv[i], "--lod") == 0) {
+			use_lod = true;
+		} else if (strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc) {
+			lod_max_pixels = (float)atof(argv[++i]);
+		} else if (strcmp(argv[i], "--lod-dither") == 0) {
+			lod_fade_band = 0.25f;
+		} else {
+			printf("Unknown argument %s\n", argv[i]);
+		}
+	}
+
+	// The calling thread culls too, so leave one core for the GL thread
+	unsigned int worker_count = (unsigned int)glm::max(SDL_GetCPUCount() - 2, 0);
+	if (!cull_init(worker_count) || !occlusion_init(OCCLUSION_DEFAULT_WIDTH, OCCLUSION_DEFAULT_HEIGHT, worker_count) || !light_cluster_init(worker_count)) {
+		return -1;
+	}
+	if (cull_implementation_arg != NULL) {
+		for (int i = 0; i < CULL_IMPLEMENTATION_COUNT; i++) {
+			if (strcmp(cull_implementation_arg, cull_implementation_name((CullImplementation)i)) == 0) {
+				cull_set_implementation((CullImplementation)i);
+			}
+		}
+		printf("Culling: %s\n", cull_implementation_name(cull_get_implementation()));
+	}
+	if (cull_benchmarking) {
+		bool matched = benchmark_culling(cull_benchmark_output_path);
+		printf("Wrote %s\n", cull_benchmark_output_path);
+		quit_workers();
+		return matched ? 0 : -1;
+	}
+	if (bvh_benchmarking) {
+		bool matched = benchmark_bvh(bvh_benchmark_output_path, (unsigned int)glm::max(SDL_GetCPUCount(), 1));
+		printf("Wrote %s\n", bvh_benchmark_output_path);
+		quit_workers();
+		return matched ? 0 : -1;
+	}
+	if (light_cluster_benchmarking) {
+		bool matched = benchmark_light_clusters(light_cluster_benchmark_output_path, worker_count);
+		printf("Wrote %s\n", light_cluster_benchmark_output_path);
+		quit_workers();
+		return matched ? 0 : -1;
+	}
+	if (occlusion_benchmarking) {
+		bool matched = benchmark_occlusion(occlusion_benchmark_output_path, worker_count);
+		printf("Wrote %s\n", occlusion_benchmark_output_path);
+		quit_workers();
+		return matched ? 0 : -1;
+	}
 
-int main() {
 	if (!init()) {
 		return -1;
 	}
+	if (vertex_benchmarking) {
+		glBindFramebuffer(GL_FRAMEBUFFER, platform_get_backbuffer());
+		bool written = benchmark_vertex_fetch(vertex_benchmark_output_path, pbr_shader, mesh_buffer.vertices);
+		printf("Wrote %s\n", vertex_benchmark_output_path);
+		quit_workers();
+		quit();
+		return written ? 0 : -1;
+	}
 
-	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCREEN_WIDTH / (float)SCREEN_HEIGHT, 0.1f, 100.0f);
+	projection = glm::perspective(glm::radians(45.0f), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, NEAR_PLANE, FAR_PLANE);
 
-	glm::vec3 light_positions[] = {
-		glm::vec3(0.0f, 0.0f, 10.0f),
-	};
-	glm::vec3 light_colors[] = {
-		glm::vec3(150.0f),
-	};
-	int light_count = (int)(sizeof(light_positions) / sizeof(glm::vec3));
-	light_count = 0;
+	GLuint mesh_shaders[] = { pbr_shader, pbr_indirect_shader, light_shader, depth_shader, depth_indirect_shader, light_depth_shader, gbuffer_shader, gbuffer_indirect_shader, visibility_shader, visibility_resolve_shader };
+	for (GLuint shader : mesh_shaders) {
+		if (shader != 0) {
+			gl_state_use_program(shader);
+			mesh_buffer_set_decode_uniforms(mesh_buffer, shader);
+		}
+	}
+	GLuint visibility_shaders[] = { visibility_shader, visibility_resolve_shader };
+	for (GLuint shader : visibility_shaders) {
+		gl_state_use_program(shader);
+		visibility_set_uniforms(shader);
+	}
+	GLuint lit_shaders[] = { pbr_shader, pbr_indirect_shader, deferred_shader, visibility_resolve_shader };
+	for (GLuint shader : lit_shaders) {
+		if (shader == 0) {
+			continue;
+		}
+		gl_state_use_program(shader);
+		shadow_set_uniforms(shader);
+	}
+	shadow_init(shadow_settings);
+	// The upscale benchmark's reference has to be rendered at the window's size
+	if (upscale_benchmarking) {
+		initial_render_scale = 1.0f;
+		dynamic_resolution_settings.enabled = false;
+	}
+	dynamic_resolution_init(&dynamic_resolution, dynamic_resolution_settings, initial_render_scale);
+	render_scale = dynamic_resolution.scale;
+
+	CameraState initial_camera;
+	initial_camera.position = glm::vec3(0.0f, 0.0f, -3.0f);
+	initial_camera.yaw = -90.0f;
+	initial_camera.pitch = 0.0f;
+	simulation_init(&simulation, initial_camera);
+
+	// Headless and benchmark runs always follow a path, circling the grid unless one is given
+	scripted = headless || benchmarking;
+	if (camera_path_file != NULL) {
+		if (!camera_path_load(&camera_path, camera_path_file)) {
+			return -1;
+		}
+		camera_path_active = true;
+	} else if (scripted) {
+		float grid_extent = (float)scene_grid_size * 2.5f;
+		camera_path_create_orbit(&camera_path, glm::vec3(0.0f), glm::max(grid_extent, 8.0f), grid_extent * 0.25f, 10.0f, 8);
+		camera_path_active = true;
+	}
+	if (scripted && frame_limit == 0) {
+		frame_limit = HEADLESS_DEFAULT_FRAMES;
+	}
 
-	glUseProgram(pbr_shader);
-	glUniform1i(glGetUniformLocation(pbr_shader, "light_count"), light_count);
-	for (int i = 0; i < light_count; i++) {
-		glUniform3fv(glGetUniformLocation(pbr_shader, (std::string("light_positions[") + std::to_string(i) + std::string("]")).c_str()), 1, glm::value_ptr(light_positions[i]));
-		glUniform3fv(glGetUniformLocation(pbr_shader, (std::string("light_colors[") + std::to_string(i) + std::string("]")).c_str()), 1, glm::value_ptr(light_colors[i]));
+	// Benchmarks run uncapped and end themselves after the warm-up plus the measured frames
+	if (benchmarking) {
+		BenchmarkSettings settings;
+		settings.warmup_frames = benchmark_warmup_frames;
+		settings.frames = frame_limit;
+		settings.camera_path = camera_path_file != NULL ? camera_path_file : "orbit";
+		settings.grid_size = (unsigned int)scene_grid_size;
+		settings.sphere_segments = sphere_segments;
+		settings.lights = (unsigned int)scene.lights.size();
+		settings.texture_size = environment_size;
+		settings.headless = headless;
+		settings.pipelined = pipeline_threaded;
+		settings.render_path = use_indirect ? "multi-draw indirect" : "per-draw";
+		settings.lod = use_lod;
+		settings.vertex_format = vertex_format.name;
+		settings.depth_prepass = depth_prepass_mode_name(depth_prepass_mode);
+		settings.shading = SHADING_PATH_NAMES[shading_path];
+		settings.shadows = use_shadows;
+		settings.shadow_cascades = glm::min(shadow_settings.cascade_count, SHADOW_MAX_CASCADES);
+		settings.shadow_update_budget = shadow_settings.update_budget;
+		settings.sun_speed = sun_speed;
+		AntiAliasingMode benchmark_antialiasing = antialiasing_mode;
+		const char* antialiasing_zone = antialiasing_zone_name(benchmark_antialiasing);
+		settings.antialiasing = antialiasing_mode_name(benchmark_antialiasing);
+		settings.antialiasing_samples = shading_path == SHADING_FORWARD ? antialiasing_samples(benchmark_antialiasing, max_samples) : 0;
+		settings.antialiasing_zone = antialiasing_zone != NULL ? antialiasing_zone : "";
+		settings.window_width = WINDOW_WIDTH;
+		settings.window_height = WINDOW_HEIGHT;
+		settings.render_scale = dynamic_resolution.scale;
+		settings.dynamic_resolution = dynamic_resolution.settings.enabled;
+		settings.dynamic_resolution_budget_ms = dynamic_resolution.settings.budget_ms;
+		settings.upscaler = upscaler_name(upscaler);
+		settings.gbuffer_bytes_per_pixel = shading_path == SHADING_DEFERRED ? GBUFFER_BYTES_PER_PIXEL : shading_path == SHADING_VISIBILITY ? VISIBILITY_BYTES_PER_PIXEL : 0;
+		benchmark_init(&benchmark, settings);
+		frame_limit = 0;
+		frame_pacer_set_mode(&frame_pacer, FRAME_PACING_UNCAPPED);
 	}
 
-	glm::vec3 camera_position = glm::vec3(0.0f, 0.0f, -3.0f);
-	glm::vec3 camera_forward = glm::vec3(0.0f, 0.0f, -1.0f);
-	glm::vec3 camera_up = glm::vec3(0.0f, 1.0f, 0.0f);
-	glm::vec3 camera_right = glm::normalize(glm::cross(camera_forward, camera_up));
-	float camera_yaw = -90.0f;
-	float camera_pitch = 0.0f;
+	if (!pipeline_init(&pipeline, update_frame, pipeline_threaded)) {
+		return -1;
+	}
 
-	const Uint8* keys = SDL_GetKeyboardState(NULL);
+	SimulationInput input = SimulationInput();
+	unsigned int frames_rendered = 0;
 
 	while (running) {
         // Timekeep
-		unsigned long current_time = SDL_GetTicks();
-		if (current_time - last_time < FRAME_TIME) {
-            continue;
-		}
-
-		delta = (float)(current_time - last_time) / 60.0f;
-		last_time = current_time;
-
-		if (current_time - last_second >= 1000) {
-			fps = frames;
-			frames = 0;
-			last_second += 1000;
+		PROFILE_FRAME();
+		delta = frame_pacer_begin_frame(&frame_pacer);
+		if (scripted) {
+			// Fixed steps so scripted runs are repeatable however fast they go
+			delta = SIMULATION_TICK_SECONDS;
 		}
           
         // Poll events
-        SDL_Event e;
-        while (SDL_PollEvent(&e) != 0) {
-			if (e.type == SDL_QUIT) {
+		PROFILE_BEGIN("poll_events");
+        PlatformEvent e;
+        while (platform_poll_event(&e)) {
+			if (e.type == PLATFORM_EVENT_QUIT) {
 				running = false;
-			} else if (SDL_GetRelativeMouseMode() == SDL_FALSE) {
-				if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) {
-					SDL_SetRelativeMouseMode(SDL_TRUE);
+			} else if (e.type == PLATFORM_EVENT_KEY_DOWN && e.key == SDLK_F1) {
+				use_indirect = indirect_available() && !use_indirect;
+				printf("Render path: %s\n", use_indirect ? "multi-draw indirect" : "per-draw");
+			} else if (e.type == PLATFORM_EVENT_KEY_DOWN && e.key == SDLK_F2) {
+				const FramePacerStats& pacing = frame_pacer.stats;
+				printf("Frame pacing %s: %.2f ms mean, %.2f ms jitter, %.2f ms max, %.0f%% cpu\n", frame_pacer_mode_name(frame_pacer.mode), pacing.frame_time_mean, pacing.frame_time_jitter, pacing.frame_time_max, pacing.cpu_utilization * 100.0);
+				frame_pacer_set_mode(&frame_pacer, (FramePacingMode)((frame_pacer.mode + 1) % FRAME_PACING_MODE_COUNT));
+				printf("Frame pacing: %s\n", frame_pacer_mode_name(frame_pacer.mode));
+			} else if (e.type == PLATFORM_EVENT_KEY_DOWN && e.key == SDLK_F3) {
+				if (gpu_timer_write_csv("gpu_timings.csv")) {
+					printf("Wrote GPU timings to gpu_timings.csv\n");
 				}
-			} else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE) {
-				SDL_SetRelativeMouseMode(SDL_FALSE);
-			} else if (e.type == SDL_MOUSEMOTION) {
-				camera_yaw += e.motion.xrel * 0.1f;
-				camera_pitch -= e.motion.yrel * 0.1f;
-				if (camera_pitch > 89.0f) {
-					camera_pitch = 89.0f;
-				} else if (camera_pitch < -89.0f) {
-					camera_pitch = -89.0f;
+			} else if (e.type == PLATFORM_EVENT_KEY_DOWN && e.key == SDLK_F4) {
+				profiler_write_trace("cpu_trace.json", PROFILER_TRACE_FRAMES);
+			} else if (e.type == PLATFORM_EVENT_KEY_DOWN && e.key == SDLK_F5) {
+				depth_prepass_set_mode(&depth_prepass, (DepthPrepassMode)((depth_prepass.mode + 1) % DEPTH_PREPASS_MODE_COUNT));
+				printf("Depth pre-pass: %s\n", depth_prepass_mode_name(depth_prepass.mode));
+			} else if (e.type == PLATFORM_EVENT_KEY_DOWN && e.key == SDLK_F6) {
+				shading_path = (ShadingPath)((shading_path + 1) % SHADING_PATH_COUNT);
+				printf("Shading: %s\n", SHADING_PATH_NAMES[shading_path]);
+				if (use_indirect && !indirect_available()) {
+					use_indirect = false;
+					printf("Render path: per-draw\n");
 				}
-
-				camera_forward = glm::normalize(glm::vec3(
-					std::cos(glm::radians(camera_yaw)) * std::cos(glm::radians(camera_pitch)),
-					std::sin(glm::radians(camera_pitch)),
-					std::sin(glm::radians(camera_yaw)) * std::cos(glm::radians(camera_pitch))
-				));
-				camera_right = glm::normalize(glm::cross(camera_forward, glm::vec3(0.0f, 1.0f, 0.0f)));
-				camera_up = glm::normalize(glm::cross(camera_right, camera_forward));
+			} else if (e.type == PLATFORM_EVENT_KEY_DOWN && e.key == SDLK_F7) {
+				antialiasing_mode = (AntiAliasingMode)((antialiasing_mode + 1) % ANTIALIASING_MODE_COUNT);
+				printf("Anti-aliasing: %s\n", antialiasing_mode_name(antialiasing_mode));
+			} else if (e.type == PLATFORM_EVENT_KEY_DOWN && e.key == SDLK_F8) {
+				dynamic_resolution_set_enabled(&dynamic_resolution, !dynamic_resolution.settings.enabled);
+				render_scale = dynamic_resolution.scale;
+				printf("Dynamic resolution: %s, scale %.2f\n", dynamic_resolution.settings.enabled ? "on" : "off", dynamic_resolution.scale);
+			} else if (e.type == PLATFORM_EVENT_KEY_DOWN && e.key == SDLK_F9) {
+				upscaler = (Upscaler)((upscaler + 1) % UPSCALER_COUNT);
+				printf("Upscaler: %s\n", upscaler_name(upscaler));
+			} else if (!platform_mouse_captured()) {
+				if (e.type == PLATFORM_EVENT_MOUSE_BUTTON_DOWN && e.button == SDL_BUTTON_LEFT) {
+					platform_set_mouse_captured(true);
+				}
+			} else if (e.type == PLATFORM_EVENT_KEY_DOWN && e.key == SDLK_ESCAPE) {
+				platform_set_mouse_captured(false);
+			} else if (e.type == PLATFORM_EVENT_MOUSE_MOTION) {
+				input.look_x += e.motion_x;
+				input.look_y += e.motion_y;
 			}
         }
+		PROFILE_END();
+
+		// Update, which builds the next frame's packet while this one renders when pipelined
+		input.forward = platform_key_down(SDL_SCANCODE_W);
+		input.back = platform_key_down(SDL_SCANCODE_S);
+		input.left = platform_key_down(SDL_SCANCODE_A);
+		input.right = platform_key_down(SDL_SCANCODE_D);
+		input.up = platform_key_down(SDL_SCANCODE_E);
+		input.down = platform_key_down(SDL_SCANCODE_Q);
+		PROFILE_BEGIN("wait_for_update");
+		const RenderPacket& packet = pipeline_begin_frame(&pipeline, input, delta);
+		PROFILE_END();
+		input.look_x = 0.0f;
+		input.look_y = 0.0f;
 
-		// Update
-		glm::vec3 camera_move_direction = glm::vec3(0.0f);
-		if (keys[SDL_SCANCODE_W]) {
-			camera_move_direction += camera_forward;
+        // RENDER
+		PROFILE_BEGIN("render_submit");
+		gl_state_reset_stats();
+		gpu_timer_begin_frame();
+		render_graph_begin(&render_graph, platform_get_backbuffer(), WINDOW_WIDTH, WINDOW_HEIGHT);
+
+		// Everything up to the present pass renders at the packet's size, the present pass scales it to the window
+		unsigned int render_width = packet.render_width;
+		unsigned int render_height = packet.render_height;
+		set_lit_shader_render_size(render_width, render_height);
+		AntiAliasingMode frame_antialiasing = packet.antialiasing.mode;
+		unsigned int scene_samples = shading_path == SHADING_FORWARD ? antialiasing_samples(frame_antialiasing, max_samples) : 0;
+		RenderGraphTextureDesc scene_color_desc = { render_width, render_height, GL_RGBA8, scene_samples };
+		RenderGraphTextureDesc scene_depth_desc = { render_width, render_height, GL_DEPTH24_STENCIL8, scene_samples };
+		scene_color_target = render_graph_create_texture(&render_graph, "scene_color", scene_color_desc);
+		scene_depth_target = render_graph_create_texture(&render_graph, "scene_depth", scene_depth_desc);
+
+		// Lighting copies the G-buffer depth into the scene depth, so the forward draws after it are depth tested
+		// without the pass sampling a texture it has attached
+		if (shading_path == SHADING_DEFERRED) {
+			RenderGraphTextureDesc gbuffer_albedo_desc = { render_width, render_height, GL_RGBA8, 0 };
+			RenderGraphTextureDesc gbuffer_normal_desc = { render_width, render_height, GL_RGBA16, 0 };
+			RenderGraphTextureDesc gbuffer_depth_desc = { render_width, render_height, GL_DEPTH24_STENCIL8, 0 };
+			gbuffer_albedo_target = render_graph_create_texture(&render_graph, "gbuffer_albedo", gbuffer_albedo_desc);
+			gbuffer_normal_target = render_graph_create_texture(&render_graph, "gbuffer_normal", gbuffer_normal_desc);
+			gbuffer_depth_target = render_graph_create_texture(&render_graph, "gbuffer_depth", gbuffer_depth_desc);
+
+			unsigned int gbuffer_pass = render_graph_add_pass(&render_graph, "gbuffer", render_pass_gbuffer, (void*)&packet);
+			render_graph_write_color(&render_graph, gbuffer_pass, gbuffer_albedo_target, glm::vec4(0.0f));
+			render_graph_write_color(&render_graph, gbuffer_pass, gbuffer_normal_target, glm::vec4(0.0f));
+			render_graph_write_depth(&render_graph, gbuffer_pass, gbuffer_depth_target);
+
+			unsigned int lighting_pass = render_graph_add_pass(&render_graph, "deferred_lighting", render_pass_deferred_lighting, (void*)&packet);
+			render_graph_read_texture(&render_graph, lighting_pass, gbuffer_albedo_target);
+			render_graph_read_texture(&render_graph, lighting_pass, gbuffer_normal_target);
+			render_graph_read_texture(&render_graph, lighting_pass, gbuffer_depth_target);
+			render_graph_write_color(&render_graph, lighting_pass, scene_color_target, glm::vec4(1.0f));
+			render_graph_write_depth(&render_graph, lighting_pass, scene_depth_target);
+		} else if (shading_path == SHADING_VISIBILITY) {
+			RenderGraphTextureDesc visibility_desc = { render_width, render_height, GL_R32UI, 0 };
+			RenderGraphTextureDesc visibility_depth_desc = { render_width, render_height, GL_DEPTH24_STENCIL8, 0 };
+			visibility_target = render_graph_create_texture(&render_graph, "visibility", visibility_desc);
+			visibility_depth_target = render_graph_create_texture(&render_graph, "visibility_depth", visibility_depth_desc);
+
+			unsigned int visibility_pass = render_graph_add_pass(&render_graph, "visibility", render_pass_visibility, (void*)&packet);
+			render_graph_write_color(&render_graph, visibility_pass, visibility_target, glm::vec4(0.0f));
+			render_graph_write_depth(&render_graph, visibility_pass, visibility_depth_target);
+
+			unsigned int resolve_pass = render_graph_add_pass(&render_graph, "visibility_resolve", render_pass_visibility_resolve, (void*)&packet);
+			render_graph_read_texture(&render_graph, resolve_pass, visibility_target);
+			render_graph_write_color(&render_graph, resolve_pass, scene_color_target, glm::vec4(1.0f));
+			render_graph_write_depth(&render_graph, resolve_pass, scene_depth_target);
 		}
-		if (keys[SDL_SCANCODE_S]) {
-			camera_move_direction -= camera_forward;
+
+		unsigned int scene_pass = render_graph_add_pass(&render_graph, "scene", render_pass_scene, (void*)&packet);
+		render_graph_write_color(&render_graph, scene_pass, scene_color_target, glm::vec4(1.0f));
+		render_graph_write_depth(&render_graph, scene_pass, scene_depth_target);
+
+		present_source_target = scene_color_target;
+		if (frame_antialiasing == ANTIALIASING_FXAA) {
+			RenderGraphTextureDesc antialiased_desc = { render_width, render_height, GL_RGBA8, 0 };
+			present_source_target = render_graph_create_texture(&render_graph, "antialiased_color", antialiased_desc);
+
+			unsigned int fxaa_pass = render_graph_add_pass(&render_graph, "fxaa", render_pass_fxaa, NULL);
+			render_graph_read_texture(&render_graph, fxaa_pass, scene_color_target);
+			render_graph_write_color(&render_graph, fxaa_pass, present_source_target, glm::vec4(0.0f));
+		} else if (frame_antialiasing == ANTIALIASING_TAA) {
+			// This frame's result is presented from the history it is written into
+			// The history stays at the window's size, so it survives render scale changes
+			taa_history_valid = antialiasing_begin_frame(WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGBA8) && packet.antialiasing.history_valid;
+			RenderGraphTextureDesc history_desc = { WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGBA8, 0 };
+			RenderGraphResource history_read_target = render_graph_import_texture(&render_graph, "taa_history", antialiasing_history_read(), history_desc);
+			present_source_target = render_graph_import_texture(&render_graph, "taa_output", antialiasing_history_write(), history_desc);
+
+			unsigned int taa_pass = render_graph_add_pass(&render_graph, "taa", render_pass_taa, (void*)&packet);
+			render_graph_read_texture(&render_graph, taa_pass, scene_color_target);
+			render_graph_read_texture(&render_graph, taa_pass, scene_depth_target);
+			render_graph_read_texture(&render_graph, taa_pass, history_read_target);
+			render_graph_write_color(&render_graph, taa_pass, present_source_target, glm::vec4(0.0f));
 		}
-		if (keys[SDL_SCANCODE_A]) {
-			camera_move_direction -= camera_right;
+
+		// TAA already resolves into a window sized history, and a full size scene has nothing to upscale
+		RenderGraphTextureDesc present_source_desc = render_graph_get_desc(render_graph, present_source_target);
+		frame_upscaling = upscaler == UPSCALER_EASU && (present_source_desc.width < WINDOW_WIDTH || present_source_desc.height < WINDOW_HEIGHT);
+		if (frame_upscaling) {
+			RenderGraphTextureDesc upscaled_desc = { WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGBA8, 0 };
+			upscaled_target = render_graph_create_texture(&render_graph, "upscaled_color", upscaled_desc);
+
+			unsigned int easu_pass = render_graph_add_pass(&render_graph, "easu", render_pass_easu, NULL);
+			render_graph_read_texture(&render_graph, easu_pass, present_source_target);
+			render_graph_write_color(&render_graph, easu_pass, upscaled_target, glm::vec4(0.0f));
 		}
-		if (keys[SDL_SCANCODE_D]) {
-			camera_move_direction += camera_right;
+
+		unsigned int present_pass = render_graph_add_pass(&render_graph, frame_upscaling ? "rcas" : "present", render_pass_present, NULL);
+		render_graph_read_texture(&render_graph, present_pass, frame_upscaling ? upscaled_target : present_source_target);
+		render_graph_write_color(&render_graph, present_pass, RENDER_GRAPH_BACKBUFFER, glm::vec4(1.0f));
+
+		unsigned int overlay_pass = render_graph_add_pass(&render_graph, "overlay", render_pass_overlay, (void*)&packet);
+		render_graph_write_color(&render_graph, overlay_pass, RENDER_GRAPH_BACKBUFFER, glm::vec4(1.0f));
+
+		if (render_graph_compile(&render_graph)) {
+			gpu_timer_begin("frame");
+			shadow_render(&render_queue, packet.shadows);
+			render_graph_execute(&render_graph);
+			gpu_timer_end();
 		}
-		if (keys[SDL_SCANCODE_E]) {
-			camera_move_direction += glm::vec3(0.0f, 1.0f, 0.0f);
+		if (dynamic_resolution_update(&dynamic_resolution, "frame")) {
+			render_scale = dynamic_resolution.scale;
+		}
+		if (upscale_benchmarking && frames_rendered + 1 >= benchmark_warmup_frames) {
+			if (benchmark_upscaling(upscale_benchmark_output_path, render_graph_get_texture(render_graph, present_source_target), WINDOW_WIDTH, WINDOW_HEIGHT, upscale_programs, quad_vao)) {
+				printf("Wrote %s\n", upscale_benchmark_output_path);
+			}
+			running = false;
 		}
-		if (keys[SDL_SCANCODE_Q]) {
-			camera_move_direction -= glm::vec3(0.0f, 1.0f, 0.0f);
+		if (frame_output_dir != NULL) {
+			char frame_path[512];
+			snprintf(frame_path, sizeof(frame_path), "%s/frame_%05lu.ppm", frame_output_dir, packet.frame);
+			platform_save_backbuffer(frame_path);
 		}
-		if (glm::length(camera_move_direction) > 0.0f) {
-			camera_position += glm::normalize(camera_move_direction) * 1.0f * delta;
+		PROFILE_END();
+
+		PROFILE_BEGIN("frame_wait");
+		frame_pacer_wait(&frame_pacer);
+		PROFILE_END();
+		PROFILE_BEGIN("swap");
+		platform_swap();
+		PROFILE_END();
+
+		frames_rendered++;
+		if (frame_limit != 0 && frames_rendered >= frame_limit) {
+			running = false;
+		}
+		if (benchmarking) {
+			BenchmarkFrame benchmark_frame;
+			benchmark_frame.draws = render_queue.stats.draws;
+			benchmark_frame.triangles = render_queue.stats.triangles;
+			benchmark_frame.state_changes = gl_state_total_issued();
+			benchmark_frame.light_cluster_ms = packet.lights.stats.build_ms;
+			benchmark_frame.shadow_updates = packet.shadows.stats.updates;
+			benchmark_frame.shadow_triangles = packet.shadows.stats.triangles;
+			benchmark_frame.shadow_plan_ms = packet.shadows.stats.plan_ms;
+			benchmark_frame.render_scale = (float)packet.render_width / (float)WINDOW_WIDTH;
+			if (benchmark_record_frame(&benchmark, benchmark_frame)) {
+				running = false;
+			}
 		}
+	}
 
-        // RENDER
-		// render_prepare_framebuffer();
+	if (benchmarking && benchmark_write_json(benchmark, benchmark_output_path)) {
+		BenchmarkStats cpu_stats = benchmark_compute_stats(benchmark.cpu_frame_times);
+		BenchmarkStats gpu_stats = benchmark_compute_stats(benchmark.gpu_frame_times);
+		printf("Benchmark on %s: cpu %.2f ms mean, %.2f ms p99, gpu %.2f ms mean, %.2f ms p99. Wrote %s\n", (const char*)glGetString(GL_RENDERER), cpu_stats.mean, cpu_stats.p99, gpu_stats.mean, gpu_stats.p99, benchmark_output_path);
+	}
 
-		glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-		glEnable(GL_DEPTH_TEST);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		// Render main sphere
-		glm::mat4 view = glm::lookAt(camera_position, camera_position + camera_forward, camera_up);
-		glm::mat4 projection_view = projection * view;
-
-		glUseProgram(pbr_shader);
-		glUniformMatrix4fv(glGetUniformLocation(pbr_shader, "projection_view"), 1, GL_FALSE, glm::value_ptr(projection_view));
-		glUniform3fv(glGetUniformLocation(pbr_shader, "view_position"), 1, glm::value_ptr(camera_position));
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, sphere_albedo);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, sphere_normal);
-		glActiveTexture(GL_TEXTURE2);
-		glBindTexture(GL_TEXTURE_2D, sphere_metallic);
-		glActiveTexture(GL_TEXTURE3);
-		glBindTexture(GL_TEXTURE_2D, sphere_roughness);
-		glActiveTexture(GL_TEXTURE4);
-		glBindTexture(GL_TEXTURE_2D, sphere_ao);
-		glActiveTexture(GL_TEXTURE5);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, irradiance_map);
-		glActiveTexture(GL_TEXTURE6);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, prefilter_map);
-		glActiveTexture(GL_TEXTURE7);
-		glBindTexture(GL_TEXTURE_2D, brdf_lookup_texture);
-
-		int rows = 7;
-		int columns = 7;
-		float spacing = 2.5f;
-		glUniform1i(glGetUniformLocation(pbr_shader, "use_material_maps"), 0);
-		glUniform3f(glGetUniformLocation(pbr_shader, "u_albedo"), 0.5f, 0.0f, 0.0f);
-		glUniform1f(glGetUniformLocation(pbr_shader, "u_ao"), 1.0f);
-		for (int row = 0; row < rows; row++) {
-			glUniform1f(glGetUniformLocation(pbr_shader, "u_metallic"), (float)row / (float)rows);
-			for (int column = 0; column < columns; column++) {
-				glm::mat4 sphere_model = glm::mat4(1.0f);
-				sphere_model = glm::translate(sphere_model, glm::vec3(
-					(column - (columns / 2)) * spacing,
-					(row - (rows / 2)) * spacing,
-					0.0f
-				));
-
-				glUniform1f(glGetUniformLocation(pbr_shader, "u_roughness"), glm::clamp((float)column / (float)columns, 0.05f, 1.0f));
-				glUniformMatrix4fv(glGetUniformLocation(pbr_shader, "model"), 1, GL_FALSE, glm::value_ptr(sphere_model));
-				glUniformMatrix3fv(glGetUniformLocation(pbr_shader, "normal_matrix"), 1, GL_FALSE, glm::value_ptr(glm::transpose(glm::inverse(glm::mat3(sphere_model)))));
-
-				glBindVertexArray(sphere_vao);
-				glDrawElements(GL_TRIANGLE_STRIP, sphere_vao_index_count, GL_UNSIGNED_INT, 0);
+	pipeline_quit(&pipeline);
+	quit_workers();
+	if (trace_frames_on_exit != 0) {
+		profiler_write_trace("cpu_trace.json", trace_frames_on_exit);
+	}
+	render_graph_destroy(&render_graph);
+	depth_prepass_quit(&depth_prepass);
+	light_cluster_destroy_buffers();
+	shadow_destroy_buffers();
+	antialiasing_destroy_buffers();
+	visibility_quit();
+	gpu_timer_quit();
+	quit();
+	return 0;
+}
+
+void render_pass_scene(const RenderGraph& graph, void* user_data) {
+	const RenderPacket* packet = (const RenderPacket*)user_data;
+	if (shading_path == SHADING_DEFERRED) {
+		render_queue_execute(&render_queue, packet->list, RENDER_QUEUE_DEFERRED);
+		return;
+	} else if (shading_path == SHADING_VISIBILITY) {
+		render_queue_execute(&render_queue, packet->list, RENDER_QUEUE_VISIBILITY_RESOLVED);
+		return;
+	}
+
+	bool prepass = depth_prepass_begin_frame(&depth_prepass);
+	if (prepass) {
+		render_queue.opaque_samples_query = depth_prepass_get_query(depth_prepass, DEPTH_PREPASS_QUERY_DEPTH);
+		render_queue_execute_depth(&render_queue, packet->list);
+		render_queue.opaque_samples_query = depth_prepass_get_query(depth_prepass, DEPTH_PREPASS_QUERY_SHADED);
+	}
+	light_cluster_upload(packet->lights);
+	render_queue_execute(&render_queue, packet->list, prepass ? RENDER_QUEUE_PREPASSED : RENDER_QUEUE_FORWARD);
+	render_queue.opaque_samples_query = 0;
+}
+
+// The depth pre-pass is left out, overdraw only costs the G-buffer writes here
+void render_pass_gbuffer(const RenderGraph& graph, void* user_data) {
+	const RenderPacket* packet = (const RenderPacket*)user_data;
+	render_queue_execute(&render_queue, packet->list, RENDER_QUEUE_GBUFFER);
+}
+
+void render_pass_deferred_lighting(const RenderGraph& graph, void* user_data) {
+	const RenderPacket* packet = (const RenderPacket*)user_data;
+	const RenderList& list = packet->list;
+	light_cluster_upload(packet->lights);
+
+	// Depth always passes, the shader writes the G-buffer's
+	gl_state_enable(GL_DEPTH_TEST);
+	gl_state_depth_func(GL_ALWAYS);
+	gl_state_depth_mask(GL_TRUE);
+	gl_state_blend_func(GL_ONE, GL_ZERO);
+	gl_state_use_program(deferred_shader);
+	glm::mat4 inverse_projection_view = glm::inverse(list.projection * list.view);
+	glUniformMatrix4fv(glGetUniformLocation(deferred_shader, "inverse_projection_view"), 1, GL_FALSE, glm::value_ptr(inverse_projection_view));
+	glUniform3fv(glGetUniformLocation(deferred_shader, "view_position"), 1, glm::value_ptr(list.view_position));
+	gl_state_bind_texture(0, GL_TEXTURE_2D, render_graph_get_texture(graph, gbuffer_albedo_target));
+	gl_state_bind_texture(1, GL_TEXTURE_2D, render_graph_get_texture(graph, gbuffer_normal_target));
+	gl_state_bind_texture(2, GL_TEXTURE_2D, render_graph_get_texture(graph, gbuffer_depth_target));
+	gl_state_bind_texture(5, GL_TEXTURE_CUBE_MAP, irradiance_map);
+	gl_state_bind_texture(6, GL_TEXTURE_CUBE_MAP, prefilter_map);
+	gl_state_bind_texture(7, GL_TEXTURE_2D, brdf_lookup_texture);
+	gl_state_bind_vertex_array(quad_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	gl_state_depth_func(GL_LESS);
+}
+
+// Like the G-buffer pass, without a depth pre-pass. Overdraw only costs an ID write.
+void render_pass_visibility(const RenderGraph& graph, void* user_data) {
+	const RenderPacket* packet = (const RenderPacket*)user_data;
+	render_queue_execute(&render_queue, packet->list, RENDER_QUEUE_VISIBILITY);
+}
+
+void render_pass_visibility_resolve(const RenderGraph& graph, void* user_data) {
+	const RenderPacket* packet = (const RenderPacket*)user_data;
+	const RenderList& list = packet->list;
+	light_cluster_upload(packet->lights);
+	visibility_upload(render_queue, list, render_graph_get_texture(graph, visibility_target));
+
+	// Depth always passes, the shader writes the resolved triangle's
+	gl_state_enable(GL_DEPTH_TEST);
+	gl_state_depth_func(GL_ALWAYS);
+	gl_state_depth_mask(GL_TRUE);
+	gl_state_blend_func(GL_ONE, GL_ZERO);
+	gl_state_use_program(visibility_resolve_shader);
+	glm::mat4 projection_view = list.projection * list.view;
+	glUniformMatrix4fv(glGetUniformLocation(visibility_resolve_shader, "projection_view"), 1, GL_FALSE, glm::value_ptr(projection_view));
+	glUniform3fv(glGetUniformLocation(visibility_resolve_shader, "view_position"), 1, glm::value_ptr(list.view_position));
+	const RenderTextureSet& textures = render_queue.texture_sets[scene_texture_set];
+	for (unsigned int unit = 0; unit < textures.count; unit++) {
+		gl_state_bind_texture(unit, textures.targets[unit], textures.textures[unit]);
+	}
+	gl_state_bind_vertex_array(quad_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	gl_state_depth_func(GL_LESS);
+}
+
+void render_pass_fxaa(const RenderGraph& graph, void* user_data) {
+	gl_state_disable(GL_DEPTH_TEST);
+	gl_state_blend_func(GL_ONE, GL_ZERO);
+	gl_state_use_program(fxaa_shader);
+	gl_state_bind_vertex_array(quad_vao);
+	gl_state_bind_texture(0, GL_TEXTURE_2D, render_graph_get_texture(graph, scene_color_target));
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void render_pass_taa(const RenderGraph& graph, void* user_data) {
+	const RenderPacket* packet = (const RenderPacket*)user_data;
+	const RenderList& list = packet->list;
+
+	gl_state_disable(GL_DEPTH_TEST);
+	gl_state_blend_func(GL_ONE, GL_ZERO);
+	gl_state_use_program(taa_shader);
+	glm::mat4 inverse_projection_view = glm::inverse(list.projection * list.view);
+	glUniformMatrix4fv(glGetUniformLocation(taa_shader, "inverse_projection_view"), 1, GL_FALSE, glm::value_ptr(inverse_projection_view));
+	glUniformMatrix4fv(glGetUniformLocation(taa_shader, "previous_projection_view"), 1, GL_FALSE, glm::value_ptr(packet->antialiasing.previous_projection_view));
+	glUniform1f(glGetUniformLocation(taa_shader, "current_weight"), taa_history_valid ? TAA_CURRENT_WEIGHT : 1.0f);
+	gl_state_bind_vertex_array(quad_vao);
+	gl_state_bind_texture(0, GL_TEXTURE_2D, render_graph_get_texture(graph, scene_color_target));
+	gl_state_bind_texture(1, GL_TEXTURE_2D, render_graph_get_texture(graph, scene_depth_target));
+	gl_state_bind_texture(2, GL_TEXTURE_2D, antialiasing_history_read());
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void render_pass_easu(const RenderGraph& graph, void* user_data) {
+	gl_state_disable(GL_DEPTH_TEST);
+	gl_state_blend_func(GL_ONE, GL_ZERO);
+	gl_state_use_program(easu_shader);
+	gl_state_bind_vertex_array(quad_vao);
+	gl_state_bind_texture(0, GL_TEXTURE_2D, render_graph_get_texture(graph, present_source_target));
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+// Bilinear from the source, or RCAS over the EASU output when upscaling
+void render_pass_present(const RenderGraph& graph, void* user_data) {
+	gl_state_disable(GL_DEPTH_TEST);
+	gl_state_blend_func(GL_ONE, GL_ZERO);
+	gl_state_use_program(frame_upscaling ? rcas_shader : screen_shader);
+	gl_state_bind_vertex_array(quad_vao);
+	gl_state_bind_texture(0, GL_TEXTURE_2D, render_graph_get_texture(graph, frame_upscaling ? upscaled_target : present_source_target));
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+// GL state counts cover everything drawn before the overlay
+void render_pass_overlay(const RenderGraph& graph, void* user_data) {
+	const RenderPacket* packet = (const RenderPacket*)user_data;
+	const RenderQueueStats& stats = render_queue.stats;
+	const RenderGraphStats& graph_stats = graph.stats;
+	unsigned int state_issued = gl_state_total_issued();
+	unsigned int state_skipped = gl_state_total_skipped();
+
+	gl_state_disable(GL_DEPTH_TEST);
+	gl_state_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	const FramePacerStats& pacing = frame_pacer.stats;
+	char pacing_text[128];
+	snprintf(pacing_text, sizeof(pacing_text), "FPS: %u (%s) %.2f ms, jitter %.2f ms, cpu %.0f%%", pacing.fps, frame_pacer_mode_name(frame_pacer.mode), pacing.frame_time_mean, pacing.frame_time_jitter, pacing.cpu_utilization * 100.0);
+	font_hack10.render(pacing_text, glm::vec2(0.0f), FONT_COLOR_WHITE);
+	font_hack10.render("Draws: " + std::to_string(stats.draws) + " Programs: " + std::to_string(stats.program_changes) + " Textures: " + std::to_string(stats.texture_set_changes) + " Materials: " + std::to_string(stats.material_changes) + " VAOs: " + std::to_string(stats.vao_changes), glm::vec2(0.0f, (float)font_hack10.glyph_height), FONT_COLOR_WHITE);
+	font_hack10.render("GL state calls: " + std::to_string(state_issued) + " issued, " + std::to_string(state_skipped) + " skipped", glm::vec2(0.0f, (float)(font_hack10.glyph_height * 2)), FONT_COLOR_WHITE);
+	char update_text[128];
+	snprintf(update_text, sizeof(update_text), "Update: %.2f ms (%s), %u visible, %u culled (%s)", packet->update_ms, pipeline.threaded ? "pipelined" : "inline", packet->objects_visible, packet->objects_culled, use_bvh ? "BVH" : cull_implementation_name(cull_get_implementation()));
+	font_hack10.render(update_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * 3)), FONT_COLOR_WHITE);
+	char graph_text[128];
+	snprintf(graph_text, sizeof(graph_text), "Render targets: %u passes, %u textures in %u, %.1f MB (%.1f MB unaliased)", graph_stats.passes, graph_stats.virtual_textures, graph_stats.physical_textures, graph_stats.physical_bytes / (1024.0 * 1024.0), graph_stats.virtual_bytes / (1024.0 * 1024.0));
+	font_hack10.render(graph_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * 4)), FONT_COLOR_WHITE);
+	char occlusion_text[128];
+	if (occlusion_settings.selection == OCCLUDERS_NONE) {
+		snprintf(occlusion_text, sizeof(occlusion_text), "Occlusion: off");
+	} else {
+		const OcclusionStats& occlusion = packet->occlusion;
+		snprintf(occlusion_text, sizeof(occlusion_text), "Occlusion: %u occluders, %u triangles, %u of %u occluded, %.2f ms raster, %.2f ms test", occlusion.occluders, occlusion.triangles, occlusion.occluded, occlusion.tested, occlusion.raster_ms, occlusion.test_ms);
+	}
+	font_hack10.render(occlusion_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * 5)), FONT_COLOR_WHITE);
+	std::string lod_text = "LOD: off";
+	if (use_lod) {
+		lod_text = "LOD: " + std::to_string(render_queue.stats.triangles) + " triangles, draws per level";
+		for (unsigned int lod = 0; lod < MESH_MAX_LODS; lod++) {
+			lod_text += " " + std::to_string(packet->lod_draws[lod]);
+		}
+		lod_text += ", " + std::to_string(packet->lod_dithered) + " dithered";
+	}
+	font_hack10.render(lod_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * 6)), FONT_COLOR_WHITE);
+	char prepass_text[128];
+	snprintf(prepass_text, sizeof(prepass_text), "Depth pre-pass: %s (%s), %u draws, overdraw %.2f", depth_prepass.running && shading_path == SHADING_FORWARD ? "on" : "off", depth_prepass_mode_name(depth_prepass.mode), render_queue.prepass_stats.draws, depth_prepass.overdraw);
+	font_hack10.render(prepass_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * 7)), FONT_COLOR_WHITE);
+	const LightClusterStats& light_stats = packet->lights.stats;
+	char light_text[128];
+	snprintf(light_text, sizeof(light_text), "Lights: %u visible of %u, %u in clusters, %u most in one, %.2f ms (%s)", light_stats.visible_lights, light_stats.lights, light_stats.references, light_stats.max_cluster_lights, light_stats.build_ms, light_cluster_implementation_name(light_cluster_get_implementation()));
+	font_hack10.render(light_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * 8)), FONT_COLOR_WHITE);
+	char shading_text[128];
+	if (shading_path == SHADING_VISIBILITY) {
+		snprintf(shading_text, sizeof(shading_text), "Shading: visibility, %u B/px, %u instances, %u triangle ID bits", VISIBILITY_BYTES_PER_PIXEL, (unsigned int)render_queue.visibility_draws.size(), visibility_triangle_bits());
+	} else if (shading_path == SHADING_DEFERRED) {
+		double gbuffer_mb = (double)packet->render_width * packet->render_height * GBUFFER_BYTES_PER_PIXEL / (1024.0 * 1024.0);
+		snprintf(shading_text, sizeof(shading_text), "Shading: deferred, G-buffer %u B/px, %.1f MB written and read back per frame before overdraw", GBUFFER_BYTES_PER_PIXEL, gbuffer_mb);
+	} else {
+		snprintf(shading_text, sizeof(shading_text), "Shading: forward");
+	}
+	font_hack10.render(shading_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * 9)), FONT_COLOR_WHITE);
+	char shadow_text[160];
+	const ShadowStats& shadow_stats = packet->shadows.stats;
+	if (!packet->shadows.enabled) {
+		snprintf(shadow_text, sizeof(shadow_text), "Shadows: off");
+	} else {
+		snprintf(shadow_text, sizeof(shadow_text), "Shadows: %u updates (%u coverage, %u light, %u casters), %u pending, %u draws, %u triangles, atlas %u of %u tiles, %.1f MB, %.2f ms", shadow_stats.updates, shadow_stats.updates_by_reason[SHADOW_UPDATE_COVERAGE], shadow_stats.updates_by_reason[SHADOW_UPDATE_LIGHT], shadow_stats.updates_by_reason[SHADOW_UPDATE_CASTERS], shadow_stats.pending, shadow_stats.draws, shadow_stats.triangles, shadow_stats.tiles_used, SHADOW_ATLAS_TILES, shadow_atlas_bytes() / (1024.0 * 1024.0), shadow_stats.plan_ms);
+	}
+	font_hack10.render(shadow_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * 10)), FONT_COLOR_WHITE);
+
+	// GPU timings trail by a few frames, since they are only read back once the GPU has finished them
+	std::vector<GpuTimerZoneStats> gpu_timings;
+	gpu_timer_get_stats(&gpu_timings);
+
+	AntiAliasingMode frame_antialiasing = packet->antialiasing.mode;
+	const char* antialiasing_zone = antialiasing_zone_name(frame_antialiasing);
+	double antialiasing_ms = 0.0;
+	for (const GpuTimerZoneStats& zone : gpu_timings) {
+		if (antialiasing_zone != NULL && zone.active && zone.name == antialiasing_zone) {
+			antialiasing_ms = zone.average;
+		}
+	}
+	char antialiasing_text[128];
+	unsigned int samples = antialiasing_samples(frame_antialiasing, max_samples);
+	if (frame_antialiasing == ANTIALIASING_TAA) {
+		snprintf(antialiasing_text, sizeof(antialiasing_text), "Anti-aliasing: taa, %u jitter phases, history %.1f MB, %.2f ms", TAA_JITTER_PHASES, antialiasing_history_bytes() / (1024.0 * 1024.0), antialiasing_ms);
+	} else if (frame_antialiasing == ANTIALIASING_FXAA) {
+		snprintf(antialiasing_text, sizeof(antialiasing_text), "Anti-aliasing: fxaa, %.2f ms", antialiasing_ms);
+	} else if (samples != 0 && shading_path != SHADING_FORWARD) {
+		snprintf(antialiasing_text, sizeof(antialiasing_text), "Anti-aliasing: %s, off with %s shading", antialiasing_mode_name(frame_antialiasing), SHADING_PATH_NAMES[shading_path]);
+	} else if (samples != 0) {
+		snprintf(antialiasing_text, sizeof(antialiasing_text), "Anti-aliasing: %s, %ux samples, resolve %.2f ms", antialiasing_mode_name(frame_antialiasing), samples, antialiasing_ms);
+	} else {
+		snprintf(antialiasing_text, sizeof(antialiasing_text), "Anti-aliasing: none");
+	}
+	font_hack10.render(antialiasing_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * 11)), FONT_COLOR_WHITE);
+	char resolution_text[160];
+	if (dynamic_resolution.settings.enabled) {
+		snprintf(resolution_text, sizeof(resolution_text), "Resolution: %ux%u of %ux%u (%.0f%%), dynamic, gpu %.2f ms of %.2f ms budget, %u changes", packet->render_width, packet->render_height, WINDOW_WIDTH, WINDOW_HEIGHT, dynamic_resolution.scale * 100.0f, dynamic_resolution.measured_ms, dynamic_resolution.settings.budget_ms, dynamic_resolution.changes);
+	} else {
+		snprintf(resolution_text, sizeof(resolution_text), "Resolution: %ux%u of %ux%u (%.0f%%), fixed", packet->render_width, packet->render_height, WINDOW_WIDTH, WINDOW_HEIGHT, dynamic_resolution.scale * 100.0f);
+	}
+	font_hack10.render(resolution_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * 12)), FONT_COLOR_WHITE);
+	char upscaling_text[128];
+	const RenderGraphTextureDesc& present_source_desc = render_graph_get_desc(graph, present_source_target);
+	if (frame_upscaling) {
+		double upscaling_ms = 0.0;
+		for (const GpuTimerZoneStats& zone : gpu_timings) {
+			if (zone.active && (zone.name == "easu" || zone.name == "rcas")) {
+				upscaling_ms += zone.average;
 			}
 		}
+		snprintf(upscaling_text, sizeof(upscaling_text), "Upscaling: easu + rcas, %ux%u to %ux%u, %.2f ms", present_source_desc.width, present_source_desc.height, WINDOW_WIDTH, WINDOW_HEIGHT, upscaling_ms);
+	} else if (present_source_desc.width < WINDOW_WIDTH || present_source_desc.height < WINDOW_HEIGHT) {
+		snprintf(upscaling_text, sizeof(upscaling_text), "Upscaling: bilinear, %ux%u to %ux%u", present_source_desc.width, present_source_desc.height, WINDOW_WIDTH, WINDOW_HEIGHT);
+	} else {
+		snprintf(upscaling_text, sizeof(upscaling_text), "Upscaling: none, %s", upscaler_name(upscaler));
+	}
+	font_hack10.render(upscaling_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * 13)), FONT_COLOR_WHITE);
 
+	int timing_line = 14;
+	for (const GpuTimerZoneStats& zone : gpu_timings) {
+		if (!zone.active) {
+			continue;
+		}
+		char timing_text[128];
+		snprintf(timing_text, sizeof(timing_text), "%*s%-*s %6.2f ms  avg %6.2f  p95 %6.2f  p99 %6.2f", zone.depth * 2, "", 20 - zone.depth * 2, zone.name.c_str(), zone.last, zone.average, zone.p95, zone.p99);
+		font_hack10.render(timing_text, glm::vec2(0.0f, (float)(font_hack10.glyph_height * timing_line)), FONT_COLOR_WHITE);
+		timing_line++;
+	}
+	gl_state_blend_func(GL_ONE, GL_ZERO);
+}
+
+// Cluster lookups go by pixel, so the lit shaders need the size they render at
+void set_lit_shader_render_size(unsigned int width, unsigned int height) {
+	static unsigned int current_width = 0;
+	static unsigned int current_height = 0;
+	if (width == current_width && height == current_height) {
+		return;
+	}
+
+	GLuint lit_shaders[] = { pbr_shader, pbr_indirect_shader, deferred_shader, visibility_resolve_shader };
+	for (GLuint shader : lit_shaders) {
+		if (shader == 0) {
+			continue;
+		}
+		gl_state_use_program(shader);
+		light_cluster_set_uniforms(shader, width, height, NEAR_PLANE, FAR_PLANE);
+	}
+	current_width = width;
+	current_height = height;
+}
 
-		// Render lights
-		for (int i = 0; i < light_count; i++) {
-			glm::mat4 light_model = glm::mat4(1.0f);
-			light_model = glm::translate(light_model, light_positions[i]);
-			light_model = glm::scale(light_model, glm::vec3(0.2f));
+// Seconds animations are driven by. Scripted runs go by frame number, so they see the same frames every time,
+// pipelined or not. Otherwise it is simulation time, so nothing moves faster at a higher frame rate.
+float animation_time(const RenderPacket* packet) {
+	return scripted ? (float)packet->frame * SIMULATION_TICK_SECONDS : simulation_time(simulation);
+}
 
-			glUseProgram(light_shader);
-			glUniformMatrix4fv(glGetUniformLocation(light_shader, "projection_view"), 1, GL_FALSE, glm::value_ptr(projection_view));
-			glUniformMatrix4fv(glGetUniformLocation(light_shader, "model"), 1, GL_FALSE, glm::value_ptr(light_model));
-			glUniform3fv(glGetUniformLocation(light_shader, "light_color"), 1, glm::value_ptr(light_colors[i]));
+// Update stage. Runs the simulation and records the frame's draws into the packet without touching GL.
+void update_frame(RenderPacket* packet, const SimulationInput& input, float delta) {
+	PROFILE_ZONE("update_frame");
+	simulation.input.forward = input.forward;
+	simulation.input.back = input.back;
+	simulation.input.left = input.left;
+	simulation.input.right = input.right;
+	simulation.input.up = input.up;
+	simulation.input.down = input.down;
+	simulation.input.look_x += input.look_x;
+	simulation.input.look_y += input.look_y;
+	simulation_advance(&simulation, delta);
+	CameraState camera = simulation_interpolate_camera(simulation);
+	if (camera_path_active) {
+		camera = camera_path_sample(camera_path, animation_time(packet));
+	}
+	packet->camera = camera;
+
+	glm::mat4 view = camera_view_matrix(camera);
+	PROFILE_BEGIN("lights");
+	scene_animate_lights(&scene, animation_time(packet));
+	light_cluster_build(&packet->lights, scene.lights, view, projection, NEAR_PLANE, FAR_PLANE);
+	PROFILE_END();
+	scene_animate_sun(&scene, animation_time(packet));
+	shadow_plan(&packet->shadows, scene, mesh_buffer, pbr_queue_program, view, projection, NEAR_PLANE);
+	// Only what is drawn is jittered. Culling, LOD and the light clusters use the real projection.
+	dynamic_resolution_size(render_scale, WINDOW_WIDTH, WINDOW_HEIGHT, &packet->render_width, &packet->render_height);
+	glm::mat4 render_projection = antialiasing_plan(&packet->antialiasing, antialiasing_mode, view, projection, packet->render_width, packet->render_height, packet->frame);
+	render_list_begin(&packet->list, view, render_projection, camera.position, FAR_PLANE);
+	Frustum frustum = frustum_from_matrix(projection * view);
+	packet->objects_visible = 0;
+	packet->objects_culled = 0;
+	packet->objects_occluded = 0;
+	packet->occlusion = OcclusionStats();
+	memset(packet->lod_draws, 0, sizeof(packet->lod_draws));
+	packet->lod_dithered = 0;
+
+	// Spheres. The indirect path draws every object, its command buffer isn't rebuilt per frame.
+	PROFILE_BEGIN("cull_and_submit");
+	if (use_indirect) {
+		packet->objects_visible = (unsigned int)scene.objects.size();
+		RenderDraw draw = {};
+		draw.kind = RENDER_DRAW_INDIRECT;
+		draw.pass = RENDER_PASS_OPAQUE;
+		draw.program = pbr_indirect_queue_program;
+		draw.texture_set = scene_texture_set;
+		draw.material = RENDER_NO_MATERIAL;
+		draw.vao = indirect_get_vao();
+		draw.model = glm::mat4(1.0f);
+		render_list_submit(&packet->list, draw);
+	} else {
+		if (use_bvh) {
+			packet->objects_visible = bvh_query_frustum(scene_bvh, frustum, scene_visible.data(), NULL);
+		} else {
+			packet->objects_visible = cull_frustum(scene_bounds, frustum, scene_visible.data());
+		}
+		packet->objects_culled = (unsigned int)scene.objects.size() - packet->objects_visible;
+
+		// The largest of the frustum visible occluders are drawn into the occlusion buffer, then everything
+		// visible is tested against it. The occluders themselves always pass, since their boxes enclose them.
+		if (occlusion_settings.selection != OCCLUDERS_NONE) {
+			PROFILE_BEGIN("occlusion");
+			occlusion_begin_frame(view, projection);
+			occluder_candidates.clear();
+			for (unsigned int i = 0; i < packet->objects_visible; i++) {
+				const SceneObject& object = scene.objects[scene_visible[i]];
+				float screen_size = occlusion_screen_size(glm::vec3(object.model[3]), mesh_buffer.primitives[object.primitive].bounding_radius);
+				if (occlusion_is_occluder(occlusion_settings, object.occluder, screen_size)) {
+					occluder_candidates.push_back(std::make_pair(screen_size, scene_visible[i]));
+				}
+			}
+			std::sort(occluder_candidates.begin(), occluder_candidates.end(), std::greater<std::pair<float, unsigned int>>());
+			occluder_candidates.resize(glm::min((unsigned int)occluder_candidates.size(), occlusion_settings.max_occluders));
+			for (const std::pair<float, unsigned int>& candidate : occluder_candidates) {
+				occlusion_add_occluder(sphere_occluder, scene.objects[candidate.second].model);
+			}
+			occlusion_rasterize();
 
-			glDrawElements(GL_TRIANGLE_STRIP, sphere_vao_index_count, GL_UNSIGNED_INT, 0);
+			unsigned int unoccluded = occlusion_cull_items(scene_box_min, scene_box_max, scene_visible.data(), packet->objects_visible);
+			packet->objects_occluded = packet->objects_visible - unoccluded;
+			packet->objects_visible = unoccluded;
+			packet->occlusion = occlusion_get_stats();
+			PROFILE_END();
 		}
-		glBindVertexArray(0);
 
-		// Render skybox
-		glm::mat4 projection_rot_view = projection * glm::mat4(glm::mat3(view));
+		// Assumes unscaled models, as the bounds do. Detail is picked for the window, which the scene is shown at.
+		float pixels_per_unit = projection[1][1] * (float)WINDOW_HEIGHT * 0.5f;
+		for (unsigned int i = 0; i < packet->objects_visible; i++) {
+			const SceneObject& object = scene.objects[scene_visible[i]];
+			const MeshPrimitive& full_primitive = mesh_buffer.primitives[object.primitive];
+			unsigned int lod = 0;
+			float fade = 0.0f;
+			if (use_lod) {
+				float distance = glm::length(glm::vec3(object.model[3]) - camera.position) - full_primitive.bounding_radius;
+				lod = mesh_select_lod(full_primitive, distance, pixels_per_unit, lod_max_pixels, lod_fade_band, &fade);
+			}
+			packet->lod_draws[lod]++;
+
+			// Mid switch the finer level dithers out as the coarser one dithers in
+			unsigned int level_count = fade > 0.0f ? 2 : 1;
+			packet->lod_dithered += level_count - 1;
+			for (unsigned int level = 0; level < level_count; level++) {
+				const MeshPrimitive& primitive = mesh_buffer.primitives[full_primitive.lods[lod + level]];
+				RenderDraw draw;
+				draw.kind = RENDER_DRAW_ELEMENTS;
+				draw.pass = RENDER_PASS_OPAQUE;
+				draw.program = pbr_queue_program;
+				draw.texture_set = scene_texture_set;
+				draw.material = (int)object.material;
+				draw.vao = mesh_buffer.vao;
+				draw.mode = primitive.mode;
+				draw.first = primitive.first_index;
+				draw.count = primitive.index_count;
+				draw.base_vertex = primitive.base_vertex;
+				draw.index_type = mesh_buffer.index_type;
+				draw.model = object.model;
+				draw.lod_fade = level_count == 1 ? 0.0f : (level == 0 ? 1.0f - fade : fade - 1.0f);
+				render_list_submit(&packet->list, draw);
+			}
+		}
+	}
 
-		glDepthFunc(GL_LEQUAL);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_CUBE_MAP, skybox_texture);
-		glUseProgram(skybox_shader);
-		glUniformMatrix4fv(glGetUniformLocation(skybox_shader, "projection_rot_view"), 1, GL_FALSE, glm::value_ptr(projection_rot_view));
-		glBindVertexArray(cube_vao);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
-		glBindVertexArray(0);
-		glDepthFunc(GL_LESS);
+	PROFILE_END();
 
-		// render_flip_framebuffer();
-		SDL_GL_SwapWindow(window);
-		frames++;
+	// Light markers, for the lights that have them
+	const MeshPrimitive& light_primitive = mesh_buffer.primitives[sphere_primitive];
+	for (unsigned int i = 0; i < scene.lights.size(); i++) {
+		if (scene.lights[i].material == SCENE_NO_MATERIAL) {
+			continue;
+		}
+		RenderDraw draw;
+		draw.kind = RENDER_DRAW_ELEMENTS;
+		draw.pass = RENDER_PASS_OPAQUE;
+		draw.program = light_queue_program;
+		draw.texture_set = RENDER_NO_TEXTURE_SET;
+		draw.material = (int)scene.lights[i].material;
+		draw.vao = mesh_buffer.vao;
+		draw.mode = light_primitive.mode;
+		draw.first = light_primitive.first_index;
+		draw.count = light_primitive.index_count;
+		draw.base_vertex = light_primitive.base_vertex;
+		draw.index_type = mesh_buffer.index_type;
+		draw.model = glm::scale(glm::translate(glm::mat4(1.0f), scene.lights[i].position), glm::vec3(0.2f));
+		draw.lod_fade = 0.0f;
+		render_list_submit(&packet->list, draw);
 	}
 
-	quit();
-	return 0;
+	// Skybox
+	RenderDraw skybox_draw = {};
+	skybox_draw.kind = RENDER_DRAW_ARRAYS;
+	skybox_draw.pass = RENDER_PASS_SKY;
+	skybox_draw.program = skybox_queue_program;
+	skybox_draw.texture_set = skybox_texture_set;
+	skybox_draw.material = RENDER_NO_MATERIAL;
+	skybox_draw.vao = cube_vao;
+	skybox_draw.mode = GL_TRIANGLES;
+	skybox_draw.first = 0;
+	skybox_draw.count = 36;
+	skybox_draw.model = glm::mat4(1.0f);
+	render_list_submit(&packet->list, skybox_draw);
+
+	PROFILE_BEGIN("sort");
+	render_list_sort(&packet->list);
+	PROFILE_END();
 }
 
 // Used in generating font atlas textures
@@ -357,16 +1341,15 @@ bool Font::load(const char* path, unsigned int size) {
 }
 
 void Font::render(std::string text, glm::vec2 render_pos, glm::vec3 color) {
-    glUseProgram(text_shader);
+    gl_state_use_program(text_shader);
     glm::vec2 atlas_size = glm::vec2((float)next_largest_power_of_two(glyph_width * 96), (float)next_largest_power_of_two(glyph_height));
     glUniform2fv(glGetUniformLocation(text_shader, "atlas_size"), 1, glm::value_ptr(atlas_size));
     glm::vec2 render_size = glm::vec2((float)glyph_width, (float)glyph_height);
     glUniform2fv(glGetUniformLocation(text_shader, "render_size"), 1, glm::value_ptr(render_size));
     glUniform3fv(glGetUniformLocation(text_shader, "font_color"), 1, glm::value_ptr(color));
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, atlas);
-    glBindVertexArray(glyph_vao);
+    gl_state_bind_texture(0, GL_TEXTURE_2D, atlas);
+    gl_state_bind_vertex_array(glyph_vao);
 
     glm::vec2 render_coords = render_pos;
     glm::vec2 texture_offset;
@@ -380,15 +1363,24 @@ void Font::render(std::string text, glm::vec2 render_pos, glm::vec3 color) {
 
         render_coords.x += glyph_width;
     }
+}
 
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+// Detail levels and BVH or occlusion culling pick draws per object, which the static indirect commands can't.
+// The visibility buffer needs every draw to be an instance of its own.
+bool indirect_available() {
+	return indirect_supported && !use_lod && !use_bvh && occlusion_settings.selection == OCCLUDERS_NONE && shading_path != SHADING_VISIBILITY;
 }
 
 bool init() {
-	// Init SDL
-	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-		printf("Error initializing SDL: %s\n", SDL_GetError());
+	PROFILE_ZONE("init");
+
+	// Window or headless context, see platform.h
+	PROFILE_BEGIN("init_platform");
+	if (!platform_init(headless ? PLATFORM_HEADLESS : PLATFORM_WINDOWED, "gltf viewer", WINDOW_WIDTH, WINDOW_HEIGHT)) {
+		return false;
+	}
+	if (glGenVertexArrays == NULL) {
+		printf("Error loading OpenGL.\n");
 		return false;
 	}
 
@@ -404,32 +1396,14 @@ bool init() {
 		return false;
 	}
 
-	// Set GL version
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_LoadLibrary(NULL);
-
-	// Create SDL window 
-	window = SDL_CreateWindow("gltf viewer", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_OPENGL);
-	if (window == NULL) {
-		printf("Error creating window: %s\n", SDL_GetError());
-		return false;
-	}
-
-	// Create GL context
-	context = SDL_GL_CreateContext(window);
-	if (context == NULL) {
-		printf("Error creating GL context: %s\n", SDL_GetError());
-		return false;
-	}
-
-	// Setup GLAD
-	gladLoadGLLoader(SDL_GL_GetProcAddress);
-	if (glGenVertexArrays == NULL) {
-		printf("Error loading OpenGL.\n");
-		return false;
-	}
+	indirect_supported = GLAD_GL_VERSION_4_3 != 0;
+	use_indirect = indirect_available();
+	printf("OpenGL %d.%d, render path: %s\n", GLVersion.major, GLVersion.minor, use_indirect ? "multi-draw indirect" : "per-draw");
+	GLint max_color_samples = 0;
+	GLint max_depth_samples = 0;
+	glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &max_color_samples);
+	glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &max_depth_samples);
+	max_samples = (unsigned int)glm::max(glm::min(max_color_samples, max_depth_samples), 0);
 
 	// Set GL flags
 	glEnable(GL_DEPTH_TEST);
@@ -439,7 +1413,10 @@ bool init() {
 	// STB Image
 	stbi_set_flip_vertically_on_load(true);
 
+	PROFILE_END();
+
 	// Setup quad VAO
+	PROFILE_BEGIN("init_geometry");
 	float quad_vertices[] = {
 		// positions   // texCoords
 		-1.0f,  1.0f,  0.0f, 1.0f,
@@ -465,74 +1442,76 @@ bool init() {
 
 	glBindVertexArray(0);
 
-	// Setup sphere VAO
-	GLuint sphere_vbo;
-	GLuint sphere_ebo;
-	std::vector<float> data;
-	std::vector<unsigned int> indices;
-	const unsigned int X_SEGMENTS = 64;
-	const unsigned int Y_SEGMENTS = 64;
-	const float PI = 3.14159265359f;
-
-	// generate sphere positions, normals, and texture coordinates
-	for (unsigned int x = 0; x <= X_SEGMENTS; x++) {
-		for (unsigned int y = 0; y <= Y_SEGMENTS; y++) {
-			float x_segment = (float)x / (float)X_SEGMENTS;
-			float y_segment = (float)y / (float)Y_SEGMENTS;
-			float x_pos = std::cos(x_segment * 2.0f * PI) * std::sin(y_segment * PI);
-			float y_pos = std::cos(y_segment * PI);
-			float z_pos = std::sin(x_segment * 2.0f * PI) * std::sin(y_segment * PI);
-
-			// position
-			data.push_back(x_pos);
-			data.push_back(y_pos);
-			data.push_back(z_pos);
-			// normal
-			data.push_back(x_pos);
-			data.push_back(y_pos);
-			data.push_back(z_pos);
-			// texure coordinate
-			data.push_back(x_pos);
-			data.push_back(y_pos);
-		}
+	// Setup scene mesh buffer
+	std::vector<Vertex> sphere_vertices;
+	std::vector<unsigned int> sphere_indices;
+	mesh_generate_sphere(&sphere_vertices, &sphere_indices, sphere_segments, sphere_segments);
+	GLenum sphere_mode = GL_TRIANGLE_STRIP;
+	if (optimize_meshes) {
+		std::vector<unsigned int> strip_triangles;
+		mesh_triangle_list(GL_TRIANGLE_STRIP, sphere_indices, &strip_triangles);
+		MeshCacheStats before = mesh_analyze_vertex_cache(strip_triangles, (unsigned int)sphere_vertices.size(), MESH_CACHE_SIZE);
+		mesh_optimize(GL_TRIANGLE_STRIP, &sphere_vertices, &sphere_indices);
+		sphere_mode = GL_TRIANGLES;
+		MeshCacheStats after = mesh_analyze_vertex_cache(sphere_indices, (unsigned int)sphere_vertices.size(), MESH_CACHE_SIZE);
+		printf("Sphere vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
 	}
-
-	// generate sphere indices
-	bool odd_row = false;
-	for (unsigned int y = 0; y < Y_SEGMENTS; y++) {
-		if (!odd_row) {
-			for (unsigned int x = 0; x <= X_SEGMENTS; x++) {
-				indices.push_back(y * (X_SEGMENTS + 1) + x);
-				indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-			}
-		} else {
-			for (int x = X_SEGMENTS; x >= 0; x--) {
-				indices.push_back((y + 1) * (X_SEGMENTS + 1) + x);
-				indices.push_back(y * (X_SEGMENTS + 1) + x);
-			}
-		}
-		odd_row = !odd_row;
+	sphere_primitive = mesh_buffer_add(&mesh_buffer, sphere_mode, sphere_vertices, sphere_indices);
+	Uint64 lod_start = SDL_GetPerformanceCounter();
+	mesh_buffer_add_lods(&mesh_buffer, sphere_primitive, SIMPLIFY_DEFAULT_SETTINGS);
+	double lod_ms = (double)(SDL_GetPerformanceCounter() - lod_start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+	const MeshPrimitive& sphere = mesh_buffer.primitives[sphere_primitive];
+	printf("Sphere LODs in %.1f ms:", lod_ms);
+	for (unsigned int lod = 0; lod < sphere.lod_count; lod++) {
+		const MeshPrimitive& level = mesh_buffer.primitives[sphere.lods[lod]];
+		printf(" %u triangles (error %.4f)%s", mesh_triangle_count(level.mode, level.index_count), sphere.lod_errors[lod], lod + 1 < sphere.lod_count ? "," : "\n");
+	}
+	std::vector<Vertex> occluder_vertices;
+	std::vector<unsigned int> occluder_indices;
+	mesh_generate_sphere(&occluder_vertices, &occluder_indices, 16, 16);
+	std::vector<glm::vec3> occluder_positions;
+	for (const Vertex& vertex : occluder_vertices) {
+		occluder_positions.push_back(vertex.position);
+	}
+	occlusion_mesh_create(&sphere_occluder, occluder_positions, occluder_indices, true);
+	mesh_buffer_upload(&mesh_buffer, vertex_format);
+	printf("Vertex format: %s, %u bytes per vertex, %u bit indices\n", vertex_format.name, vertex_format.stride, mesh_index_size(mesh_buffer.index_type) * 8);
+	visibility_init(mesh_buffer);
+
+	scene_create_sphere_grid(&scene, sphere_primitive, scene_grid_size, scene_grid_size, 2.5f);
+	cull_bounds_clear(&scene_bounds);
+	for (const SceneObject& object : scene.objects) {
+		const MeshPrimitive& primitive = mesh_buffer.primitives[object.primitive];
+		// Assumes model matrices have no scale. The box is refit around the rotated local box.
+		glm::vec3 local_center = (primitive.bounds_min + primitive.bounds_max) * 0.5f;
+		glm::vec3 local_extent = (primitive.bounds_max - primitive.bounds_min) * 0.5f;
+		glm::mat3 rotation = glm::mat3(object.model);
+		glm::mat3 abs_rotation = glm::mat3(glm::abs(rotation[0]), glm::abs(rotation[1]), glm::abs(rotation[2]));
+		glm::vec3 center = glm::vec3(object.model * glm::vec4(local_center, 1.0f));
+		glm::vec3 extent = abs_rotation * local_extent;
+		cull_bounds_add(&scene_bounds, glm::vec3(object.model[3]), primitive.bounding_radius, center - extent, center + extent);
+		scene_box_min.push_back(center - extent);
+		scene_box_max.push_back(center + extent);
+	}
+	scene_visible.resize(scene.objects.size());
+	bvh_build(&scene_bvh, scene_box_min, scene_box_max, (unsigned int)glm::max(SDL_GetCPUCount(), 1));
+	printf("Scene BVH: %u nodes, depth %u, built in %.2f ms\n", (unsigned int)scene_bvh.nodes.size(), scene_bvh.depth, scene_bvh.build_ms);
+	// The grid is lit by the environment map, plus any lights spread in a row in front of it
+	float light_spacing = (float)scene_grid_size * 2.5f / (float)glm::max(scene_light_count, 1u);
+	for (unsigned int i = 0; i < scene_light_count; i++) {
+		float light_x = ((float)i - (float)(scene_light_count - 1) * 0.5f) * light_spacing;
+		scene_add_light(&scene, glm::vec3(light_x, 0.0f, -6.0f), glm::vec3(150.0f));
+	}
+	// Low enough across the grid that each sphere shadows the next one along
+	if (use_shadows) {
+		scene_set_sun(&scene, glm::radians(35.0f), glm::radians(105.0f), sun_speed, glm::vec3(5.0f, 4.75f, 4.3f));
+	}
+	float grid_half_extent = (float)scene_grid_size * 2.5f * 0.5f;
+	scene_spawn_lights(&scene, scene_cluster_light_count, glm::vec3(-grid_half_extent, -grid_half_extent, -3.0f), glm::vec3(grid_half_extent, grid_half_extent, 3.0f));
+	if (indirect_supported) {
+		indirect_init(mesh_buffer);
+		indirect_upload_scene(mesh_buffer, scene);
 	}
-	sphere_vao_index_count = (unsigned int)indices.size();
-
-	// generate buffers and buffer data
-	glGenVertexArrays(1, &sphere_vao);
-	glGenBuffers(1, &sphere_vbo);
-	glGenBuffers(1, &sphere_ebo);
-	glBindVertexArray(sphere_vao);
-	glBindBuffer(GL_ARRAY_BUFFER, sphere_vbo);
-	glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphere_ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-
-	glBindVertexArray(0);
 
 	// Setup cube vao
 	float cube_vertices[] = {
@@ -596,7 +1575,10 @@ bool init() {
 
 	glBindVertexArray(0);
 
+	PROFILE_END();
+
 	// Load sphere textures
+	PROFILE_BEGIN("init_textures");
 	if (!texture_load(&sphere_albedo, "./res/rustediron2_basecolor.png")) {
 		return false;
 	}
@@ -613,49 +1595,33 @@ bool init() {
 		return false;
 	}
 
-	// Setup screen framebuffer
-	glGenFramebuffers(1, &screen_framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, screen_framebuffer);
+	PROFILE_END();
 
-	glActiveTexture(GL_TEXTURE0);
-	glGenTextures(1, &screen_framebuffer_texture);
-	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, screen_framebuffer_texture);
-	glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, 4, GL_RGB, SCREEN_WIDTH, SCREEN_HEIGHT, GL_TRUE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, screen_framebuffer_texture, 0);
-	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
-
-	GLuint rbo;
-	glGenRenderbuffers(1, &rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-	glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_DEPTH24_STENCIL8, SCREEN_WIDTH, SCREEN_HEIGHT);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		printf("Error, framebuffer not complete.\n");
+	// Init shaders
+	PROFILE_BEGIN("init_shaders");
+	if (!shader_compile(&screen_shader, "./shader/screen_vs.glsl", "./shader/screen_fs.glsl")) {
 		return false;
 	}
-	
-	glGenFramebuffers(1, &screen_intermediate_framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, screen_intermediate_framebuffer);
-	glGenTextures(1, &screen_intermediate_framebuffer_texture);
-	glBindTexture(GL_TEXTURE_2D, screen_intermediate_framebuffer_texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCREEN_WIDTH, SCREEN_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, screen_intermediate_framebuffer_texture, 0);
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-		printf("Framebuffer not complete!\n");
+	if (!shader_compile(&fxaa_shader, "./shader/screen_vs.glsl", "./shader/fxaa_fs.glsl")) {
 		return false;
 	}
-
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	// Init shaders
-	if (!shader_compile(&screen_shader, "./shader/screen_vs.glsl", "./shader/screen_fs.glsl")) {
+	if (!shader_compile(&taa_shader, "./shader/screen_vs.glsl", "./shader/taa_fs.glsl")) {
 		return false;
 	}
+	if (!shader_compile(&easu_shader, "./shader/screen_vs.glsl", "./shader/easu_fs.glsl")) {
+		return false;
+	}
+	if (!shader_compile(&rcas_shader, "./shader/screen_vs.glsl", "./shader/rcas_fs.glsl")) {
+		return false;
+	}
+	upscale_programs.bilinear = screen_shader;
+	upscale_programs.easu = easu_shader;
+	upscale_programs.rcas = rcas_shader;
+	upscale_set_uniforms(upscale_programs);
+	glUseProgram(taa_shader);
+	glUniform1i(glGetUniformLocation(taa_shader, "scene_color"), 0);
+	glUniform1i(glGetUniformLocation(taa_shader, "scene_depth"), 1);
+	glUniform1i(glGetUniformLocation(taa_shader, "history"), 2);
 	if (!shader_compile(&text_shader, "./shader/text_vs.glsl", "./shader/text_fs.glsl")) {
 		return false;
 	}
@@ -665,15 +1631,58 @@ bool init() {
 	if (!shader_compile(&pbr_shader, "./shader/pbr_vs.glsl", "./shader/pbr_fs.glsl")) {
 		return false;
 	}
-	glUseProgram(pbr_shader);
-	glUniform1i(glGetUniformLocation(pbr_shader, "albedo_map"), 0);
-	glUniform1i(glGetUniformLocation(pbr_shader, "normal_map"), 1);
-	glUniform1i(glGetUniformLocation(pbr_shader, "metallic_map"), 2);
-	glUniform1i(glGetUniformLocation(pbr_shader, "roughness_map"), 3);
-	glUniform1i(glGetUniformLocation(pbr_shader, "ao_map"), 4);
-	glUniform1i(glGetUniformLocation(pbr_shader, "irradiance_map"), 5);
-	glUniform1i(glGetUniformLocation(pbr_shader, "prefilter_map"), 6);
-	glUniform1i(glGetUniformLocation(pbr_shader, "brdf_lookup_texture"), 7);
+	if (!shader_compile(&depth_shader, "./shader/depth_vs.glsl", "./shader/depth_fs.glsl")) {
+		return false;
+	}
+	if (!shader_compile(&light_depth_shader, "./shader/light_vs.glsl", "./shader/depth_fs.glsl")) {
+		return false;
+	}
+	if (!shader_compile(&gbuffer_shader, "./shader/pbr_vs.glsl", "./shader/gbuffer_fs.glsl")) {
+		return false;
+	}
+	if (!shader_compile(&deferred_shader, "./shader/screen_vs.glsl", "./shader/deferred_fs.glsl")) {
+		return false;
+	}
+	if (!shader_compile(&visibility_shader, "./shader/depth_vs.glsl", "./shader/visibility_fs.glsl")) {
+		return false;
+	}
+	if (!shader_compile(&visibility_resolve_shader, "./shader/screen_vs.glsl", "./shader/visibility_resolve_fs.glsl")) {
+		return false;
+	}
+	// The G-buffer and lighting shaders split the PBR shader's inputs between them, units are shared
+	GLuint pbr_shaders[] = { pbr_shader, gbuffer_shader, deferred_shader, visibility_resolve_shader };
+	for (GLuint shader : pbr_shaders) {
+		glUseProgram(shader);
+		glUniform1i(glGetUniformLocation(shader, "albedo_map"), 0);
+		glUniform1i(glGetUniformLocation(shader, "normal_map"), 1);
+		glUniform1i(glGetUniformLocation(shader, "metallic_map"), 2);
+		glUniform1i(glGetUniformLocation(shader, "roughness_map"), 3);
+		glUniform1i(glGetUniformLocation(shader, "ao_map"), 4);
+		glUniform1i(glGetUniformLocation(shader, "irradiance_map"), 5);
+		glUniform1i(glGetUniformLocation(shader, "prefilter_map"), 6);
+		glUniform1i(glGetUniformLocation(shader, "brdf_lookup_texture"), 7);
+		glUniform1i(glGetUniformLocation(shader, "use_material_maps"), 0);
+	}
+	glUseProgram(deferred_shader);
+	glUniform1i(glGetUniformLocation(deferred_shader, "gbuffer_albedo"), 0);
+	glUniform1i(glGetUniformLocation(deferred_shader, "gbuffer_normal"), 1);
+	glUniform1i(glGetUniformLocation(deferred_shader, "gbuffer_depth"), 2);
+
+	if (indirect_supported) {
+		if (!shader_compile(&pbr_indirect_shader, "./shader/pbr_indirect_vs.glsl", "./shader/pbr_indirect_fs.glsl")) {
+			return false;
+		}
+		glUseProgram(pbr_indirect_shader);
+		glUniform1i(glGetUniformLocation(pbr_indirect_shader, "irradiance_map"), 5);
+		glUniform1i(glGetUniformLocation(pbr_indirect_shader, "prefilter_map"), 6);
+		glUniform1i(glGetUniformLocation(pbr_indirect_shader, "brdf_lookup_texture"), 7);
+		if (!shader_compile(&depth_indirect_shader, "./shader/depth_indirect_vs.glsl", "./shader/depth_fs.glsl")) {
+			return false;
+		}
+		if (!shader_compile(&gbuffer_indirect_shader, "./shader/pbr_indirect_vs.glsl", "./shader/gbuffer_indirect_fs.glsl")) {
+			return false;
+		}
+	}
 
 	if (!shader_compile(&cubemap_shader, "./shader/cubemap_vs.glsl", "./shader/cubemap_fs.glsl")) {
 		return false;
@@ -703,12 +1712,71 @@ bool init() {
 		return false;
 	}
 
-	// Load HDR texture
-	if (!texture_hdr_load(&skybox_texture, &irradiance_map, &prefilter_map, &brdf_lookup_texture, "./res/small_room_8k.hdr")) {
+	PROFILE_END();
+
+	// Load HDR texture, timing the bake passes
+	PROFILE_BEGIN("init_environment");
+	gpu_timer_init();
+	depth_prepass_init(&depth_prepass, depth_prepass_mode);
+	gpu_timer_begin("environment_bake");
+	if (!texture_hdr_load(&skybox_texture, &irradiance_map, &prefilter_map, &brdf_lookup_texture, "./res/small_room_8k.hdr", environment_size)) {
 		return false;
 	}
+	gpu_timer_end();
+	gpu_timer_flush();
+	std::vector<GpuTimerZoneStats> bake_timings;
+	gpu_timer_get_stats(&bake_timings);
+	for (const GpuTimerZoneStats& zone : bake_timings) {
+		printf("%*s%s: %.2f ms\n", zone.depth * 2, "", zone.name.c_str(), zone.last);
+	}
+
+	PROFILE_END();
+
+	// Setup render queue
+	PROFILE_BEGIN("init_render_queue");
+	render_queue.materials = &scene.materials;
+	pbr_queue_program = render_queue_add_program(&render_queue, pbr_shader);
+	if (indirect_supported) {
+		pbr_indirect_queue_program = render_queue_add_program(&render_queue, pbr_indirect_shader);
+	}
+	light_queue_program = render_queue_add_program(&render_queue, light_shader);
+	depth_queue_program = render_queue_add_program(&render_queue, depth_shader);
+	render_queue_set_depth_program(&render_queue, pbr_queue_program, depth_queue_program);
+	light_depth_queue_program = render_queue_add_program(&render_queue, light_depth_shader);
+	render_queue_set_depth_program(&render_queue, light_queue_program, light_depth_queue_program);
+	if (indirect_supported) {
+		depth_indirect_queue_program = render_queue_add_program(&render_queue, depth_indirect_shader);
+		render_queue_set_depth_program(&render_queue, pbr_indirect_queue_program, depth_indirect_queue_program);
+		gbuffer_indirect_queue_program = render_queue_add_program(&render_queue, gbuffer_indirect_shader);
+		render_queue_set_gbuffer_program(&render_queue, pbr_indirect_queue_program, gbuffer_indirect_queue_program);
+	}
+	gbuffer_queue_program = render_queue_add_program(&render_queue, gbuffer_shader);
+	render_queue_set_gbuffer_program(&render_queue, pbr_queue_program, gbuffer_queue_program);
+	visibility_queue_program = render_queue_add_program(&render_queue, visibility_shader);
+	render_queue_set_visibility_program(&render_queue, pbr_queue_program, visibility_queue_program);
+	render_queue.visibility_capacity = visibility_max_instances();
+	skybox_queue_program = render_queue_add_program(&render_queue, skybox_shader);
+
+	RenderTextureSet scene_textures;
+	scene_textures.count = 8;
+	GLenum scene_texture_targets[] = { GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D };
+	GLuint scene_texture_ids[] = { sphere_albedo, sphere_normal, sphere_metallic, sphere_roughness, sphere_ao, irradiance_map, prefilter_map, brdf_lookup_texture };
+	for (unsigned int i = 0; i < scene_textures.count; i++) {
+		scene_textures.targets[i] = scene_texture_targets[i];
+		scene_textures.textures[i] = scene_texture_ids[i];
+	}
+	scene_texture_set = render_queue_add_texture_set(&render_queue, scene_textures);
+
+	RenderTextureSet skybox_textures;
+	skybox_textures.count = 1;
+	skybox_textures.targets[0] = GL_TEXTURE_CUBE_MAP;
+	skybox_textures.textures[0] = skybox_texture;
+	skybox_texture_set = render_queue_add_texture_set(&render_queue, skybox_textures);
+
+	PROFILE_END();
 
 	// Buffer glyph vertex data
+	PROFILE_BEGIN("init_font");
 	float glyph_vertices[12] = {
 		0.0f, 0.0f,
 		1.0f, 0.0f,
@@ -732,7 +1800,7 @@ bool init() {
 
 	// Setup font shader
 	glUseProgram(text_shader);
-	float screen_size[2] = { SCREEN_WIDTH, SCREEN_HEIGHT };
+	float screen_size[2] = { (float)WINDOW_WIDTH, (float)WINDOW_HEIGHT };
 	glUniform2fv(glGetUniformLocation(text_shader, "screen_size"), 1, &screen_size[0]);
 	glUniform1ui(glGetUniformLocation(text_shader, "u_texture"), 0);
 
@@ -741,9 +1809,13 @@ bool init() {
 		return false;
 	}
 
+	PROFILE_END();
+
+	// Everything above bound GL objects directly, so start the state cache from scratch
+	gl_state_invalidate();
+
 	// Init timekeep values
-	last_time = SDL_GetTicks();
-	last_second = last_time;
+	frame_pacer_init(&frame_pacer, headless ? FRAME_PACING_UNCAPPED : FRAME_PACING_LIMITED, TARGET_FPS);
 	running = true;
 
 	return true;
@@ -752,64 +1824,50 @@ bool init() {
 void quit() {
 	TTF_Quit();
 	IMG_Quit();
-	SDL_DestroyWindow(window);
-	SDL_Quit();
+	platform_quit();
 }
 
-void render_prepare_framebuffer() {
-	// Prepare framebuffer for rendering
-	glBindFramebuffer(GL_FRAMEBUFFER, screen_framebuffer);
-	glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-	glBlendFunc(GL_ONE, GL_ZERO);
-	glEnable(GL_DEPTH_TEST);
-	glClearColor(0.05f, 0.05f, 0.05f, 0.05f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+// The CPU modules' worker threads, started before anything else so the CPU benchmarks can run without GL
+void quit_workers() {
+	cull_quit();
+	occlusion_quit();
+	light_cluster_quit();
 }
 
-void render_flip_framebuffer() {
-	// Blit multisample buffer to intermediate buffer
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, screen_framebuffer);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, screen_intermediate_framebuffer);
-	glBlitFramebuffer(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-
-	// Render framebuffer to screen
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
-	glBlendFunc(GL_ONE, GL_ZERO);
-	glDisable(GL_DEPTH_TEST);
-	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
-
-	glUseProgram(screen_shader);
-	glBindVertexArray(quad_vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, screen_intermediate_framebuffer_texture);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glBindVertexArray(0);
-
-	// Render fps
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	font_hack10.render("FPS: " + std::to_string(fps), glm::vec2(0.0f), glm::vec3(1.0f));
+// Reads a shader file, splicing in any #include "file" lines from the shader directory
+bool shader_read_source(const char* path, std::string* source) {
+	std::ifstream file;
+	std::string line;
+	file.open(path);
+	if (!file.is_open()) {
+		return false;
+	}
+	while (std::getline(file, line)) {
+		if (line.rfind("#include", 0) == 0) {
+			size_t path_start = line.find('"') + 1;
+			size_t path_end = line.rfind('"');
+			std::string include_path = "./shader/" + line.substr(path_start, path_end - path_start);
+			if (!shader_read_source(include_path.c_str(), source)) {
+				printf("Error opening shader include at path %s\n", include_path.c_str());
+				return false;
+			}
+			continue;
+		}
+		*source += line + "\n";
+	}
+	file.close();
 
-	// Swap window
-	SDL_GL_SwapWindow(window);
-	frames++;
+	return true;
 }
 
 bool shader_compile(GLuint* id, const char* vertex_path, const char* fragment_path) {
+	PROFILE_ZONE("shader_compile");
 	// Read vertex shader
 	std::string vertex_source;
-	std::ifstream vertex_file;
-	std::string line;
-	vertex_file.open(vertex_path);
-	if (!vertex_file.is_open()) {
+	if (!shader_read_source(vertex_path, &vertex_source)) {
 		printf("Error opening vertex shader at path %s\n", vertex_path);
 		return false;
 	}
-	while (std::getline(vertex_file, line)) {
-		vertex_source += line + "\n";
-	}
-	vertex_file.close();
 
 	// Compile vertex shader
 	int success;
@@ -827,16 +1885,10 @@ bool shader_compile(GLuint* id, const char* vertex_path, const char* fragment_pa
 
 	// Read fragment shader
 	std::string fragment_source;
-	std::ifstream fragment_file;
-	fragment_file.open(fragment_path);
-	if (!fragment_file.is_open()) {
+	if (!shader_read_source(fragment_path, &fragment_source)) {
 		printf("Error opening fragment shader at path %s\n", fragment_path);
 		return false;
 	}
-	while (std::getline(fragment_file, line)) {
-		fragment_source += line + "\n";
-	}
-	fragment_file.close();
 
 	// Compile fragment shader
 	GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
@@ -870,6 +1922,7 @@ bool shader_compile(GLuint* id, const char* vertex_path, const char* fragment_pa
 }
 
 bool texture_load(GLuint* texture, std::string path) {
+	PROFILE_ZONE("texture_load");
 	SDL_Surface* texture_surface = IMG_Load(path.c_str());
 	if (texture_surface == NULL) {
 		printf("Unable to load model texture at path %s: %s\n", path.c_str(), IMG_GetError());
@@ -906,7 +1959,8 @@ bool texture_load(GLuint* texture, std::string path) {
 	return true;
 }
 
-bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* prefilter_map, GLuint* brdf_lookup_texture, std::string path) {
+bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* prefilter_map, GLuint* brdf_lookup_texture, std::string path, unsigned int cubemap_size) {
+	PROFILE_ZONE("texture_hdr_load");
 	// Load file
 	int width, height, number_of_components;
 	float* data = stbi_loadf(path.c_str(), &width, &height, &number_of_components, 0);
@@ -934,7 +1988,7 @@ bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* pr
 	glGenRenderbuffers(1, &capture_rbo);
 	glBindFramebuffer(GL_FRAMEBUFFER, capture_fbo);
 	glBindRenderbuffer(GL_RENDERBUFFER, capture_rbo);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, cubemap_size, cubemap_size);
 	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, capture_rbo);
 
 	// Initialize projection and view matrices
@@ -952,7 +2006,7 @@ bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* pr
 	glGenTextures(1, skybox_texture);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, *skybox_texture);
 	for (unsigned int i = 0; i < 6; i++) {
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 512, 512, 0, GL_RGB, GL_FLOAT, NULL);
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, cubemap_size, cubemap_size, 0, GL_RGB, GL_FLOAT, NULL);
 	}
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -961,8 +2015,9 @@ bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* pr
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 	// Render HDR texture onto skybox texture
+	gpu_timer_begin("equirect_to_cubemap");
 	glUseProgram(cubemap_shader);
-	glViewport(0, 0, 512, 512);
+	glViewport(0, 0, cubemap_size, cubemap_size);
 	glBindVertexArray(cube_vao);
 	glBindTexture(GL_TEXTURE_2D, hdr_texture);
 	for (unsigned int i = 0; i < 6; i++) {
@@ -975,6 +2030,7 @@ bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* pr
 	}
 	glBindTexture(GL_TEXTURE_CUBE_MAP, *skybox_texture);
 	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+	gpu_timer_end();
 	
 	// Setup irradiance cubemap
 	glGenTextures(1, irradiance_map);
@@ -989,6 +2045,7 @@ bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* pr
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 	// Render HDR texture onto irradiance map
+	gpu_timer_begin("irradiance");
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 32, 32);
 	glUseProgram(irradiance_map_shader);
 	glViewport(0, 0, 32, 32);
@@ -1001,12 +2058,14 @@ bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* pr
 
 		glDrawArrays(GL_TRIANGLES, 0, 36);
 	}
+	gpu_timer_end();
 
-	// Setup prefilter map
+	// Setup prefilter map, a quarter of the skybox size
+	unsigned int prefilter_size = glm::max(cubemap_size / 4, 32u);
 	glGenTextures(1, prefilter_map);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, *prefilter_map);
 	for (unsigned int i = 0; i < 6; i++) {
-		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, 128, 128, 0, GL_RGB, GL_FLOAT, NULL);
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB16F, prefilter_size, prefilter_size, 0, GL_RGB, GL_FLOAT, NULL);
 	}
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -1016,13 +2075,14 @@ bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* pr
 	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 
 	// Capture the prefilter mipmap levels
+	gpu_timer_begin("prefilter");
 	glUseProgram(prefilter_shader);
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, *skybox_texture);
 	unsigned int max_mip_levels = 5;
 	for (unsigned int mip = 0; mip < max_mip_levels; mip++) {
-		unsigned int mip_width = 128 * std::pow(0.5, mip);
-		unsigned int mip_height = 128 * std::pow(0.5, mip);
+		unsigned int mip_width = prefilter_size * std::pow(0.5, mip);
+		unsigned int mip_height = prefilter_size * std::pow(0.5, mip);
 		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mip_width, mip_height);
 		glViewport(0, 0, mip_width, mip_height);
 
@@ -1037,6 +2097,7 @@ bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* pr
 			glDrawArrays(GL_TRIANGLES, 0, 36);
 		}
 	}
+	gpu_timer_end();
 
 	// Generate BRDF lookup texture
 	glGenTextures(1, brdf_lookup_texture);
@@ -1049,10 +2110,12 @@ bool texture_hdr_load(GLuint* skybox_texture, GLuint* irradiance_map, GLuint* pr
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, 512, 512);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *brdf_lookup_texture, 0);
 	glViewport(0, 0, 512, 512);
+	gpu_timer_begin("brdf_lut");
 	glUseProgram(brdf_shader);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glBindVertexArray(quad_vao);
 	glDrawArrays(GL_TRIANGLES, 0, 6);
+	gpu_timer_end();
 
 	glBindVertexArray(0);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -0,0 +1,175 @@
+#include "mesh.h"
+
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+unsigned int mesh_buffer_add(MeshBuffer* buffer, GLenum mode, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+	MeshPrimitive primitive;
+	primitive.mode = mode;
+	primitive.first_index = (unsigned int)buffer->indices.size();
+	primitive.index_count = (unsigned int)indices.size();
+	primitive.base_vertex = (int)buffer->vertices.size();
+	primitive.vertex_count = (unsigned int)vertices.size();
+	primitive.bounding_radius = 0.0f;
+	primitive.bounds_min = vertices.empty() ? glm::vec3(0.0f) : vertices[0].position;
+	primitive.bounds_max = primitive.bounds_min;
+	for (const Vertex& vertex : vertices) {
+		primitive.bounding_radius = glm::max(primitive.bounding_radius, glm::length(vertex.position));
+		primitive.bounds_min = glm::min(primitive.bounds_min, vertex.position);
+		primitive.bounds_max = glm::max(primitive.bounds_max, vertex.position);
+	}
+	primitive.lod_count = 1;
+	primitive.lods[0] = (unsigned int)buffer->primitives.size();
+	primitive.lod_errors[0] = 0.0f;
+
+	buffer->vertices.insert(buffer->vertices.end(), vertices.begin(), vertices.end());
+	buffer->indices.insert(buffer->indices.end(), indices.begin(), indices.end());
+	buffer->primitives.push_back(primitive);
+
+	return (unsigned int)(buffer->primitives.size() - 1);
+}
+
+// Quantized positions are relative to the bounds of the whole buffer, which every primitive shares
+void mesh_buffer_upload(MeshBuffer* buffer, const VertexFormat& format) {
+	buffer->format = format;
+	buffer->position_offset = glm::vec3(0.0f);
+	buffer->position_scale = glm::vec3(1.0f);
+	if (format.position.encoding != VERTEX_ENCODING_FLOAT && !buffer->vertices.empty()) {
+		glm::vec3 bounds_min = buffer->vertices[0].position;
+		glm::vec3 bounds_max = bounds_min;
+		for (const Vertex& vertex : buffer->vertices) {
+			bounds_min = glm::min(bounds_min, vertex.position);
+			bounds_max = glm::max(bounds_max, vertex.position);
+		}
+		buffer->position_offset = bounds_min;
+		buffer->position_scale = glm::max(bounds_max - bounds_min, glm::vec3(1e-6f));
+	}
+	buffer->index_type = GL_UNSIGNED_SHORT;
+	for (const MeshPrimitive& primitive : buffer->primitives) {
+		if (primitive.vertex_count > 65536) {
+			buffer->index_type = GL_UNSIGNED_INT;
+		}
+	}
+	std::vector<uint8_t> vertex_data;
+	vertex_format_encode(format, buffer->vertices.data(), buffer->vertices.size(), buffer->position_offset, buffer->position_scale, &vertex_data);
+
+	glGenVertexArrays(1, &buffer->vao);
+	glGenBuffers(1, &buffer->vbo);
+	glGenBuffers(1, &buffer->ebo);
+	glBindVertexArray(buffer->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer->vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertex_data.size(), vertex_data.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer->ebo);
+	if (buffer->index_type == GL_UNSIGNED_SHORT) {
+		std::vector<uint16_t> short_indices(buffer->indices.begin(), buffer->indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, short_indices.size() * sizeof(uint16_t), short_indices.data(), GL_STATIC_DRAW);
+	} else {
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, buffer->indices.size() * sizeof(unsigned int), &buffer->indices[0], GL_STATIC_DRAW);
+	}
+	vertex_format_apply(format);
+
+	glBindVertexArray(0);
+}
+
+unsigned int mesh_index_size(GLenum index_type) {
+	return index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+}
+
+// Expects the program to be in use
+void mesh_buffer_set_decode_uniforms(const MeshBuffer& buffer, GLuint program) {
+	glUniform3fv(glGetUniformLocation(program, "position_offset"), 1, &buffer.position_offset[0]);
+	glUniform3fv(glGetUniformLocation(program, "position_scale"), 1, &buffer.position_scale[0]);
+	glUniform1i(glGetUniformLocation(program, "octahedral_normals"), buffer.format.normal.encoding == VERTEX_ENCODING_OCTAHEDRAL_SNORM16);
+}
+
+// Assumes buffer.vao is already bound
+void mesh_buffer_draw(const MeshBuffer& buffer, unsigned int primitive) {
+	const MeshPrimitive& mesh_primitive = buffer.primitives[primitive];
+	glDrawElementsBaseVertex(mesh_primitive.mode, mesh_primitive.index_count, buffer.index_type, (void*)(uintptr_t)(mesh_primitive.first_index * mesh_index_size(buffer.index_type)), mesh_primitive.base_vertex);
+}
+
+unsigned int mesh_triangle_count(GLenum mode, unsigned int vertex_count) {
+	if (mode == GL_TRIANGLES) {
+		return vertex_count / 3;
+	} else if ((mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN) && vertex_count >= 3) {
+		return vertex_count - 2;
+	}
+	return 0;
+}
+
+void mesh_triangle_list(GLenum mode, const std::vector<unsigned int>& indices, std::vector<unsigned int>* triangles) {
+	triangles->clear();
+	bool strip = mode == GL_TRIANGLE_STRIP;
+	for (size_t i = 2; i < indices.size(); i += strip ? 1 : 3) {
+		unsigned int a = indices[i - 2];
+		unsigned int b = indices[i - 1];
+		unsigned int c = indices[i];
+		// Degenerate triangles join the strip's rows
+		if (a == b || b == c || a == c) {
+			continue;
+		}
+		// Every other strip triangle is wound the other way
+		if (strip && i % 2 == 1) {
+			std::swap(a, b);
+		}
+		triangles->push_back(a);
+		triangles->push_back(b);
+		triangles->push_back(c);
+	}
+}
+
+unsigned int mesh_select_lod(const MeshPrimitive& primitive, float distance, float pixels_per_unit, float max_pixels, float fade_band, float* fade) {
+	*fade = 0.0f;
+	float pixels_per_error = pixels_per_unit / glm::max(distance, 0.001f);
+	unsigned int lod = 0;
+	while (lod + 1 < primitive.lod_count && primitive.lod_errors[lod + 1] * pixels_per_error <= max_pixels) {
+		lod++;
+	}
+	// Start fading to the next level once its error is within the band of being acceptable
+	if (fade_band > 0.0f && lod + 1 < primitive.lod_count) {
+		float acceptable = max_pixels / (primitive.lod_errors[lod + 1] * pixels_per_error);
+		*fade = glm::clamp((acceptable - (1.0f - fade_band)) / fade_band, 0.0f, 1.0f);
+	}
+
+	return lod;
+}
+
+// Generates a UV sphere as a serpentine triangle strip
+void mesh_generate_sphere(std::vector<Vertex>* vertices, std::vector<unsigned int>* indices, unsigned int x_segments, unsigned int y_segments) {
+	const float PI = 3.14159265359f;
+
+	// generate sphere positions, normals, and texture coordinates
+	for (unsigned int x = 0; x <= x_segments; x++) {
+		for (unsigned int y = 0; y <= y_segments; y++) {
+			float x_segment = (float)x / (float)x_segments;
+			float y_segment = (float)y / (float)y_segments;
+			float x_pos = std::cos(x_segment * 2.0f * PI) * std::sin(y_segment * PI);
+			float y_pos = std::cos(y_segment * PI);
+			float z_pos = std::sin(x_segment * 2.0f * PI) * std::sin(y_segment * PI);
+
+			Vertex vertex;
+			vertex.position = glm::vec3(x_pos, y_pos, z_pos);
+			vertex.normal = glm::vec3(x_pos, y_pos, z_pos);
+			vertex.texture_coordinates = glm::vec2(x_segment, y_segment);
+			vertices->push_back(vertex);
+		}
+	}
+
+	// generate sphere indices
+	bool odd_row = false;
+	for (unsigned int y = 0; y < y_segments; y++) {
+		if (!odd_row) {
+			for (unsigned int x = 0; x <= x_segments; x++) {
+				indices->push_back(y * (x_segments + 1) + x);
+				indices->push_back((y + 1) * (x_segments + 1) + x);
+			}
+		} else {
+			for (int x = x_segments; x >= 0; x--) {
+				indices->push_back((y + 1) * (x_segments + 1) + x);
+				indices->push_back(y * (x_segments + 1) + x);
+			}
+		}
+		odd_row = !odd_row;
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "vertex_format.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Vertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texture_coordinates;
+};
+
+const unsigned int MESH_MAX_LODS = 6;
+
+// A range of the shared index buffer that makes up one drawable primitive
+struct MeshPrimitive {
+	GLenum mode;
+	unsigned int first_index;
+	unsigned int index_count;
+	int base_vertex;
+	unsigned int vertex_count;
+	// Bounding sphere centered on the primitive's local origin
+	float bounding_radius;
+	glm::vec3 bounds_min;
+	glm::vec3 bounds_max;
+	// Detail levels from finest to coarsest, lods[0] is this primitive. Coarser levels are primitives of their own
+	// sharing its vertices, see mesh_simplify.h.
+	unsigned int lod_count;
+	unsigned int lods[MESH_MAX_LODS];
+	// Model space error of each level, 0 for the full detail one
+	float lod_errors[MESH_MAX_LODS];
+};
+
+// Every primitive lives in one shared vertex and index buffer so the whole scene can be drawn from a single VAO
+struct MeshBuffer {
+	GLuint vao;
+	GLuint vbo;
+	GLuint ebo;
+	// GPU side layout, and how quantized positions map back to model space
+	VertexFormat format;
+	glm::vec3 position_offset;
+	glm::vec3 position_scale;
+	// Indices are relative to each primitive's base vertex, so they fit in 16 bits unless a primitive has more
+	// than 65536 vertices
+	GLenum index_type;
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<MeshPrimitive> primitives;
+};
+
+unsigned int mesh_buffer_add(MeshBuffer* buffer, GLenum mode, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+void mesh_buffer_upload(MeshBuffer* buffer, const VertexFormat& format);
+unsigned int mesh_index_size(GLenum index_type);
+// Points a program using vertex_decode.glsl at the buffer's format
+void mesh_buffer_set_decode_uniforms(const MeshBuffer& buffer, GLuint program);
+void mesh_buffer_draw(const MeshBuffer& buffer, unsigned int primitive);
+// Triangles submitted by drawing this many vertices, counting the degenerate ones that join strips
+unsigned int mesh_triangle_count(GLenum mode, unsigned int vertex_count);
+// Converts GL_TRIANGLES or GL_TRIANGLE_STRIP indices to a triangle list, dropping degenerate triangles. Strip
+// triangles keep facing the same way.
+void mesh_triangle_list(GLenum mode, const std::vector<unsigned int>& indices, std::vector<unsigned int>* triangles);
+// Index into primitive.lods of the coarsest level whose error spans at most max_pixels on screen. pixels_per_unit
+// is projection[1][1] * viewport height / 2, the pixels one unit covers at a distance of 1. When fade_band is above
+// 0, fade is how far the primitive is through a dithered switch to the next coarser level, otherwise it is 0.
+unsigned int mesh_select_lod(const MeshPrimitive& primitive, float distance, float pixels_per_unit, float max_pixels, float fade_band, float* fade);
+void mesh_generate_sphere(std::vector<Vertex>* vertices, std::vector<unsigned int>* indices, unsigned int x_segments, unsigned int y_segments);
@@ -0,0 +1,224 @@
+#include "mesh_optimize.h"
+
+#include <algorithm>
+
+// A soft cluster ends once its miss ratio, counted from a cold cache, is within this factor of the whole mesh's
+static const float CLUSTER_ACMR_THRESHOLD = 1.05f;
+
+MeshCacheStats mesh_analyze_vertex_cache(const std::vector<unsigned int>& triangles, unsigned int vertex_count, unsigned int cache_size) {
+	// A vertex is cached while fewer than cache_size misses have happened since it was last loaded
+	std::vector<unsigned int> loaded_at(vertex_count, 0);
+	unsigned int misses = 0;
+	for (unsigned int index : triangles) {
+		if (loaded_at[index] == 0 || misses - loaded_at[index] + 1 > cache_size) {
+			misses++;
+			loaded_at[index] = misses;
+		}
+	}
+
+	MeshCacheStats stats;
+	unsigned int triangle_count = (unsigned int)triangles.size() / 3;
+	stats.acmr = triangle_count == 0 ? 0.0f : (float)misses / (float)triangle_count;
+	stats.atvr = vertex_count == 0 ? 0.0f : (float)misses / (float)vertex_count;
+	return stats;
+}
+
+void mesh_optimize_vertex_cache(const std::vector<unsigned int>& triangles, unsigned int vertex_count, unsigned int cache_size, std::vector<unsigned int>* result, std::vector<unsigned int>* clusters) {
+	unsigned int triangle_count = (unsigned int)triangles.size() / 3;
+	result->clear();
+	clusters->clear();
+	if (triangle_count == 0) {
+		return;
+	}
+
+	// Triangles around each vertex, packed with an offset per vertex
+	std::vector<unsigned int> live(vertex_count, 0);
+	for (unsigned int index : triangles) {
+		live[index]++;
+	}
+	std::vector<unsigned int> offsets(vertex_count + 1, 0);
+	for (unsigned int vertex = 0; vertex < vertex_count; vertex++) {
+		offsets[vertex + 1] = offsets[vertex] + live[vertex];
+	}
+	std::vector<unsigned int> adjacency(triangles.size());
+	std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+	for (unsigned int t = 0; t < triangle_count; t++) {
+		for (int corner = 0; corner < 3; corner++) {
+			adjacency[fill[triangles[t * 3 + corner]]++] = t;
+		}
+	}
+
+	// Tipsify. Fans out every remaining triangle around the current vertex, then moves to the candidate that will
+	// still be cached after its own remaining triangles are emitted, preferring the oldest. With none, it falls back
+	// to recently used vertices on a dead end stack, then to the next vertex in input order.
+	std::vector<unsigned int> cache_time(vertex_count, 0);
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<unsigned int> dead_end;
+	std::vector<unsigned int> candidates;
+	std::vector<bool> hard_boundary;
+	unsigned int time = cache_size + 1;
+	unsigned int cursor = 0;
+	int fanning = 0;
+	bool jumped = true;
+	while (fanning >= 0) {
+		candidates.clear();
+		for (unsigned int i = offsets[fanning]; i < offsets[fanning + 1]; i++) {
+			unsigned int t = adjacency[i];
+			if (emitted[t]) {
+				continue;
+			}
+			for (int corner = 0; corner < 3; corner++) {
+				unsigned int vertex = triangles[t * 3 + corner];
+				result->push_back(vertex);
+				dead_end.push_back(vertex);
+				candidates.push_back(vertex);
+				live[vertex]--;
+				if (time - cache_time[vertex] > cache_size) {
+					cache_time[vertex] = time;
+					time++;
+				}
+			}
+			emitted[t] = true;
+			hard_boundary.push_back(jumped);
+			jumped = false;
+		}
+
+		int next = -1;
+		int best_priority = -1;
+		for (unsigned int vertex : candidates) {
+			if (live[vertex] == 0) {
+				continue;
+			}
+			int priority = 0;
+			if (time - cache_time[vertex] + 2 * live[vertex] <= cache_size) {
+				priority = (int)(time - cache_time[vertex]);
+			}
+			if (priority > best_priority) {
+				best_priority = priority;
+				next = (int)vertex;
+			}
+		}
+		if (next == -1) {
+			jumped = true;
+			while (!dead_end.empty() && next == -1) {
+				unsigned int vertex = dead_end.back();
+				dead_end.pop_back();
+				if (live[vertex] > 0) {
+					next = (int)vertex;
+				}
+			}
+			while (next == -1 && cursor < vertex_count) {
+				if (live[cursor] > 0) {
+					next = (int)cursor;
+				}
+				cursor++;
+			}
+		}
+		fanning = next;
+	}
+
+	// Cut clusters at the jumps, and within a run wherever the cold start has been paid off
+	MeshCacheStats stats = mesh_analyze_vertex_cache(*result, vertex_count, cache_size);
+	float cluster_limit = stats.acmr * CLUSTER_ACMR_THRESHOLD;
+	std::vector<unsigned int> loaded_at(vertex_count, 0);
+	unsigned int misses = 0;
+	unsigned int cluster_start_misses = 0;
+	unsigned int cluster_start = 0;
+	for (unsigned int t = 0; t < triangle_count; t++) {
+		bool ended = t > cluster_start && (float)(misses - cluster_start_misses) <= cluster_limit * (float)(t - cluster_start);
+		if (t == 0 || hard_boundary[t] || ended) {
+			clusters->push_back(t);
+			cluster_start = t;
+			cluster_start_misses = misses;
+		}
+		// Counted from a cold cache, so vertices loaded before the cluster started miss again
+		for (int corner = 0; corner < 3; corner++) {
+			unsigned int vertex = (*result)[t * 3 + corner];
+			if (loaded_at[vertex] <= cluster_start_misses || misses - loaded_at[vertex] + 1 > cache_size) {
+				misses++;
+				loaded_at[vertex] = misses;
+			}
+		}
+	}
+}
+
+void mesh_optimize_overdraw(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& clusters, std::vector<unsigned int>* triangles) {
+	unsigned int triangle_count = (unsigned int)triangles->size() / 3;
+	if (clusters.size() < 2) {
+		return;
+	}
+
+	glm::vec3 mesh_center = glm::vec3(0.0f);
+	float mesh_area = 0.0f;
+	std::vector<glm::vec3> cluster_centers(clusters.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> cluster_normals(clusters.size(), glm::vec3(0.0f));
+	std::vector<float> cluster_areas(clusters.size(), 0.0f);
+	for (size_t cluster = 0; cluster < clusters.size(); cluster++) {
+		unsigned int end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangle_count;
+		for (unsigned int t = clusters[cluster]; t < end; t++) {
+			glm::vec3 a = vertices[(*triangles)[t * 3]].position;
+			glm::vec3 b = vertices[(*triangles)[t * 3 + 1]].position;
+			glm::vec3 c = vertices[(*triangles)[t * 3 + 2]].position;
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			float area = glm::length(normal);
+			glm::vec3 center = (a + b + c) / 3.0f;
+			cluster_centers[cluster] += center * area;
+			cluster_normals[cluster] += normal;
+			cluster_areas[cluster] += area;
+			mesh_center += center * area;
+			mesh_area += area;
+		}
+	}
+	if (mesh_area == 0.0f) {
+		return;
+	}
+	mesh_center /= mesh_area;
+
+	std::vector<float> sort_keys(clusters.size(), 0.0f);
+	for (size_t cluster = 0; cluster < clusters.size(); cluster++) {
+		float normal_length = glm::length(cluster_normals[cluster]);
+		if (cluster_areas[cluster] > 0.0f && normal_length > 0.0f) {
+			glm::vec3 center = cluster_centers[cluster] / cluster_areas[cluster];
+			sort_keys[cluster] = glm::dot(center - mesh_center, cluster_normals[cluster] / normal_length);
+		}
+	}
+	std::vector<unsigned int> order(clusters.size());
+	for (unsigned int i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+		return sort_keys[a] > sort_keys[b];
+	});
+
+	std::vector<unsigned int> sorted;
+	sorted.reserve(triangles->size());
+	for (unsigned int cluster : order) {
+		unsigned int end = cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangle_count;
+		sorted.insert(sorted.end(), triangles->begin() + clusters[cluster] * 3, triangles->begin() + end * 3);
+	}
+	triangles->swap(sorted);
+}
+
+void mesh_optimize_vertex_fetch(std::vector<Vertex>* vertices, std::vector<unsigned int>* triangles) {
+	const unsigned int UNUSED = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vertices->size(), UNUSED);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices->size());
+	for (unsigned int& index : *triangles) {
+		if (remap[index] == UNUSED) {
+			remap[index] = (unsigned int)reordered.size();
+			reordered.push_back((*vertices)[index]);
+		}
+		index = remap[index];
+	}
+	vertices->swap(reordered);
+}
+
+void mesh_optimize(GLenum mode, std::vector<Vertex>* vertices, std::vector<unsigned int>* indices) {
+	std::vector<unsigned int> triangles;
+	mesh_triangle_list(mode, *indices, &triangles);
+	std::vector<unsigned int> clusters;
+	mesh_optimize_vertex_cache(triangles, (unsigned int)vertices->size(), MESH_CACHE_SIZE, indices, &clusters);
+	mesh_optimize_overdraw(*vertices, clusters, indices);
+	mesh_optimize_vertex_fetch(vertices, indices);
+}
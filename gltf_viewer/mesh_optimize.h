@@ -0,0 +1,30 @@
+#pragma once
+
+#include "mesh.h"
+#include <vector>
+
+// Index buffer optimization for the post-transform vertex cache, overdraw and vertex fetch. Triangles are reordered
+// with Tipsify (Sander, Nehab and Barczak), which fans around recently used vertices so they are still cached, and
+// the clusters it produces are sorted so outward facing ones draw first. Vertices are then renumbered in the order
+// the triangles first use them, so fetches walk the vertex buffer forwards.
+const unsigned int MESH_CACHE_SIZE = 16;
+
+// Average cache miss ratio is vertices transformed per triangle, 0.5 at best and 3 at worst. Average transform to
+// vertex ratio is vertices transformed per vertex in the mesh, 1 at best. Both assume a FIFO cache.
+struct MeshCacheStats {
+	float acmr;
+	float atvr;
+};
+
+// triangles is a GL_TRIANGLES index list
+MeshCacheStats mesh_analyze_vertex_cache(const std::vector<unsigned int>& triangles, unsigned int vertex_count, unsigned int cache_size);
+// Writes the reordered triangles, and the first triangle of each cluster. A new cluster starts wherever the cache
+// has taken in enough triangles to absorb the misses of starting cold, so clusters can be reordered without
+// raising the miss ratio by much.
+void mesh_optimize_vertex_cache(const std::vector<unsigned int>& triangles, unsigned int vertex_count, unsigned int cache_size, std::vector<unsigned int>* result, std::vector<unsigned int>* clusters);
+// Sorts clusters by how far out they face from the mesh's center. Those usually cover the rest from any angle.
+void mesh_optimize_overdraw(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& clusters, std::vector<unsigned int>* triangles);
+// Renumbers vertices by first use and drops unused ones
+void mesh_optimize_vertex_fetch(std::vector<Vertex>* vertices, std::vector<unsigned int>* triangles);
+// Runs all three, turning GL_TRIANGLES or GL_TRIANGLE_STRIP indices into an optimized GL_TRIANGLES list
+void mesh_optimize(GLenum mode, std::vector<Vertex>* vertices, std::vector<unsigned int>* indices);
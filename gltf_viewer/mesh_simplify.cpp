@@ -0,0 +1,455 @@
+#include "mesh_simplify.h"
+#include "mesh_optimize.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+
+// Position, normal and texture coordinates
+static const int QUADRIC_SIZE = 8;
+// Entries of the upper triangle of the symmetric 8x8 matrix
+static const int QUADRIC_MATRIX_SIZE = QUADRIC_SIZE * (QUADRIC_SIZE + 1) / 2;
+// Vertex copies closer than this fraction of the mesh size are welded
+static const float WELD_TOLERANCE = 1e-5f;
+static const float ATTRIBUTE_TOLERANCE = 1e-4f;
+// Levels stop once their error would pass this fraction of the bounding radius. Past that, locked seams leave only
+// collapses that wreck the shape.
+static const float LOD_MAX_RELATIVE_ERROR = 0.1f;
+
+// Error of a point v is v^T A v + 2 b.v + c, the area weighted sum of squared distances to the triangles' planes in
+// 8 dimensions. Dividing by the summed area turns it back into a mean squared distance.
+struct Quadric {
+	double a[QUADRIC_MATRIX_SIZE];
+	double b[QUADRIC_SIZE];
+	double c;
+	double area;
+};
+
+struct Collapse {
+	double cost;
+	unsigned int from;
+	unsigned int to;
+	unsigned int from_version;
+	unsigned int to_version;
+
+	bool operator>(const Collapse& other) const {
+		return cost > other.cost;
+	}
+};
+
+static void simplify_point(const Vertex& vertex, double normal_scale, double uv_scale, double* point) {
+	point[0] = vertex.position.x;
+	point[1] = vertex.position.y;
+	point[2] = vertex.position.z;
+	point[3] = vertex.normal.x * normal_scale;
+	point[4] = vertex.normal.y * normal_scale;
+	point[5] = vertex.normal.z * normal_scale;
+	point[6] = vertex.texture_coordinates.x * uv_scale;
+	point[7] = vertex.texture_coordinates.y * uv_scale;
+}
+
+static double simplify_dot(const double* a, const double* b) {
+	double result = 0.0;
+	for (int i = 0; i < QUADRIC_SIZE; i++) {
+		result += a[i] * b[i];
+	}
+	return result;
+}
+
+static void quadric_clear(Quadric* quadric) {
+	std::fill(quadric->a, quadric->a + QUADRIC_MATRIX_SIZE, 0.0);
+	std::fill(quadric->b, quadric->b + QUADRIC_SIZE, 0.0);
+	quadric->c = 0.0;
+	quadric->area = 0.0;
+}
+
+static void quadric_add(Quadric* quadric, const Quadric& other) {
+	for (int i = 0; i < QUADRIC_MATRIX_SIZE; i++) {
+		quadric->a[i] += other.a[i];
+	}
+	for (int i = 0; i < QUADRIC_SIZE; i++) {
+		quadric->b[i] += other.b[i];
+	}
+	quadric->c += other.c;
+	quadric->area += other.area;
+}
+
+// Adds the area weighted quadric of the plane through three points, from Garland and Heckbert's generalization to
+// attributes. Two orthonormal vectors e1 and e2 span the plane, and the error is the squared length of whatever of
+// v - p1 they don't cover.
+static void quadric_add_triangle(Quadric* quadric, const double* p1, const double* p2, const double* p3, double area) {
+	double e1[QUADRIC_SIZE];
+	double e2[QUADRIC_SIZE];
+	for (int i = 0; i < QUADRIC_SIZE; i++) {
+		e1[i] = p2[i] - p1[i];
+		e2[i] = p3[i] - p1[i];
+	}
+	double e1_length = std::sqrt(simplify_dot(e1, e1));
+	if (e1_length == 0.0) {
+		return;
+	}
+	for (int i = 0; i < QUADRIC_SIZE; i++) {
+		e1[i] /= e1_length;
+	}
+	double projection = simplify_dot(e1, e2);
+	for (int i = 0; i < QUADRIC_SIZE; i++) {
+		e2[i] -= e1[i] * projection;
+	}
+	double e2_length = std::sqrt(simplify_dot(e2, e2));
+	if (e2_length == 0.0) {
+		return;
+	}
+	for (int i = 0; i < QUADRIC_SIZE; i++) {
+		e2[i] /= e2_length;
+	}
+
+	// A = I - e1 e1^T - e2 e2^T, b = (p1.e1) e1 + (p1.e2) e2 - p1, c = p1.p1 - (p1.e1)^2 - (p1.e2)^2
+	double p1_e1 = simplify_dot(p1, e1);
+	double p1_e2 = simplify_dot(p1, e2);
+	int entry = 0;
+	for (int i = 0; i < QUADRIC_SIZE; i++) {
+		for (int j = i; j < QUADRIC_SIZE; j++) {
+			double value = (i == j ? 1.0 : 0.0) - e1[i] * e1[j] - e2[i] * e2[j];
+			quadric->a[entry++] += value * area;
+		}
+		quadric->b[i] += (p1_e1 * e1[i] + p1_e2 * e2[i] - p1[i]) * area;
+	}
+	quadric->c += (simplify_dot(p1, p1) - p1_e1 * p1_e1 - p1_e2 * p1_e2) * area;
+	quadric->area += area;
+}
+
+static double quadric_error(const Quadric& first, const Quadric& second, const double* point) {
+	double error = first.c + second.c;
+	int entry = 0;
+	for (int i = 0; i < QUADRIC_SIZE; i++) {
+		for (int j = i; j < QUADRIC_SIZE; j++) {
+			double value = first.a[entry] + second.a[entry];
+			error += value * point[i] * point[j] * (i == j ? 1.0 : 2.0);
+			entry++;
+		}
+		error += 2.0 * (first.b[i] + second.b[i]) * point[i];
+	}
+	double area = first.area + second.area;
+	return area > 0.0 ? glm::max(error, 0.0) / area : 0.0;
+}
+
+static bool simplify_attributes_match(const Vertex& a, const Vertex& b) {
+	return glm::all(glm::lessThanEqual(glm::abs(a.normal - b.normal), glm::vec3(ATTRIBUTE_TOLERANCE))) &&
+		glm::all(glm::lessThanEqual(glm::abs(a.texture_coordinates - b.texture_coordinates), glm::vec2(ATTRIBUTE_TOLERANCE)));
+}
+
+float mesh_simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& triangles, unsigned int target_triangles, float max_error, const SimplifySettings& settings, std::vector<unsigned int>* result) {
+	unsigned int vertex_count = (unsigned int)vertices.size();
+	result->clear();
+	if (vertex_count == 0) {
+		return 0.0f;
+	}
+
+	glm::vec3 bounds_min = vertices[0].position;
+	glm::vec3 bounds_max = vertices[0].position;
+	for (const Vertex& vertex : vertices) {
+		bounds_min = glm::min(bounds_min, vertex.position);
+		bounds_max = glm::max(bounds_max, vertex.position);
+	}
+	glm::vec3 size = bounds_max - bounds_min;
+	float extent = glm::max(glm::max(size.x, size.y), glm::max(size.z, FLT_MIN));
+
+	// Weld copies of a vertex. Sorting by quantized position groups the copies, then within a group copies with
+	// matching attributes merge and the rest make the group a seam.
+	float quantize = 1.0f / (extent * WELD_TOLERANCE);
+	std::vector<int64_t> keys(vertex_count * 3);
+	for (unsigned int i = 0; i < vertex_count; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			keys[i * 3 + axis] = (int64_t)std::floor(vertices[i].position[axis] * quantize + 0.5f);
+		}
+	}
+	std::vector<unsigned int> sorted(vertex_count);
+	for (unsigned int i = 0; i < vertex_count; i++) {
+		sorted[i] = i;
+	}
+	std::sort(sorted.begin(), sorted.end(), [&](unsigned int a, unsigned int b) {
+		return std::lexicographical_compare(&keys[a * 3], &keys[a * 3] + 3, &keys[b * 3], &keys[b * 3] + 3);
+	});
+	std::vector<unsigned int> remap(vertex_count);
+	std::vector<bool> locked(vertex_count, false);
+	for (unsigned int group_start = 0; group_start < vertex_count;) {
+		unsigned int group_end = group_start + 1;
+		while (group_end < vertex_count && std::equal(&keys[sorted[group_start] * 3], &keys[sorted[group_start] * 3] + 3, &keys[sorted[group_end] * 3])) {
+			group_end++;
+		}
+		bool seam = false;
+		for (unsigned int i = group_start; i < group_end; i++) {
+			unsigned int vertex = sorted[i];
+			remap[vertex] = vertex;
+			for (unsigned int j = group_start; j < i; j++) {
+				if (remap[sorted[j]] == sorted[j] && simplify_attributes_match(vertices[vertex], vertices[sorted[j]])) {
+					remap[vertex] = sorted[j];
+					break;
+				}
+			}
+			seam = seam || (remap[vertex] == vertex && i != group_start);
+		}
+		for (unsigned int i = group_start; i < group_end; i++) {
+			locked[remap[sorted[i]]] = locked[remap[sorted[i]]] || seam;
+		}
+		group_start = group_end;
+	}
+
+	// Triangles over welded vertices, without the ones that collapsed to a line
+	std::vector<unsigned int> corners;
+	for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+		unsigned int a = remap[triangles[i]];
+		unsigned int b = remap[triangles[i + 1]];
+		unsigned int c = remap[triangles[i + 2]];
+		if (a == b || b == c || a == c || vertices[a].position == vertices[b].position || vertices[b].position == vertices[c].position || vertices[a].position == vertices[c].position) {
+			continue;
+		}
+		corners.push_back(a);
+		corners.push_back(b);
+		corners.push_back(c);
+	}
+	unsigned int triangle_count = (unsigned int)corners.size() / 3;
+	std::vector<bool> triangle_alive(triangle_count, true);
+	std::vector<std::vector<unsigned int>> vertex_triangles(vertex_count);
+	for (unsigned int t = 0; t < triangle_count; t++) {
+		for (int corner = 0; corner < 3; corner++) {
+			vertex_triangles[corners[t * 3 + corner]].push_back(t);
+		}
+	}
+
+	// Edges used by a single triangle are borders. Counting both directions of every edge finds them.
+	std::vector<std::pair<uint64_t, unsigned int>> edges;
+	for (unsigned int t = 0; t < triangle_count; t++) {
+		for (int corner = 0; corner < 3; corner++) {
+			unsigned int a = corners[t * 3 + corner];
+			unsigned int b = corners[t * 3 + (corner + 1) % 3];
+			edges.push_back(std::make_pair(((uint64_t)glm::min(a, b) << 32) | glm::max(a, b), t));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size();) {
+		size_t end = i + 1;
+		while (end < edges.size() && edges[end].first == edges[i].first) {
+			end++;
+		}
+		if (end - i == 1) {
+			locked[(unsigned int)(edges[i].first >> 32)] = true;
+			locked[(unsigned int)(edges[i].first & 0xFFFFFFFF)] = true;
+		}
+		i = end;
+	}
+
+	double normal_scale = settings.normal_weight * extent;
+	double uv_scale = settings.uv_weight * extent;
+	std::vector<double> points(vertex_count * QUADRIC_SIZE);
+	for (unsigned int i = 0; i < vertex_count; i++) {
+		simplify_point(vertices[i], normal_scale, uv_scale, &points[i * QUADRIC_SIZE]);
+	}
+	std::vector<Quadric> quadrics(vertex_count);
+	for (Quadric& quadric : quadrics) {
+		quadric_clear(&quadric);
+	}
+	for (unsigned int t = 0; t < triangle_count; t++) {
+		unsigned int a = corners[t * 3];
+		unsigned int b = corners[t * 3 + 1];
+		unsigned int c = corners[t * 3 + 2];
+		double area = 0.5 * (double)glm::length(glm::cross(vertices[b].position - vertices[a].position, vertices[c].position - vertices[a].position));
+		Quadric triangle_quadric;
+		quadric_clear(&triangle_quadric);
+		quadric_add_triangle(&triangle_quadric, &points[a * QUADRIC_SIZE], &points[b * QUADRIC_SIZE], &points[c * QUADRIC_SIZE], area);
+		quadric_add(&quadrics[a], triangle_quadric);
+		quadric_add(&quadrics[b], triangle_quadric);
+		quadric_add(&quadrics[c], triangle_quadric);
+	}
+
+	// Each edge offers its cheaper direction. Versions go up whenever a vertex's quadric or neighborhood changes,
+	// which invalidates queued collapses that touch it instead of searching the heap for them.
+	std::vector<unsigned int> versions(vertex_count, 0);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+	auto queue_edge = [&](unsigned int a, unsigned int b) {
+		Collapse collapse;
+		collapse.cost = DBL_MAX;
+		if (!locked[a]) {
+			collapse.cost = quadric_error(quadrics[a], quadrics[b], &points[b * QUADRIC_SIZE]);
+			collapse.from = a;
+			collapse.to = b;
+		}
+		if (!locked[b]) {
+			double cost = quadric_error(quadrics[a], quadrics[b], &points[a * QUADRIC_SIZE]);
+			if (cost < collapse.cost) {
+				collapse.cost = cost;
+				collapse.from = b;
+				collapse.to = a;
+			}
+		}
+		if (collapse.cost == DBL_MAX) {
+			return;
+		}
+		collapse.from_version = versions[collapse.from];
+		collapse.to_version = versions[collapse.to];
+		heap.push(collapse);
+	};
+	for (size_t i = 0; i < edges.size(); i++) {
+		if (i == 0 || edges[i].first != edges[i - 1].first) {
+			queue_edge((unsigned int)(edges[i].first >> 32), (unsigned int)(edges[i].first & 0xFFFFFFFF));
+		}
+	}
+
+	std::vector<unsigned int> neighbors;
+	std::vector<unsigned int> to_neighbors;
+	auto gather_neighbors = [&](unsigned int vertex, std::vector<unsigned int>* result) {
+		result->clear();
+		for (unsigned int t : vertex_triangles[vertex]) {
+			for (int corner = 0; corner < 3; corner++) {
+				unsigned int other = corners[t * 3 + corner];
+				if (other != vertex) {
+					result->push_back(other);
+				}
+			}
+		}
+		std::sort(result->begin(), result->end());
+		result->erase(std::unique(result->begin(), result->end()), result->end());
+	};
+
+	unsigned int alive_triangles = triangle_count;
+	double max_cost = (double)max_error * (double)max_error;
+	double reached_cost = 0.0;
+	while (alive_triangles > target_triangles && !heap.empty()) {
+		Collapse collapse = heap.top();
+		heap.pop();
+		if (collapse.from_version != versions[collapse.from] || collapse.to_version != versions[collapse.to]) {
+			continue;
+		}
+		if (collapse.cost > max_cost) {
+			break;
+		}
+		unsigned int from = collapse.from;
+		unsigned int to = collapse.to;
+
+		// Dropping dead triangles here keeps the lists short
+		for (unsigned int vertex : { from, to }) {
+			std::vector<unsigned int>& list = vertex_triangles[vertex];
+			list.erase(std::remove_if(list.begin(), list.end(), [&](unsigned int t) { return !triangle_alive[t]; }), list.end());
+		}
+
+		// Only two neighbors may be shared, the ones across the collapsing edge, or the surface pinches
+		gather_neighbors(from, &neighbors);
+		gather_neighbors(to, &to_neighbors);
+		unsigned int shared = 0;
+		for (unsigned int neighbor : neighbors) {
+			shared += std::binary_search(to_neighbors.begin(), to_neighbors.end(), neighbor) ? 1 : 0;
+		}
+		if (shared > 2) {
+			continue;
+		}
+
+		bool flips = false;
+		for (unsigned int t : vertex_triangles[from]) {
+			glm::vec3 positions[3];
+			glm::vec3 moved[3];
+			bool has_to = false;
+			for (int corner = 0; corner < 3; corner++) {
+				unsigned int vertex = corners[t * 3 + corner];
+				has_to = has_to || vertex == to;
+				positions[corner] = vertices[vertex].position;
+				moved[corner] = vertex == from ? vertices[to].position : positions[corner];
+			}
+			if (has_to) {
+				continue;
+			}
+			glm::vec3 normal = glm::cross(positions[1] - positions[0], positions[2] - positions[0]);
+			glm::vec3 moved_normal = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+			float lengths = glm::length(normal) * glm::length(moved_normal);
+			if (lengths == 0.0f || glm::dot(normal, moved_normal) < settings.min_normal_dot * lengths) {
+				flips = true;
+				break;
+			}
+		}
+		if (flips) {
+			continue;
+		}
+
+		for (unsigned int t : vertex_triangles[from]) {
+			bool has_to = false;
+			for (int corner = 0; corner < 3; corner++) {
+				has_to = has_to || corners[t * 3 + corner] == to;
+			}
+			if (has_to) {
+				triangle_alive[t] = false;
+				alive_triangles--;
+				continue;
+			}
+			for (int corner = 0; corner < 3; corner++) {
+				if (corners[t * 3 + corner] == from) {
+					corners[t * 3 + corner] = to;
+				}
+			}
+			vertex_triangles[to].push_back(t);
+		}
+		vertex_triangles[from].clear();
+		quadric_add(&quadrics[to], quadrics[from]);
+		versions[from]++;
+		versions[to]++;
+		reached_cost = glm::max(reached_cost, collapse.cost);
+
+		std::vector<unsigned int>& list = vertex_triangles[to];
+		list.erase(std::remove_if(list.begin(), list.end(), [&](unsigned int t) { return !triangle_alive[t]; }), list.end());
+		gather_neighbors(to, &to_neighbors);
+		for (unsigned int neighbor : to_neighbors) {
+			queue_edge(to, neighbor);
+		}
+	}
+
+	for (unsigned int t = 0; t < triangle_count; t++) {
+		if (triangle_alive[t]) {
+			result->insert(result->end(), &corners[t * 3], &corners[t * 3] + 3);
+		}
+	}
+
+	return (float)std::sqrt(reached_cost);
+}
+
+void mesh_buffer_add_lods(MeshBuffer* buffer, unsigned int primitive, const SimplifySettings& settings) {
+	MeshPrimitive source = buffer->primitives[primitive];
+	std::vector<Vertex> vertices(buffer->vertices.begin() + source.base_vertex, buffer->vertices.begin() + source.base_vertex + source.vertex_count);
+	std::vector<unsigned int> indices(buffer->indices.begin() + source.first_index, buffer->indices.begin() + source.first_index + source.index_count);
+	std::vector<unsigned int> triangles;
+	mesh_triangle_list(source.mode, indices, &triangles);
+
+	// Every level is simplified from the full mesh, so its error is measured against the original surface
+	unsigned int previous_triangles = (unsigned int)triangles.size() / 3;
+	std::vector<unsigned int> lod_indices;
+	while (buffer->primitives[primitive].lod_count < MESH_MAX_LODS) {
+		float error = mesh_simplify(vertices, triangles, previous_triangles / 2, source.bounding_radius * LOD_MAX_RELATIVE_ERROR, settings, &lod_indices);
+		unsigned int lod_triangles = (unsigned int)lod_indices.size() / 3;
+		if (lod_triangles == 0 || lod_triangles > previous_triangles * 3 / 4) {
+			break;
+		}
+
+		// Levels share the full mesh's vertex order, so only their triangles are reordered
+		std::vector<unsigned int> clusters;
+		std::vector<unsigned int> optimized;
+		mesh_optimize_vertex_cache(lod_indices, source.vertex_count, MESH_CACHE_SIZE, &optimized, &clusters);
+		mesh_optimize_overdraw(vertices, clusters, &optimized);
+		lod_indices.swap(optimized);
+
+		MeshPrimitive lod = source;
+		lod.mode = GL_TRIANGLES;
+		lod.first_index = (unsigned int)buffer->indices.size();
+		lod.index_count = (unsigned int)lod_indices.size();
+		lod.lod_count = 1;
+		lod.lods[0] = (unsigned int)buffer->primitives.size();
+		lod.lod_errors[0] = 0.0f;
+		buffer->indices.insert(buffer->indices.end(), lod_indices.begin(), lod_indices.end());
+		buffer->primitives.push_back(lod);
+
+		MeshPrimitive& parent = buffer->primitives[primitive];
+		parent.lods[parent.lod_count] = lod.lods[0];
+		// Selection walks the levels in order, so errors mustn't go down
+		parent.lod_errors[parent.lod_count] = glm::max(error, parent.lod_errors[parent.lod_count - 1]);
+		parent.lod_count++;
+		previous_triangles = lod_triangles;
+	}
+}
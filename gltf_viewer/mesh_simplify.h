@@ -0,0 +1,26 @@
+#pragma once
+
+#include "mesh.h"
+#include <vector>
+
+// Edge collapse simplification driven by quadric error metrics (Garland and Heckbert). Each vertex sums a quadric
+// over position, normal and texture coordinates from its triangles, so collapses that smear shading or stretch UVs
+// cost more than ones that only flatten geometry. Vertices collapse onto one of their neighbors rather than to a
+// new position, so a simplified mesh only references the original vertices and can share their buffer. Vertices on
+// borders and on seams, where copies share a position but not attributes, are locked so meshes don't open up.
+struct SimplifySettings {
+	// Weights of the attributes against position. Both are scaled by the mesh's size first.
+	float normal_weight;
+	float uv_weight;
+	// Collapses turning any triangle's normal past this cosine are rejected, which stops fold overs
+	float min_normal_dot;
+};
+
+const SimplifySettings SIMPLIFY_DEFAULT_SETTINGS = { 0.5f, 0.25f, 0.2f };
+
+// triangles is a GL_TRIANGLES index list. Collapses edges until at most target_triangles remain or the next collapse
+// would pass max_error, then writes the remaining triangles to result. Returns the error reached, in model units.
+float mesh_simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& triangles, unsigned int target_triangles, float max_error, const SimplifySettings& settings, std::vector<unsigned int>* result);
+// Adds up to MESH_MAX_LODS - 1 coarser levels to a primitive, each with half the triangles of the one before,
+// stopping early once a level can't shrink much without a large error. Call before mesh_buffer_upload.
+void mesh_buffer_add_lods(MeshBuffer* buffer, unsigned int primitive, const SimplifySettings& settings);
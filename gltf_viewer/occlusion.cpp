@@ -0,0 +1,483 @@
+#include "occlusion.h"
+#include "cpu_profiler.h"
+#include "mesh.h"
+
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define OCCLUSION_HAS_SSE
+	#include <emmintrin.h>
+#endif
+
+static const unsigned int FULL_COVERAGE = 0xFFFFFFFF;
+// Below this many triangles the bands aren't worth handing out
+static const unsigned int PARALLEL_MIN_TRIANGLES = 64;
+// Boxes with a corner this close to the eye plane are never culled
+static const float NEAR_W = 0.0001f;
+
+struct OcclusionTile {
+	// Everything in the tile is at least this near
+	float far_depth;
+	// Working layer, the covered pixels are at least layer_depth near
+	float layer_depth;
+	unsigned int layer_mask;
+};
+
+// Screen space triangle, set up once and rasterized by every band it overlaps
+struct OcclusionTriangle {
+	// Edge functions a * x + b * y + c, positive inside
+	float edge_a[3];
+	float edge_b[3];
+	float edge_c[3];
+	// Depth plane
+	float depth_dx;
+	float depth_dy;
+	float depth_c;
+	float depth_min;
+	float depth_max;
+	unsigned int tile_min_x;
+	unsigned int tile_min_y;
+	unsigned int tile_max_x;
+	unsigned int tile_max_y;
+};
+
+struct OcclusionOccluder {
+	const OcclusionMesh* mesh;
+	glm::mat4 model;
+};
+
+struct OcclusionBand {
+	unsigned int first_row;
+	unsigned int last_row;
+};
+
+static const char* WORKER_NAMES[OCCLUSION_MAX_WORKERS] = { "occlusion 0", "occlusion 1", "occlusion 2", "occlusion 3", "occlusion 4", "occlusion 5", "occlusion 6", "occlusion 7" };
+
+static unsigned int width = 0;
+static unsigned int height = 0;
+static unsigned int tiles_x = 0;
+static unsigned int tiles_y = 0;
+static std::vector<OcclusionTile> tiles;
+static glm::mat4 view_matrix;
+static glm::mat4 projection_matrix;
+static glm::mat4 projection_view;
+static std::vector<OcclusionOccluder> occluders;
+static std::vector<OcclusionTriangle> triangles;
+static std::vector<glm::vec4> clip_positions;
+static OcclusionStats stats;
+
+static unsigned int worker_count = 0;
+static SDL_Thread* workers[OCCLUSION_MAX_WORKERS];
+static SDL_sem* worker_start[OCCLUSION_MAX_WORKERS];
+static SDL_sem* workers_done = NULL;
+static OcclusionBand bands[OCCLUSION_MAX_WORKERS + 1];
+static std::atomic<bool> running(false);
+
+static double occlusion_elapsed_ms(Uint64 start) {
+	return (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+// Bit row * 8 + column is set for each pixel center inside all three edges
+static unsigned int occlusion_tile_coverage(const OcclusionTriangle& triangle, float tile_x, float tile_y) {
+	unsigned int coverage = 0;
+#ifdef OCCLUSION_HAS_SSE
+	__m128 left_x = _mm_add_ps(_mm_set1_ps(tile_x), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+	__m128 right_x = _mm_add_ps(left_x, _mm_set1_ps(4.0f));
+	__m128 edge_left[3], edge_right[3];
+	for (int edge = 0; edge < 3; edge++) {
+		__m128 a = _mm_set1_ps(triangle.edge_a[edge]);
+		__m128 row = _mm_set1_ps(triangle.edge_b[edge] * (tile_y + 0.5f) + triangle.edge_c[edge]);
+		edge_left[edge] = _mm_add_ps(_mm_mul_ps(a, left_x), row);
+		edge_right[edge] = _mm_add_ps(_mm_mul_ps(a, right_x), row);
+	}
+	const __m128 zero = _mm_setzero_ps();
+	for (unsigned int row = 0; row < OCCLUSION_TILE_HEIGHT; row++) {
+		__m128 inside_left = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(edge_left[0], zero), _mm_cmpgt_ps(edge_left[1], zero)), _mm_cmpgt_ps(edge_left[2], zero));
+		__m128 inside_right = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(edge_right[0], zero), _mm_cmpgt_ps(edge_right[1], zero)), _mm_cmpgt_ps(edge_right[2], zero));
+		unsigned int row_mask = (unsigned int)_mm_movemask_ps(inside_left) | ((unsigned int)_mm_movemask_ps(inside_right) << 4);
+		coverage |= row_mask << (row * OCCLUSION_TILE_WIDTH);
+		for (int edge = 0; edge < 3; edge++) {
+			__m128 b = _mm_set1_ps(triangle.edge_b[edge]);
+			edge_left[edge] = _mm_add_ps(edge_left[edge], b);
+			edge_right[edge] = _mm_add_ps(edge_right[edge], b);
+		}
+	}
+#else
+	for (unsigned int row = 0; row < OCCLUSION_TILE_HEIGHT; row++) {
+		for (unsigned int column = 0; column < OCCLUSION_TILE_WIDTH; column++) {
+			float x = tile_x + (float)column + 0.5f;
+			float y = tile_y + (float)row + 0.5f;
+			bool inside = true;
+			for (int edge = 0; edge < 3; edge++) {
+				inside = inside && triangle.edge_a[edge] * x + triangle.edge_b[edge] * y + triangle.edge_c[edge] > 0.0f;
+			}
+			if (inside) {
+				coverage |= 1u << (row * OCCLUSION_TILE_WIDTH + column);
+			}
+		}
+	}
+#endif
+
+	return coverage;
+}
+
+static void occlusion_update_tile(OcclusionTile* tile, unsigned int coverage, float depth) {
+	// A triangle much nearer than the working layer starts a new one, rather than the layer keeping the farther
+	// depth and the nearer occluder never getting a tile of its own
+	if (tile->layer_mask != 0 && tile->layer_depth - depth > tile->far_depth - tile->layer_depth) {
+		tile->layer_mask = 0;
+		tile->layer_depth = 0.0f;
+	}
+	tile->layer_depth = std::max(tile->layer_depth, depth);
+	tile->layer_mask |= coverage;
+	if (tile->layer_mask == FULL_COVERAGE) {
+		tile->far_depth = std::min(tile->far_depth, tile->layer_depth);
+		tile->layer_mask = 0;
+		tile->layer_depth = 0.0f;
+	}
+}
+
+static void occlusion_rasterize_band(const OcclusionBand& band) {
+	PROFILE_ZONE("occlusion_band");
+	for (const OcclusionTriangle& triangle : triangles) {
+		unsigned int first_row = std::max(triangle.tile_min_y, band.first_row);
+		unsigned int last_row = std::min(triangle.tile_max_y, band.last_row - 1);
+		for (unsigned int tile_row = first_row; tile_row <= last_row && first_row <= last_row; tile_row++) {
+			float tile_y = (float)(tile_row * OCCLUSION_TILE_HEIGHT);
+			for (unsigned int tile_column = triangle.tile_min_x; tile_column <= triangle.tile_max_x; tile_column++) {
+				OcclusionTile& tile = tiles[tile_row * tiles_x + tile_column];
+				if (triangle.depth_min >= tile.far_depth) {
+					continue;
+				}
+				float tile_x = (float)(tile_column * OCCLUSION_TILE_WIDTH);
+				unsigned int coverage = occlusion_tile_coverage(triangle, tile_x, tile_y);
+				if (coverage == 0) {
+					continue;
+				}
+
+				// Farthest the triangle's plane gets over the tile, which can't be past its farthest vertex
+				float depth = triangle.depth_c;
+				depth += std::max(triangle.depth_dx * tile_x, triangle.depth_dx * (tile_x + (float)OCCLUSION_TILE_WIDTH));
+				depth += std::max(triangle.depth_dy * tile_y, triangle.depth_dy * (tile_y + (float)OCCLUSION_TILE_HEIGHT));
+				occlusion_update_tile(&tile, coverage, std::min(depth, triangle.depth_max));
+			}
+		}
+	}
+}
+
+static int occlusion_worker_thread(void* data) {
+	unsigned int worker = (unsigned int)(size_t)data;
+	PROFILE_THREAD(WORKER_NAMES[worker]);
+	while (true) {
+		SDL_SemWait(worker_start[worker]);
+		if (!running.load()) {
+			break;
+		}
+		// Band 0 belongs to the calling thread
+		occlusion_rasterize_band(bands[worker + 1]);
+		SDL_SemPost(workers_done);
+	}
+
+	return 0;
+}
+
+bool occlusion_init(unsigned int buffer_width, unsigned int buffer_height, unsigned int requested_workers) {
+	if (buffer_width == 0 || buffer_height == 0 || buffer_width % OCCLUSION_TILE_WIDTH != 0 || buffer_height % OCCLUSION_TILE_HEIGHT != 0) {
+		printf("Occlusion buffer size %ux%u isn't a whole number of %ux%u tiles\n", buffer_width, buffer_height, OCCLUSION_TILE_WIDTH, OCCLUSION_TILE_HEIGHT);
+		return false;
+	}
+	width = buffer_width;
+	height = buffer_height;
+	tiles_x = width / OCCLUSION_TILE_WIDTH;
+	tiles_y = height / OCCLUSION_TILE_HEIGHT;
+	tiles.resize(tiles_x * tiles_y);
+	stats = OcclusionStats();
+
+	worker_count = 0;
+	requested_workers = std::min(requested_workers, OCCLUSION_MAX_WORKERS);
+	if (requested_workers == 0) {
+		return true;
+	}
+
+	workers_done = SDL_CreateSemaphore(0);
+	if (workers_done == NULL) {
+		printf("Unable to create occlusion semaphore! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+	running.store(true);
+	for (unsigned int i = 0; i < requested_workers; i++) {
+		worker_start[i] = SDL_CreateSemaphore(0);
+		if (worker_start[i] == NULL) {
+			printf("Unable to create occlusion semaphore! SDL Error: %s\n", SDL_GetError());
+			occlusion_quit();
+			return false;
+		}
+		workers[i] = SDL_CreateThread(occlusion_worker_thread, WORKER_NAMES[i], (void*)(size_t)i);
+		if (workers[i] == NULL) {
+			printf("Unable to create occlusion worker thread! SDL Error: %s\n", SDL_GetError());
+			SDL_DestroySemaphore(worker_start[i]);
+			occlusion_quit();
+			return false;
+		}
+		worker_count++;
+	}
+
+	return true;
+}
+
+void occlusion_quit() {
+	running.store(false);
+	for (unsigned int i = 0; i < worker_count; i++) {
+		SDL_SemPost(worker_start[i]);
+		SDL_WaitThread(workers[i], NULL);
+		SDL_DestroySemaphore(worker_start[i]);
+	}
+	worker_count = 0;
+	if (workers_done != NULL) {
+		SDL_DestroySemaphore(workers_done);
+		workers_done = NULL;
+	}
+}
+
+void occlusion_mesh_create(OcclusionMesh* mesh, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, bool strip) {
+	mesh->positions = positions;
+	mesh_triangle_list(strip ? GL_TRIANGLE_STRIP : GL_TRIANGLES, indices, &mesh->indices);
+}
+
+void occlusion_begin_frame(const glm::mat4& view, const glm::mat4& projection) {
+	view_matrix = view;
+	projection_matrix = projection;
+	projection_view = projection * view;
+	for (OcclusionTile& tile : tiles) {
+		tile.far_depth = 1.0f;
+		tile.layer_depth = 0.0f;
+		tile.layer_mask = 0;
+	}
+	occluders.clear();
+	stats = OcclusionStats();
+}
+
+float occlusion_screen_size(glm::vec3 center, float radius) {
+	float distance = -(view_matrix * glm::vec4(center, 1.0f)).z;
+	if (distance <= radius) {
+		return 1.0f;
+	}
+
+	// projection[1][1] is the cotangent of half the vertical field of view
+	return radius * projection_matrix[1][1] / distance;
+}
+
+bool occlusion_is_occluder(const OcclusionSettings& settings, bool marked, float screen_size) {
+	switch (settings.selection) {
+		case OCCLUDERS_MARKED:
+			return marked;
+		case OCCLUDERS_SCREEN_SIZE:
+			return marked && screen_size >= settings.min_screen_size;
+		default:
+			return false;
+	}
+}
+
+void occlusion_add_occluder(const OcclusionMesh& mesh, const glm::mat4& model) {
+	OcclusionOccluder occluder;
+	occluder.mesh = &mesh;
+	occluder.model = model;
+	occluders.push_back(occluder);
+}
+
+static void occlusion_setup_triangle(glm::vec4 v0, glm::vec4 v1, glm::vec4 v2) {
+	glm::vec3 screen[3];
+	glm::vec4 clip[3] = { v0, v1, v2 };
+	for (int i = 0; i < 3; i++) {
+		glm::vec3 ndc = glm::vec3(clip[i]) / clip[i].w;
+		screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * (float)width, (ndc.y * 0.5f + 0.5f) * (float)height, ndc.z * 0.5f + 0.5f);
+	}
+
+	// Back facing and degenerate triangles have no area
+	float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) - (screen[2].x - screen[0].x) * (screen[1].y - screen[0].y);
+	if (!(area > 0.0f)) {
+		return;
+	}
+
+	float min_x = std::min(std::min(screen[0].x, screen[1].x), screen[2].x);
+	float max_x = std::max(std::max(screen[0].x, screen[1].x), screen[2].x);
+	float min_y = std::min(std::min(screen[0].y, screen[1].y), screen[2].y);
+	float max_y = std::max(std::max(screen[0].y, screen[1].y), screen[2].y);
+	if (max_x < 0.0f || max_y < 0.0f || min_x >= (float)width || min_y >= (float)height) {
+		return;
+	}
+
+	OcclusionTriangle triangle;
+	for (int i = 0; i < 3; i++) {
+		const glm::vec3& start = screen[i];
+		const glm::vec3& end = screen[(i + 1) % 3];
+		triangle.edge_a[i] = start.y - end.y;
+		triangle.edge_b[i] = end.x - start.x;
+		triangle.edge_c[i] = start.x * end.y - end.x * start.y;
+	}
+	triangle.depth_dx = ((screen[1].z - screen[0].z) * (screen[2].y - screen[0].y) - (screen[2].z - screen[0].z) * (screen[1].y - screen[0].y)) / area;
+	triangle.depth_dy = ((screen[2].z - screen[0].z) * (screen[1].x - screen[0].x) - (screen[1].z - screen[0].z) * (screen[2].x - screen[0].x)) / area;
+	triangle.depth_c = screen[0].z - triangle.depth_dx * screen[0].x - triangle.depth_dy * screen[0].y;
+	triangle.depth_min = std::min(std::min(screen[0].z, screen[1].z), screen[2].z);
+	triangle.depth_max = std::max(std::max(screen[0].z, screen[1].z), screen[2].z);
+	triangle.tile_min_x = (unsigned int)std::max(min_x, 0.0f) / OCCLUSION_TILE_WIDTH;
+	triangle.tile_min_y = (unsigned int)std::max(min_y, 0.0f) / OCCLUSION_TILE_HEIGHT;
+	triangle.tile_max_x = std::min((unsigned int)max_x / OCCLUSION_TILE_WIDTH, tiles_x - 1);
+	triangle.tile_max_y = std::min((unsigned int)max_y / OCCLUSION_TILE_HEIGHT, tiles_y - 1);
+	triangles.push_back(triangle);
+}
+
+// Clips against the near plane, where z + w = 0, and fans out what's left
+static void occlusion_clip_triangle(glm::vec4 v0, glm::vec4 v1, glm::vec4 v2) {
+	glm::vec4 input[3] = { v0, v1, v2 };
+	float distance[3];
+	bool all_inside = true;
+	for (int i = 0; i < 3; i++) {
+		distance[i] = input[i].z + input[i].w;
+		all_inside = all_inside && distance[i] > 0.0f;
+	}
+	if (all_inside) {
+		occlusion_setup_triangle(v0, v1, v2);
+		return;
+	}
+
+	glm::vec4 output[4];
+	int output_count = 0;
+	for (int i = 0; i < 3; i++) {
+		int next = (i + 1) % 3;
+		if (distance[i] > 0.0f) {
+			output[output_count++] = input[i];
+		}
+		if ((distance[i] > 0.0f) != (distance[next] > 0.0f)) {
+			float t = distance[i] / (distance[i] - distance[next]);
+			output[output_count++] = glm::mix(input[i], input[next], t);
+		}
+	}
+	for (int i = 2; i < output_count; i++) {
+		occlusion_setup_triangle(output[0], output[i - 1], output[i]);
+	}
+}
+
+void occlusion_rasterize() {
+	Uint64 start = SDL_GetPerformanceCounter();
+	triangles.clear();
+	for (const OcclusionOccluder& occluder : occluders) {
+		glm::mat4 model_view_projection = projection_view * occluder.model;
+		const OcclusionMesh& mesh = *occluder.mesh;
+		clip_positions.resize(mesh.positions.size());
+		for (size_t i = 0; i < mesh.positions.size(); i++) {
+			clip_positions[i] = model_view_projection * glm::vec4(mesh.positions[i], 1.0f);
+		}
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+			occlusion_clip_triangle(clip_positions[mesh.indices[i]], clip_positions[mesh.indices[i + 1]], clip_positions[mesh.indices[i + 2]]);
+		}
+	}
+	stats.occluders = (unsigned int)occluders.size();
+	stats.triangles = (unsigned int)triangles.size();
+
+	// Bands of whole tile rows, so no two threads ever touch the same tile
+	unsigned int band_count = 1;
+	if (worker_count != 0 && triangles.size() >= PARALLEL_MIN_TRIANGLES) {
+		band_count = std::min(worker_count + 1, tiles_y);
+	}
+	for (unsigned int i = 0; i < band_count; i++) {
+		bands[i].first_row = tiles_y * i / band_count;
+		bands[i].last_row = tiles_y * (i + 1) / band_count;
+	}
+	for (unsigned int i = 1; i < band_count; i++) {
+		SDL_SemPost(worker_start[i - 1]);
+	}
+	occlusion_rasterize_band(bands[0]);
+	for (unsigned int i = 1; i < band_count; i++) {
+		SDL_SemWait(workers_done);
+	}
+
+	stats.raster_ms = occlusion_elapsed_ms(start);
+}
+
+bool occlusion_test_box(glm::vec3 box_min, glm::vec3 box_max) {
+	stats.tested++;
+
+	float min_x = (float)width;
+	float min_y = (float)height;
+	float max_x = 0.0f;
+	float max_y = 0.0f;
+	float min_depth = 1.0f;
+	bool visible = false;
+	for (int corner = 0; corner < 8 && !visible; corner++) {
+		glm::vec3 position = glm::vec3(corner & 1 ? box_max.x : box_min.x, corner & 2 ? box_max.y : box_min.y, corner & 4 ? box_max.z : box_min.z);
+		glm::vec4 clip = projection_view * glm::vec4(position, 1.0f);
+		// Boxes crossing the near plane are too close to bother with
+		if (clip.w < NEAR_W || clip.z < -clip.w) {
+			visible = true;
+			break;
+		}
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		min_x = std::min(min_x, (ndc.x * 0.5f + 0.5f) * (float)width);
+		max_x = std::max(max_x, (ndc.x * 0.5f + 0.5f) * (float)width);
+		min_y = std::min(min_y, (ndc.y * 0.5f + 0.5f) * (float)height);
+		max_y = std::max(max_y, (ndc.y * 0.5f + 0.5f) * (float)height);
+		min_depth = std::min(min_depth, ndc.z * 0.5f + 0.5f);
+	}
+
+	// Off screen boxes are left to frustum culling
+	if (!visible && (max_x < 0.0f || max_y < 0.0f || min_x >= (float)width || min_y >= (float)height)) {
+		visible = true;
+	}
+	if (!visible) {
+		unsigned int tile_min_x = (unsigned int)std::max(min_x, 0.0f) / OCCLUSION_TILE_WIDTH;
+		unsigned int tile_min_y = (unsigned int)std::max(min_y, 0.0f) / OCCLUSION_TILE_HEIGHT;
+		unsigned int tile_max_x = std::min((unsigned int)max_x / OCCLUSION_TILE_WIDTH, tiles_x - 1);
+		unsigned int tile_max_y = std::min((unsigned int)max_y / OCCLUSION_TILE_HEIGHT, tiles_y - 1);
+		for (unsigned int tile_row = tile_min_y; tile_row <= tile_max_y && !visible; tile_row++) {
+			for (unsigned int tile_column = tile_min_x; tile_column <= tile_max_x; tile_column++) {
+				if (min_depth < tiles[tile_row * tiles_x + tile_column].far_depth) {
+					visible = true;
+					break;
+				}
+			}
+		}
+	}
+
+	if (!visible) {
+		stats.occluded++;
+	}
+
+	return visible;
+}
+
+unsigned int occlusion_cull_items(const std::vector<glm::vec3>& box_min, const std::vector<glm::vec3>& box_max, unsigned int* items, unsigned int count) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	unsigned int visible_count = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		if (occlusion_test_box(box_min[items[i]], box_max[items[i]])) {
+			items[visible_count++] = items[i];
+		}
+	}
+	stats.test_ms += occlusion_elapsed_ms(start);
+
+	return visible_count;
+}
+
+const OcclusionStats& occlusion_get_stats() {
+	return stats;
+}
+
+unsigned int occlusion_get_width() {
+	return width;
+}
+
+unsigned int occlusion_get_height() {
+	return height;
+}
+
+void occlusion_get_tile_depths(std::vector<float>* depths) {
+	depths->resize(tiles.size());
+	for (size_t i = 0; i < tiles.size(); i++) {
+		(*depths)[i] = tiles[i].far_depth;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Software occlusion culling in the style of masked occlusion culling. Occluder triangles are rasterized on the CPU
+// into a low resolution buffer of 8x4 pixel tiles. Rather than a depth per pixel, each tile keeps a conservative
+// far depth for the whole tile plus one working layer: a coverage mask and the farthest depth under it. Once the
+// working layer covers the tile it becomes the new far depth. Occludee boxes are tested against the far depths of
+// the tiles they overlap. Rasterizing is split into bands of tile rows across worker threads, and tile coverage is
+// computed 4 pixels per instruction with SSE. Needs no GPU support.
+const unsigned int OCCLUSION_TILE_WIDTH = 8;
+const unsigned int OCCLUSION_TILE_HEIGHT = 4;
+const unsigned int OCCLUSION_DEFAULT_WIDTH = 320;
+const unsigned int OCCLUSION_DEFAULT_HEIGHT = 180;
+const unsigned int OCCLUSION_MAX_WORKERS = 8;
+
+enum OccluderSelection {
+	// Objects are never occluders, occlusion culling is off
+	OCCLUDERS_NONE,
+	// Every visible object marked as an occluder
+	OCCLUDERS_MARKED,
+	// Marked objects covering at least min_screen_size of the screen height
+	OCCLUDERS_SCREEN_SIZE
+};
+
+struct OcclusionSettings {
+	OccluderSelection selection;
+	float min_screen_size;
+	// The largest on screen are kept when there are more candidates than this
+	unsigned int max_occluders;
+};
+
+// Triangle list in model space. Occluders must lie inside the geometry they stand in for or things behind them can
+// be culled wrongly, a lower detail version of an inscribed mesh works.
+struct OcclusionMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<unsigned int> indices;
+};
+
+struct OcclusionStats {
+	unsigned int occluders;
+	unsigned int triangles;
+	unsigned int tested;
+	unsigned int occluded;
+	double raster_ms;
+	double test_ms;
+};
+
+// width must be a multiple of OCCLUSION_TILE_WIDTH and height of OCCLUSION_TILE_HEIGHT
+bool occlusion_init(unsigned int width, unsigned int height, unsigned int worker_count);
+void occlusion_quit();
+// Converts GL_TRIANGLES or GL_TRIANGLE_STRIP indices to an occluder mesh. Strips keep their triangles facing the
+// same way.
+void occlusion_mesh_create(OcclusionMesh* mesh, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, bool strip);
+
+// Clears the buffer and stats. Not reentrant, only one thread may use the buffer at a time.
+void occlusion_begin_frame(const glm::mat4& view, const glm::mat4& projection);
+// Fraction of the screen height covered by a bounding sphere, for picking occluders
+float occlusion_screen_size(glm::vec3 center, float radius);
+bool occlusion_is_occluder(const OcclusionSettings& settings, bool marked, float screen_size);
+// Queues a mesh. Counter-clockwise triangles face forward, back faces are skipped.
+void occlusion_add_occluder(const OcclusionMesh& mesh, const glm::mat4& model);
+// Rasterizes the queued occluders
+void occlusion_rasterize();
+// False if the box is hidden behind the occluders
+bool occlusion_test_box(glm::vec3 box_min, glm::vec3 box_max);
+// Tests the boxes of items[0] to items[count - 1], keeping the unoccluded ones in order. Returns how many are left.
+unsigned int occlusion_cull_items(const std::vector<glm::vec3>& box_min, const std::vector<glm::vec3>& box_max, unsigned int* items, unsigned int count);
+const OcclusionStats& occlusion_get_stats();
+unsigned int occlusion_get_width();
+unsigned int occlusion_get_height();
+// Each tile's far depth, one float per tile row by row, 0 at the near plane and 1 at the far plane
+void occlusion_get_tile_depths(std::vector<float>* depths);
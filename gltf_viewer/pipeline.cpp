@@ -0,0 +1,129 @@
+#include "pipeline.h"
+#include "cpu_profiler.h"
+
+#include <cstdio>
+
+// Set on the middle slot index when it holds a packet the GL thread hasn't taken yet
+static const int PACKET_FRESH = 4;
+static const int PACKET_INDEX_MASK = 3;
+
+static void pipeline_build_packet(Pipeline* pipeline) {
+	RenderPacket* packet = &pipeline->packets[pipeline->back];
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	packet->frame = pipeline->next_frame++;
+	pipeline->update(packet, pipeline->input, pipeline->delta);
+	packet->update_ms = (float)((double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+
+	pipeline->back = pipeline->middle.exchange(pipeline->back | PACKET_FRESH, std::memory_order_acq_rel) & PACKET_INDEX_MASK;
+}
+
+static void pipeline_acquire_packet(Pipeline* pipeline) {
+	if (pipeline->middle.load(std::memory_order_acquire) & PACKET_FRESH) {
+		pipeline->front = pipeline->middle.exchange(pipeline->front, std::memory_order_acq_rel) & PACKET_INDEX_MASK;
+	}
+}
+
+static int pipeline_update_thread(void* data) {
+	Pipeline* pipeline = (Pipeline*)data;
+	PROFILE_THREAD("update");
+	while (true) {
+		SDL_SemWait(pipeline->update_ready);
+		if (!pipeline->running.load()) {
+			break;
+		}
+		pipeline_build_packet(pipeline);
+		SDL_SemPost(pipeline->packet_ready);
+	}
+
+	return 0;
+}
+
+bool pipeline_init(Pipeline* pipeline, PipelineUpdateFunction update, bool threaded) {
+	pipeline->update = update;
+	pipeline->threaded = threaded;
+	pipeline->back = 0;
+	pipeline->middle.store(1);
+	pipeline->front = 2;
+	pipeline->next_frame = 0;
+	pipeline->first_frame = true;
+	pipeline->input = SimulationInput();
+	pipeline->delta = 0.0f;
+	pipeline->thread = NULL;
+	pipeline->update_ready = NULL;
+	pipeline->packet_ready = NULL;
+
+	// The first packet is built up front so the GL thread has something to draw on its first frame
+	pipeline_build_packet(pipeline);
+	pipeline_acquire_packet(pipeline);
+	if (!threaded) {
+		return true;
+	}
+
+	pipeline->update_ready = SDL_CreateSemaphore(0);
+	pipeline->packet_ready = SDL_CreateSemaphore(0);
+	if (pipeline->update_ready == NULL || pipeline->packet_ready == NULL) {
+		printf("Unable to create pipeline semaphores! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	pipeline->running.store(true);
+	pipeline->thread = SDL_CreateThread(pipeline_update_thread, "update", pipeline);
+	if (pipeline->thread == NULL) {
+		printf("Unable to create update thread! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	return true;
+}
+
+void pipeline_quit(Pipeline* pipeline) {
+	if (pipeline->thread != NULL) {
+		// A packet is being built unless no frame was started
+		if (!pipeline->first_frame) {
+			SDL_SemWait(pipeline->packet_ready);
+		}
+		pipeline->running.store(false);
+		SDL_SemPost(pipeline->update_ready);
+		SDL_WaitThread(pipeline->thread, NULL);
+		pipeline->thread = NULL;
+	}
+	if (pipeline->update_ready != NULL) {
+		SDL_DestroySemaphore(pipeline->update_ready);
+		pipeline->update_ready = NULL;
+	}
+	if (pipeline->packet_ready != NULL) {
+		SDL_DestroySemaphore(pipeline->packet_ready);
+		pipeline->packet_ready = NULL;
+	}
+}
+
+const RenderPacket& pipeline_begin_frame(Pipeline* pipeline, const SimulationInput& input, float delta) {
+	// The init packet is already in front. Pipelined, this frame's input starts the next packet. Unpipelined there
+	// is nothing to build yet and the first frame's input is dropped, it only covers startup.
+	if (pipeline->first_frame) {
+		pipeline->first_frame = false;
+		if (pipeline->threaded) {
+			pipeline->input = input;
+			pipeline->delta = delta;
+			SDL_SemPost(pipeline->update_ready);
+		}
+		return pipeline->packets[pipeline->front];
+	}
+	if (!pipeline->threaded) {
+		pipeline->input = input;
+		pipeline->delta = delta;
+		pipeline_build_packet(pipeline);
+		pipeline_acquire_packet(pipeline);
+		return pipeline->packets[pipeline->front];
+	}
+
+	// Wait for the packet started last frame, then start the next one before rendering this one
+	SDL_SemWait(pipeline->packet_ready);
+	pipeline_acquire_packet(pipeline);
+	pipeline->input = input;
+	pipeline->delta = delta;
+	SDL_SemPost(pipeline->update_ready);
+
+	return pipeline->packets[pipeline->front];
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "render_queue.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "light_cluster.h"
+#include "shadow.h"
+#include "antialiasing.h"
+#include "simulation.h"
+#include <SDL2/SDL.h>
+#include <atomic>
+
+// Everything the GL thread needs to draw one frame. It is not touched by the update stage once published.
+struct RenderPacket {
+	unsigned long frame;
+	CameraState camera;
+	RenderList list;
+	unsigned int objects_visible;
+	unsigned int objects_culled;
+	unsigned int objects_occluded;
+	OcclusionStats occlusion;
+	// Objects drawn at each detail level, and how many were mid switch and drawn twice
+	unsigned int lod_draws[MESH_MAX_LODS];
+	unsigned int lod_dithered;
+	// Lights assigned to clusters of this frame's view
+	LightClusters lights;
+	// Sun shadow cascades to render this frame, and the ones to sample
+	ShadowFrame shadows;
+	// Scene render target size, the window's scaled by the render scale of the time
+	unsigned int render_width;
+	unsigned int render_height;
+	// Anti-aliasing mode, and the cameras TAA reprojects between
+	AntiAliasingFrame antialiasing;
+	float update_ms;
+};
+
+// Builds a packet from the frame's input. Runs on the update thread when pipelining, so it must not call GL.
+typedef void (*PipelineUpdateFunction)(RenderPacket* packet, const SimulationInput& input, float delta);
+
+// Two stage pipeline. While the GL thread submits frame N, the update thread builds frame N+1.
+// Packets are passed through a lock-free triple buffer: the update stage writes the back slot and swaps it into
+// the middle, and the GL thread swaps the middle slot out as its front. The semaphores only pace the two stages
+// so the update thread stays one frame ahead instead of spinning.
+struct Pipeline {
+	PipelineUpdateFunction update;
+	bool threaded;
+
+	RenderPacket packets[3];
+	std::atomic<int> middle;
+	int back;
+	int front;
+	unsigned long next_frame;
+	// Set while the front packet is the one pipeline_init built, which the first frame draws
+	bool first_frame;
+
+	// Written by the GL thread before update_ready is posted, read by the update thread after waiting on it
+	SimulationInput input;
+	float delta;
+
+	SDL_Thread* thread;
+	SDL_sem* update_ready;
+	SDL_sem* packet_ready;
+	std::atomic<bool> running;
+};
+
+bool pipeline_init(Pipeline* pipeline, PipelineUpdateFunction update, bool threaded);
+void pipeline_quit(Pipeline* pipeline);
+// Hands this frame's input to the update stage and returns the packet to render. The first call returns the packet
+// pipeline_init built, so every packet that is built is drawn.
+const RenderPacket& pipeline_begin_frame(Pipeline* pipeline, const SimulationInput& input, float delta);
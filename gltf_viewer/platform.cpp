@@ -0,0 +1,216 @@
+#include "platform.h"
+#include "gl_state.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static PlatformMode platform_mode = PLATFORM_WINDOWED;
+static unsigned int backbuffer_width = 0;
+static unsigned int backbuffer_height = 0;
+
+static SDL_Window* window = NULL;
+static SDL_GLContext context = NULL;
+
+// Headless backbuffer
+static GLuint offscreen_framebuffer = 0;
+static GLuint offscreen_color = 0;
+static GLuint offscreen_depth = 0;
+// With nothing presented there is no swap to throttle on, so frames are fenced to keep at most this many in flight
+static const unsigned int HEADLESS_FRAMES_IN_FLIGHT = 2;
+static GLsync frame_fences[HEADLESS_FRAMES_IN_FLIGHT];
+static unsigned int frame_fence_index = 0;
+
+static bool platform_create_window(const char* title, Uint32 flags) {
+	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+		printf("Error initializing SDL: %s\n", SDL_GetError());
+		return false;
+	}
+
+	// Set GL version, asking for 4.3 for multi-draw indirect
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	SDL_GL_LoadLibrary(NULL);
+
+	// Create SDL window
+	window = SDL_CreateWindow(title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, backbuffer_width, backbuffer_height, SDL_WINDOW_OPENGL | flags);
+	if (window == NULL) {
+		printf("Error creating window: %s\n", SDL_GetError());
+		return false;
+	}
+
+	// Create GL context
+	context = SDL_GL_CreateContext(window);
+	if (context == NULL) {
+		// 4.1 is the newest core profile on some platforms (e.g. macOS)
+		printf("GL 4.3 context unavailable, falling back to 4.1: %s\n", SDL_GetError());
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+		context = SDL_GL_CreateContext(window);
+	}
+	if (context == NULL) {
+		printf("Error creating GL context: %s\n", SDL_GetError());
+		return false;
+	}
+
+	gladLoadGLLoader(SDL_GL_GetProcAddress);
+	return true;
+}
+
+static bool platform_init_headless(const char* title) {
+	// The window only provides the GL context and is never shown or swapped
+	if (!platform_create_window(title, SDL_WINDOW_HIDDEN)) {
+		return false;
+	}
+
+	// Stands in for the default framebuffer
+	glGenRenderbuffers(1, &offscreen_color);
+	glBindRenderbuffer(GL_RENDERBUFFER, offscreen_color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, backbuffer_width, backbuffer_height);
+	glGenRenderbuffers(1, &offscreen_depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, offscreen_depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, backbuffer_width, backbuffer_height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &offscreen_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, offscreen_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreen_color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, offscreen_depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Offscreen framebuffer not complete!\n");
+		return false;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	return true;
+}
+
+bool platform_init(PlatformMode mode, const char* title, unsigned int width, unsigned int height) {
+	platform_mode = mode;
+	backbuffer_width = width;
+	backbuffer_height = height;
+
+	if (mode == PLATFORM_WINDOWED) {
+		return platform_create_window(title, 0);
+	}
+	return platform_init_headless(title);
+}
+
+void platform_quit() {
+	for (GLsync& fence : frame_fences) {
+		if (fence != NULL) {
+			glDeleteSync(fence);
+			fence = NULL;
+		}
+	}
+	if (offscreen_framebuffer != 0) {
+		glDeleteFramebuffers(1, &offscreen_framebuffer);
+		glDeleteRenderbuffers(1, &offscreen_color);
+		glDeleteRenderbuffers(1, &offscreen_depth);
+		offscreen_framebuffer = 0;
+	}
+	if (window != NULL) {
+		SDL_GL_DeleteContext(context);
+		SDL_DestroyWindow(window);
+		window = NULL;
+	}
+	SDL_Quit();
+}
+
+bool platform_is_headless() {
+	return platform_mode == PLATFORM_HEADLESS;
+}
+
+bool platform_poll_event(PlatformEvent* event) {
+	if (platform_mode == PLATFORM_HEADLESS) {
+		return false;
+	}
+
+	SDL_Event e;
+	while (SDL_PollEvent(&e) != 0) {
+		memset(event, 0, sizeof(PlatformEvent));
+		if (e.type == SDL_QUIT) {
+			event->type = PLATFORM_EVENT_QUIT;
+			return true;
+		} else if (e.type == SDL_KEYDOWN) {
+			event->type = PLATFORM_EVENT_KEY_DOWN;
+			event->key = e.key.keysym.sym;
+			return true;
+		} else if (e.type == SDL_MOUSEBUTTONDOWN) {
+			event->type = PLATFORM_EVENT_MOUSE_BUTTON_DOWN;
+			event->button = e.button.button;
+			return true;
+		} else if (e.type == SDL_MOUSEMOTION) {
+			event->type = PLATFORM_EVENT_MOUSE_MOTION;
+			event->motion_x = e.motion.xrel;
+			event->motion_y = e.motion.yrel;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool platform_key_down(SDL_Scancode scancode) {
+	if (platform_mode == PLATFORM_HEADLESS) {
+		return false;
+	}
+	return SDL_GetKeyboardState(NULL)[scancode] != 0;
+}
+
+bool platform_mouse_captured() {
+	return platform_mode == PLATFORM_WINDOWED && SDL_GetRelativeMouseMode() == SDL_TRUE;
+}
+
+void platform_set_mouse_captured(bool captured) {
+	if (platform_mode == PLATFORM_WINDOWED) {
+		SDL_SetRelativeMouseMode(captured ? SDL_TRUE : SDL_FALSE);
+	}
+}
+
+GLuint platform_get_backbuffer() {
+	return offscreen_framebuffer;
+}
+
+bool platform_set_swap_interval(int interval) {
+	if (platform_mode == PLATFORM_HEADLESS) {
+		return interval == 0;
+	}
+	return SDL_GL_SetSwapInterval(interval) == 0;
+}
+
+void platform_swap() {
+	if (platform_mode == PLATFORM_WINDOWED) {
+		SDL_GL_SwapWindow(window);
+		return;
+	}
+
+	GLsync& fence = frame_fences[frame_fence_index];
+	if (fence != NULL) {
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(fence);
+	}
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	frame_fence_index = (frame_fence_index + 1) % HEADLESS_FRAMES_IN_FLIGHT;
+}
+
+bool platform_save_backbuffer(const char* path) {
+	std::vector<unsigned char> pixels(backbuffer_width * backbuffer_height * 3);
+	gl_state_bind_framebuffer(GL_READ_FRAMEBUFFER, offscreen_framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, backbuffer_width, backbuffer_height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("Unable to open %s for writing\n", path);
+		return false;
+	}
+	fprintf(file, "P6\n%u %u\n255\n", backbuffer_width, backbuffer_height);
+	// GL rows start at the bottom
+	for (unsigned int row = 0; row < backbuffer_height; row++) {
+		fwrite(&pixels[(backbuffer_height - 1 - row) * backbuffer_width * 3], 1, backbuffer_width * 3, file);
+	}
+	fclose(file);
+
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <glad/glad.h>
+
+// Window, GL context, input and presentation. The renderer only talks to the platform through these functions,
+// so it runs the same whether it draws to an SDL window or headless.
+enum PlatformMode {
+	PLATFORM_WINDOWED,
+	// Nothing is shown and there is no input. The GL context comes from a hidden window, so a GL driver is still
+	// needed, and frames are drawn into an offscreen framebuffer.
+	PLATFORM_HEADLESS
+};
+
+enum PlatformEventType {
+	PLATFORM_EVENT_QUIT,
+	PLATFORM_EVENT_KEY_DOWN,
+	PLATFORM_EVENT_MOUSE_BUTTON_DOWN,
+	PLATFORM_EVENT_MOUSE_MOTION
+};
+
+struct PlatformEvent {
+	PlatformEventType type;
+	SDL_Keycode key;
+	Uint8 button;
+	int motion_x;
+	int motion_y;
+};
+
+bool platform_init(PlatformMode mode, const char* title, unsigned int width, unsigned int height);
+void platform_quit();
+bool platform_is_headless();
+
+// Headless mode never has events
+bool platform_poll_event(PlatformEvent* event);
+bool platform_key_down(SDL_Scancode scancode);
+bool platform_mouse_captured();
+void platform_set_mouse_captured(bool captured);
+
+// Framebuffer frames are drawn into, 0 when windowed
+GLuint platform_get_backbuffer();
+// Returns false if the interval isn't supported. Headless mode only supports 0.
+bool platform_set_swap_interval(int interval);
+void platform_swap();
+// Writes the backbuffer as a binary PPM
+bool platform_save_backbuffer(const char* path);
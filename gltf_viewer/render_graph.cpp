@@ -0,0 +1,554 @@
+#include "render_graph.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Pooled textures that go unused for this many frames are freed
+static const unsigned long POOL_RELEASE_FRAMES = 60;
+
+static void render_graph_format_info(GLenum internal_format, GLenum* format, GLenum* type, unsigned int* bytes_per_pixel) {
+	*format = GL_RGBA;
+	*type = GL_UNSIGNED_BYTE;
+	*bytes_per_pixel = 4;
+	switch (internal_format) {
+		case GL_R8:
+			*format = GL_RED;
+			*bytes_per_pixel = 1;
+			break;
+		case GL_RG8:
+			*format = GL_RG;
+			*bytes_per_pixel = 2;
+			break;
+		case GL_RG16F:
+			*format = GL_RG;
+			*type = GL_FLOAT;
+			break;
+		case GL_R32F:
+			*format = GL_RED;
+			*type = GL_FLOAT;
+			break;
+		case GL_R32UI:
+			*format = GL_RED_INTEGER;
+			*type = GL_UNSIGNED_INT;
+			break;
+		case GL_R11F_G11F_B10F:
+			*format = GL_RGB;
+			*type = GL_FLOAT;
+			break;
+		case GL_RGBA16:
+			*type = GL_UNSIGNED_SHORT;
+			*bytes_per_pixel = 8;
+			break;
+		case GL_RGBA16F:
+			*type = GL_FLOAT;
+			*bytes_per_pixel = 8;
+			break;
+		case GL_RGBA32F:
+			*type = GL_FLOAT;
+			*bytes_per_pixel = 16;
+			break;
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32F:
+			*format = GL_DEPTH_COMPONENT;
+			*type = GL_FLOAT;
+			break;
+		case GL_DEPTH24_STENCIL8:
+			*format = GL_DEPTH_STENCIL;
+			*type = GL_UNSIGNED_INT_24_8;
+			break;
+		default:
+			break;
+	}
+}
+
+static bool render_graph_is_depth_format(GLenum internal_format) {
+	return internal_format == GL_DEPTH_COMPONENT24 || internal_format == GL_DEPTH_COMPONENT32F || internal_format == GL_DEPTH24_STENCIL8;
+}
+
+static size_t render_graph_texture_bytes(const RenderGraphTextureDesc& desc) {
+	GLenum format, type;
+	unsigned int bytes_per_pixel;
+	render_graph_format_info(desc.internal_format, &format, &type, &bytes_per_pixel);
+
+	return (size_t)desc.width * desc.height * bytes_per_pixel * (desc.samples == 0 ? 1 : desc.samples);
+}
+
+static bool render_graph_desc_equal(const RenderGraphTextureDesc& a, const RenderGraphTextureDesc& b) {
+	return a.width == b.width && a.height == b.height && a.internal_format == b.internal_format && a.samples == b.samples;
+}
+
+static GLuint render_graph_create_physical_texture(const RenderGraphTextureDesc& desc) {
+	GLuint texture;
+	glGenTextures(1, &texture);
+	if (desc.samples != 0) {
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture);
+		glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.internal_format, desc.width, desc.height, GL_TRUE);
+		glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+	} else {
+		GLenum format, type;
+		unsigned int bytes_per_pixel;
+		render_graph_format_info(desc.internal_format, &format, &type, &bytes_per_pixel);
+		GLint filter = render_graph_is_depth_format(desc.internal_format) || format == GL_RED_INTEGER ? GL_NEAREST : GL_LINEAR;
+
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, desc.internal_format, desc.width, desc.height, 0, format, type, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	// Raw binds above bypassed the state cache
+	gl_state_invalidate();
+
+	return texture;
+}
+
+static void render_graph_clear_framebuffers(RenderGraph* graph) {
+	for (auto& entry : graph->framebuffers) {
+		glDeleteFramebuffers(1, &entry.second);
+	}
+	graph->framebuffers.clear();
+	gl_state_invalidate();
+}
+
+static GLuint render_graph_physical(const RenderGraph& graph, RenderGraphResource resource) {
+	const RenderGraphTexture& texture = graph.textures[resource];
+	return texture.imported != 0 ? texture.imported : graph.pool[texture.physical].texture;
+}
+
+// Finds or creates the framebuffer for a set of attachments. depth is NO_DEPTH if there is none.
+static const RenderGraphResource NO_DEPTH = 0xFFFFFFFF;
+static GLuint render_graph_get_framebuffer(RenderGraph* graph, const std::vector<RenderGraphResource>& colors, RenderGraphResource depth) {
+	std::vector<GLuint> key;
+	for (RenderGraphResource color : colors) {
+		key.push_back(render_graph_physical(*graph, color));
+	}
+	key.push_back(0);
+	if (depth != NO_DEPTH) {
+		key.push_back(render_graph_physical(*graph, depth));
+	}
+
+	auto it = graph->framebuffers.find(key);
+	if (it != graph->framebuffers.end()) {
+		return it->second;
+	}
+
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
+	gl_state_bind_framebuffer(GL_FRAMEBUFFER, framebuffer);
+	std::vector<GLenum> draw_buffers;
+	for (unsigned int i = 0; i < colors.size(); i++) {
+		const RenderGraphTextureDesc& desc = graph->textures[colors[i]].desc;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, desc.samples != 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, key[i], 0);
+		draw_buffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+	}
+	if (depth != NO_DEPTH) {
+		const RenderGraphTextureDesc& desc = graph->textures[depth].desc;
+		GLenum attachment = desc.internal_format == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, desc.samples != 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D, key.back(), 0);
+	}
+	if (draw_buffers.empty()) {
+		glDrawBuffer(GL_NONE);
+	} else {
+		glDrawBuffers((GLsizei)draw_buffers.size(), draw_buffers.data());
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Render graph framebuffer not complete!\n");
+	}
+
+	graph->framebuffers[key] = framebuffer;
+	return framebuffer;
+}
+
+void render_graph_begin(RenderGraph* graph, GLuint backbuffer_framebuffer, unsigned int backbuffer_width, unsigned int backbuffer_height) {
+	graph->backbuffer_framebuffer = backbuffer_framebuffer;
+	graph->passes.clear();
+	graph->textures.clear();
+	graph->order.clear();
+	graph->frame++;
+
+	RenderGraphTextureDesc backbuffer_desc = { backbuffer_width, backbuffer_height, GL_RGBA8, 0 };
+	render_graph_create_texture(graph, "backbuffer", backbuffer_desc);
+}
+
+RenderGraphResource render_graph_create_texture(RenderGraph* graph, const char* name, RenderGraphTextureDesc desc) {
+	RenderGraphTexture texture;
+	texture.name = name;
+	texture.desc = desc;
+	texture.first_use = -1;
+	texture.last_use = -1;
+	texture.physical = -1;
+	texture.resolve_target = -1;
+	texture.imported = 0;
+	texture.written = false;
+	texture.resolve_dirty = false;
+	texture.image_written = false;
+	graph->textures.push_back(texture);
+
+	return (RenderGraphResource)(graph->textures.size() - 1);
+}
+
+RenderGraphResource render_graph_import_texture(RenderGraph* graph, const char* name, GLuint texture, RenderGraphTextureDesc desc) {
+	RenderGraphResource resource = render_graph_create_texture(graph, name, desc);
+	graph->textures[resource].imported = texture;
+	graph->textures[resource].written = true;
+
+	return resource;
+}
+
+unsigned int render_graph_add_pass(RenderGraph* graph, const char* name, RenderGraphExecuteFunction execute, void* user_data) {
+	RenderGraphPass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.user_data = user_data;
+	pass.culled = false;
+	graph->passes.push_back(pass);
+
+	return (unsigned int)(graph->passes.size() - 1);
+}
+
+static void render_graph_add_access(RenderGraph* graph, unsigned int pass, RenderGraphResource resource, RenderGraphAccessType type, glm::vec4 clear_value) {
+	RenderGraphAccess access;
+	access.resource = resource;
+	access.type = type;
+	access.clear_value = clear_value;
+	graph->passes[pass].accesses.push_back(access);
+}
+
+void render_graph_read_texture(RenderGraph* graph, unsigned int pass, RenderGraphResource resource) {
+	render_graph_add_access(graph, pass, resource, RENDER_GRAPH_READ_TEXTURE, glm::vec4(0.0f));
+}
+
+void render_graph_write_color(RenderGraph* graph, unsigned int pass, RenderGraphResource resource, glm::vec4 clear_color) {
+	render_graph_add_access(graph, pass, resource, RENDER_GRAPH_WRITE_COLOR, clear_color);
+}
+
+void render_graph_write_depth(RenderGraph* graph, unsigned int pass, RenderGraphResource resource) {
+	render_graph_add_access(graph, pass, resource, RENDER_GRAPH_WRITE_DEPTH, glm::vec4(1.0f));
+}
+
+void render_graph_write_image(RenderGraph* graph, unsigned int pass, RenderGraphResource resource) {
+	render_graph_add_access(graph, pass, resource, RENDER_GRAPH_WRITE_IMAGE, glm::vec4(0.0f));
+}
+
+static bool render_graph_pass_writes(const RenderGraphPass& pass, RenderGraphResource resource) {
+	for (const RenderGraphAccess& access : pass.accesses) {
+		if (access.resource == resource && access.type != RENDER_GRAPH_READ_TEXTURE) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool render_graph_compile(RenderGraph* graph) {
+	unsigned int pass_count = (unsigned int)graph->passes.size();
+
+	// Cull passes that don't contribute to the backbuffer. A pass is needed if it writes something a needed pass
+	// uses, repeated until nothing changes. Every writer of a needed texture stays, since later writes load it.
+	std::vector<bool> needed_textures(graph->textures.size(), false);
+	needed_textures[RENDER_GRAPH_BACKBUFFER] = true;
+	for (RenderGraphPass& pass : graph->passes) {
+		pass.culled = true;
+	}
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (RenderGraphPass& pass : graph->passes) {
+			if (!pass.culled) {
+				continue;
+			}
+			for (const RenderGraphAccess& access : pass.accesses) {
+				if (access.type != RENDER_GRAPH_READ_TEXTURE && needed_textures[access.resource]) {
+					pass.culled = false;
+				}
+			}
+			if (!pass.culled) {
+				for (const RenderGraphAccess& access : pass.accesses) {
+					needed_textures[access.resource] = true;
+				}
+				changed = true;
+			}
+		}
+	}
+
+	// Every writer of a texture runs before every pass that only reads it, and writers run in declaration order.
+	// The order is a topological sort of that, preferring declaration order when passes are independent.
+	std::vector<std::vector<unsigned int>> edges(pass_count);
+	std::vector<unsigned int> incoming(pass_count, 0);
+	for (RenderGraphResource resource = 0; resource < graph->textures.size(); resource++) {
+		int last_writer = -1;
+		std::vector<unsigned int> writers;
+		std::vector<unsigned int> readers;
+		for (unsigned int pass_index = 0; pass_index < pass_count; pass_index++) {
+			const RenderGraphPass& pass = graph->passes[pass_index];
+			if (pass.culled) {
+				continue;
+			}
+			if (render_graph_pass_writes(pass, resource)) {
+				writers.push_back(pass_index);
+				if (last_writer != -1) {
+					edges[last_writer].push_back(pass_index);
+					incoming[pass_index]++;
+				}
+				last_writer = (int)pass_index;
+				continue;
+			}
+			for (const RenderGraphAccess& access : pass.accesses) {
+				if (access.resource == resource) {
+					readers.push_back(pass_index);
+					break;
+				}
+			}
+		}
+		if (last_writer == -1 && !readers.empty() && graph->textures[resource].imported == 0) {
+			printf("Render graph texture %s is read but never written\n", graph->textures[resource].name);
+			return false;
+		}
+		if (last_writer == -1) {
+			continue;
+		}
+		for (unsigned int reader : readers) {
+			edges[last_writer].push_back(reader);
+			incoming[reader]++;
+		}
+	}
+
+	graph->order.clear();
+	std::vector<bool> scheduled(pass_count, false);
+	unsigned int live_passes = 0;
+	for (const RenderGraphPass& pass : graph->passes) {
+		live_passes += pass.culled ? 0 : 1;
+	}
+	while (graph->order.size() < live_passes) {
+		int next = -1;
+		for (unsigned int pass_index = 0; pass_index < pass_count; pass_index++) {
+			if (!graph->passes[pass_index].culled && !scheduled[pass_index] && incoming[pass_index] == 0) {
+				next = (int)pass_index;
+				break;
+			}
+		}
+		if (next == -1) {
+			printf("Render graph has a dependency cycle\n");
+			return false;
+		}
+		scheduled[next] = true;
+		graph->order.push_back((unsigned int)next);
+		for (unsigned int target : edges[next]) {
+			incoming[target]--;
+		}
+	}
+
+	// Lifetimes in execution order. Sampled MSAA textures get a single sample copy to resolve into.
+	for (unsigned int position = 0; position < graph->order.size(); position++) {
+		const RenderGraphPass& pass = graph->passes[graph->order[position]];
+		for (const RenderGraphAccess& access : pass.accesses) {
+			RenderGraphResource resource = access.resource;
+			if (access.type == RENDER_GRAPH_READ_TEXTURE && graph->textures[resource].desc.samples != 0) {
+				if (graph->textures[resource].resolve_target == -1) {
+					RenderGraphTextureDesc resolve_desc = graph->textures[resource].desc;
+					resolve_desc.samples = 0;
+					RenderGraphResource resolve_target = render_graph_create_texture(graph, graph->textures[resource].name, resolve_desc);
+					graph->textures[resource].resolve_target = (int)resolve_target;
+				}
+				resource = (RenderGraphResource)graph->textures[resource].resolve_target;
+			}
+
+			RenderGraphTexture& texture = graph->textures[resource];
+			if (texture.first_use == -1) {
+				texture.first_use = (int)position;
+			}
+			texture.last_use = (int)position;
+			if (resource != access.resource) {
+				graph->textures[access.resource].last_use = (int)position;
+			}
+		}
+	}
+
+	// Assign pooled textures, reusing any with a matching description that is free by the texture's first use
+	memset(&graph->stats, 0, sizeof(graph->stats));
+	for (RenderGraphPhysicalTexture& physical : graph->pool) {
+		physical.busy_until = -1;
+	}
+	std::vector<unsigned int> allocation_order;
+	for (unsigned int resource = 1; resource < graph->textures.size(); resource++) {
+		if (graph->textures[resource].first_use != -1 && graph->textures[resource].imported == 0) {
+			allocation_order.push_back(resource);
+		}
+	}
+	std::stable_sort(allocation_order.begin(), allocation_order.end(), [graph](unsigned int a, unsigned int b) {
+		return graph->textures[a].first_use < graph->textures[b].first_use;
+	});
+	for (unsigned int resource : allocation_order) {
+		RenderGraphTexture& texture = graph->textures[resource];
+		for (unsigned int physical_index = 0; physical_index < graph->pool.size(); physical_index++) {
+			RenderGraphPhysicalTexture& physical = graph->pool[physical_index];
+			if (render_graph_desc_equal(physical.desc, texture.desc) && physical.busy_until < texture.first_use) {
+				texture.physical = (int)physical_index;
+				break;
+			}
+		}
+		if (texture.physical == -1) {
+			RenderGraphPhysicalTexture physical;
+			physical.desc = texture.desc;
+			physical.texture = render_graph_create_physical_texture(texture.desc);
+			graph->pool.push_back(physical);
+			texture.physical = (int)(graph->pool.size() - 1);
+		}
+		graph->pool[texture.physical].busy_until = texture.last_use;
+		graph->pool[texture.physical].last_used_frame = graph->frame;
+
+		graph->stats.virtual_textures++;
+		graph->stats.virtual_bytes += render_graph_texture_bytes(texture.desc);
+	}
+
+	// Free pooled textures that have gone unused for a while. Indices shift, so reassign them afterwards.
+	bool released = false;
+	for (unsigned int physical_index = 0; physical_index < graph->pool.size();) {
+		RenderGraphPhysicalTexture& physical = graph->pool[physical_index];
+		if (graph->frame - physical.last_used_frame > POOL_RELEASE_FRAMES) {
+			glDeleteTextures(1, &physical.texture);
+			graph->pool.erase(graph->pool.begin() + physical_index);
+			for (RenderGraphTexture& texture : graph->textures) {
+				if (texture.physical > (int)physical_index) {
+					texture.physical--;
+				}
+			}
+			released = true;
+		} else {
+			physical_index++;
+		}
+	}
+	if (released) {
+		render_graph_clear_framebuffers(graph);
+	}
+
+	graph->stats.passes = (unsigned int)graph->order.size();
+	graph->stats.culled_passes = pass_count - graph->stats.passes;
+	graph->stats.physical_textures = (unsigned int)graph->pool.size();
+	for (const RenderGraphPhysicalTexture& physical : graph->pool) {
+		graph->stats.physical_bytes += render_graph_texture_bytes(physical.desc);
+	}
+
+	return true;
+}
+
+static void render_graph_resolve(RenderGraph* graph, RenderGraphResource resource) {
+	RenderGraphTexture& texture = graph->textures[resource];
+	RenderGraphResource target = (RenderGraphResource)texture.resolve_target;
+	std::vector<RenderGraphResource> source_colors(1, resource);
+	std::vector<RenderGraphResource> target_colors(1, target);
+	bool depth = render_graph_is_depth_format(texture.desc.internal_format);
+
+	GLuint source_framebuffer = depth ? render_graph_get_framebuffer(graph, std::vector<RenderGraphResource>(), resource) : render_graph_get_framebuffer(graph, source_colors, NO_DEPTH);
+	GLuint target_framebuffer = depth ? render_graph_get_framebuffer(graph, std::vector<RenderGraphResource>(), target) : render_graph_get_framebuffer(graph, target_colors, NO_DEPTH);
+	gl_state_bind_framebuffer(GL_READ_FRAMEBUFFER, source_framebuffer);
+	gl_state_bind_framebuffer(GL_DRAW_FRAMEBUFFER, target_framebuffer);
+	gpu_timer_begin("msaa_resolve");
+	glBlitFramebuffer(0, 0, texture.desc.width, texture.desc.height, 0, 0, texture.desc.width, texture.desc.height, depth ? GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	gpu_timer_end();
+
+	texture.resolve_dirty = false;
+	graph->textures[target].written = true;
+	graph->stats.resolves++;
+}
+
+void render_graph_execute(RenderGraph* graph) {
+	for (unsigned int pass_index : graph->order) {
+		RenderGraphPass& pass = graph->passes[pass_index];
+
+		// Image stores are incoherent, so anything this pass touches that was image-written needs a barrier first
+		bool needs_barrier = false;
+		for (const RenderGraphAccess& access : pass.accesses) {
+			needs_barrier = needs_barrier || graph->textures[access.resource].image_written;
+		}
+		if (needs_barrier && glMemoryBarrier != NULL) {
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+			for (RenderGraphTexture& texture : graph->textures) {
+				texture.image_written = false;
+			}
+			graph->stats.barriers++;
+		}
+
+		std::vector<RenderGraphResource> colors;
+		RenderGraphResource depth = NO_DEPTH;
+		for (const RenderGraphAccess& access : pass.accesses) {
+			RenderGraphTexture& texture = graph->textures[access.resource];
+			if (access.type == RENDER_GRAPH_READ_TEXTURE && texture.resolve_dirty) {
+				render_graph_resolve(graph, access.resource);
+			} else if (access.type == RENDER_GRAPH_WRITE_COLOR) {
+				colors.push_back(access.resource);
+			} else if (access.type == RENDER_GRAPH_WRITE_DEPTH) {
+				depth = access.resource;
+			}
+		}
+
+		if (!colors.empty() || depth != NO_DEPTH) {
+			const RenderGraphTextureDesc& target_desc = graph->textures[colors.empty() ? depth : colors[0]].desc;
+			if (!colors.empty() && colors[0] == RENDER_GRAPH_BACKBUFFER) {
+				gl_state_bind_framebuffer(GL_FRAMEBUFFER, graph->backbuffer_framebuffer);
+			} else {
+				gl_state_bind_framebuffer(GL_FRAMEBUFFER, render_graph_get_framebuffer(graph, colors, depth));
+			}
+			glViewport(0, 0, target_desc.width, target_desc.height);
+		}
+
+		// Textures start each frame undefined, since their memory may have been used by another texture
+		unsigned int color_index = 0;
+		for (const RenderGraphAccess& access : pass.accesses) {
+			RenderGraphTexture& texture = graph->textures[access.resource];
+			if (access.type == RENDER_GRAPH_WRITE_COLOR) {
+				if (!texture.written && texture.desc.internal_format == GL_R32UI) {
+					// Integer targets have to be cleared with integers, the clear value's x converted
+					GLuint clear_value[4] = { (GLuint)access.clear_value.x, 0, 0, 0 };
+					glClearBufferuiv(GL_COLOR, color_index, clear_value);
+					graph->stats.clears++;
+				} else if (!texture.written) {
+					glClearBufferfv(GL_COLOR, color_index, &access.clear_value[0]);
+					graph->stats.clears++;
+				}
+				color_index++;
+			} else if (access.type == RENDER_GRAPH_WRITE_DEPTH && !texture.written) {
+				gl_state_depth_mask(GL_TRUE);
+				if (texture.desc.internal_format == GL_DEPTH24_STENCIL8) {
+					glClearBufferfi(GL_DEPTH_STENCIL, 0, access.clear_value.x, 0);
+				} else {
+					glClearBufferfv(GL_DEPTH, 0, &access.clear_value.x);
+				}
+				graph->stats.clears++;
+			}
+			if (access.type != RENDER_GRAPH_READ_TEXTURE) {
+				texture.written = true;
+				texture.resolve_dirty = texture.resolve_target != -1;
+				texture.image_written = access.type == RENDER_GRAPH_WRITE_IMAGE;
+			}
+		}
+
+		gpu_timer_begin(pass.name);
+		pass.execute(*graph, pass.user_data);
+		gpu_timer_end();
+	}
+}
+
+void render_graph_destroy(RenderGraph* graph) {
+	render_graph_clear_framebuffers(graph);
+	for (RenderGraphPhysicalTexture& physical : graph->pool) {
+		glDeleteTextures(1, &physical.texture);
+	}
+	graph->pool.clear();
+}
+
+GLuint render_graph_get_texture(const RenderGraph& graph, RenderGraphResource resource) {
+	const RenderGraphTexture& texture = graph.textures[resource];
+	if (texture.resolve_target != -1) {
+		return render_graph_physical(graph, (RenderGraphResource)texture.resolve_target);
+	}
+	return texture.physical == -1 && texture.imported == 0 ? 0 : render_graph_physical(graph, resource);
+}
+
+const RenderGraphTextureDesc& render_graph_get_desc(const RenderGraph& graph, RenderGraphResource resource) {
+	return graph.textures[resource].desc;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// Frame graph over the render targets. Each frame, passes are declared along with the textures they read and
+// write. The graph orders and culls them, backs the transient textures with pooled GL textures, and handles
+// first-use clears, MSAA resolves and image store barriers. Textures whose lifetimes don't overlap within
+// the frame share the same pooled texture. Textures that have to outlive the frame, like a history, are owned
+// outside the graph and imported each frame instead.
+typedef unsigned int RenderGraphResource;
+
+// The framebuffer given to render_graph_begin(), normally the default one. Only color can be written to it.
+const RenderGraphResource RENDER_GRAPH_BACKBUFFER = 0;
+
+struct RenderGraphTextureDesc {
+	unsigned int width;
+	unsigned int height;
+	GLenum internal_format;
+	// 0 for a regular texture, otherwise a multisample texture with this many samples
+	unsigned int samples;
+};
+
+enum RenderGraphAccessType {
+	RENDER_GRAPH_READ_TEXTURE,
+	RENDER_GRAPH_WRITE_COLOR,
+	RENDER_GRAPH_WRITE_DEPTH,
+	// Written with image stores from a shader, reads after it get a memory barrier
+	RENDER_GRAPH_WRITE_IMAGE
+};
+
+struct RenderGraphAccess {
+	RenderGraphResource resource;
+	RenderGraphAccessType type;
+	// Used if this is the first write to the texture in the frame
+	glm::vec4 clear_value;
+};
+
+struct RenderGraph;
+typedef void (*RenderGraphExecuteFunction)(const RenderGraph& graph, void* user_data);
+
+struct RenderGraphPass {
+	const char* name;
+	RenderGraphExecuteFunction execute;
+	void* user_data;
+	std::vector<RenderGraphAccess> accesses;
+	bool culled;
+};
+
+struct RenderGraphTexture {
+	const char* name;
+	RenderGraphTextureDesc desc;
+	// Positions in the execution order, -1 if unused this frame
+	int first_use;
+	int last_use;
+	int physical;
+	// Single sample texture an MSAA texture is resolved into when a pass samples it, -1 if none
+	int resolve_target;
+	// Texture owned outside the graph, 0 for a transient one
+	GLuint imported;
+
+	bool written;
+	bool resolve_dirty;
+	bool image_written;
+};
+
+struct RenderGraphPhysicalTexture {
+	RenderGraphTextureDesc desc;
+	GLuint texture;
+	int busy_until;
+	unsigned long last_used_frame;
+};
+
+struct RenderGraphStats {
+	unsigned int passes;
+	unsigned int culled_passes;
+	unsigned int virtual_textures;
+	unsigned int physical_textures;
+	// What the frame's textures would need without aliasing, and what the pool actually holds
+	size_t virtual_bytes;
+	size_t physical_bytes;
+	unsigned int clears;
+	unsigned int resolves;
+	unsigned int barriers;
+};
+
+struct RenderGraph {
+	std::vector<RenderGraphPass> passes;
+	std::vector<RenderGraphTexture> textures;
+	std::vector<unsigned int> order;
+
+	std::vector<RenderGraphPhysicalTexture> pool;
+	// Keyed by the attached textures: colors, then 0, then depth
+	std::map<std::vector<GLuint>, GLuint> framebuffers;
+	GLuint backbuffer_framebuffer;
+	unsigned long frame;
+
+	RenderGraphStats stats;
+};
+
+void render_graph_begin(RenderGraph* graph, GLuint backbuffer_framebuffer, unsigned int backbuffer_width, unsigned int backbuffer_height);
+RenderGraphResource render_graph_create_texture(RenderGraph* graph, const char* name, RenderGraphTextureDesc desc);
+// Imported textures keep their contents from earlier frames, so they can be read before anything writes them and
+// aren't cleared on their first write. They are never pooled or aliased. Single sample only.
+RenderGraphResource render_graph_import_texture(RenderGraph* graph, const char* name, GLuint texture, RenderGraphTextureDesc desc);
+unsigned int render_graph_add_pass(RenderGraph* graph, const char* name, RenderGraphExecuteFunction execute, void* user_data);
+void render_graph_read_texture(RenderGraph* graph, unsigned int pass, RenderGraphResource resource);
+void render_graph_write_color(RenderGraph* graph, unsigned int pass, RenderGraphResource resource, glm::vec4 clear_color);
+void render_graph_write_depth(RenderGraph* graph, unsigned int pass, RenderGraphResource resource);
+void render_graph_write_image(RenderGraph* graph, unsigned int pass, RenderGraphResource resource);
+bool render_graph_compile(RenderGraph* graph);
+void render_graph_execute(RenderGraph* graph);
+void render_graph_destroy(RenderGraph* graph);
+
+// Texture to sample for a resource. For MSAA textures this is the resolved copy.
+GLuint render_graph_get_texture(const RenderGraph& graph, RenderGraphResource resource);
+const RenderGraphTextureDesc& render_graph_get_desc(const RenderGraph& graph, RenderGraphResource resource);
@@ -0,0 +1,169 @@
+#include "render_indirect.h"
+
+#include <algorithm>
+#include <cstddef>
+
+// Layout defined by the GL spec for GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
+};
+
+// std430 layouts matching pbr_indirect_vs.glsl / pbr_indirect_fs.glsl
+struct IndirectDrawData {
+	glm::mat4 model;
+	glm::mat4 normal_matrix;
+	GLuint material;
+	GLuint padding[3];
+};
+
+struct IndirectMaterial {
+	glm::vec3 albedo;
+	float metallic;
+	float roughness;
+	float ao;
+	float padding[2];
+};
+
+// A run of commands that share a primitive mode and can go out in one multi-draw
+struct IndirectBatch {
+	GLenum mode;
+	unsigned int first_command;
+	unsigned int command_count;
+};
+
+static GLuint indirect_vao;
+static GLuint command_buffer;
+static GLuint draw_id_buffer;
+static GLuint draw_data_buffer;
+static GLuint material_buffer;
+
+static std::vector<IndirectBatch> batches;
+// Scene object index for each draw slot, since draws are reordered to group primitive modes
+static std::vector<unsigned int> draw_objects;
+static unsigned int triangle_count = 0;
+static GLenum index_type = GL_UNSIGNED_INT;
+
+void indirect_init(const MeshBuffer& mesh_buffer) {
+	glGenBuffers(1, &command_buffer);
+	glGenBuffers(1, &draw_id_buffer);
+	glGenBuffers(1, &draw_data_buffer);
+	glGenBuffers(1, &material_buffer);
+
+	// Same vertex layout as the mesh buffer VAO plus a per-instance draw id
+	glGenVertexArrays(1, &indirect_vao);
+	glBindVertexArray(indirect_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh_buffer.vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_buffer.ebo);
+
+	vertex_format_apply(mesh_buffer.format);
+	index_type = mesh_buffer.index_type;
+
+	// Each command sets base_instance to its draw slot. Instanced attributes are offset by base_instance,
+	// so reading 0, 1, 2... with a divisor of 1 gives the shader its draw index.
+	glBindBuffer(GL_ARRAY_BUFFER, draw_id_buffer);
+	glEnableVertexAttribArray(3);
+	glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+	glVertexAttribDivisor(3, 1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void indirect_upload_scene(const MeshBuffer& mesh_buffer, const Scene& scene) {
+	draw_objects.clear();
+	for (unsigned int i = 0; i < scene.objects.size(); i++) {
+		draw_objects.push_back(i);
+	}
+	std::stable_sort(draw_objects.begin(), draw_objects.end(), [&](unsigned int a, unsigned int b) {
+		return mesh_buffer.primitives[scene.objects[a].primitive].mode < mesh_buffer.primitives[scene.objects[b].primitive].mode;
+	});
+
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<GLuint> draw_ids;
+	batches.clear();
+	triangle_count = 0;
+	for (unsigned int slot = 0; slot < draw_objects.size(); slot++) {
+		const MeshPrimitive& primitive = mesh_buffer.primitives[scene.objects[draw_objects[slot]].primitive];
+
+		DrawElementsIndirectCommand command;
+		command.count = primitive.index_count;
+		command.instance_count = 1;
+		command.first_index = primitive.first_index;
+		command.base_vertex = primitive.base_vertex;
+		command.base_instance = slot;
+		commands.push_back(command);
+		draw_ids.push_back(slot);
+		triangle_count += mesh_triangle_count(primitive.mode, primitive.index_count);
+
+		if (batches.empty() || batches.back().mode != primitive.mode) {
+			batches.push_back({ primitive.mode, slot, 0 });
+		}
+		batches.back().command_count++;
+	}
+
+	std::vector<IndirectMaterial> materials;
+	for (const Material& material : scene.materials) {
+		IndirectMaterial indirect_material;
+		indirect_material.albedo = material.albedo;
+		indirect_material.metallic = material.metallic;
+		indirect_material.roughness = material.roughness;
+		indirect_material.ao = material.ao;
+		materials.push_back(indirect_material);
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, draw_id_buffer);
+	glBufferData(GL_ARRAY_BUFFER, draw_ids.size() * sizeof(GLuint), draw_ids.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, material_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(IndirectMaterial), materials.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, draw_data_buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, draw_objects.size() * sizeof(IndirectDrawData), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	indirect_update_transforms(scene);
+}
+
+// Re-uploads model and normal matrices. The object list must not have changed since indirect_upload_scene().
+void indirect_update_transforms(const Scene& scene) {
+	std::vector<IndirectDrawData> draw_data(draw_objects.size());
+	for (unsigned int slot = 0; slot < draw_objects.size(); slot++) {
+		const SceneObject& object = scene.objects[draw_objects[slot]];
+		draw_data[slot].model = object.model;
+		draw_data[slot].normal_matrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(object.model))));
+		draw_data[slot].material = object.material;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, draw_data_buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, draw_data.size() * sizeof(IndirectDrawData), draw_data.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+unsigned int indirect_triangle_count() {
+	return triangle_count;
+}
+
+GLuint indirect_get_vao() {
+	return indirect_vao;
+}
+
+// Expects indirect_get_vao() and the indirect PBR program to be bound, with its per-frame uniforms set
+void indirect_render() {
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, draw_data_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, material_buffer);
+
+	for (const IndirectBatch& batch : batches) {
+		glMultiDrawElementsIndirect(batch.mode, index_type, (void*)(batch.first_command * sizeof(DrawElementsIndirectCommand)), batch.command_count, 0);
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
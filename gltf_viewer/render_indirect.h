@@ -0,0 +1,15 @@
+#pragma once
+
+#include "mesh.h"
+#include "scene.h"
+
+// GPU-driven scene submission. All objects are packed into DrawElementsIndirectCommands and drawn with one
+// glMultiDrawElementsIndirect per primitive mode, with per-draw transforms and materials read from SSBOs.
+// Needs a GL 4.3 context, otherwise the per-draw path in main.cpp is used.
+void indirect_init(const MeshBuffer& mesh_buffer);
+void indirect_upload_scene(const MeshBuffer& mesh_buffer, const Scene& scene);
+void indirect_update_transforms(const Scene& scene);
+void indirect_render();
+GLuint indirect_get_vao();
+// Triangles drawn by one indirect_render()
+unsigned int indirect_triangle_count();
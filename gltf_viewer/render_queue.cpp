@@ -0,0 +1,454 @@
+#include "render_queue.h"
+#include "render_indirect.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+#include <utility>
+
+// Sort key layout, most significant bits first.
+// Opaque, sky and overlay draws group by state and then go front to back:
+//   pass 2 | program 8 | texture set 8 | material 12 | vao 8 | depth 26
+// Transparent draws must blend back to front, so depth comes before state:
+//   pass 2 | inverted depth 26 | program 8 | texture set 8 | material 12 | vao 8
+static const int KEY_PASS_SHIFT = 62;
+static const uint64_t KEY_DEPTH_MAX = (1ull << 26) - 1;
+
+// GPU timer zone names, indexed by RenderPass
+static const char* RENDER_PASS_NAMES[] = { "opaque", "sky", "transparent", "overlay" };
+
+static uint64_t render_queue_state_bits(const RenderDraw& draw) {
+	uint64_t texture_set = draw.texture_set == RENDER_NO_TEXTURE_SET ? 0xFF : (uint64_t)draw.texture_set & 0xFF;
+	uint64_t material = draw.material == RENDER_NO_MATERIAL ? 0xFFF : (uint64_t)draw.material & 0xFFF;
+
+	return ((uint64_t)(draw.program & 0xFF) << 28) | (texture_set << 20) | (material << 8) | ((uint64_t)draw.vao & 0xFF);
+}
+
+static uint64_t render_queue_key(const RenderList& list, const RenderDraw& draw) {
+	// Quantize view space distance of the object origin over the depth range
+	float distance = -(list.view * draw.model[3]).z;
+	float normalized_depth = glm::clamp(distance / list.far_plane, 0.0f, 1.0f);
+	uint64_t depth = (uint64_t)(normalized_depth * (float)KEY_DEPTH_MAX);
+
+	uint64_t key = (uint64_t)draw.pass << KEY_PASS_SHIFT;
+	if (draw.pass == RENDER_PASS_TRANSPARENT) {
+		key |= (KEY_DEPTH_MAX - depth) << 36;
+		key |= render_queue_state_bits(draw);
+	} else {
+		key |= render_queue_state_bits(draw) << 26;
+		key |= depth;
+	}
+
+	return key;
+}
+
+unsigned int render_queue_add_program(RenderQueue* queue, GLuint program) {
+	RenderProgram render_program;
+	render_program.id = program;
+	render_program.projection_view_location = glGetUniformLocation(program, "projection_view");
+	render_program.projection_rot_view_location = glGetUniformLocation(program, "projection_rot_view");
+	render_program.view_position_location = glGetUniformLocation(program, "view_position");
+	render_program.model_location = glGetUniformLocation(program, "model");
+	render_program.normal_matrix_location = glGetUniformLocation(program, "normal_matrix");
+	render_program.albedo_location = glGetUniformLocation(program, "u_albedo");
+	render_program.metallic_location = glGetUniformLocation(program, "u_metallic");
+	render_program.roughness_location = glGetUniformLocation(program, "u_roughness");
+	render_program.ao_location = glGetUniformLocation(program, "u_ao");
+	render_program.lod_fade_location = glGetUniformLocation(program, "lod_fade");
+	render_program.visibility_instance_location = glGetUniformLocation(program, "visibility_instance");
+	render_program.depth_program = -1;
+	render_program.gbuffer_program = -1;
+	render_program.visibility_program = -1;
+	queue->programs.push_back(render_program);
+
+	return (unsigned int)(queue->programs.size() - 1);
+}
+
+void render_queue_set_depth_program(RenderQueue* queue, unsigned int program, unsigned int depth_program) {
+	queue->programs[program].depth_program = (int)depth_program;
+}
+
+void render_queue_set_gbuffer_program(RenderQueue* queue, unsigned int program, unsigned int gbuffer_program) {
+	queue->programs[program].gbuffer_program = (int)gbuffer_program;
+}
+
+void render_queue_set_visibility_program(RenderQueue* queue, unsigned int program, unsigned int visibility_program) {
+	queue->programs[program].visibility_program = (int)visibility_program;
+}
+
+// Program an earlier pass of this mode's frame drew the opaque draws of program with, -1 if it didn't
+static int render_queue_replacement_program(const RenderProgram& program, RenderQueueMode mode) {
+	switch (mode) {
+		case RENDER_QUEUE_GBUFFER:
+		case RENDER_QUEUE_DEFERRED:
+			return program.gbuffer_program;
+		case RENDER_QUEUE_VISIBILITY:
+		case RENDER_QUEUE_VISIBILITY_RESOLVED:
+			return program.visibility_program;
+		default:
+			return -1;
+	}
+}
+
+unsigned int render_queue_add_texture_set(RenderQueue* queue, const RenderTextureSet& texture_set) {
+	queue->texture_sets.push_back(texture_set);
+
+	return (unsigned int)(queue->texture_sets.size() - 1);
+}
+
+void render_list_begin(RenderList* list, const glm::mat4& view, const glm::mat4& projection, glm::vec3 view_position, float far_plane) {
+	list->view = view;
+	list->projection = projection;
+	list->view_position = view_position;
+	list->far_plane = far_plane;
+	list->draws.clear();
+	list->keys.clear();
+	list->order.clear();
+}
+
+void render_list_submit(RenderList* list, const RenderDraw& draw) {
+	list->keys.push_back(render_queue_key(*list, draw));
+	list->order.push_back((uint32_t)list->draws.size());
+	list->draws.push_back(draw);
+}
+
+// LSD radix sort of key/value pairs, one byte per pass. Passes where every key has the same byte are skipped,
+// which is most of them since draws share their high state bits.
+void render_radix_sort(uint64_t* keys, uint32_t* values, uint64_t* keys_scratch, uint32_t* values_scratch, size_t count) {
+	uint64_t* keys_in = keys;
+	uint32_t* values_in = values;
+	uint64_t* keys_out = keys_scratch;
+	uint32_t* values_out = values_scratch;
+
+	for (int shift = 0; shift < 64; shift += 8) {
+		size_t histogram[256];
+		memset(histogram, 0, sizeof(histogram));
+		for (size_t i = 0; i < count; i++) {
+			histogram[(keys_in[i] >> shift) & 0xFF]++;
+		}
+		if (count == 0 || histogram[(keys_in[0] >> shift) & 0xFF] == count) {
+			continue;
+		}
+
+		size_t offset = 0;
+		for (int bucket = 0; bucket < 256; bucket++) {
+			size_t bucket_count = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucket_count;
+		}
+		for (size_t i = 0; i < count; i++) {
+			size_t destination = histogram[(keys_in[i] >> shift) & 0xFF]++;
+			keys_out[destination] = keys_in[i];
+			values_out[destination] = values_in[i];
+		}
+
+		std::swap(keys_in, keys_out);
+		std::swap(values_in, values_out);
+	}
+
+	if (keys_in != keys) {
+		memcpy(keys, keys_in, count * sizeof(uint64_t));
+		memcpy(values, values_in, count * sizeof(uint32_t));
+	}
+}
+
+void render_list_sort(RenderList* list) {
+	list->sort_keys_scratch.resize(list->keys.size());
+	list->sort_order_scratch.resize(list->order.size());
+	render_radix_sort(list->keys.data(), list->order.data(), list->sort_keys_scratch.data(), list->sort_order_scratch.data(), list->keys.size());
+}
+
+static void render_queue_apply_pass(RenderPass pass) {
+	switch (pass) {
+		case RENDER_PASS_OPAQUE:
+			gl_state_enable(GL_DEPTH_TEST);
+			gl_state_depth_func(GL_LESS);
+			gl_state_depth_mask(GL_TRUE);
+			gl_state_blend_func(GL_ONE, GL_ZERO);
+			break;
+		case RENDER_PASS_SKY:
+			// The skybox is drawn at max depth, so it only fills pixels the opaque pass left empty
+			gl_state_enable(GL_DEPTH_TEST);
+			gl_state_depth_func(GL_LEQUAL);
+			gl_state_depth_mask(GL_TRUE);
+			gl_state_blend_func(GL_ONE, GL_ZERO);
+			break;
+		case RENDER_PASS_TRANSPARENT:
+			gl_state_enable(GL_DEPTH_TEST);
+			gl_state_depth_func(GL_LESS);
+			gl_state_depth_mask(GL_FALSE);
+			gl_state_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			break;
+		case RENDER_PASS_OVERLAY:
+			gl_state_disable(GL_DEPTH_TEST);
+			gl_state_depth_mask(GL_TRUE);
+			gl_state_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			break;
+	}
+}
+
+static void render_queue_upload_view(const RenderProgram& program, const RenderList& list, const glm::mat4& projection_view, const glm::mat4& projection_rot_view) {
+	if (program.projection_view_location != -1) {
+		glUniformMatrix4fv(program.projection_view_location, 1, GL_FALSE, glm::value_ptr(projection_view));
+	}
+	if (program.projection_rot_view_location != -1) {
+		glUniformMatrix4fv(program.projection_rot_view_location, 1, GL_FALSE, glm::value_ptr(projection_rot_view));
+	}
+	if (program.view_position_location != -1) {
+		glUniform3fv(program.view_position_location, 1, glm::value_ptr(list.view_position));
+	}
+}
+
+// Per draw uniforms and the draw call itself
+static void render_queue_draw(const RenderProgram& program, const RenderDraw& draw, RenderQueueStats* stats) {
+	if (program.model_location != -1) {
+		glUniformMatrix4fv(program.model_location, 1, GL_FALSE, glm::value_ptr(draw.model));
+	}
+	if (program.normal_matrix_location != -1) {
+		glUniformMatrix3fv(program.normal_matrix_location, 1, GL_FALSE, glm::value_ptr(glm::transpose(glm::inverse(glm::mat3(draw.model)))));
+	}
+	if (program.lod_fade_location != -1) {
+		glUniform1f(program.lod_fade_location, draw.lod_fade);
+	}
+
+	switch (draw.kind) {
+		case RENDER_DRAW_ELEMENTS:
+			glDrawElementsBaseVertex(draw.mode, draw.count, draw.index_type, (void*)(uintptr_t)(draw.first * mesh_index_size(draw.index_type)), draw.base_vertex);
+			stats->triangles += mesh_triangle_count(draw.mode, draw.count);
+			break;
+		case RENDER_DRAW_ARRAYS:
+			glDrawArrays(draw.mode, draw.first, draw.count);
+			stats->triangles += mesh_triangle_count(draw.mode, draw.count);
+			break;
+		case RENDER_DRAW_INDIRECT:
+			indirect_render();
+			stats->triangles += indirect_triangle_count();
+			break;
+	}
+	stats->draws++;
+}
+
+// Opaque draws sort first, so this stops at the first draw of a later pass. Textures and materials are skipped,
+// the depth programs only need the transforms.
+void render_queue_execute_depth(RenderQueue* queue, const RenderList& list) {
+	memset(&queue->prepass_stats, 0, sizeof(queue->prepass_stats));
+
+	gpu_timer_begin("depth_prepass");
+	render_queue_apply_pass(RENDER_PASS_OPAQUE);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	if (queue->opaque_samples_query != 0) {
+		glBeginQuery(GL_SAMPLES_PASSED, queue->opaque_samples_query);
+	}
+
+	int current_program = -1;
+	GLuint current_vao = 0;
+	bool vao_bound = false;
+	glm::mat4 projection_view = list.projection * list.view;
+	glm::mat4 projection_rot_view = list.projection * glm::mat4(glm::mat3(list.view));
+
+	for (uint32_t index : list.order) {
+		const RenderDraw& draw = list.draws[index];
+		if (draw.pass != RENDER_PASS_OPAQUE) {
+			break;
+		}
+		int depth_program = queue->programs[draw.program].depth_program;
+		if (depth_program == -1) {
+			continue;
+		}
+
+		const RenderProgram& program = queue->programs[depth_program];
+		if (depth_program != current_program) {
+			gl_state_use_program(program.id);
+			render_queue_upload_view(program, list, projection_view, projection_rot_view);
+			current_program = depth_program;
+			queue->prepass_stats.program_changes++;
+		}
+		if (!vao_bound || draw.vao != current_vao) {
+			gl_state_bind_vertex_array(draw.vao);
+			current_vao = draw.vao;
+			vao_bound = true;
+			queue->prepass_stats.vao_changes++;
+		}
+		render_queue_draw(program, draw, &queue->prepass_stats);
+	}
+
+	if (queue->opaque_samples_query != 0) {
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	gpu_timer_end();
+}
+
+void render_queue_execute_casters(RenderQueue* queue, const std::vector<RenderDraw>& draws, const glm::mat4& projection_view, RenderQueueStats* stats) {
+	int current_program = -1;
+	GLuint current_vao = 0;
+	bool vao_bound = false;
+	for (const RenderDraw& draw : draws) {
+		int depth_program = queue->programs[draw.program].depth_program;
+		if (depth_program == -1) {
+			continue;
+		}
+
+		const RenderProgram& program = queue->programs[depth_program];
+		if (depth_program != current_program) {
+			gl_state_use_program(program.id);
+			if (program.projection_view_location != -1) {
+				glUniformMatrix4fv(program.projection_view_location, 1, GL_FALSE, glm::value_ptr(projection_view));
+			}
+			current_program = depth_program;
+			stats->program_changes++;
+		}
+		if (!vao_bound || draw.vao != current_vao) {
+			gl_state_bind_vertex_array(draw.vao);
+			current_vao = draw.vao;
+			vao_bound = true;
+			stats->vao_changes++;
+		}
+		render_queue_draw(program, draw, stats);
+	}
+}
+
+// Walks the sorted draws and only touches GL state when it differs from the previous draw
+void render_queue_execute(RenderQueue* queue, const RenderList& list, RenderQueueMode mode) {
+	if (mode != RENDER_QUEUE_DEFERRED && mode != RENDER_QUEUE_VISIBILITY_RESOLVED) {
+		memset(&queue->stats, 0, sizeof(queue->stats));
+	}
+	if (mode == RENDER_QUEUE_VISIBILITY) {
+		queue->visibility_draws.clear();
+	}
+	bool replacing = mode == RENDER_QUEUE_GBUFFER || mode == RENDER_QUEUE_VISIBILITY;
+	// Both visibility modes walk the same draws in the same order, so the remainder can tell which didn't fit
+	unsigned int replaced_draws = 0;
+	if (mode != RENDER_QUEUE_PREPASSED) {
+		memset(&queue->prepass_stats, 0, sizeof(queue->prepass_stats));
+	}
+
+	int current_pass = -1;
+	int current_program = -1;
+	int current_texture_set = RENDER_NO_TEXTURE_SET;
+	int current_material = RENDER_NO_MATERIAL;
+	GLuint current_vao = 0;
+	bool vao_bound = false;
+	bool counting_samples = false;
+	bool samples_counted = false;
+	std::vector<bool> view_uploaded(queue->programs.size(), false);
+
+	glm::mat4 projection_view = list.projection * list.view;
+	glm::mat4 projection_rot_view = list.projection * glm::mat4(glm::mat3(list.view));
+
+	for (uint32_t index : list.order) {
+		const RenderDraw& draw = list.draws[index];
+		unsigned int program_index = draw.program;
+		int replacement = draw.pass == RENDER_PASS_OPAQUE ? render_queue_replacement_program(queue->programs[draw.program], mode) : -1;
+		if (replacing && draw.pass != RENDER_PASS_OPAQUE) {
+			break;
+		} else if (replacing) {
+			if (replacement == -1) {
+				continue;
+			}
+			if (mode == RENDER_QUEUE_VISIBILITY && replaced_draws++ >= queue->visibility_capacity) {
+				continue;
+			}
+			program_index = (unsigned int)replacement;
+		} else if (replacement != -1) {
+			if (mode != RENDER_QUEUE_VISIBILITY_RESOLVED || replaced_draws++ < queue->visibility_draws.size()) {
+				continue;
+			}
+		}
+
+		bool pass_changed = (int)draw.pass != current_pass;
+		if (pass_changed) {
+			if (counting_samples) {
+				glEndQuery(GL_SAMPLES_PASSED);
+				counting_samples = false;
+			}
+			if (current_pass != -1) {
+				gpu_timer_end();
+			}
+			gpu_timer_begin(RENDER_PASS_NAMES[draw.pass]);
+			render_queue_apply_pass(draw.pass);
+			current_pass = (int)draw.pass;
+			queue->stats.pass_changes++;
+			if (draw.pass == RENDER_PASS_OPAQUE && queue->opaque_samples_query != 0) {
+				glBeginQuery(GL_SAMPLES_PASSED, queue->opaque_samples_query);
+				counting_samples = true;
+				samples_counted = true;
+			}
+		}
+
+		const RenderProgram& program = queue->programs[program_index];
+		bool program_changed = (int)program_index != current_program;
+		if (program_changed) {
+			gl_state_use_program(program.id);
+			current_program = (int)program_index;
+			// Material uniforms are program state, so they have to be set again
+			current_material = RENDER_NO_MATERIAL;
+			queue->stats.program_changes++;
+
+			if (!view_uploaded[program_index]) {
+				render_queue_upload_view(program, list, projection_view, projection_rot_view);
+				view_uploaded[program_index] = true;
+			}
+		}
+
+		if (mode == RENDER_QUEUE_PREPASSED && draw.pass == RENDER_PASS_OPAQUE && (pass_changed || program_changed)) {
+			bool prepassed = program.depth_program != -1;
+			gl_state_depth_func(prepassed ? GL_EQUAL : GL_LESS);
+			gl_state_depth_mask(prepassed ? GL_FALSE : GL_TRUE);
+		}
+
+		if (draw.texture_set != RENDER_NO_TEXTURE_SET && draw.texture_set != current_texture_set) {
+			const RenderTextureSet& texture_set = queue->texture_sets[draw.texture_set];
+			for (unsigned int unit = 0; unit < texture_set.count; unit++) {
+				gl_state_bind_texture(unit, texture_set.targets[unit], texture_set.textures[unit]);
+			}
+			current_texture_set = draw.texture_set;
+			queue->stats.texture_set_changes++;
+		}
+
+		if (draw.material != RENDER_NO_MATERIAL && draw.material != current_material) {
+			const Material& material = (*queue->materials)[draw.material];
+			if (program.albedo_location != -1) {
+				glUniform3fv(program.albedo_location, 1, glm::value_ptr(material.albedo));
+			}
+			if (program.metallic_location != -1) {
+				glUniform1f(program.metallic_location, material.metallic);
+			}
+			if (program.roughness_location != -1) {
+				glUniform1f(program.roughness_location, material.roughness);
+			}
+			if (program.ao_location != -1) {
+				glUniform1f(program.ao_location, material.ao);
+			}
+			current_material = draw.material;
+			queue->stats.material_changes++;
+		}
+
+		if (!vao_bound || draw.vao != current_vao) {
+			gl_state_bind_vertex_array(draw.vao);
+			current_vao = draw.vao;
+			vao_bound = true;
+			queue->stats.vao_changes++;
+		}
+
+		if (mode == RENDER_QUEUE_VISIBILITY) {
+			glUniform1ui(program.visibility_instance_location, (GLuint)queue->visibility_draws.size());
+			queue->visibility_draws.push_back(index);
+		}
+		render_queue_draw(program, draw, &queue->stats);
+	}
+
+	if (counting_samples) {
+		glEndQuery(GL_SAMPLES_PASSED);
+	} else if (!samples_counted && queue->opaque_samples_query != 0) {
+		// Still issue the query with nothing drawn, so it has a result to read back
+		glBeginQuery(GL_SAMPLES_PASSED, queue->opaque_samples_query);
+		glEndQuery(GL_SAMPLES_PASSED);
+	}
+	if (current_pass != -1) {
+		gpu_timer_end();
+	}
+	gl_state_bind_vertex_array(0);
+	render_queue_apply_pass(RENDER_PASS_OPAQUE);
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "scene.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Passes execute in this order
+enum RenderPass {
+	RENDER_PASS_OPAQUE = 0,
+	RENDER_PASS_SKY = 1,
+	RENDER_PASS_TRANSPARENT = 2,
+	RENDER_PASS_OVERLAY = 3
+};
+
+enum RenderDrawKind {
+	RENDER_DRAW_ELEMENTS,
+	RENDER_DRAW_ARRAYS,
+	// Submits the whole scene through render_indirect
+	RENDER_DRAW_INDIRECT
+};
+
+// How render_queue_execute() treats the opaque draws
+enum RenderQueueMode {
+	RENDER_QUEUE_FORWARD,
+	// Draws that were in the depth pre-pass test equal to its depth and don't write it
+	RENDER_QUEUE_PREPASSED,
+	// Only draws whose programs have a G-buffer program, drawn with it. Stops after the opaque pass.
+	RENDER_QUEUE_GBUFFER,
+	// Everything the G-buffer pass didn't draw, over the lit G-buffer and its depth
+	RENDER_QUEUE_DEFERRED,
+	// Only draws whose programs have a visibility program, drawn with it and recorded in visibility_draws as the
+	// visibility instance of that index. Stops after the opaque pass.
+	RENDER_QUEUE_VISIBILITY,
+	// Everything the visibility pass didn't draw, over the resolved visibility buffer and its depth
+	RENDER_QUEUE_VISIBILITY_RESOLVED
+};
+
+const int RENDER_NO_MATERIAL = -1;
+const int RENDER_NO_TEXTURE_SET = -1;
+
+// Uniform locations are looked up once when the program is added instead of every draw
+struct RenderProgram {
+	GLuint id;
+	GLint projection_view_location;
+	GLint projection_rot_view_location;
+	GLint view_position_location;
+	GLint model_location;
+	GLint normal_matrix_location;
+	GLint albedo_location;
+	GLint metallic_location;
+	GLint roughness_location;
+	GLint ao_location;
+	GLint lod_fade_location;
+	GLint visibility_instance_location;
+	// Program drawing this one's draws in the depth pre-pass, -1 if they aren't pre-passed
+	int depth_program;
+	// Program writing this one's draws into the G-buffer, -1 if they are drawn forward even when deferred
+	int gbuffer_program;
+	// Program writing this one's draws' triangle and instance IDs into the visibility buffer, -1 if they are drawn
+	// forward even when the visibility buffer is used
+	int visibility_program;
+};
+
+// Textures bound to units 0..count-1
+struct RenderTextureSet {
+	unsigned int count;
+	GLenum targets[8];
+	GLuint textures[8];
+};
+
+struct RenderDraw {
+	RenderDrawKind kind;
+	RenderPass pass;
+	unsigned int program;
+	int texture_set;
+	int material;
+	GLuint vao;
+	GLenum mode;
+	unsigned int first;
+	unsigned int count;
+	int base_vertex;
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, for RENDER_DRAW_ELEMENTS
+	GLenum index_type;
+	glm::mat4 model;
+	// Dithers the draw out while switching detail levels. Above 0 it keeps that fraction of the pixels, below 0 it
+	// keeps the pixels the same positive value would drop, so a pair of draws covers the screen once. 0 keeps all.
+	float lod_fade;
+};
+
+struct RenderQueueStats {
+	unsigned int draws;
+	unsigned int triangles;
+	unsigned int pass_changes;
+	unsigned int program_changes;
+	unsigned int texture_set_changes;
+	unsigned int material_changes;
+	unsigned int vao_changes;
+};
+
+// One frame's draws. Building and sorting a list doesn't touch GL, so it can happen off the GL thread.
+struct RenderList {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 view_position;
+	float far_plane;
+
+	std::vector<RenderDraw> draws;
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> order;
+	std::vector<uint64_t> sort_keys_scratch;
+	std::vector<uint32_t> sort_order_scratch;
+};
+
+// Programs, texture sets and materials the draws refer to by index. Set up once at init.
+struct RenderQueue {
+	std::vector<RenderProgram> programs;
+	std::vector<RenderTextureSet> texture_sets;
+	const std::vector<Material>* materials;
+	// If set, samples passing the depth test in the opaque pass are counted into this GL_SAMPLES_PASSED query
+	GLuint opaque_samples_query;
+	// Draws the visibility buffer can tell apart. Any past it are left to the forward remainder.
+	unsigned int visibility_capacity;
+	// List indices of the last visibility pass's draws, in instance order
+	std::vector<uint32_t> visibility_draws;
+
+	RenderQueueStats stats;
+	RenderQueueStats prepass_stats;
+};
+
+unsigned int render_queue_add_program(RenderQueue* queue, GLuint program);
+// The depth program must compute gl_Position exactly as the program does, declared invariant in both, and discard
+// the same fragments, or the opaque pass's equal test will drop pixels
+void render_queue_set_depth_program(RenderQueue* queue, unsigned int program, unsigned int depth_program);
+// The G-buffer program takes the same uniforms, textures and materials as the program
+void render_queue_set_gbuffer_program(RenderQueue* queue, unsigned int program, unsigned int gbuffer_program);
+// The visibility program takes the same transforms as the program, plus the visibility_instance uniform
+void render_queue_set_visibility_program(RenderQueue* queue, unsigned int program, unsigned int visibility_program);
+unsigned int render_queue_add_texture_set(RenderQueue* queue, const RenderTextureSet& texture_set);
+void render_list_begin(RenderList* list, const glm::mat4& view, const glm::mat4& projection, glm::vec3 view_position, float far_plane);
+void render_list_submit(RenderList* list, const RenderDraw& draw);
+void render_list_sort(RenderList* list);
+// Draws the opaque draws whose programs have a depth program into depth only
+void render_queue_execute_depth(RenderQueue* queue, const RenderList& list);
+// Draws unsorted opaque draws with their programs' depth programs into whatever depth target and state is current,
+// like the shadow casters, see shadow.h. Only adds to the stats given.
+void render_queue_execute_casters(RenderQueue* queue, const std::vector<RenderDraw>& draws, const glm::mat4& projection_view, RenderQueueStats* stats);
+// Stats restart unless mode is RENDER_QUEUE_DEFERRED or RENDER_QUEUE_VISIBILITY_RESOLVED, which add to the pass
+// before them
+void render_queue_execute(RenderQueue* queue, const RenderList& list, RenderQueueMode mode);
+void render_radix_sort(uint64_t* keys, uint32_t* values, uint64_t* keys_scratch, uint32_t* values_scratch, size_t count);
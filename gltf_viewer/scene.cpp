@@ -0,0 +1,101 @@
+#include "scene.h"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+// Lights also get a material so their marker spheres can be drawn with the light color
+void scene_add_light(Scene* scene, glm::vec3 position, glm::vec3 color) {
+	Material material;
+	material.albedo = color;
+	material.metallic = 0.0f;
+	material.roughness = 1.0f;
+	material.ao = 1.0f;
+	scene->materials.push_back(material);
+
+	PointLight light;
+	light.position = position;
+	light.color = color;
+	// Where inverse square falloff drops to the cutoff
+	light.radius = glm::sqrt(glm::max(color.r, glm::max(color.g, color.b)) / SCENE_LIGHT_CUTOFF);
+	light.material = (unsigned int)(scene->materials.size() - 1);
+	light.dynamic = false;
+	light.anchor = position;
+	light.phase = 0.0f;
+	scene->lights.push_back(light);
+}
+
+// Same seed every time so runs are repeatable
+void scene_spawn_lights(Scene* scene, unsigned int count, glm::vec3 box_min, glm::vec3 box_max) {
+	if (count == 0) {
+		return;
+	}
+	glm::vec3 size = box_max - box_min;
+	float radius = glm::pow(3.0f * SCENE_LIGHT_OVERLAP * size.x * size.y * size.z / (4.0f * glm::pi<float>() * (float)count), 1.0f / 3.0f);
+	// Bright enough to make out on their own, dim enough that the overlap doesn't wash everything out
+	float intensity = 0.25f * radius * radius;
+
+	std::mt19937 random(4321);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (unsigned int i = 0; i < count; i++) {
+		PointLight light;
+		light.anchor = box_min + size * glm::vec3(unit(random), unit(random), unit(random));
+		light.position = light.anchor;
+		light.color = glm::vec3(unit(random), unit(random), unit(random));
+		light.color = light.color / glm::max(light.color.r, glm::max(light.color.g, light.color.b)) * intensity;
+		light.radius = radius;
+		light.material = SCENE_NO_MATERIAL;
+		light.dynamic = true;
+		light.phase = unit(random) * glm::two_pi<float>();
+		scene->lights.push_back(light);
+	}
+}
+
+void scene_animate_lights(Scene* scene, float time) {
+	for (PointLight& light : scene->lights) {
+		if (!light.dynamic) {
+			continue;
+		}
+		float angle = time + light.phase;
+		light.position = light.anchor + glm::vec3(glm::sin(angle), glm::cos(angle * 0.7f), glm::sin(angle * 1.3f)) * light.radius * 0.5f;
+	}
+}
+
+void scene_set_sun(Scene* scene, float elevation, float azimuth, float speed, glm::vec3 color) {
+	scene->sun.elevation = elevation;
+	scene->sun.azimuth = azimuth;
+	scene->sun.speed = speed;
+	scene->sun.color = color;
+	scene_animate_sun(scene, 0.0f);
+}
+
+void scene_animate_sun(Scene* scene, float time) {
+	DirectionalLight& sun = scene->sun;
+	float azimuth = sun.azimuth + sun.speed * time;
+	sun.direction = glm::vec3(glm::cos(sun.elevation) * glm::sin(azimuth), glm::sin(sun.elevation), glm::cos(sun.elevation) * glm::cos(azimuth));
+}
+
+// Metallic increases with each row and roughness with each column
+void scene_create_sphere_grid(Scene* scene, unsigned int sphere_primitive, int rows, int columns, float spacing) {
+	for (int row = 0; row < rows; row++) {
+		for (int column = 0; column < columns; column++) {
+			Material material;
+			material.albedo = glm::vec3(0.5f, 0.0f, 0.0f);
+			material.metallic = (float)row / (float)rows;
+			material.roughness = glm::clamp((float)column / (float)columns, 0.05f, 1.0f);
+			material.ao = 1.0f;
+			scene->materials.push_back(material);
+
+			SceneObject object;
+			object.primitive = sphere_primitive;
+			object.material = (unsigned int)(scene->materials.size() - 1);
+			object.occluder = true;
+			object.model = glm::translate(glm::mat4(1.0f), glm::vec3(
+				(column - (columns / 2)) * spacing,
+				(row - (rows / 2)) * spacing,
+				0.0f
+			));
+			scene->objects.push_back(object);
+		}
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct Material {
+	glm::vec3 albedo;
+	float metallic;
+	float roughness;
+	float ao;
+};
+
+// Material index of lights drawn without a marker sphere
+const unsigned int SCENE_NO_MATERIAL = 0xFFFFFFFF;
+
+struct PointLight {
+	glm::vec3 position;
+	glm::vec3 color;
+	// Distance the light's contribution is cut off at, which is what the light clusters bound
+	float radius;
+	unsigned int material;
+	// Dynamic lights circle their anchor, starting phase radians along the way
+	bool dynamic;
+	glm::vec3 anchor;
+	float phase;
+};
+
+// Off while its color is black
+struct DirectionalLight {
+	// Towards the light
+	glm::vec3 direction;
+	glm::vec3 color;
+	// Angle above the horizon, and around the up axis at time 0, in radians
+	float elevation;
+	float azimuth;
+	// Radians a second it turns about the up axis, see scene_animate_sun
+	float speed;
+};
+
+struct SceneObject {
+	unsigned int primitive;
+	unsigned int material;
+	glm::mat4 model;
+	// May be drawn into the occlusion buffer, see occlusion.h
+	bool occluder;
+};
+
+const float SCENE_LIGHT_OVERLAP = 16.0f;
+// Brightness below which a light's contribution is cut off
+const float SCENE_LIGHT_CUTOFF = 0.05f;
+
+struct Scene {
+	std::vector<Material> materials;
+	std::vector<SceneObject> objects;
+	std::vector<PointLight> lights;
+	DirectionalLight sun;
+};
+
+void scene_add_light(Scene* scene, glm::vec3 position, glm::vec3 color);
+// Scatters count small dynamic lights through the box, sized so each point inside is in reach of about
+// SCENE_LIGHT_OVERLAP of them. They have no markers.
+void scene_spawn_lights(Scene* scene, unsigned int count, glm::vec3 box_min, glm::vec3 box_max);
+// Moves the dynamic lights to where they are time seconds in
+void scene_animate_lights(Scene* scene, float time);
+void scene_set_sun(Scene* scene, float elevation, float azimuth, float speed, glm::vec3 color);
+// Turns the sun to where it is time seconds in
+void scene_animate_sun(Scene* scene, float time);
+
+void scene_create_sphere_grid(Scene* scene, unsigned int sphere_primitive, int rows, int columns, float spacing);
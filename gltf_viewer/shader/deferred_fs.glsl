@@ -0,0 +1,38 @@
+#version 410 core
+
+// Lights the G-buffer in one fullscreen pass: the environment once per pixel, then the point lights of the pixel's
+// light cluster. Copies depth into the scene depth buffer for the forward draws that follow.
+
+out vec4 color;
+
+uniform sampler2D gbuffer_albedo;
+uniform sampler2D gbuffer_normal;
+uniform sampler2D gbuffer_depth;
+
+uniform mat4 inverse_projection_view;
+uniform vec3 view_position;
+
+#include "pbr_common.glsl"
+#include "gbuffer.glsl"
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gbuffer_depth, pixel, 0).r;
+	// Nothing was drawn here, leave it to the sky
+	if (depth == 1.0) {
+		discard;
+	}
+
+	vec4 albedo_ao = texelFetch(gbuffer_albedo, pixel, 0);
+	vec4 normal_material = texelFetch(gbuffer_normal, pixel, 0);
+	vec3 albedo = pow(albedo_ao.rgb, vec3(2.2));
+	vec3 normal = gbuffer_decode_normal(normal_material.xy);
+
+	vec2 screen_position = gl_FragCoord.xy / vec2(textureSize(gbuffer_depth, 0));
+	vec4 world_position = inverse_projection_view * vec4(vec3(screen_position, depth) * 2.0 - 1.0, 1.0);
+	world_position /= world_position.w;
+	vec3 view_direction = normalize(view_position - world_position.xyz);
+
+	color = vec4(pbr_shade_at(gl_FragCoord.xy, depth, world_position.xyz, normal, view_direction, albedo, normal_material.z, normal_material.w, albedo_ao.a), 1.0);
+	gl_FragDepth = depth;
+}
@@ -0,0 +1,9 @@
+#version 410 core
+
+#include "lod_dither.glsl"
+
+void main() {
+	if (lod_dither_discard(lod_fade)) {
+		discard;
+	}
+}
@@ -0,0 +1,27 @@
+#version 430 core
+
+layout (location = 0) in vec3 a_position;
+layout (location = 3) in uint a_draw_id;
+
+struct DrawData {
+	mat4 model;
+	mat4 normal_matrix;
+	uint material;
+};
+
+layout (std430, binding = 0) readonly buffer draw_data_buffer {
+	DrawData draws[];
+};
+
+uniform mat4 projection_view;
+
+#include "vertex_decode.glsl"
+
+// Must match pbr_indirect_vs.glsl exactly for the opaque pass's equal depth test
+invariant gl_Position;
+
+void main() {
+	vec3 world_position = vec3(draws[a_draw_id].model * vec4(decode_position(a_position), 1.0));
+
+	gl_Position = projection_view * vec4(world_position, 1.0);
+}
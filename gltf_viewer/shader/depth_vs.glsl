@@ -0,0 +1,17 @@
+#version 410 core
+
+layout (location = 0) in vec3 a_position;
+
+uniform mat4 projection_view;
+uniform mat4 model;
+
+#include "vertex_decode.glsl"
+
+// Must match pbr_vs.glsl exactly for the opaque pass's equal depth test
+invariant gl_Position;
+
+void main() {
+	vec3 world_position = vec3(model * vec4(decode_position(a_position), 1.0));
+
+	gl_Position = projection_view * vec4(world_position, 1.0);
+}
@@ -0,0 +1,131 @@
+#version 410 core
+
+// Edge-adaptive spatial upsample, after the approach of FSR 1's EASU. Each output pixel takes the 12 input texels
+// closest to it and finds the local edge's direction and strength from their luma. The taps are weighted by a
+// windowed Lanczos-2 shaped kernel, rotated to the edge and stretched along it, so edges stay sharp without
+// stair-steps. The result is clamped to the 4 nearest texels so the kernel's negative lobe can't ring.
+
+in vec2 texture_coordinate;
+
+out vec4 color;
+
+uniform sampler2D screen_texture;
+
+// Luma times 2, weighted to green the way FSR does it. Only the relative values matter.
+float easu_luma(vec3 rgb) {
+	return dot(rgb, vec3(0.5, 1.0, 0.5));
+}
+
+// Accumulates the edge direction and strength around one of the 4 nearest texels, from its neighbours
+void easu_edge(inout vec2 direction, inout float strength, float weight, float luma_down, float luma_left, float luma_center, float luma_right, float luma_up) {
+	float difference_right = luma_right - luma_center;
+	float difference_left = luma_center - luma_left;
+	float direction_x = luma_right - luma_left;
+	float strength_x = clamp(abs(direction_x) / max(max(abs(difference_right), abs(difference_left)), 1.0 / 65536.0), 0.0, 1.0);
+	direction.x += direction_x * weight;
+	strength += strength_x * strength_x * weight;
+
+	float difference_up = luma_up - luma_center;
+	float difference_down = luma_center - luma_down;
+	float direction_y = luma_up - luma_down;
+	float strength_y = clamp(abs(direction_y) / max(max(abs(difference_up), abs(difference_down)), 1.0 / 65536.0), 0.0, 1.0);
+	direction.y += direction_y * weight;
+	strength += strength_y * strength_y * weight;
+}
+
+void easu_tap(inout vec3 color_sum, inout float weight_sum, vec2 offset, vec2 direction, vec2 stretch, float lobe, float clip, vec3 tap_color) {
+	vec2 rotated = vec2(dot(offset, direction), dot(offset, vec2(-direction.y, direction.x))) * stretch;
+	float distance_squared = min(dot(rotated, rotated), clip);
+	// (25/16 * (2/5 * x^2 - 1)^2 - (25/16 - 1)) * (lobe * x^2 - 1)^2 approximates Lanczos 2 without a sin or sqrt
+	float window = 2.0 / 5.0 * distance_squared - 1.0;
+	float base = lobe * distance_squared - 1.0;
+	window *= window;
+	base *= base;
+	window = 25.0 / 16.0 * window - (25.0 / 16.0 - 1.0);
+	float weight = window * base;
+	color_sum += tap_color * weight;
+	weight_sum += weight;
+}
+
+vec3 easu_fetch(ivec2 texel, ivec2 limit) {
+	return texelFetch(screen_texture, clamp(texel, ivec2(0), limit), 0).rgb;
+}
+
+void main() {
+	ivec2 input_size = textureSize(screen_texture, 0);
+	ivec2 limit = input_size - 1;
+	vec2 position = texture_coordinate * vec2(input_size) - 0.5;
+	ivec2 origin = ivec2(floor(position));
+	vec2 fraction = position - vec2(origin);
+
+	// The 4x4 texels around the position, less the corners:
+	//     b c
+	//   e f g h
+	//   i j k l
+	//     n o
+	// with f at origin, x to the right and y up the rows
+	vec3 b = easu_fetch(origin + ivec2(0, -1), limit);
+	vec3 c = easu_fetch(origin + ivec2(1, -1), limit);
+	vec3 e = easu_fetch(origin + ivec2(-1, 0), limit);
+	vec3 f = easu_fetch(origin, limit);
+	vec3 g = easu_fetch(origin + ivec2(1, 0), limit);
+	vec3 h = easu_fetch(origin + ivec2(2, 0), limit);
+	vec3 i = easu_fetch(origin + ivec2(-1, 1), limit);
+	vec3 j = easu_fetch(origin + ivec2(0, 1), limit);
+	vec3 k = easu_fetch(origin + ivec2(1, 1), limit);
+	vec3 l = easu_fetch(origin + ivec2(2, 1), limit);
+	vec3 n = easu_fetch(origin + ivec2(0, 2), limit);
+	vec3 o = easu_fetch(origin + ivec2(1, 2), limit);
+	float luma_b = easu_luma(b);
+	float luma_c = easu_luma(c);
+	float luma_e = easu_luma(e);
+	float luma_f = easu_luma(f);
+	float luma_g = easu_luma(g);
+	float luma_h = easu_luma(h);
+	float luma_i = easu_luma(i);
+	float luma_j = easu_luma(j);
+	float luma_k = easu_luma(k);
+	float luma_l = easu_luma(l);
+	float luma_n = easu_luma(n);
+	float luma_o = easu_luma(o);
+
+	// Edge analysis at the 4 nearest texels, blended by their bilinear weights
+	vec2 direction = vec2(0.0);
+	float strength = 0.0;
+	easu_edge(direction, strength, (1.0 - fraction.x) * (1.0 - fraction.y), luma_b, luma_e, luma_f, luma_g, luma_j);
+	easu_edge(direction, strength, fraction.x * (1.0 - fraction.y), luma_c, luma_f, luma_g, luma_h, luma_k);
+	easu_edge(direction, strength, (1.0 - fraction.x) * fraction.y, luma_f, luma_i, luma_j, luma_k, luma_n);
+	easu_edge(direction, strength, fraction.x * fraction.y, luma_g, luma_j, luma_k, luma_l, luma_o);
+
+	// Flat areas get an arbitrary direction, the kernel is round there anyway
+	float direction_length_squared = dot(direction, direction);
+	direction = direction_length_squared < 1.0 / 32768.0 ? vec2(1.0, 0.0) : direction * inversesqrt(direction_length_squared);
+	strength = 0.5 * strength;
+	strength *= strength;
+
+	// Stretch the kernel along diagonals up to sqrt(2), and narrow it across strong edges
+	float diagonal_stretch = dot(direction, direction) / max(abs(direction.x), abs(direction.y));
+	vec2 stretch = vec2(1.0 + (diagonal_stretch - 1.0) * strength, 1.0 - 0.5 * strength);
+	// The negative lobe goes from none to its full depth as the edge gets stronger
+	float lobe = 0.5 + ((1.0 / 4.0 - 0.04) - 0.5) * strength;
+	float clip = 1.0 / lobe;
+
+	vec3 color_sum = vec3(0.0);
+	float weight_sum = 0.0;
+	easu_tap(color_sum, weight_sum, vec2(0.0, -1.0) - fraction, direction, stretch, lobe, clip, b);
+	easu_tap(color_sum, weight_sum, vec2(1.0, -1.0) - fraction, direction, stretch, lobe, clip, c);
+	easu_tap(color_sum, weight_sum, vec2(-1.0, 0.0) - fraction, direction, stretch, lobe, clip, e);
+	easu_tap(color_sum, weight_sum, vec2(0.0, 0.0) - fraction, direction, stretch, lobe, clip, f);
+	easu_tap(color_sum, weight_sum, vec2(1.0, 0.0) - fraction, direction, stretch, lobe, clip, g);
+	easu_tap(color_sum, weight_sum, vec2(2.0, 0.0) - fraction, direction, stretch, lobe, clip, h);
+	easu_tap(color_sum, weight_sum, vec2(-1.0, 1.0) - fraction, direction, stretch, lobe, clip, i);
+	easu_tap(color_sum, weight_sum, vec2(0.0, 1.0) - fraction, direction, stretch, lobe, clip, j);
+	easu_tap(color_sum, weight_sum, vec2(1.0, 1.0) - fraction, direction, stretch, lobe, clip, k);
+	easu_tap(color_sum, weight_sum, vec2(2.0, 1.0) - fraction, direction, stretch, lobe, clip, l);
+	easu_tap(color_sum, weight_sum, vec2(0.0, 2.0) - fraction, direction, stretch, lobe, clip, n);
+	easu_tap(color_sum, weight_sum, vec2(1.0, 2.0) - fraction, direction, stretch, lobe, clip, o);
+
+	vec3 nearest_min = min(min(f, g), min(j, k));
+	vec3 nearest_max = max(max(f, g), max(j, k));
+	color = vec4(clamp(color_sum / weight_sum, nearest_min, nearest_max), 1.0);
+}
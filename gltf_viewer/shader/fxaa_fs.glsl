@@ -0,0 +1,118 @@
+#version 410 core
+
+// FXAA over the scene color, after the approach of FXAA 3.11's quality preset. Pixels with enough luma contrast
+// to their neighbours are on an edge. The edge is followed both ways until its luma changes, and the pixel is
+// sampled off center towards the edge by how close it is to the edge's nearer end. Pixels that stand out from all
+// their neighbours are blended as well, by how much they do.
+
+in vec2 texture_coordinate;
+
+out vec4 color;
+
+uniform sampler2D screen_texture;
+
+// Contrast below the larger of these, relative to the brightest neighbour and absolute, isn't an edge
+const float EDGE_THRESHOLD = 0.125;
+const float EDGE_THRESHOLD_MIN = 0.0312;
+const float SUBPIXEL_QUALITY = 0.75;
+const int SEARCH_STEPS = 8;
+const float SEARCH_STEP_SIZES[SEARCH_STEPS] = float[](1.0, 1.5, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);
+
+// The scene color is already gamma encoded, so its luma is close enough to perceptual
+float fxaa_luma(vec2 uv) {
+	return dot(texture(screen_texture, uv).rgb, vec3(0.299, 0.587, 0.114));
+}
+
+void main() {
+	vec2 texel = 1.0 / vec2(textureSize(screen_texture, 0));
+	vec2 uv = texture_coordinate;
+	vec4 center_color = texture(screen_texture, uv);
+	float luma_center = dot(center_color.rgb, vec3(0.299, 0.587, 0.114));
+	float luma_north = fxaa_luma(uv + vec2(0.0, texel.y));
+	float luma_south = fxaa_luma(uv - vec2(0.0, texel.y));
+	float luma_east = fxaa_luma(uv + vec2(texel.x, 0.0));
+	float luma_west = fxaa_luma(uv - vec2(texel.x, 0.0));
+
+	float luma_min = min(luma_center, min(min(luma_north, luma_south), min(luma_east, luma_west)));
+	float luma_max = max(luma_center, max(max(luma_north, luma_south), max(luma_east, luma_west)));
+	float luma_range = luma_max - luma_min;
+	if (luma_range < max(EDGE_THRESHOLD_MIN, luma_max * EDGE_THRESHOLD)) {
+		color = center_color;
+		return;
+	}
+
+	float luma_north_east = fxaa_luma(uv + texel);
+	float luma_south_west = fxaa_luma(uv - texel);
+	float luma_north_west = fxaa_luma(uv + vec2(-texel.x, texel.y));
+	float luma_south_east = fxaa_luma(uv + vec2(texel.x, -texel.y));
+
+	// Whichever way the luma changes more across is the edge's normal
+	float edge_horizontal = abs(luma_north_west + luma_south_west - 2.0 * luma_west) + 2.0 * abs(luma_north + luma_south - 2.0 * luma_center) + abs(luma_north_east + luma_south_east - 2.0 * luma_east);
+	float edge_vertical = abs(luma_north_west + luma_north_east - 2.0 * luma_north) + 2.0 * abs(luma_west + luma_east - 2.0 * luma_center) + abs(luma_south_west + luma_south_east - 2.0 * luma_south);
+	bool horizontal = edge_horizontal >= edge_vertical;
+
+	// The side of the pixel with the steeper gradient is where the edge lies
+	float luma_negative = horizontal ? luma_south : luma_west;
+	float luma_positive = horizontal ? luma_north : luma_east;
+	float gradient_negative = luma_negative - luma_center;
+	float gradient_positive = luma_positive - luma_center;
+	bool negative_steepest = abs(gradient_negative) >= abs(gradient_positive);
+	float gradient_scaled = 0.25 * max(abs(gradient_negative), abs(gradient_positive));
+	float step_length = horizontal ? texel.y : texel.x;
+	float luma_local_average;
+	if (negative_steepest) {
+		step_length = -step_length;
+		luma_local_average = 0.5 * (luma_negative + luma_center);
+	} else {
+		luma_local_average = 0.5 * (luma_positive + luma_center);
+	}
+
+	// Walk along the edge, half a pixel over, until the luma no longer matches it at each end
+	vec2 edge_uv = uv;
+	if (horizontal) {
+		edge_uv.y += step_length * 0.5;
+	} else {
+		edge_uv.x += step_length * 0.5;
+	}
+	vec2 search_step = horizontal ? vec2(texel.x, 0.0) : vec2(0.0, texel.y);
+	vec2 uv_backward = edge_uv;
+	vec2 uv_forward = edge_uv;
+	float luma_end_backward = 0.0;
+	float luma_end_forward = 0.0;
+	bool reached_backward = false;
+	bool reached_forward = false;
+	for (int i = 0; i < SEARCH_STEPS && !(reached_backward && reached_forward); i++) {
+		if (!reached_backward) {
+			uv_backward -= search_step * SEARCH_STEP_SIZES[i];
+			luma_end_backward = fxaa_luma(uv_backward) - luma_local_average;
+			reached_backward = abs(luma_end_backward) >= gradient_scaled;
+		}
+		if (!reached_forward) {
+			uv_forward += search_step * SEARCH_STEP_SIZES[i];
+			luma_end_forward = fxaa_luma(uv_forward) - luma_local_average;
+			reached_forward = abs(luma_end_forward) >= gradient_scaled;
+		}
+	}
+
+	float distance_backward = horizontal ? uv.x - uv_backward.x : uv.y - uv_backward.y;
+	float distance_forward = horizontal ? uv_forward.x - uv.x : uv_forward.y - uv.y;
+	bool backward_nearer = distance_backward < distance_forward;
+	float distance_nearer = min(distance_backward, distance_forward);
+	float edge_offset = 0.5 - distance_nearer / (distance_backward + distance_forward);
+	// Only move towards the edge if the nearer end's luma goes the other way to this pixel's
+	bool center_smaller = luma_center < luma_local_average;
+	bool correct_variation = ((backward_nearer ? luma_end_backward : luma_end_forward) < 0.0) != center_smaller;
+	float pixel_offset = correct_variation ? edge_offset : 0.0;
+
+	float luma_average = (2.0 * (luma_north + luma_south + luma_east + luma_west) + luma_north_east + luma_north_west + luma_south_east + luma_south_west) / 12.0;
+	float subpixel = clamp(abs(luma_average - luma_center) / luma_range, 0.0, 1.0);
+	subpixel = (-2.0 * subpixel + 3.0) * subpixel * subpixel;
+	pixel_offset = max(pixel_offset, subpixel * subpixel * SUBPIXEL_QUALITY);
+
+	if (horizontal) {
+		uv.y += pixel_offset * step_length;
+	} else {
+		uv.x += pixel_offset * step_length;
+	}
+	color = texture(screen_texture, uv);
+}
@@ -0,0 +1,31 @@
+// G-buffer layout for deferred shading, pulled in with #include "gbuffer.glsl"
+//   0 RGBA8:  albedo, gamma encoded so the 8 bits go further in the darks, and ambient occlusion
+//   1 RGBA16: octahedral normal, metallic and roughness
+// Position isn't stored, it is rebuilt from the depth buffer.
+
+// Folds the lower hemisphere of the octahedron over the upper one, then maps it to [0, 1]
+vec2 gbuffer_encode_normal(vec3 normal) {
+	normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+	vec2 encoded = normal.xy;
+	if (normal.z < 0.0) {
+		encoded = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return encoded * 0.5 + 0.5;
+}
+
+vec3 gbuffer_decode_normal(vec2 encoded) {
+	encoded = encoded * 2.0 - 1.0;
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.x += normal.x >= 0.0 ? -fold : fold;
+	normal.y += normal.y >= 0.0 ? -fold : fold;
+	return normalize(normal);
+}
+
+vec4 gbuffer_pack_albedo(vec3 albedo, float ao) {
+	return vec4(pow(albedo, vec3(1.0 / 2.2)), ao);
+}
+
+vec4 gbuffer_pack_normal(vec3 normal, float metallic, float roughness) {
+	return vec4(gbuffer_encode_normal(normal), metallic, roughness);
+}
@@ -0,0 +1,28 @@
+#version 410 core
+
+layout (location = 0) out vec4 gbuffer_albedo;
+layout (location = 1) out vec4 gbuffer_normal;
+
+in vec2 texture_coordinates;
+in vec3 world_position;
+in vec3 normal_in;
+
+#include "pbr_material.glsl"
+#include "lod_dither.glsl"
+#include "gbuffer.glsl"
+
+void main() {
+	if (lod_dither_discard(lod_fade)) {
+		discard;
+	}
+
+	vec3 normal = normalize(normal_in);
+	vec3 albedo;
+	float metallic;
+	float roughness;
+	float ao;
+	pbr_material(texture_coordinates, world_position, normal, albedo, metallic, roughness, ao);
+
+	gbuffer_albedo = gbuffer_pack_albedo(albedo, ao);
+	gbuffer_normal = gbuffer_pack_normal(normal, metallic, roughness);
+}
@@ -0,0 +1,28 @@
+#version 430 core
+
+layout (location = 0) out vec4 gbuffer_albedo;
+layout (location = 1) out vec4 gbuffer_normal;
+
+in vec2 texture_coordinates;
+in vec3 world_position;
+in vec3 normal_in;
+flat in uint material_index;
+
+struct Material {
+	vec3 albedo;
+	float metallic;
+	float roughness;
+	float ao;
+};
+
+layout (std430, binding = 1) readonly buffer material_buffer {
+	Material materials[];
+};
+
+#include "gbuffer.glsl"
+
+void main() {
+	Material material = materials[material_index];
+	gbuffer_albedo = gbuffer_pack_albedo(material.albedo, material.ao);
+	gbuffer_normal = gbuffer_pack_normal(normalize(normal_in), material.metallic, material.roughness);
+}
@@ -2,8 +2,8 @@
 
 out vec4 color;
 
-uniform vec3 light_color;
+uniform vec3 u_albedo;
 
 void main() {
-	color = vec4(light_color, 1.0);
+	color = vec4(u_albedo, 1.0);
 }
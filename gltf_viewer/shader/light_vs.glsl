@@ -7,6 +7,11 @@ layout (location = 2) in vec2 a_texture_coordinates;
 uniform mat4 projection_view;
 uniform mat4 model;
 
+#include "vertex_decode.glsl"
+
+// The depth pre-pass draws lights with this shader too, and the opaque pass tests equal to its depth
+invariant gl_Position;
+
 void main() {
-	gl_Position = projection_view * model * vec4(a_position, 1.0);
+	gl_Position = projection_view * model * vec4(decode_position(a_position), 1.0);
 }
\ No newline at end of file
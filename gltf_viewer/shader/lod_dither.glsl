@@ -0,0 +1,20 @@
+// Detail level cross fade, see RenderDraw::lod_fade. Shared with depth_fs.glsl so the depth pre-pass drops the same
+// pixels as the shaded pass.
+uniform float lod_fade;
+
+// 4x4 ordered dither thresholds, so two complementary fades cover each pixel exactly once
+const float DITHER_THRESHOLDS[16] = float[](
+	0.0 / 16.0, 8.0 / 16.0, 2.0 / 16.0, 10.0 / 16.0,
+	12.0 / 16.0, 4.0 / 16.0, 14.0 / 16.0, 6.0 / 16.0,
+	3.0 / 16.0, 11.0 / 16.0, 1.0 / 16.0, 9.0 / 16.0,
+	15.0 / 16.0, 7.0 / 16.0, 13.0 / 16.0, 5.0 / 16.0
+);
+
+bool lod_dither_discard(float fade) {
+	if (fade == 0.0) {
+		return false;
+	}
+	ivec2 pixel = ivec2(gl_FragCoord.xy) % 4;
+	float threshold = DITHER_THRESHOLDS[pixel.y * 4 + pixel.x];
+	return (fade > 0.0) != (threshold < abs(fade));
+}
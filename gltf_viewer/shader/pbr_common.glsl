@@ -0,0 +1,193 @@
+// Shared Cook-Torrance + IBL lighting, pulled in with #include "pbr_common.glsl"
+
+// Clustered point lights, see light_cluster.h. Two texels per light, position and radius then color, and an offset
+// and count per cluster into the light index list.
+uniform samplerBuffer cluster_light_data;
+uniform usamplerBuffer cluster_grid;
+uniform usamplerBuffer cluster_light_indices;
+uniform uvec3 cluster_dimensions;
+uniform vec2 cluster_tile_size;
+uniform vec2 cluster_depth_range;
+uniform float cluster_slice_scale;
+
+// The sun and its cascaded shadow maps, see shadow.h. Cascades whose y is 0 haven't been rendered, and the sun is
+// off while the w of its direction is 0.
+const int SHADOW_MAX_CASCADES = 4;
+layout (std140) uniform shadow_data {
+	mat4 shadow_matrices[SHADOW_MAX_CASCADES];
+	vec4 shadow_tiles[SHADOW_MAX_CASCADES];
+	vec4 shadow_cascades[SHADOW_MAX_CASCADES];
+	vec4 sun_direction;
+	vec4 sun_color;
+};
+uniform sampler2DShadow shadow_atlas;
+
+uniform samplerCube irradiance_map;
+uniform samplerCube prefilter_map;
+uniform sampler2D brdf_lookup_texture;
+
+const float PI = 3.14159265359;
+
+float distribution_ggx(vec3 normal, vec3 halfway, float roughness) {
+	float a = roughness * roughness;
+	float a_squared = a * a;
+	float n_dot_h = max(dot(normal, halfway), 0.0);
+	float n_dot_h_squared = n_dot_h * n_dot_h;
+
+	float denominator = (n_dot_h_squared * (a_squared - 1.0) + 1.0);
+	denominator = PI * denominator * denominator;
+
+	return a_squared / denominator;
+}
+
+float geometry_schlick_ggx(float n_dot_v, float roughness) {
+	float r = roughness + 1.0;
+	float k = (r * r) / 8.0;
+
+	float denominator = n_dot_v * (1.0 - k) + k;
+	return n_dot_v / denominator;
+}
+
+float geometry_smith(vec3 normal, vec3 view_direction, vec3 light_direction, float roughness) {
+	float n_dot_v = max(dot(normal, view_direction), 0.0);
+	float n_dot_l = max(dot(normal, light_direction), 0.0);
+	float ggx2 = geometry_schlick_ggx(n_dot_v, roughness);
+	float ggx1 = geometry_schlick_ggx(n_dot_l, roughness);
+
+	return ggx1 * ggx2;
+}
+
+vec3 fresnel_schlick(float cos_theta, vec3 base_reflectivity) {
+	return base_reflectivity + (1.0 - base_reflectivity) * pow(clamp(1.0 - cos_theta, 0.0, 1.0), 5.0);
+}
+
+vec3 fresnel_schlick_roughness(float cos_theta, vec3 base_reflectivity, float roughness) {
+	return base_reflectivity + (max(vec3(1.0 - roughness), base_reflectivity) - base_reflectivity) * pow(clamp(1.0 - cos_theta, 0.0, 1.0), 5.0);
+}
+
+// Radiance reflected towards the viewer from light arriving from light_direction
+vec3 pbr_direct_light(vec3 normal, vec3 view_direction, vec3 albedo, float metallic, float roughness, vec3 base_reflectivity, vec3 light_direction, vec3 radiance) {
+	vec3 halfway = normalize(view_direction + light_direction);
+
+	// Cook-torrance BRDF
+	float NDF = distribution_ggx(normal, halfway, roughness);
+	float G = geometry_smith(normal, view_direction, light_direction, roughness);
+	vec3 light_reflected = fresnel_schlick(clamp(dot(halfway, view_direction), 0.0, 1.0), base_reflectivity);
+	// the refracted light is any light that wasn't reflected
+	// we also multiply by 1 - metallic in order to reinforce the property that metallic surfaces don't have refractions
+	vec3 light_refracted = (vec3(1.0) - light_reflected) * (1.0 - metallic);
+
+	vec3 numerator = NDF * G * light_reflected;
+	// adding 0.0001 to this prevents division by 0 in the case that the dot products are 0
+	float denominator = 4.0 * max(dot(normal, view_direction), 0.0) * max(dot(normal, light_direction), 0.0) + 0.0001;
+	vec3 specular = numerator / denominator;
+
+	float n_dot_l = max(dot(normal, light_direction), 0.0);
+	return (light_refracted * albedo / PI + specular) * radiance * n_dot_l;
+}
+
+// Radiance reflected towards the viewer from a single point light
+vec3 pbr_point_light(vec3 world_position, vec3 normal, vec3 view_direction, vec3 albedo, float metallic, float roughness, vec3 base_reflectivity, vec3 light_position, float light_radius, vec3 light_color) {
+	vec3 light_direction = normalize(light_position - world_position);
+	float light_distance = length(light_position - world_position);
+	// Inverse square, windowed to reach zero at the radius the light was clustered with
+	float falloff = clamp(1.0 - pow(light_distance / light_radius, 4.0), 0.0, 1.0);
+	float attenuation = falloff * falloff / max(light_distance * light_distance, 0.0001);
+
+	return pbr_direct_light(normal, view_direction, albedo, metallic, roughness, base_reflectivity, light_direction, light_color * attenuation);
+}
+
+// Fraction of the sun reaching the point, from the first rendered cascade that covers it. The lookup is pushed out
+// along the normal by a texel or two, more as the sun grazes the surface, then filtered over 3x3 texels. Points no
+// cascade covers are lit.
+float shadow_sun_visibility(vec3 world_position, vec3 normal) {
+	vec2 atlas_texel = 1.0 / vec2(textureSize(shadow_atlas, 0));
+	float n_dot_l = clamp(dot(normal, sun_direction.xyz), 0.0, 1.0);
+	for (int i = 0; i < SHADOW_MAX_CASCADES; i++) {
+		vec4 cascade = shadow_cascades[i];
+		if (cascade.y == 0.0) {
+			continue;
+		}
+		vec3 offset_position = world_position + normal * cascade.x * (1.0 + 2.0 * (1.0 - n_dot_l));
+		// Orthographic, so no divide
+		vec3 coordinates = (shadow_matrices[i] * vec4(offset_position, 1.0)).xyz;
+		vec4 tile = shadow_tiles[i];
+		vec2 margin = atlas_texel * 1.5 / tile.zw;
+		if (any(lessThan(coordinates.xy, margin)) || any(greaterThan(coordinates.xy, 1.0 - margin)) || coordinates.z > 1.0) {
+			continue;
+		}
+
+		vec2 atlas_position = tile.xy + coordinates.xy * tile.zw;
+		float lit = 0.0;
+		for (int y = -1; y <= 1; y++) {
+			for (int x = -1; x <= 1; x++) {
+				lit += texture(shadow_atlas, vec3(atlas_position + vec2(x, y) * atlas_texel, max(coordinates.z, 0.0)));
+			}
+		}
+		return lit / 9.0;
+	}
+	return 1.0;
+}
+
+// Image based ambient lighting from the irradiance and prefiltered environment maps
+vec3 pbr_ambient(vec3 normal, vec3 view_direction, vec3 albedo, float metallic, float roughness, float ao, vec3 base_reflectivity) {
+	vec3 reflected = reflect(-view_direction, normal);
+
+	// IBL diffuse
+	vec3 light_reflected = fresnel_schlick_roughness(max(dot(normal, view_direction), 0.0), base_reflectivity, roughness);
+	vec3 light_refracted = (vec3(1.0) - light_reflected) * (1.0 - metallic);
+	vec3 irradiance = texture(irradiance_map, normal).rgb;
+	vec3 diffuse = irradiance * albedo;
+
+	// IBL specular
+	const float MAX_RELFECTION_LOD = 4.0;
+	vec3 prefiltered_color = textureLod(prefilter_map, reflected, roughness * MAX_RELFECTION_LOD).rgb;
+	vec2 brdf = texture(brdf_lookup_texture, vec2(max(dot(normal, view_direction), 0.0), roughness)).rg;
+	vec3 specular = prefiltered_color * (light_reflected * brdf.x + brdf.y);
+
+	return (light_refracted * diffuse + specular) * ao;
+}
+
+// Cluster of the fragment at this pixel and window space depth, matching light_cluster_index() on the CPU
+uint cluster_index(vec2 pixel, float window_depth) {
+	float near = cluster_depth_range.x;
+	float far = cluster_depth_range.y;
+	float depth = 2.0 * near * far / (far + near - (2.0 * window_depth - 1.0) * (far - near));
+	uint slice = uint(clamp(log(depth / near) * cluster_slice_scale, 0.0, float(cluster_dimensions.z - 1u)));
+	uvec2 tile = min(uvec2(pixel / cluster_tile_size), cluster_dimensions.xy - 1u);
+	return (slice * cluster_dimensions.y + tile.y) * cluster_dimensions.x + tile.x;
+}
+
+// Returns tone mapped, gamma corrected color. The pixel and its window space depth pick the light cluster.
+vec3 pbr_shade_at(vec2 pixel, float window_depth, vec3 world_position, vec3 normal, vec3 view_direction, vec3 albedo, float metallic, float roughness, float ao) {
+	vec3 base_reflectivity = vec3(0.04);
+	base_reflectivity = mix(base_reflectivity, albedo, metallic);
+
+	vec3 Lo = vec3(0.0);
+	uvec2 cluster = texelFetch(cluster_grid, int(cluster_index(pixel, window_depth))).rg;
+	for (uint i = 0u; i < cluster.y; i++) {
+		int light = int(texelFetch(cluster_light_indices, int(cluster.x + i)).r);
+		vec4 light_position = texelFetch(cluster_light_data, light * 2);
+		vec3 light_color = texelFetch(cluster_light_data, light * 2 + 1).rgb;
+		Lo += pbr_point_light(world_position, normal, view_direction, albedo, metallic, roughness, base_reflectivity, light_position.xyz, light_position.w, light_color);
+	}
+
+	if (sun_direction.w != 0.0 && dot(normal, sun_direction.xyz) > 0.0) {
+		vec3 radiance = sun_color.rgb * shadow_sun_visibility(world_position, normal);
+		Lo += pbr_direct_light(normal, view_direction, albedo, metallic, roughness, base_reflectivity, sun_direction.xyz, radiance);
+	}
+
+	vec3 _color = pbr_ambient(normal, view_direction, albedo, metallic, roughness, ao, base_reflectivity) + Lo;
+
+	// Reinhard tone mapping (HDR)
+	_color = _color / (_color + vec3(1.0));
+	// Gamma correction
+	_color = pow(_color, vec3(1.0 / 2.2));
+
+	return _color;
+}
+
+// Shades the current fragment
+vec3 pbr_shade(vec3 world_position, vec3 normal, vec3 view_direction, vec3 albedo, float metallic, float roughness, float ao) {
+	return pbr_shade_at(gl_FragCoord.xy, gl_FragCoord.z, world_position, normal, view_direction, albedo, metallic, roughness, ao);
+}
@@ -0,0 +1,31 @@
+#version 430 core
+
+out vec4 color;
+
+in vec2 texture_coordinates;
+in vec3 world_position;
+in vec3 normal_in;
+flat in uint material_index;
+
+uniform vec3 view_position;
+
+struct Material {
+	vec3 albedo;
+	float metallic;
+	float roughness;
+	float ao;
+};
+
+layout (std430, binding = 1) readonly buffer material_buffer {
+	Material materials[];
+};
+
+#include "pbr_common.glsl"
+
+void main() {
+	Material material = materials[material_index];
+	vec3 view_direction = normalize(view_position - world_position);
+	vec3 normal = normalize(normal_in);
+
+	color = vec4(pbr_shade(world_position, normal, view_direction, material.albedo, material.metallic, material.roughness, material.ao), 1.0);
+}
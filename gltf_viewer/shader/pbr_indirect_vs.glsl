@@ -0,0 +1,40 @@
+#version 430 core
+
+layout (location = 0) in vec3 a_position;
+layout (location = 1) in vec3 a_normal;
+layout (location = 2) in vec2 a_texture_coordinates;
+// Instanced attribute offset by each command's base_instance, so it holds the draw index
+layout (location = 3) in uint a_draw_id;
+
+struct DrawData {
+	mat4 model;
+	mat4 normal_matrix;
+	uint material;
+};
+
+layout (std430, binding = 0) readonly buffer draw_data_buffer {
+	DrawData draws[];
+};
+
+out vec2 texture_coordinates;
+out vec3 world_position;
+out vec3 normal_in;
+flat out uint material_index;
+
+uniform mat4 projection_view;
+
+#include "vertex_decode.glsl"
+
+// Depth written by depth_indirect_vs.glsl is tested for equality
+invariant gl_Position;
+
+void main() {
+	DrawData draw = draws[a_draw_id];
+
+	texture_coordinates = a_texture_coordinates;
+	world_position = vec3(draw.model * vec4(decode_position(a_position), 1.0));
+	normal_in = mat3(draw.normal_matrix) * decode_normal(a_normal);
+	material_index = draw.material;
+
+	gl_Position = projection_view * vec4(world_position, 1.0);
+}
@@ -0,0 +1,41 @@
+// Surface inputs of the per draw PBR programs, pulled in with #include "pbr_material.glsl". Reads the material
+// maps, or the draw's material uniforms when they are off.
+uniform bool use_material_maps;
+
+uniform sampler2D albedo_map;
+uniform sampler2D normal_map;
+uniform sampler2D metallic_map;
+uniform sampler2D roughness_map;
+uniform sampler2D ao_map;
+
+uniform float u_ao;
+uniform float u_metallic;
+uniform float u_roughness;
+uniform vec3 u_albedo;
+
+// Samples the maps with the given screen space derivatives of the texture coordinates and world position, for
+// passes that rebuild them instead of taking them from dFdx and dFdy. Perturbs normal by the normal map.
+void pbr_material_maps(vec2 texture_coordinates, vec2 st1, vec2 st2, vec3 q1, vec3 q2, inout vec3 normal, out vec3 albedo, out float metallic, out float roughness, out float ao) {
+	albedo = pow(textureGrad(albedo_map, texture_coordinates, st1, st2).rgb, vec3(2.2));
+	metallic = textureGrad(metallic_map, texture_coordinates, st1, st2).r;
+	roughness = textureGrad(roughness_map, texture_coordinates, st1, st2).r;
+	ao = textureGrad(ao_map, texture_coordinates, st1, st2).r;
+
+	vec3 tangent_normal = textureGrad(normal_map, texture_coordinates, st1, st2).xyz * 2.0 - 1.0;
+	vec3 n = normalize(normal);
+	vec3 t = normalize(q1 * st2.t - q2 * st1.t);
+	vec3 b = -normalize(cross(n, t));
+	normal = normalize(mat3(t, b, n) * tangent_normal);
+}
+
+// The normal map perturbs normal, which comes in as the interpolated vertex normal
+void pbr_material(vec2 texture_coordinates, vec3 world_position, inout vec3 normal, out vec3 albedo, out float metallic, out float roughness, out float ao) {
+	if (use_material_maps) {
+		pbr_material_maps(texture_coordinates, dFdx(texture_coordinates), dFdy(texture_coordinates), dFdx(world_position), dFdy(world_position), normal, albedo, metallic, roughness, ao);
+	} else {
+		albedo = u_albedo;
+		metallic = u_metallic;
+		roughness = u_roughness;
+		ao = u_ao;
+	}
+}
@@ -12,10 +12,15 @@ uniform mat4 projection_view;
 uniform mat4 model;
 uniform mat3 normal_matrix;
 
+#include "vertex_decode.glsl"
+
+// Depth written by depth_vs.glsl is tested for equality
+invariant gl_Position;
+
 void main() {
 	texture_coordinates = a_texture_coordinates;
-	world_position = vec3(model * vec4(a_position, 1.0));
-	normal_in = normal_matrix * a_normal;
+	world_position = vec3(model * vec4(decode_position(a_position), 1.0));
+	normal_in = normal_matrix * decode_normal(a_normal);
 
 	gl_Position = projection_view * vec4(world_position, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+#version 410 core
+
+// Contrast adaptive sharpening, after the approach of FSR 1's RCAS. Each pixel is sharpened with a negative lobe
+// on its 4 neighbours, as strong as it can be without the result leaving the range [0, 1] in any channel, which
+// is what keeps it from ringing. The sharpness uniform scales that limit down.
+
+out vec4 color;
+
+uniform sampler2D screen_texture;
+// exp2 of minus the stops of sharpness taken off, 1 for the most
+uniform float sharpness;
+
+// The most negative lobe allowed, past it the 5 tap kernel starts to look like a box
+const float RCAS_LIMIT = 0.25 - 1.0 / 16.0;
+
+void main() {
+	ivec2 limit = textureSize(screen_texture, 0) - 1;
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec3 up = texelFetch(screen_texture, clamp(pixel + ivec2(0, 1), ivec2(0), limit), 0).rgb;
+	vec3 left = texelFetch(screen_texture, clamp(pixel - ivec2(1, 0), ivec2(0), limit), 0).rgb;
+	vec3 center = texelFetch(screen_texture, pixel, 0).rgb;
+	vec3 right = texelFetch(screen_texture, clamp(pixel + ivec2(1, 0), ivec2(0), limit), 0).rgb;
+	vec3 down = texelFetch(screen_texture, clamp(pixel - ivec2(0, 1), ivec2(0), limit), 0).rgb;
+
+	// Lobe weights that would take the darkest neighbour to 0 or the brightest to 1, per channel
+	vec3 neighbour_min = min(min(up, down), min(left, right));
+	vec3 neighbour_max = max(max(up, down), max(left, right));
+	vec3 hit_min = min(neighbour_min, center) / max(4.0 * max(neighbour_max, center), vec3(1.0 / 65536.0));
+	vec3 hit_max = (1.0 - max(neighbour_max, center)) / min(4.0 * min(neighbour_min, center) - 4.0, vec3(-1.0 / 65536.0));
+	vec3 lobe_rgb = max(-hit_min, hit_max);
+	float lobe = max(-RCAS_LIMIT, min(max(lobe_rgb.r, max(lobe_rgb.g, lobe_rgb.b)), 0.0)) * sharpness;
+
+	color = vec4((lobe * (up + left + right + down) + center) / (4.0 * lobe + 1.0), 1.0);
+}
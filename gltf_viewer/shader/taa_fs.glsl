@@ -0,0 +1,48 @@
+#version 410 core
+
+// Blends the jittered scene color into the history. Each pixel's world position is rebuilt from the depth and
+// projected with last frame's camera to find it in the history, which is then clamped to the range of the current
+// 3x3 neighbourhood, since anything outside it can't be this surface. The history is window sized, so the scene
+// may be smaller when the render scale is below 1.
+
+in vec2 texture_coordinate;
+
+out vec4 color;
+
+uniform sampler2D scene_color;
+uniform sampler2D scene_depth;
+uniform sampler2D history;
+
+// This frame's, jittered as it was rendered, and last frame's without jitter
+uniform mat4 inverse_projection_view;
+uniform mat4 previous_projection_view;
+// 1 when there is no history
+uniform float current_weight;
+
+void main() {
+	vec2 texel = 1.0 / vec2(textureSize(scene_color, 0));
+	vec2 uv = texture_coordinate;
+	vec4 current = texture(scene_color, uv);
+
+	vec3 neighbourhood_min = current.rgb;
+	vec3 neighbourhood_max = current.rgb;
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			vec3 neighbour = texture(scene_color, uv + vec2(x, y) * texel).rgb;
+			neighbourhood_min = min(neighbourhood_min, neighbour);
+			neighbourhood_max = max(neighbourhood_max, neighbour);
+		}
+	}
+
+	float depth = texture(scene_depth, uv).r;
+	vec4 world_position = inverse_projection_view * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+	vec4 previous_position = previous_projection_view * vec4(world_position.xyz / world_position.w, 1.0);
+	vec2 previous_uv = previous_position.xy / previous_position.w * 0.5 + 0.5;
+
+	float weight = current_weight;
+	if (any(lessThan(previous_uv, vec2(0.0))) || any(greaterThan(previous_uv, vec2(1.0)))) {
+		weight = 1.0;
+	}
+	vec3 history_color = clamp(texture(history, previous_uv).rgb, neighbourhood_min, neighbourhood_max);
+	color = vec4(mix(history_color, current.rgb, weight), current.a);
+}
@@ -0,0 +1,20 @@
+// Undoes the vertex format chosen in vertex_format.h. Full float vertices pass through with an offset of 0 and a
+// scale of 1.
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+uniform bool octahedral_normals;
+
+vec3 decode_position(vec3 position) {
+	return position_offset + position * position_scale;
+}
+
+// Octahedral normals arrive as xy with z filled in as 0
+vec3 decode_normal(vec3 normal) {
+	if (octahedral_normals) {
+		normal = vec3(normal.xy, 1.0 - abs(normal.x) - abs(normal.y));
+		float fold = max(-normal.z, 0.0);
+		normal.x += normal.x >= 0.0 ? -fold : fold;
+		normal.y += normal.y >= 0.0 ? -fold : fold;
+	}
+	return normalize(normal);
+}
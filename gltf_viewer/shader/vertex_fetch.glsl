@@ -0,0 +1,78 @@
+// Reads vertices straight out of the shared mesh buffer, for passes with no vertex stage to do it. The vertex buffer
+// is bound as 16 bit texels and decoded the way the vertex attributes in vertex_format.cpp would be. Pulled in after
+// vertex_decode.glsl, which undoes the quantization.
+uniform usamplerBuffer mesh_vertices;
+uniform usamplerBuffer mesh_indices;
+// Encoding and offset of the position, normal and texture coordinates. Offsets and stride count 16 bit texels.
+uniform uvec3 vertex_encodings;
+uniform uvec3 vertex_offsets;
+uniform uint vertex_stride;
+
+// Matches VertexEncoding in vertex_format.h
+const uint VERTEX_ENCODING_FLOAT = 0u;
+const uint VERTEX_ENCODING_UNORM16 = 1u;
+const uint VERTEX_ENCODING_OCTAHEDRAL_SNORM16 = 2u;
+const uint VERTEX_ENCODING_SNORM10 = 3u;
+const uint VERTEX_ENCODING_HALF = 4u;
+
+uint fetch_u16(uint texel) {
+	return texelFetch(mesh_vertices, int(texel)).r;
+}
+
+uint fetch_u32(uint texel) {
+	return fetch_u16(texel) | (fetch_u16(texel + 1u) << 16);
+}
+
+// Signed normalized values map the most negative integer to -1 as well, like GL does
+float fetch_snorm(uint value, uint bits) {
+	uint sign_bit = 1u << (bits - 1u);
+	int signed_value = int(value) - (value >= sign_bit ? int(sign_bit << 1) : 0);
+	return max(float(signed_value) / float(sign_bit - 1u), -1.0);
+}
+
+// unpackHalf2x16() needs GLSL 4.20. Infinities and NaNs aren't expected in vertex data.
+float fetch_half(uint value) {
+	uint exponent = (value >> 10) & 31u;
+	float mantissa = float(value & 1023u) / 1024.0;
+	float magnitude = exponent == 0u ? mantissa * exp2(-14.0) : (1.0 + mantissa) * exp2(float(exponent) - 15.0);
+	return (value & 32768u) != 0u ? -magnitude : magnitude;
+}
+
+// Octahedral normals come back as xy with z as 0, ready for decode_normal()
+vec3 fetch_attribute(uint vertex, uint encoding, uint offset, uint components) {
+	uint texel = vertex * vertex_stride + offset;
+	vec3 value = vec3(0.0);
+	if (encoding == VERTEX_ENCODING_SNORM10) {
+		uint bits = fetch_u32(texel);
+		return vec3(fetch_snorm(bits & 1023u, 10u), fetch_snorm((bits >> 10) & 1023u, 10u), fetch_snorm((bits >> 20) & 1023u, 10u));
+	}
+	for (uint i = 0u; i < components; i++) {
+		if (encoding == VERTEX_ENCODING_FLOAT) {
+			value[i] = uintBitsToFloat(fetch_u32(texel + i * 2u));
+		} else if (encoding == VERTEX_ENCODING_UNORM16) {
+			value[i] = float(fetch_u16(texel + i)) / 65535.0;
+		} else if (encoding == VERTEX_ENCODING_OCTAHEDRAL_SNORM16) {
+			value[i] = fetch_snorm(fetch_u16(texel + i), 16u);
+		} else {
+			value[i] = fetch_half(fetch_u16(texel + i));
+		}
+	}
+	return value;
+}
+
+uint fetch_index(uint index) {
+	return texelFetch(mesh_indices, int(index)).r;
+}
+
+vec3 fetch_position(uint vertex) {
+	return decode_position(fetch_attribute(vertex, vertex_encodings.x, vertex_offsets.x, 3u));
+}
+
+vec3 fetch_normal(uint vertex) {
+	uint components = vertex_encodings.y == VERTEX_ENCODING_OCTAHEDRAL_SNORM16 ? 2u : 3u;
+	return decode_normal(fetch_attribute(vertex, vertex_encodings.y, vertex_offsets.y, components));
+}
+
+vec2 fetch_texture_coordinates(uint vertex) {
+	return fetch_attribute(vertex, vertex_encodings.z, vertex_offsets.z, 2u).xy;
+}
@@ -0,0 +1,14 @@
+// Visibility buffer IDs, see visibility.h. The instance is stored one up in the high bits, so 0 means nothing was
+// drawn, and the triangle within the instance's primitive takes the low visibility_triangle_bits.
+uniform uint visibility_triangle_bits;
+
+uint visibility_pack(uint instance, uint triangle) {
+	return ((instance + 1u) << visibility_triangle_bits) | triangle;
+}
+
+// False where nothing was drawn
+bool visibility_unpack(uint id, out uint instance, out uint triangle) {
+	instance = (id >> visibility_triangle_bits) - 1u;
+	triangle = id & ((1u << visibility_triangle_bits) - 1u);
+	return id != 0u;
+}
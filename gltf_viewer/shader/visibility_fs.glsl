@@ -0,0 +1,19 @@
+#version 410 core
+
+// Draws into the visibility buffer with depth_vs.glsl. Strips count their degenerate triangles in gl_PrimitiveID
+// too, which the resolve expects.
+
+layout (location = 0) out uint visibility;
+
+uniform uint visibility_instance;
+
+#include "lod_dither.glsl"
+#include "visibility.glsl"
+
+void main() {
+	if (lod_dither_discard(lod_fade)) {
+		discard;
+	}
+
+	visibility = visibility_pack(visibility_instance, uint(gl_PrimitiveID));
+}
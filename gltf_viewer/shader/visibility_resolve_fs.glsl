@@ -0,0 +1,112 @@
+#version 410 core
+
+// Shades the visibility buffer in one fullscreen pass. Each pixel fetches its triangle's vertices, finds where the
+// view ray through it lands in the triangle, and interpolates the vertex attributes there the way the rasterizer
+// would have. Writes depth for the forward draws that follow.
+
+out vec4 color;
+
+uniform mat4 projection_view;
+uniform vec3 view_position;
+
+#include "pbr_common.glsl"
+#include "pbr_material.glsl"
+#include "vertex_decode.glsl"
+#include "vertex_fetch.glsl"
+#include "visibility.glsl"
+
+uniform usampler2D visibility_buffer;
+// Nine texels per instance, see visibility.cpp. Its transforms and material as float bits, then its first index,
+// base vertex and whether it is a strip.
+uniform usamplerBuffer visibility_instance_data;
+
+// Perspective correct barycentrics of the pixel and how they change one pixel right and one pixel up
+struct Barycentrics {
+	vec3 lambda;
+	vec3 ddx;
+	vec3 ddy;
+};
+
+// Screen space barycentrics are linear in NDC, and perspective correct ones are those over w renormalized, so both
+// and their derivatives come from the plane equations of the projected triangle (Schied and Dachsbacher)
+Barycentrics visibility_barycentrics(vec4 clip0, vec4 clip1, vec4 clip2, vec2 pixel_ndc, vec2 pixel_size_ndc) {
+	vec3 inverse_w = 1.0 / vec3(clip0.w, clip1.w, clip2.w);
+	vec2 ndc0 = clip0.xy * inverse_w.x;
+	vec2 ndc1 = clip1.xy * inverse_w.y;
+	vec2 ndc2 = clip2.xy * inverse_w.z;
+
+	float inverse_determinant = 1.0 / determinant(mat2(ndc2 - ndc1, ndc0 - ndc1));
+	vec3 ddx = vec3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * inverse_determinant * inverse_w;
+	vec3 ddy = vec3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * inverse_determinant * inverse_w;
+	float ddx_sum = dot(ddx, vec3(1.0));
+	float ddy_sum = dot(ddy, vec3(1.0));
+
+	vec2 delta = pixel_ndc - ndc0;
+	float interpolated_inverse_w = inverse_w.x + delta.x * ddx_sum + delta.y * ddy_sum;
+	vec3 lambda_over_w = vec3(inverse_w.x, 0.0, 0.0) + delta.x * ddx + delta.y * ddy;
+
+	Barycentrics result;
+	result.lambda = lambda_over_w / interpolated_inverse_w;
+	ddx *= pixel_size_ndc.x;
+	ddy *= pixel_size_ndc.y;
+	ddx_sum *= pixel_size_ndc.x;
+	ddy_sum *= pixel_size_ndc.y;
+	result.ddx = (lambda_over_w + ddx) / (interpolated_inverse_w + ddx_sum) - result.lambda;
+	result.ddy = (lambda_over_w + ddy) / (interpolated_inverse_w + ddy_sum) - result.lambda;
+	return result;
+}
+
+void main() {
+	uint instance;
+	uint triangle;
+	// Nothing was drawn here, leave it to the sky
+	if (!visibility_unpack(texelFetch(visibility_buffer, ivec2(gl_FragCoord.xy), 0).r, instance, triangle)) {
+		discard;
+	}
+
+	int texel = int(instance) * 9;
+	uvec4 range = texelFetch(visibility_instance_data, texel + 8);
+	uint first_index = range.x + (range.z != 0u ? triangle : triangle * 3u);
+	uint vertices[3];
+	for (uint i = 0u; i < 3u; i++) {
+		vertices[i] = uint(int(fetch_index(first_index + i)) + int(range.y));
+	}
+
+	mat4 model = mat4(uintBitsToFloat(texelFetch(visibility_instance_data, texel)), uintBitsToFloat(texelFetch(visibility_instance_data, texel + 1)), uintBitsToFloat(texelFetch(visibility_instance_data, texel + 2)), uintBitsToFloat(texelFetch(visibility_instance_data, texel + 3)));
+	vec4 normal_metallic = uintBitsToFloat(texelFetch(visibility_instance_data, texel + 4));
+	vec4 normal_roughness = uintBitsToFloat(texelFetch(visibility_instance_data, texel + 5));
+	vec4 normal_ao = uintBitsToFloat(texelFetch(visibility_instance_data, texel + 6));
+	vec3 instance_albedo = uintBitsToFloat(texelFetch(visibility_instance_data, texel + 7)).rgb;
+	mat3 normal_matrix = mat3(normal_metallic.xyz, normal_roughness.xyz, normal_ao.xyz);
+
+	vec3 world_positions[3];
+	vec4 clip_positions[3];
+	for (int i = 0; i < 3; i++) {
+		world_positions[i] = vec3(model * vec4(fetch_position(vertices[i]), 1.0));
+		clip_positions[i] = projection_view * vec4(world_positions[i], 1.0);
+	}
+
+	vec2 screen_size = vec2(textureSize(visibility_buffer, 0));
+	Barycentrics barycentrics = visibility_barycentrics(clip_positions[0], clip_positions[1], clip_positions[2], gl_FragCoord.xy / screen_size * 2.0 - 1.0, 2.0 / screen_size);
+	vec3 lambda = barycentrics.lambda;
+
+	mat3 positions = mat3(world_positions[0], world_positions[1], world_positions[2]);
+	vec3 world_position = positions * lambda;
+	vec3 normal = normalize(normal_matrix * (mat3(fetch_normal(vertices[0]), fetch_normal(vertices[1]), fetch_normal(vertices[2])) * lambda));
+	vec4 clip_position = mat4(clip_positions[0], clip_positions[1], clip_positions[2], vec4(0.0)) * vec4(lambda, 0.0);
+	float depth = clip_position.z / clip_position.w * 0.5 + 0.5;
+
+	vec3 albedo = instance_albedo;
+	float metallic = normal_metallic.w;
+	float roughness = normal_roughness.w;
+	float ao = normal_ao.w;
+	if (use_material_maps) {
+		mat3x2 uvs = mat3x2(fetch_texture_coordinates(vertices[0]), fetch_texture_coordinates(vertices[1]), fetch_texture_coordinates(vertices[2]));
+		vec2 texture_coordinates = uvs * lambda;
+		pbr_material_maps(texture_coordinates, uvs * barycentrics.ddx, uvs * barycentrics.ddy, positions * barycentrics.ddx, positions * barycentrics.ddy, normal, albedo, metallic, roughness, ao);
+	}
+
+	vec3 view_direction = normalize(view_position - world_position);
+	color = vec4(pbr_shade_at(gl_FragCoord.xy, depth, world_position, normal, view_direction, albedo, metallic, roughness, ao), 1.0);
+	gl_FragDepth = depth;
+}
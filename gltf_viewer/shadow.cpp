@@ -0,0 +1,391 @@
+#include "shadow.h"
+#include "gl_state.h"
+#include "gpu_timer.h"
+#include "cpu_profiler.h"
+
+#include <SDL2/SDL.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+// Cascades cover their slice's bounding sphere this many times over, which is how far the camera can move before
+// one has to be rendered again
+static const float CASCADE_PADDING = 1.25f;
+// Blend between logarithmic and uniform splits (Zhang et al.), 1 is fully logarithmic
+static const float SPLIT_LAMBDA = 0.75f;
+// Slope scaled depth bias applied while rendering the casters
+static const float POLYGON_OFFSET_FACTOR = 2.0f;
+static const float POLYGON_OFFSET_UNITS = 4.0f;
+
+// The planning thread's view of a cascade, which assumes its latest planned update gets drawn
+struct ShadowCascade {
+	bool planned;
+	// Light space center, xy snapped to whole texels, and half size of the box the cascade covers
+	glm::vec3 center;
+	float radius;
+	// Sun direction and light space rotation it was planned with
+	glm::vec3 direction;
+	glm::mat4 rotation;
+	glm::mat4 projection_view;
+	uint64_t caster_hash;
+	unsigned int tile;
+	// Plan its latest update went out in
+	unsigned long planned_plan;
+};
+
+// Matches the std140 shadow_data block in pbr_common.glsl
+struct ShadowUniforms {
+	glm::mat4 matrices[SHADOW_MAX_CASCADES];
+	glm::vec4 tiles[SHADOW_MAX_CASCADES];
+	glm::vec4 cascades[SHADOW_MAX_CASCADES];
+	glm::vec4 sun_direction;
+	glm::vec4 sun_color;
+};
+
+struct ShadowPending {
+	unsigned int cascade;
+	ShadowUpdateReason reason;
+	unsigned long planned_plan;
+};
+
+static ShadowSettings shadow_settings = { SHADOW_MAX_CASCADES, 40.0f, 2 };
+static ShadowCascade cascades[SHADOW_MAX_CASCADES];
+static std::vector<ShadowPending> pending;
+static std::vector<unsigned int> caster_indices;
+static unsigned long plan_count = 0;
+// Written by the GL thread. The plan each cascade's tile was last drawn in, and the last plan rendered at all.
+static std::atomic<unsigned long> drawn_plans[SHADOW_MAX_CASCADES];
+static std::atomic<unsigned long> rendered_plan(0);
+
+static GLuint uniform_buffer = 0;
+static GLuint atlas = 0;
+static GLuint atlas_framebuffer = 0;
+
+static const char* UPDATE_REASON_NAMES[SHADOW_UPDATE_REASON_COUNT] = { "coverage", "light", "casters" };
+
+void shadow_init(const ShadowSettings& settings) {
+	shadow_settings = settings;
+	shadow_settings.cascade_count = glm::clamp(settings.cascade_count, 1u, SHADOW_MAX_CASCADES);
+	for (unsigned int i = 0; i < SHADOW_MAX_CASCADES; i++) {
+		cascades[i] = ShadowCascade();
+		cascades[i].tile = i;
+		drawn_plans[i].store(0);
+	}
+	plan_count = 0;
+	rendered_plan.store(0);
+}
+
+const char* shadow_update_reason_name(ShadowUpdateReason reason) {
+	return UPDATE_REASON_NAMES[reason];
+}
+
+size_t shadow_atlas_bytes() {
+	return (size_t)SHADOW_ATLAS_SIZE * SHADOW_ATLAS_SIZE * 4;
+}
+
+static glm::uvec2 shadow_tile_offset(unsigned int tile) {
+	unsigned int tiles_per_row = SHADOW_ATLAS_SIZE / SHADOW_TILE_SIZE;
+	return glm::uvec2(tile % tiles_per_row, tile / tiles_per_row) * SHADOW_TILE_SIZE;
+}
+
+// Looks down the sun direction, any up vector not parallel to it will do
+static glm::mat4 shadow_light_rotation(glm::vec3 direction) {
+	glm::vec3 up = glm::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	return glm::lookAt(glm::vec3(0.0f), -direction, up);
+}
+
+// Whether a sphere in light space may shadow anything in the cascade's box. Casters between the box and the sun are
+// kept, they are clamped onto the near plane when drawn.
+static bool shadow_casts_into(const ShadowCascade& cascade, glm::vec3 center, float radius) {
+	glm::vec3 distance = center - cascade.center;
+	return glm::abs(distance.x) <= cascade.radius + radius && glm::abs(distance.y) <= cascade.radius + radius && distance.z + radius >= -cascade.radius;
+}
+
+// FNV-1a over the indices and transforms of the casters
+static uint64_t shadow_hash(uint64_t hash, const void* data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+static uint64_t shadow_caster_hash(const ShadowCascade& cascade, const Scene& scene, const MeshBuffer& buffer, std::vector<unsigned int>* casters) {
+	uint64_t hash = 14695981039346656037ull;
+	if (casters != NULL) {
+		casters->clear();
+	}
+	for (unsigned int i = 0; i < scene.objects.size(); i++) {
+		const SceneObject& object = scene.objects[i];
+		glm::vec3 center = glm::vec3(cascade.rotation * object.model[3]);
+		if (!shadow_casts_into(cascade, center, buffer.primitives[object.primitive].bounding_radius)) {
+			continue;
+		}
+		hash = shadow_hash(hash, &i, sizeof(i));
+		hash = shadow_hash(hash, glm::value_ptr(object.model), sizeof(object.model));
+		if (casters != NULL) {
+			casters->push_back(i);
+		}
+	}
+	return hash;
+}
+
+void shadow_plan(ShadowFrame* frame, const Scene& scene, const MeshBuffer& buffer, unsigned int caster_program, const glm::mat4& view, const glm::mat4& projection, float near) {
+	PROFILE_ZONE("shadow_plan");
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	plan_count++;
+	frame->plan = plan_count;
+	frame->updates.clear();
+	memset(&frame->stats, 0, sizeof(frame->stats));
+	frame->enabled = scene.sun.color != glm::vec3(0.0f);
+	frame->sun_direction = scene.sun.direction;
+	frame->sun_color = scene.sun.color;
+	if (!frame->enabled) {
+		return;
+	}
+
+	glm::mat4 inverse_view = glm::inverse(view);
+	glm::vec3 camera_position = glm::vec3(inverse_view[3]);
+	glm::vec3 camera_forward = -glm::vec3(inverse_view[2]);
+	float tan_x = 1.0f / projection[0][0];
+	float tan_y = 1.0f / projection[1][1];
+	float corner_squared = tan_x * tan_x + tan_y * tan_y;
+	glm::mat4 rotation = shadow_light_rotation(scene.sun.direction);
+	unsigned int cascade_count = shadow_settings.cascade_count;
+	float far = shadow_settings.distance;
+
+	// Each slice's smallest bounding sphere, which only depends on the projection, so texel sizes stay put
+	glm::vec3 needed_centers[SHADOW_MAX_CASCADES];
+	float needed_radii[SHADOW_MAX_CASCADES];
+	float split_start = near;
+	for (unsigned int i = 0; i < cascade_count; i++) {
+		float fraction = (float)(i + 1) / (float)cascade_count;
+		float split_end = SPLIT_LAMBDA * near * glm::pow(far / near, fraction) + (1.0f - SPLIT_LAMBDA) * (near + (far - near) * fraction);
+		float center_distance = glm::min((split_start + split_end) * (1.0f + corner_squared) * 0.5f, split_end);
+		float far_offset = split_end - center_distance;
+		needed_radii[i] = glm::sqrt(far_offset * far_offset + split_end * split_end * corner_squared);
+		needed_centers[i] = camera_position + camera_forward * center_distance;
+		split_start = split_end;
+	}
+
+	// Acquire pairs with shadow_render(), so every tile drawn in a rendered plan is seen as drawn
+	unsigned long last_rendered = rendered_plan.load(std::memory_order_acquire);
+	pending.clear();
+	for (unsigned int i = 0; i < cascade_count; i++) {
+		ShadowCascade& cascade = cascades[i];
+		// Its plan was rendered without drawing it, so the tile never got the update
+		if (cascade.planned && cascade.planned_plan <= last_rendered && drawn_plans[i].load(std::memory_order_relaxed) != cascade.planned_plan) {
+			cascade.planned = false;
+		}
+		float radius = needed_radii[i] * CASCADE_PADDING;
+		glm::vec3 distance = glm::abs(glm::vec3(cascade.rotation * glm::vec4(needed_centers[i], 1.0f)) - cascade.center);
+		bool covered = glm::max(distance.x, glm::max(distance.y, distance.z)) + needed_radii[i] <= cascade.radius;
+		if (!cascade.planned || !covered || cascade.radius != radius) {
+			pending.push_back({ i, SHADOW_UPDATE_COVERAGE, cascade.planned_plan });
+		} else if (cascade.direction != scene.sun.direction) {
+			pending.push_back({ i, SHADOW_UPDATE_LIGHT, cascade.planned_plan });
+		} else if (shadow_caster_hash(cascade, scene, buffer, NULL) != cascade.caster_hash) {
+			pending.push_back({ i, SHADOW_UPDATE_CASTERS, cascade.planned_plan });
+		}
+	}
+	// Holes in the coverage first, then whatever has waited longest, so a sun that keeps moving doesn't starve the
+	// far cascades, then whatever is nearest the camera
+	std::sort(pending.begin(), pending.end(), [](const ShadowPending& a, const ShadowPending& b) {
+		if (a.reason != b.reason) {
+			return a.reason < b.reason;
+		}
+		return a.planned_plan != b.planned_plan ? a.planned_plan < b.planned_plan : a.cascade < b.cascade;
+	});
+	unsigned int update_count = (unsigned int)pending.size();
+	if (shadow_settings.update_budget != 0) {
+		update_count = glm::min(update_count, shadow_settings.update_budget);
+	}
+	frame->stats.pending = (unsigned int)pending.size() - update_count;
+
+	frame->updates.resize(update_count);
+	for (unsigned int u = 0; u < update_count; u++) {
+		ShadowCascade& cascade = cascades[pending[u].cascade];
+		cascade.radius = needed_radii[pending[u].cascade] * CASCADE_PADDING;
+		float texel_size = 2.0f * cascade.radius / (float)SHADOW_TILE_SIZE;
+		glm::vec3 center = glm::vec3(rotation * glm::vec4(needed_centers[pending[u].cascade], 1.0f));
+		// Whole texel steps, so a re-rendered cascade samples the scene at the same points and edges don't crawl
+		center.x = glm::floor(center.x / texel_size) * texel_size;
+		center.y = glm::floor(center.y / texel_size) * texel_size;
+		cascade.center = center;
+		cascade.direction = scene.sun.direction;
+		cascade.rotation = rotation;
+		glm::mat4 light_projection = glm::ortho(center.x - cascade.radius, center.x + cascade.radius, center.y - cascade.radius, center.y + cascade.radius, -(center.z + cascade.radius), -(center.z - cascade.radius));
+		cascade.projection_view = light_projection * rotation;
+		cascade.caster_hash = shadow_caster_hash(cascade, scene, buffer, &caster_indices);
+		cascade.planned = true;
+		cascade.planned_plan = plan_count;
+
+		ShadowUpdate& update = frame->updates[u];
+		update.cascade = pending[u].cascade;
+		update.reason = pending[u].reason;
+		update.projection_view = cascade.projection_view;
+		update.offset = shadow_tile_offset(cascade.tile);
+		update.casters.clear();
+		for (unsigned int index : caster_indices) {
+			const SceneObject& object = scene.objects[index];
+			const MeshPrimitive& full_primitive = buffer.primitives[object.primitive];
+			// The coarsest level whose error stays under a texel. Coarser levels sit inside the full one, so they
+			// never shadow the surface they stand in for.
+			float fade;
+			unsigned int lod = mesh_select_lod(full_primitive, 1.0f, 1.0f / texel_size, 1.0f, 0.0f, &fade);
+			const MeshPrimitive& primitive = buffer.primitives[full_primitive.lods[lod]];
+			RenderDraw draw = {};
+			draw.kind = RENDER_DRAW_ELEMENTS;
+			draw.pass = RENDER_PASS_OPAQUE;
+			draw.program = caster_program;
+			draw.texture_set = RENDER_NO_TEXTURE_SET;
+			draw.material = RENDER_NO_MATERIAL;
+			draw.vao = buffer.vao;
+			draw.mode = primitive.mode;
+			draw.first = primitive.first_index;
+			draw.count = primitive.index_count;
+			draw.base_vertex = primitive.base_vertex;
+			draw.index_type = buffer.index_type;
+			draw.model = object.model;
+			draw.lod_fade = 0.0f;
+			update.casters.push_back(draw);
+			frame->stats.triangles += mesh_triangle_count(primitive.mode, primitive.index_count);
+		}
+		frame->stats.draws += (unsigned int)update.casters.size();
+		frame->stats.updates_by_reason[update.reason]++;
+	}
+	frame->stats.updates = update_count;
+
+	// Maps [-1, 1] clip space onto [0, 1] texture coordinates and depth
+	glm::mat4 bias = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+	float tile_scale = (float)SHADOW_TILE_SIZE / (float)SHADOW_ATLAS_SIZE;
+	for (unsigned int i = 0; i < SHADOW_MAX_CASCADES; i++) {
+		const ShadowCascade& cascade = cascades[i];
+		bool used = i < cascade_count && cascade.planned;
+		frame->matrices[i] = bias * cascade.projection_view;
+		frame->tiles[i] = glm::vec4(glm::vec2(shadow_tile_offset(cascade.tile)) / (float)SHADOW_ATLAS_SIZE, tile_scale, tile_scale);
+		frame->cascades[i] = glm::vec4(2.0f * cascade.radius / (float)SHADOW_TILE_SIZE, used ? 1.0f : 0.0f, 0.0f, 0.0f);
+		frame->stats.tiles_used += used ? 1 : 0;
+	}
+
+	frame->stats.plan_ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static void shadow_create_buffers() {
+	glGenBuffers(1, &uniform_buffer);
+	ShadowUniforms uniforms = {};
+	glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(uniforms), &uniforms, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, SHADOW_UNIFORM_BINDING, uniform_buffer);
+}
+
+// The atlas only exists once the sun is on. Sampled with depth comparison, so PCF taps are filtered in hardware.
+static void shadow_create_atlas() {
+	glGenTextures(1, &atlas);
+	gl_state_bind_texture(SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D, atlas);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glGenFramebuffers(1, &atlas_framebuffer);
+	gl_state_bind_framebuffer(GL_FRAMEBUFFER, atlas_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlas, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		printf("Shadow atlas framebuffer not complete!\n");
+	}
+
+	// Nothing is rendered until the first plan, and an empty tile must not shadow anything
+	gl_state_depth_mask(GL_TRUE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+// Every lit program reads the block, so it is created with the first of them even if the sun stays off
+void shadow_set_uniforms(GLuint program) {
+	if (uniform_buffer == 0) {
+		shadow_create_buffers();
+	}
+	GLuint block = glGetUniformBlockIndex(program, "shadow_data");
+	if (block != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, block, SHADOW_UNIFORM_BINDING);
+	}
+	glUniform1i(glGetUniformLocation(program, "shadow_atlas"), SHADOW_TEXTURE_UNIT);
+}
+
+// The atlas outlives the frame, so it is drawn here rather than declared to the render graph, whose textures are
+// transient. Each tile is scissored so its clear leaves the cached ones alone.
+void shadow_render(RenderQueue* queue, const ShadowFrame& frame) {
+	if (uniform_buffer == 0) {
+		shadow_create_buffers();
+	}
+	// The block was created saying the sun is off
+	if (!frame.enabled) {
+		rendered_plan.store(frame.plan, std::memory_order_release);
+		return;
+	}
+	if (atlas == 0) {
+		shadow_create_atlas();
+	}
+
+	if (!frame.updates.empty()) {
+		gpu_timer_begin("shadows");
+		gl_state_bind_framebuffer(GL_FRAMEBUFFER, atlas_framebuffer);
+		gl_state_enable(GL_DEPTH_TEST);
+		gl_state_depth_func(GL_LESS);
+		gl_state_depth_mask(GL_TRUE);
+		// Casters between the sun and the near plane are flattened onto it instead of clipped
+		glEnable(GL_DEPTH_CLAMP);
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(POLYGON_OFFSET_FACTOR, POLYGON_OFFSET_UNITS);
+		glEnable(GL_SCISSOR_TEST);
+		// Draws and triangles were already counted when planning
+		RenderQueueStats stats = {};
+		for (const ShadowUpdate& update : frame.updates) {
+			glViewport(update.offset.x, update.offset.y, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE);
+			glScissor(update.offset.x, update.offset.y, SHADOW_TILE_SIZE, SHADOW_TILE_SIZE);
+			glClear(GL_DEPTH_BUFFER_BIT);
+			render_queue_execute_casters(queue, update.casters, update.projection_view, &stats);
+			drawn_plans[update.cascade].store(frame.plan, std::memory_order_relaxed);
+		}
+		glDisable(GL_SCISSOR_TEST);
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glDisable(GL_DEPTH_CLAMP);
+		gpu_timer_end();
+	}
+
+	ShadowUniforms uniforms;
+	memcpy(uniforms.matrices, frame.matrices, sizeof(uniforms.matrices));
+	memcpy(uniforms.tiles, frame.tiles, sizeof(uniforms.tiles));
+	memcpy(uniforms.cascades, frame.cascades, sizeof(uniforms.cascades));
+	uniforms.sun_direction = glm::vec4(frame.sun_direction, frame.enabled ? 1.0f : 0.0f);
+	uniforms.sun_color = glm::vec4(frame.sun_color, 0.0f);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniform_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(uniforms), &uniforms);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	if (atlas != 0) {
+		gl_state_bind_texture(SHADOW_TEXTURE_UNIT, GL_TEXTURE_2D, atlas);
+	}
+	rendered_plan.store(frame.plan, std::memory_order_release);
+}
+
+void shadow_destroy_buffers() {
+	if (atlas != 0) {
+		glDeleteFramebuffers(1, &atlas_framebuffer);
+		glDeleteTextures(1, &atlas);
+		atlas = 0;
+	}
+	if (uniform_buffer != 0) {
+		glDeleteBuffers(1, &uniform_buffer);
+		uniform_buffer = 0;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "mesh.h"
+#include "render_queue.h"
+#include "scene.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Cascaded shadow maps for the scene's sun, cached across frames. Each cascade is a tile of one depth atlas and keeps
+// its last render for as long as it stays usable. It is only rendered again when:
+// - the camera's slice no longer fits in it. Cascades cover their slice with room to spare, around a texel snapped
+//   center, so small camera moves don't touch them.
+// - the sun has moved since it was rendered
+// - the casters inside it changed, which is caught by hashing their transforms
+// At most the update budget of cascades are rendered per frame, the ones the camera has left first. A cascade
+// waiting its turn is still sampled with the matrix it was rendered with, so the shader takes the first cascade that
+// covers a pixel rather than the one the pixel's distance would pick.
+//
+// Planning runs off the GL thread, like the light clusters. The GL thread only renders the planned tiles and uploads
+// the matrices to a uniform block every lit program shares. It reports back which plan each cascade was last drawn
+// in and the last plan it rendered at all, so an update planned into a frame that never got drawn is planned again.
+const unsigned int SHADOW_MAX_CASCADES = 4;
+const unsigned int SHADOW_ATLAS_SIZE = 2048;
+const unsigned int SHADOW_TILE_SIZE = 1024;
+const unsigned int SHADOW_ATLAS_TILES = (SHADOW_ATLAS_SIZE / SHADOW_TILE_SIZE) * (SHADOW_ATLAS_SIZE / SHADOW_TILE_SIZE);
+const unsigned int SHADOW_TEXTURE_UNIT = 15;
+const unsigned int SHADOW_UNIFORM_BINDING = 0;
+
+enum ShadowUpdateReason {
+	// Never rendered, or the camera's slice left it
+	SHADOW_UPDATE_COVERAGE,
+	SHADOW_UPDATE_LIGHT,
+	SHADOW_UPDATE_CASTERS,
+	SHADOW_UPDATE_REASON_COUNT
+};
+
+struct ShadowSettings {
+	unsigned int cascade_count;
+	// Distance from the camera the last cascade reaches
+	float distance;
+	// Cascades rendered per frame at most, 0 for no limit
+	unsigned int update_budget;
+};
+
+// A cascade to render this frame
+struct ShadowUpdate {
+	unsigned int cascade;
+	ShadowUpdateReason reason;
+	glm::mat4 projection_view;
+	// Atlas pixels the tile starts at
+	glm::uvec2 offset;
+	std::vector<RenderDraw> casters;
+};
+
+struct ShadowStats {
+	unsigned int updates;
+	unsigned int updates_by_reason[SHADOW_UPDATE_REASON_COUNT];
+	// Cascades still due for an update once this frame's budget ran out
+	unsigned int pending;
+	unsigned int draws;
+	unsigned int triangles;
+	unsigned int tiles_used;
+	double plan_ms;
+};
+
+// One frame's shadows. Built without GL, so it can be part of the render packet.
+struct ShadowFrame {
+	// Counts up from 1 with every shadow_plan()
+	unsigned long plan;
+	bool enabled;
+	// Towards the sun
+	glm::vec3 sun_direction;
+	glm::vec3 sun_color;
+	// World space to each cascade's [0, 1] texture coordinates and depth
+	glm::mat4 matrices[SHADOW_MAX_CASCADES];
+	// Atlas offset in xy and scale in zw of each cascade's tile
+	glm::vec4 tiles[SHADOW_MAX_CASCADES];
+	// World size of one texel in x, 1 in y once the cascade has been rendered
+	glm::vec4 cascades[SHADOW_MAX_CASCADES];
+	std::vector<ShadowUpdate> updates;
+	ShadowStats stats;
+};
+
+// cascade_count is clamped to SHADOW_MAX_CASCADES
+void shadow_init(const ShadowSettings& settings);
+const char* shadow_update_reason_name(ShadowUpdateReason reason);
+// Assumes a symmetric perspective projection starting at near and unscaled models. Casters are drawn with the depth
+// program of the queue program given. Not reentrant, only one thread may plan at a time.
+void shadow_plan(ShadowFrame* frame, const Scene& scene, const MeshBuffer& buffer, unsigned int caster_program, const glm::mat4& view, const glm::mat4& projection, float near);
+size_t shadow_atlas_bytes();
+
+// GL side. Binds the shadow_data block and atlas sampler of a program that includes pbr_common.glsl.
+void shadow_set_uniforms(GLuint program);
+// Renders the frame's updates into the atlas, then uploads the cascades and binds the atlas. Every planned frame that
+// is drawn has to come through here, sun or not, since planning relies on hearing back about it.
+void shadow_render(RenderQueue* queue, const ShadowFrame& frame);
+void shadow_destroy_buffers();
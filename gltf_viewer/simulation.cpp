@@ -0,0 +1,109 @@
+#include "simulation.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+
+static const float CAMERA_SPEED = 16.0f;
+static const float CAMERA_SENSITIVITY = 0.1f;
+
+void simulation_init(Simulation* simulation, CameraState camera) {
+	*simulation = Simulation();
+	simulation->current.camera = camera;
+	simulation->previous = simulation->current;
+}
+
+unsigned int simulation_advance(Simulation* simulation, float delta) {
+	simulation->accumulator += delta;
+	float max_accumulator = SIMULATION_TICK_SECONDS * SIMULATION_MAX_TICKS_PER_FRAME;
+	if (simulation->accumulator > max_accumulator) {
+		simulation->accumulator = max_accumulator;
+	}
+
+	unsigned int ticks = 0;
+	while (simulation->accumulator >= SIMULATION_TICK_SECONDS) {
+		simulation->previous = simulation->current;
+		simulation_tick(&simulation->current, simulation->input);
+		simulation->input.look_x = 0.0f;
+		simulation->input.look_y = 0.0f;
+		simulation->accumulator -= SIMULATION_TICK_SECONDS;
+		ticks++;
+	}
+	simulation->ticks_last_frame = ticks;
+
+	return ticks;
+}
+
+void simulation_tick(SimulationState* state, const SimulationInput& input) {
+	CameraState& camera = state->camera;
+
+	camera.yaw += input.look_x * CAMERA_SENSITIVITY;
+	camera.pitch -= input.look_y * CAMERA_SENSITIVITY;
+	if (camera.pitch > 89.0f) {
+		camera.pitch = 89.0f;
+	} else if (camera.pitch < -89.0f) {
+		camera.pitch = -89.0f;
+	}
+
+	glm::vec3 forward, right, up;
+	camera_get_basis(camera, &forward, &right, &up);
+
+	glm::vec3 move_direction = glm::vec3(0.0f);
+	if (input.forward) {
+		move_direction += forward;
+	}
+	if (input.back) {
+		move_direction -= forward;
+	}
+	if (input.left) {
+		move_direction -= right;
+	}
+	if (input.right) {
+		move_direction += right;
+	}
+	if (input.up) {
+		move_direction += glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+	if (input.down) {
+		move_direction -= glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+	if (glm::length(move_direction) > 0.0f) {
+		camera.position += glm::normalize(move_direction) * CAMERA_SPEED * SIMULATION_TICK_SECONDS;
+	}
+
+	state->tick++;
+}
+
+CameraState simulation_interpolate_camera(const Simulation& simulation) {
+	float alpha = simulation.accumulator / SIMULATION_TICK_SECONDS;
+	const CameraState& previous = simulation.previous.camera;
+	const CameraState& current = simulation.current.camera;
+
+	CameraState camera;
+	camera.position = glm::mix(previous.position, current.position, alpha);
+	camera.yaw = glm::mix(previous.yaw, current.yaw, alpha);
+	camera.pitch = glm::mix(previous.pitch, current.pitch, alpha);
+
+	return camera;
+}
+
+float simulation_time(const Simulation& simulation) {
+	float alpha = simulation.accumulator / SIMULATION_TICK_SECONDS;
+	return ((float)simulation.previous.tick + alpha) * SIMULATION_TICK_SECONDS;
+}
+
+void camera_get_basis(const CameraState& camera, glm::vec3* forward, glm::vec3* right, glm::vec3* up) {
+	*forward = glm::normalize(glm::vec3(
+		std::cos(glm::radians(camera.yaw)) * std::cos(glm::radians(camera.pitch)),
+		std::sin(glm::radians(camera.pitch)),
+		std::sin(glm::radians(camera.yaw)) * std::cos(glm::radians(camera.pitch))
+	));
+	*right = glm::normalize(glm::cross(*forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+	*up = glm::normalize(glm::cross(*right, *forward));
+}
+
+glm::mat4 camera_view_matrix(const CameraState& camera) {
+	glm::vec3 forward, right, up;
+	camera_get_basis(camera, &forward, &right, &up);
+
+	return glm::lookAt(camera.position, camera.position + forward, up);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// The simulation advances in fixed ticks so its results don't depend on the frame rate. Rendering happens between
+// ticks and interpolates the last two states by how far it is into the next tick.
+const float SIMULATION_TICK_SECONDS = 1.0f / 60.0f;
+// If rendering falls further behind than this, the remaining time is dropped instead of simulated
+const unsigned int SIMULATION_MAX_TICKS_PER_FRAME = 8;
+
+struct CameraState {
+	glm::vec3 position;
+	float yaw;
+	float pitch;
+};
+
+// Input gathered since the last tick. Look deltas are in mouse counts and are used up by the next tick.
+struct SimulationInput {
+	bool forward;
+	bool back;
+	bool left;
+	bool right;
+	bool up;
+	bool down;
+	float look_x;
+	float look_y;
+};
+
+struct SimulationState {
+	CameraState camera;
+	unsigned long tick;
+};
+
+struct Simulation {
+	SimulationState previous;
+	SimulationState current;
+	SimulationInput input;
+	float accumulator;
+	unsigned int ticks_last_frame;
+};
+
+void simulation_init(Simulation* simulation, CameraState camera);
+// Runs as many ticks as fit in the elapsed time and returns how many ran
+unsigned int simulation_advance(Simulation* simulation, float delta);
+void simulation_tick(SimulationState* state, const SimulationInput& input);
+// Camera state at render time, blended between the previous and current tick
+CameraState simulation_interpolate_camera(const Simulation& simulation);
+// Seconds simulated at render time, interpolated between the previous and current tick like the camera
+float simulation_time(const Simulation& simulation);
+
+void camera_get_basis(const CameraState& camera, glm::vec3* forward, glm::vec3* right, glm::vec3* up);
+glm::mat4 camera_view_matrix(const CameraState& camera);
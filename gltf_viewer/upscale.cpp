@@ -0,0 +1,31 @@
+#include "upscale.h"
+#include "gl_state.h"
+
+#include <cmath>
+
+static const char* UPSCALER_NAMES[UPSCALER_COUNT] = { "bilinear", "easu" };
+static const char* UPSCALE_PRESET_NAMES[UPSCALE_PRESET_COUNT] = { "ultra_quality", "quality", "balanced", "performance" };
+// Per axis, so performance renders a quarter of the pixels
+static const float UPSCALE_PRESET_SCALES[UPSCALE_PRESET_COUNT] = { 1.0f / 1.3f, 1.0f / 1.5f, 1.0f / 1.7f, 1.0f / 2.0f };
+
+const char* upscaler_name(Upscaler upscaler) {
+	return UPSCALER_NAMES[upscaler];
+}
+
+const char* upscale_preset_name(UpscalePreset preset) {
+	return UPSCALE_PRESET_NAMES[preset];
+}
+
+float upscale_preset_scale(UpscalePreset preset) {
+	return UPSCALE_PRESET_SCALES[preset];
+}
+
+void upscale_set_uniforms(const UpscalePrograms& programs) {
+	GLuint source_programs[3] = { programs.bilinear, programs.easu, programs.rcas };
+	for (GLuint program : source_programs) {
+		gl_state_use_program(program);
+		glUniform1i(glGetUniformLocation(program, "screen_texture"), 0);
+	}
+	gl_state_use_program(programs.rcas);
+	glUniform1f(glGetUniformLocation(programs.rcas, "sharpness"), std::exp2(-UPSCALE_RCAS_SHARPNESS_STOPS));
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Spatial upscaling of the scene from its render size to the window, when it is rendered smaller
+// - Bilinear is the present pass sampling the scene color with linear filtering
+// - EASU is an edge-adaptive pass that upsamples into a window sized target, see shader/easu_fs.glsl. The present
+//   pass then runs RCAS over it, which sharpens without ringing, see shader/rcas_fs.glsl.
+// Both are timed as GPU zones named after their passes. At the window's size the scene is presented as it is.
+enum Upscaler {
+	UPSCALER_BILINEAR,
+	UPSCALER_EASU,
+	UPSCALER_COUNT
+};
+
+// Fixed render scales, from the least upscaling to the most
+enum UpscalePreset {
+	UPSCALE_PRESET_ULTRA_QUALITY,
+	UPSCALE_PRESET_QUALITY,
+	UPSCALE_PRESET_BALANCED,
+	UPSCALE_PRESET_PERFORMANCE,
+	UPSCALE_PRESET_COUNT
+};
+
+// Stops of sharpness taken off RCAS's maximum, 0 is the sharpest
+const float UPSCALE_RCAS_SHARPNESS_STOPS = 0.2f;
+
+struct UpscalePrograms {
+	GLuint bilinear;
+	GLuint easu;
+	GLuint rcas;
+};
+
+const char* upscaler_name(Upscaler upscaler);
+const char* upscale_preset_name(UpscalePreset preset);
+// Of the window's width and height
+float upscale_preset_scale(UpscalePreset preset);
+// Sets the programs' constant uniforms, the source texture is read from unit 0
+void upscale_set_uniforms(const UpscalePrograms& programs);
@@ -0,0 +1,156 @@
+#include "vertex_format.h"
+#include "mesh.h"
+
+#include <glm/gtc/packing.hpp>
+#include <cstring>
+
+static VertexAttributeFormat vertex_attribute_format(VertexEncoding encoding, GLint float_components) {
+	VertexAttributeFormat attribute;
+	attribute.encoding = encoding;
+	attribute.offset = 0;
+	switch (encoding) {
+		case VERTEX_ENCODING_FLOAT:
+			attribute.components = float_components;
+			attribute.type = GL_FLOAT;
+			attribute.normalized = GL_FALSE;
+			attribute.size = float_components * sizeof(float);
+			break;
+		case VERTEX_ENCODING_UNORM16:
+			attribute.components = 3;
+			attribute.type = GL_UNSIGNED_SHORT;
+			attribute.normalized = GL_TRUE;
+			attribute.size = 3 * sizeof(uint16_t);
+			break;
+		case VERTEX_ENCODING_OCTAHEDRAL_SNORM16:
+			attribute.components = 2;
+			attribute.type = GL_SHORT;
+			attribute.normalized = GL_TRUE;
+			attribute.size = 2 * sizeof(int16_t);
+			break;
+		case VERTEX_ENCODING_SNORM10:
+			attribute.components = 4;
+			attribute.type = GL_INT_2_10_10_10_REV;
+			attribute.normalized = GL_TRUE;
+			attribute.size = sizeof(uint32_t);
+			break;
+		case VERTEX_ENCODING_HALF:
+			attribute.components = 2;
+			attribute.type = GL_HALF_FLOAT;
+			attribute.normalized = GL_FALSE;
+			attribute.size = 2 * sizeof(uint16_t);
+			break;
+	}
+	return attribute;
+}
+
+// Packed and float types need 4 byte alignment, the 16 bit ones 2
+static unsigned int vertex_attribute_alignment(const VertexAttributeFormat& attribute) {
+	return attribute.type == GL_SHORT || attribute.type == GL_UNSIGNED_SHORT || attribute.type == GL_HALF_FLOAT ? 2 : 4;
+}
+
+VertexFormat vertex_format_create(const char* name, VertexEncoding position, VertexEncoding normal, VertexEncoding texture_coordinates) {
+	VertexFormat format;
+	format.name = name;
+	format.position = vertex_attribute_format(position, 3);
+	format.normal = vertex_attribute_format(normal, 3);
+	format.texture_coordinates = vertex_attribute_format(texture_coordinates, 2);
+
+	VertexAttributeFormat* attributes[] = { &format.position, &format.normal, &format.texture_coordinates };
+	unsigned int offset = 0;
+	unsigned int max_alignment = 1;
+	for (unsigned int alignment = 4; alignment >= 2; alignment -= 2) {
+		for (VertexAttributeFormat* attribute : attributes) {
+			if (vertex_attribute_alignment(*attribute) == alignment) {
+				attribute->offset = offset;
+				offset += attribute->size;
+				max_alignment = glm::max(max_alignment, alignment);
+			}
+		}
+	}
+	format.stride = (offset + max_alignment - 1) / max_alignment * max_alignment;
+
+	return format;
+}
+
+VertexFormat vertex_format_full() {
+	return vertex_format_create("full", VERTEX_ENCODING_FLOAT, VERTEX_ENCODING_FLOAT, VERTEX_ENCODING_FLOAT);
+}
+
+VertexFormat vertex_format_compact() {
+	return vertex_format_create("compact", VERTEX_ENCODING_UNORM16, VERTEX_ENCODING_OCTAHEDRAL_SNORM16, VERTEX_ENCODING_HALF);
+}
+
+VertexFormat vertex_format_packed() {
+	return vertex_format_create("packed", VERTEX_ENCODING_UNORM16, VERTEX_ENCODING_SNORM10, VERTEX_ENCODING_HALF);
+}
+
+void vertex_format_apply(const VertexFormat& format) {
+	const VertexAttributeFormat* attributes[] = { &format.position, &format.normal, &format.texture_coordinates };
+	for (GLuint location = 0; location < 3; location++) {
+		const VertexAttributeFormat& attribute = *attributes[location];
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, attribute.components, attribute.type, attribute.normalized, format.stride, (void*)(uintptr_t)attribute.offset);
+	}
+}
+
+// Projects onto the octahedron |x| + |y| + |z| = 1 and unfolds the lower half over the corners of the upper one
+static glm::vec2 vertex_octahedral_encode(glm::vec3 normal) {
+	normal /= glm::abs(normal.x) + glm::abs(normal.y) + glm::abs(normal.z);
+	glm::vec2 encoded = glm::vec2(normal.x, normal.y);
+	if (normal.z < 0.0f) {
+		glm::vec2 sign = glm::vec2(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+		encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * sign;
+	}
+	return encoded;
+}
+
+static void vertex_write(std::vector<uint8_t>* data, size_t offset, const void* value, size_t size) {
+	memcpy(data->data() + offset, value, size);
+}
+
+static void vertex_encode_attribute(const VertexAttributeFormat& attribute, glm::vec3 value, std::vector<uint8_t>* data, size_t offset) {
+	switch (attribute.encoding) {
+		case VERTEX_ENCODING_FLOAT:
+			vertex_write(data, offset, &value[0], attribute.size);
+			break;
+		case VERTEX_ENCODING_UNORM16: {
+			uint16_t encoded[3];
+			for (int i = 0; i < 3; i++) {
+				encoded[i] = (uint16_t)glm::round(glm::clamp(value[i], 0.0f, 1.0f) * 65535.0f);
+			}
+			vertex_write(data, offset, encoded, sizeof(encoded));
+			break;
+		}
+		case VERTEX_ENCODING_OCTAHEDRAL_SNORM16: {
+			glm::vec2 octahedral = vertex_octahedral_encode(value);
+			int16_t encoded[2];
+			for (int i = 0; i < 2; i++) {
+				encoded[i] = (int16_t)glm::round(glm::clamp(octahedral[i], -1.0f, 1.0f) * 32767.0f);
+			}
+			vertex_write(data, offset, encoded, sizeof(encoded));
+			break;
+		}
+		case VERTEX_ENCODING_SNORM10: {
+			uint32_t encoded = glm::packSnorm3x10_1x2(glm::vec4(value, 0.0f));
+			vertex_write(data, offset, &encoded, sizeof(encoded));
+			break;
+		}
+		case VERTEX_ENCODING_HALF: {
+			uint16_t encoded[2] = { glm::packHalf1x16(value.x), glm::packHalf1x16(value.y) };
+			vertex_write(data, offset, encoded, sizeof(encoded));
+			break;
+		}
+	}
+}
+
+void vertex_format_encode(const VertexFormat& format, const Vertex* vertices, size_t count, glm::vec3 position_offset, glm::vec3 position_scale, std::vector<uint8_t>* data) {
+	data->assign(count * format.stride, 0);
+	bool quantized = format.position.encoding != VERTEX_ENCODING_FLOAT;
+	for (size_t i = 0; i < count; i++) {
+		size_t offset = i * format.stride;
+		glm::vec3 position = quantized ? (vertices[i].position - position_offset) / position_scale : vertices[i].position;
+		vertex_encode_attribute(format.position, position, data, offset + format.position.offset);
+		vertex_encode_attribute(format.normal, glm::normalize(vertices[i].normal), data, offset + format.normal.offset);
+		vertex_encode_attribute(format.texture_coordinates, glm::vec3(vertices[i].texture_coordinates, 0.0f), data, offset + format.texture_coordinates.offset);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+
+// How each vertex attribute is stored in the GPU buffer. The CPU side always keeps full Vertex structs, these only
+// change what mesh_buffer_upload writes and how the shaders decode it (see vertex_decode.glsl).
+enum VertexEncoding {
+	VERTEX_ENCODING_FLOAT,
+	// Positions as unsigned 16 bit fractions of the mesh bounds
+	VERTEX_ENCODING_UNORM16,
+	// Unit vectors folded onto an octahedron and stored as two signed 16 bit values
+	VERTEX_ENCODING_OCTAHEDRAL_SNORM16,
+	// Unit vectors as signed 10 bit x, y and z
+	VERTEX_ENCODING_SNORM10,
+	// Texture coordinates as half floats
+	VERTEX_ENCODING_HALF
+};
+
+struct VertexAttributeFormat {
+	VertexEncoding encoding;
+	GLint components;
+	GLenum type;
+	GLboolean normalized;
+	unsigned int offset;
+	unsigned int size;
+};
+
+// Attributes in shader locations 0, 1 and 2
+struct VertexFormat {
+	const char* name;
+	VertexAttributeFormat position;
+	VertexAttributeFormat normal;
+	VertexAttributeFormat texture_coordinates;
+	unsigned int stride;
+};
+
+// Lays out the attributes largest alignment first and pads the stride so every vertex stays aligned
+VertexFormat vertex_format_create(const char* name, VertexEncoding position, VertexEncoding normal, VertexEncoding texture_coordinates);
+// 32 bytes, plain floats
+VertexFormat vertex_format_full();
+// 14 bytes: 16 bit positions, octahedral normals and half float texture coordinates
+VertexFormat vertex_format_compact();
+// 16 bytes: like compact but with 10-10-10-2 normals
+VertexFormat vertex_format_packed();
+// Points attributes 0 to 2 of the bound VAO at the bound GL_ARRAY_BUFFER
+void vertex_format_apply(const VertexFormat& format);
+// Quantized positions decode as position_offset + position * position_scale
+void vertex_format_encode(const VertexFormat& format, const Vertex* vertices, size_t count, glm::vec3 position_offset, glm::vec3 position_scale, std::vector<uint8_t>* data);
@@ -0,0 +1,122 @@
+#include "visibility.h"
+#include "gl_state.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <vector>
+
+enum VisibilityBuffer {
+	VISIBILITY_INSTANCE_DATA,
+	VISIBILITY_VERTICES,
+	VISIBILITY_INDICES,
+	VISIBILITY_BUFFER_COUNT
+};
+
+// Texels of instance data per instance: the model matrix, then the normal matrix with metallic, roughness and ao in
+// the w of its columns, then the albedo, all as float bits, then the first index, base vertex and whether it is a
+// strip. One integer table keeps the instances to a single texture unit.
+static const unsigned int INSTANCE_TEXELS = 9;
+
+static GLuint instance_buffer;
+static GLuint textures[VISIBILITY_BUFFER_COUNT];
+static VertexFormat vertex_format;
+static unsigned int triangle_bits = 0;
+
+static std::vector<glm::uvec4> instance_data;
+
+void visibility_init(const MeshBuffer& buffer) {
+	unsigned int max_triangles = 1;
+	for (const MeshPrimitive& primitive : buffer.primitives) {
+		max_triangles = std::max(max_triangles, mesh_triangle_count(primitive.mode, primitive.index_count));
+	}
+	triangle_bits = 1;
+	while (triangle_bits < 31 && (1u << triangle_bits) < max_triangles) {
+		triangle_bits++;
+	}
+	vertex_format = buffer.format;
+
+	// The vertex buffer is read 16 bits at a time, every attribute offset and stride is a multiple of 2
+	glGenBuffers(1, &instance_buffer);
+	glGenTextures(VISIBILITY_BUFFER_COUNT, textures);
+	glBindBuffer(GL_TEXTURE_BUFFER, instance_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+	GLenum formats[VISIBILITY_BUFFER_COUNT] = { GL_RGBA32UI, GL_R16UI, (GLenum)(buffer.index_type == GL_UNSIGNED_INT ? GL_R32UI : GL_R16UI) };
+	GLuint sources[VISIBILITY_BUFFER_COUNT] = { instance_buffer, buffer.vbo, buffer.ebo };
+	for (unsigned int i = 0; i < VISIBILITY_BUFFER_COUNT; i++) {
+		gl_state_bind_texture(VISIBILITY_TEXTURE_UNIT + 1 + i, GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], sources[i]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void visibility_quit() {
+	if (instance_buffer != 0) {
+		glDeleteTextures(VISIBILITY_BUFFER_COUNT, textures);
+		glDeleteBuffers(1, &instance_buffer);
+		instance_buffer = 0;
+	}
+}
+
+// ID 0 is left for pixels nothing covered, so instances are stored one up
+unsigned int visibility_max_instances() {
+	return (unsigned int)((0xFFFFFFFFull >> triangle_bits) - 1);
+}
+
+unsigned int visibility_triangle_bits() {
+	return triangle_bits;
+}
+
+void visibility_set_uniforms(GLuint program) {
+	glUniform1ui(glGetUniformLocation(program, "visibility_triangle_bits"), triangle_bits);
+
+	const VertexAttributeFormat* attributes[] = { &vertex_format.position, &vertex_format.normal, &vertex_format.texture_coordinates };
+	glm::uvec3 encodings;
+	glm::uvec3 offsets;
+	for (int i = 0; i < 3; i++) {
+		encodings[i] = (unsigned int)attributes[i]->encoding;
+		offsets[i] = attributes[i]->offset / 2;
+	}
+	glUniform3uiv(glGetUniformLocation(program, "vertex_encodings"), 1, glm::value_ptr(encodings));
+	glUniform3uiv(glGetUniformLocation(program, "vertex_offsets"), 1, glm::value_ptr(offsets));
+	glUniform1ui(glGetUniformLocation(program, "vertex_stride"), vertex_format.stride / 2);
+
+	const char* samplers[] = { "visibility_buffer", "visibility_instance_data", "mesh_vertices", "mesh_indices" };
+	for (int i = 0; i < 4; i++) {
+		glUniform1i(glGetUniformLocation(program, samplers[i]), VISIBILITY_TEXTURE_UNIT + i);
+	}
+}
+
+void visibility_upload(const RenderQueue& queue, const RenderList& list, GLuint visibility_texture) {
+	instance_data.clear();
+	instance_data.reserve(queue.visibility_draws.size() * INSTANCE_TEXELS);
+	for (uint32_t index : queue.visibility_draws) {
+		const RenderDraw& draw = list.draws[index];
+		glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(draw.model)));
+		Material material = {};
+		if (draw.material != RENDER_NO_MATERIAL) {
+			material = (*queue.materials)[draw.material];
+		}
+		for (int column = 0; column < 4; column++) {
+			instance_data.push_back(glm::floatBitsToUint(draw.model[column]));
+		}
+		instance_data.push_back(glm::floatBitsToUint(glm::vec4(normal_matrix[0], material.metallic)));
+		instance_data.push_back(glm::floatBitsToUint(glm::vec4(normal_matrix[1], material.roughness)));
+		instance_data.push_back(glm::floatBitsToUint(glm::vec4(normal_matrix[2], material.ao)));
+		instance_data.push_back(glm::floatBitsToUint(glm::vec4(material.albedo, 1.0f)));
+		instance_data.push_back(glm::uvec4(draw.first, (unsigned int)draw.base_vertex, draw.mode == GL_TRIANGLE_STRIP ? 1 : 0, 0));
+	}
+
+	// Fresh storage every frame, so the upload doesn't wait on the last resolve
+	size_t size = instance_data.size() * sizeof(glm::uvec4);
+	glBindBuffer(GL_TEXTURE_BUFFER, instance_buffer);
+	glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t)16), NULL, GL_STREAM_DRAW);
+	if (size != 0) {
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, size, instance_data.data());
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	gl_state_bind_texture(VISIBILITY_TEXTURE_UNIT, GL_TEXTURE_2D, visibility_texture);
+	for (unsigned int i = 0; i < VISIBILITY_BUFFER_COUNT; i++) {
+		gl_state_bind_texture(VISIBILITY_TEXTURE_UNIT + 1 + i, GL_TEXTURE_BUFFER, textures[i]);
+	}
+}
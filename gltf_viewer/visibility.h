@@ -0,0 +1,29 @@
+#pragma once
+
+#include "mesh.h"
+#include "render_queue.h"
+#include <glad/glad.h>
+
+// Visibility buffer rendering (Burns and Hunt). The opaque draws write nothing but a 32 bit ID per pixel, their
+// instance in the high bits and the triangle within their primitive in the low ones, so overdraw only costs a depth
+// test and one small write. A fullscreen resolve then fetches each pixel's triangle straight from the shared mesh
+// buffers, rebuilds perspective correct barycentrics and their screen space derivatives from the three projected
+// vertices, and shades the pixel exactly once with the same PBR code as the other paths.
+//
+// Instances are the draws of the render queue's RENDER_QUEUE_VISIBILITY pass. Their transforms, materials and index
+// ranges are uploaded as a buffer texture after it, and the mesh buffer is read through buffer textures as well, so
+// it all works on GL 4.1. Only indexed draws from the shared mesh buffer can be resolved.
+const unsigned int VISIBILITY_BYTES_PER_PIXEL = 4 + 4;
+// The visibility buffer, instance data, vertices and indices are bound to this unit and the three after it
+const unsigned int VISIBILITY_TEXTURE_UNIT = 11;
+
+// Splits the IDs to fit the largest primitive in the buffer, which must already be uploaded
+void visibility_init(const MeshBuffer& buffer);
+void visibility_quit();
+// Instances the IDs have room for, see RenderQueue::visibility_capacity
+unsigned int visibility_max_instances();
+unsigned int visibility_triangle_bits();
+// Sets the ID split, the vertex layout and the sampler units on a program that includes visibility.glsl
+void visibility_set_uniforms(GLuint program);
+// Uploads the instances of the queue's last visibility pass and binds the buffer textures and the visibility buffer
+void visibility_upload(const RenderQueue& queue, const RenderList& list, GLuint visibility_texture);